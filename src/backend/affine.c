@@ -11,9 +11,9 @@
 void move_by_ox(matrix_t *A, float offset) {
   offset = limit_offset(offset);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][0] += offset;
-  }
+  // прибавление -0.0 не меняет остальные координаты
+  const float offsets[3] = {offset, -0.0f, -0.0f};
+  vertices_add(A->matrix, A->rows, offsets);
 }
 
 /**
@@ -27,9 +27,9 @@ void move_by_ox(matrix_t *A, float offset) {
 void move_by_oy(matrix_t *A, float offset) {
   offset = limit_offset(offset);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][1] += offset;
-  }
+  // прибавление -0.0 не меняет остальные координаты
+  const float offsets[3] = {-0.0f, offset, -0.0f};
+  vertices_add(A->matrix, A->rows, offsets);
 }
 
 /**
@@ -43,9 +43,9 @@ void move_by_oy(matrix_t *A, float offset) {
 void move_by_oz(matrix_t *A, float offset) {
   offset = limit_offset(offset);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][2] += offset;
-  }
+  // прибавление -0.0 не меняет остальные координаты
+  const float offsets[3] = {-0.0f, -0.0f, offset};
+  vertices_add(A->matrix, A->rows, offsets);
 }
 
 /**
@@ -75,12 +75,7 @@ float limit_offset(float offset) {
 void rotate_by_ox(matrix_t *A, float angle) {
   angle = deg_to_rad(angle);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    float temp_y = A->matrix[i][1];
-    float temp_z = A->matrix[i][2];
-    A->matrix[i][1] = cosf(angle) * temp_y - sinf(angle) * temp_z;
-    A->matrix[i][2] = sinf(angle) * temp_y + cosf(angle) * temp_z;
-  }
+  vertices_rotate(A->matrix, A->rows, 1, 2, cosf(angle), sinf(angle));
 }
 
 /**
@@ -94,12 +89,7 @@ void rotate_by_ox(matrix_t *A, float angle) {
 void rotate_by_oy(matrix_t *A, float angle) {
   angle = deg_to_rad(angle);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    float temp_x = A->matrix[i][0];
-    float temp_z = A->matrix[i][2];
-    A->matrix[i][0] = cosf(angle) * temp_x + sinf(angle) * temp_z;
-    A->matrix[i][2] = -sinf(angle) * temp_x + cosf(angle) * temp_z;
-  }
+  vertices_rotate(A->matrix, A->rows, 2, 0, cosf(angle), sinf(angle));
 }
 
 /**
@@ -113,12 +103,7 @@ void rotate_by_oy(matrix_t *A, float angle) {
 void rotate_by_oz(matrix_t *A, float angle) {
   angle = deg_to_rad(angle);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    float temp_x = A->matrix[i][0];
-    float temp_y = A->matrix[i][1];
-    A->matrix[i][0] = cosf(angle) * temp_x - sinf(angle) * temp_y;
-    A->matrix[i][1] = sinf(angle) * temp_x + cosf(angle) * temp_y;
-  }
+  vertices_rotate(A->matrix, A->rows, 0, 1, cosf(angle), sinf(angle));
 }
 
 /**
@@ -144,11 +129,8 @@ float deg_to_rad(float angle) {
 void scale_even(matrix_t *A, float scale) {
   scale = limit_scale(scale);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][0] *= scale;
-    A->matrix[i][1] *= scale;
-    A->matrix[i][2] *= scale;
-  }
+  const float scales[3] = {scale, scale, scale};
+  vertices_multiply(A->matrix, A->rows, scales);
 }
 
 /**
@@ -162,9 +144,8 @@ void scale_even(matrix_t *A, float scale) {
 void scale_by_ox(matrix_t *A, float scale) {
   scale = limit_scale(scale);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][0] *= scale;
-  }
+  const float scales[3] = {scale, 1.0f, 1.0f};
+  vertices_multiply(A->matrix, A->rows, scales);
 }
 
 /**
@@ -178,9 +159,8 @@ void scale_by_ox(matrix_t *A, float scale) {
 void scale_by_oy(matrix_t *A, float scale) {
   scale = limit_scale(scale);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][1] *= scale;
-  }
+  const float scales[3] = {1.0f, scale, 1.0f};
+  vertices_multiply(A->matrix, A->rows, scales);
 }
 
 /**
@@ -194,9 +174,8 @@ void scale_by_oy(matrix_t *A, float scale) {
 void scale_by_oz(matrix_t *A, float scale) {
   scale = limit_scale(scale);
 
-  for (size_t i = 0; i < A->rows; i++) {
-    A->matrix[i][2] *= scale;
-  }
+  const float scales[3] = {1.0f, 1.0f, scale};
+  vertices_multiply(A->matrix, A->rows, scales);
 }
 
 /**
@@ -2,6 +2,7 @@
 #define BACKEND_H
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,37 +11,222 @@
 #define OFFSET_LIMIT 100.0f
 #define SCALE_LIMIT_MIN -1.0f
 #define SCALE_LIMIT_MAX 3.0f
+// код ошибки загрузки, прерванной пользователем
+#define LOAD_CANCELLED 2
+// максимальное количество потоков разбора
+#define MAX_PARSER_THREADS 256
+// выравнивание буфера вершин в байтах
+#define VERTEX_ALIGNMENT 64
 
 /**
  * @brief Matrix of objects
  *
- * 2-dimension float array matrix with rows and cols of vertices to draw.
+ * Contiguous float buffer with rows and cols of vertices to draw. Coordinates
+ * of a vertex follow each other (x, y, z), the buffer is aligned to
+ * VERTEX_ALIGNMENT bytes and can be passed to OpenGL as is.
  *
- * @param matrix Matrix rows by cols
+ * @param matrix Buffer of rows * cols floats
  * @param rows Number of vertices
  * @param cols Number of vertex coordinates (3)
  */
 typedef struct Matrix_ {
-  float** matrix;
+  float* matrix;
   size_t rows;
   size_t cols;
 } matrix_t;
 
 /**
- * @brief Matrix of facets
+ * @brief Facets of the object
  *
- * 2-dimension size_t array of vertices to connect.
+ * Vertex numbers of all facets in one flat array, facet i takes indices from
+ * offsets[i] to offsets[i + 1]. Numbers start from 1 as in .obj files and are
+ * stored in 32 bits unless the number of vertices needs 64. Use facet_size
+ * and facet_vertex instead of reading the arrays directly.
  *
- * @param vertices Number of vertices
- * @param numbers_of_vertices_in_facets Array of vertices of the facet to
- * connect
+ * @param offsets Array of count_of_facets + 1 offsets into indices
+ * @param indices Array of uint32_t or uint64_t vertex numbers
+ * @param count_of_indices Number of vertex numbers of all facets
+ * @param wide_indices Vertex numbers are uint64_t
  */
 typedef struct Facets_ {
-  // динамический массив номеров вершин
-  size_t* vertices;
-  // количество вершин в полигоне, необходимых для соединения
-  size_t numbers_of_vertices_in_facets;
-} polygon_t;
+  size_t* offsets;
+  void* indices;
+  size_t count_of_indices;
+  int wide_indices;
+} facets_t;
+
+/**
+ * @brief Unique edges of the object
+ *
+ * Every edge shared by several facets is stored once as a pair of vertex
+ * numbers starting from 0, ready to be drawn as GL_LINES.
+ *
+ * @param indices Array of 2 * count_of_edges vertex numbers
+ * @param count_of_edges Number of edges
+ */
+typedef struct Edges_ {
+  uint32_t* indices;
+  size_t count_of_edges;
+} edges_t;
+
+// наибольшее количество уровней детализации
+#define LOD_MAX_LEVELS 8
+
+/**
+ * @brief Level of detail
+ *
+ * Simplified copy of the object drawn instead of it when the removed
+ * details are smaller than a pixel.
+ *
+ * @param vertices Vertices of the level
+ * @param edges Unique edges of the level, numbers of its vertices from 0
+ * @param error Largest root mean square distance from a merged vertex to
+ * the planes of the triangles it replaced, in units of the object
+ */
+typedef struct Lod_ {
+  matrix_t vertices;
+  edges_t edges;
+  float error;
+} lod_t;
+
+/**
+ * @brief Chain of levels of detail
+ *
+ * Levels from the finest to the coarsest, the object itself is not a level.
+ *
+ * @param levels Levels, every next one with about 4 times fewer triangles
+ * @param count_of_levels Number of levels, 0 if the object is not simplified
+ */
+typedef struct LodChain_ {
+  lod_t levels[LOD_MAX_LEVELS];
+  size_t count_of_levels;
+} lod_chain_t;
+
+/**
+ * @brief Node of the bounding volume hierarchy
+ *
+ * Box around facets from first_facet to first_facet + count_of_facets in the
+ * order of the hierarchy. The left child of an inner node follows it, the
+ * right child is at index right. Edges owned by facets of the node are from
+ * first_edge to first_edge + count_of_edges in the list of unique edges.
+ *
+ * @param min Smallest coordinates of the box
+ * @param max Largest coordinates of the box
+ * @param right Index of the right child, 0 for a leaf
+ * @param first_facet First facet of the node in the order of the hierarchy
+ * @param count_of_facets Number of facets of the node
+ * @param first_edge First edge of the node
+ * @param count_of_edges Number of edges of the node
+ */
+typedef struct BvhNode_ {
+  float min[3];
+  float max[3];
+  uint32_t right;
+  uint32_t first_facet;
+  uint32_t count_of_facets;
+  uint32_t first_edge;
+  uint32_t count_of_edges;
+} bvh_node_t;
+
+/**
+ * @brief Bounding volume hierarchy
+ *
+ * Tree of boxes around facets, the root is the first node. Facets without
+ * valid vertices are left out.
+ *
+ * @param nodes Nodes in depth-first order
+ * @param count_of_nodes Number of nodes
+ * @param facets Numbers of facets from 0 in the order of the hierarchy
+ * @param count_of_facets Number of facets in the hierarchy
+ * @param ordered_edges Unique edges of the object are ordered by nodes and
+ * edge ranges of nodes are valid
+ */
+typedef struct Bvh_ {
+  bvh_node_t* nodes;
+  size_t count_of_nodes;
+  uint32_t* facets;
+  size_t count_of_facets;
+  int ordered_edges;
+} bvh_t;
+
+// наибольшее количество вершин и треугольников кластера
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+ * @brief Meshlet
+ *
+ * Cluster of neighbouring facets, consecutive in the order of the bounding
+ * volume hierarchy, drawn or skipped as a whole. The normal cone holds
+ * normals of all triangles of the cluster.
+ *
+ * @param center Center of the bounding sphere
+ * @param radius Radius of the bounding sphere
+ * @param cone_axis Unit axis of the normal cone
+ * @param cone_cutoff Sine of the half angle of the cone, greater than 1 if
+ * the cluster faces all directions
+ * @param first_facet First facet in the order of the hierarchy
+ * @param count_of_facets Number of facets
+ * @param first_edge First edge of the cluster
+ * @param count_of_edges Number of edges
+ * @param count_of_vertices Number of different vertices
+ * @param count_of_triangles Number of triangles of fans of the facets
+ * @param first_boundary_edge First edge of the cluster shared with another
+ * cluster, in boundary_edges of the clusters
+ * @param count_of_boundary_edges Number of edges shared with other clusters
+ */
+typedef struct Meshlet_ {
+  float center[3];
+  float radius;
+  float cone_axis[3];
+  float cone_cutoff;
+  uint32_t first_facet;
+  uint32_t count_of_facets;
+  uint32_t first_edge;
+  uint32_t count_of_edges;
+  uint32_t count_of_vertices;
+  uint32_t count_of_triangles;
+  uint32_t first_boundary_edge;
+  uint32_t count_of_boundary_edges;
+} meshlet_t;
+
+/**
+ * @brief Meshlets of the object
+ *
+ * @param meshlets Clusters in the order of the hierarchy
+ * @param count_of_meshlets Number of clusters
+ * @param closed Every edge is shared by two facets, so backfacing clusters
+ * are hidden behind the rest of the surface
+ * @param boundary_edges Pairs of vertices of edges shared by two clusters,
+ * copied from the edges of the object and grouped by the owning cluster,
+ * only for a closed surface
+ * @param count_of_boundary_edges Number of edges shared by two clusters
+ */
+typedef struct Meshlets_ {
+  meshlet_t* meshlets;
+  size_t count_of_meshlets;
+  int closed;
+  uint32_t* boundary_edges;
+  size_t count_of_boundary_edges;
+} meshlets_t;
+
+/**
+ * @brief Bounds of the object
+ *
+ * Axis-aligned box and bounding sphere of all vertices. An empty box has
+ * min greater than max.
+ *
+ * @param min Smallest coordinates by OX, OY and OZ
+ * @param max Largest coordinates by OX, OY and OZ
+ * @param center Center of the box and of the sphere
+ * @param radius Radius of the sphere holding all vertices
+ */
+typedef struct Bounds_ {
+  float min[3];
+  float max[3];
+  float center[3];
+  float radius;
+} bounds_t;
 
 /**
  * @brief General matrix
@@ -51,11 +237,15 @@ typedef struct Facets_ {
  * @param count_of_facets Number of facets
  * @param obj_matrix 2-dimension float array matrix with rows and cols of
  * vertices to draw
- * @param obj_polygons 2-dimension size_t array of vertices to connect
- * @param highest_vertex The highest vertex for scaling
- * @param lowest_vertex The lowest vertex for scaling
- * @param rightest_vertex The rightest vertex for scaling
- * @param leftest_vertex The leftest vertex for scaling
+ * @param obj_facets Vertices of facets to connect
+ * @param obj_edges Unique edges of facets, empty until build_edges
+ * @param obj_lod Simplified copies of the object, empty until build_lod
+ * @param obj_bvh Hierarchy of boxes around facets, empty until build_bvh
+ * @param obj_meshlets Clusters of facets, empty until build_meshlets
+ * @param bounds Box and sphere around all vertices to fit the view
+ * @param mapping Mapped cache file holding vertices and facets, NULL if
+ * they are allocated
+ * @param mapping_size Size of the mapped cache file
  */
 typedef struct Data {
   // количество вершин
@@ -64,19 +254,127 @@ typedef struct Data {
   size_t count_of_facets;
   // матрица вершин
   matrix_t obj_matrix;
-  // динамический массив полигонов
-  polygon_t* obj_polygons;
-
-  // наивысшая вершина для масштабирования
-  float highest_vertex;
-  // наинизшая вершина для масштабирования
-  float lowest_vertex;
-  // самая правая вершина для масштабирования
-  float rightest_vertex;
-  // самая левая вершина для масштабирования
-  float leftest_vertex;
+  // вершины полигонов
+  facets_t obj_facets;
+  // уникальные рёбра полигонов
+  edges_t obj_edges;
+  // упрощённые копии объекта
+  lod_chain_t obj_lod;
+  // иерархия коробок вокруг полигонов
+  bvh_t obj_bvh;
+  // кластеры полигонов с конусами нормалей
+  meshlets_t obj_meshlets;
+
+  // границы объекта для вписывания в окно
+  bounds_t bounds;
+
+  // отображённый в память кэш, в котором лежат вершины и полигоны
+  void* mapping;
+  size_t mapping_size;
 } data_t;
 
+/**
+ * @brief Parsed part
+ *
+ * Part of the object parsed by one loading thread.
+ *
+ * @param vertex_base Number of the first vertex of the part
+ * @param facet_base Number of the first facet of the part
+ * @param parsed_vertices Number of vertices parsed so far
+ * @param parsed_facets Number of facets parsed so far
+ */
+typedef struct Part_ {
+  size_t vertex_base;
+  size_t facet_base;
+  size_t parsed_vertices;
+  size_t parsed_facets;
+} part_t;
+
+/**
+ * @brief Loading progress
+ *
+ * Shared between loading threads and the interface. Fields are accessed
+ * atomically, use progress_* functions from other threads.
+ *
+ * @param total_bytes Amount of work in bytes
+ * @param done_bytes Amount of work done in bytes
+ * @param count_of_stages Number of passes of loading, 0 for one
+ * @param stage Number of the current pass from 0, passes before it are done
+ * @param cancelled Loading should stop as soon as possible
+ * @param ready Partial object is available for the preview
+ * @param readers Number of threads reading the partial object
+ * @param partial Arrays of the object being loaded
+ * @param count_of_parts Number of loading threads
+ * @param parts Parsed parts of the object
+ */
+typedef struct Progress_ {
+  size_t total_bytes;
+  size_t done_bytes;
+  int count_of_stages;
+  int stage;
+  int cancelled;
+
+  int ready;
+  int readers;
+  data_t partial;
+  size_t count_of_parts;
+  part_t parts[MAX_PARSER_THREADS];
+} progress_t;
+
+/**
+ * @brief Partial object
+ *
+ * Snapshot of the object being loaded, taken for drawing one frame.
+ *
+ * @param data Arrays of the object, only parsed parts may be read
+ * @param count_of_parts Number of parts
+ * @param parts Parsed parts of the object
+ */
+typedef struct Partial_ {
+  const data_t* data;
+  size_t count_of_parts;
+  part_t parts[MAX_PARSER_THREADS];
+} partial_t;
+
+/**
+ * @brief Vertex of the matrix
+ *
+ * @param A Object matrix
+ * @param row Number of the vertex starting from 0
+ *
+ * @return Pointer to x, y and z of the vertex
+ */
+static inline float* matrix_vertex(const matrix_t* A, size_t row) {
+  return A->matrix + row * A->cols;
+}
+
+/**
+ * @brief Facet size
+ *
+ * @param F Facets of the object
+ * @param facet Number of the facet starting from 0
+ *
+ * @return Number of vertices of the facet
+ */
+static inline size_t facet_size(const facets_t* F, size_t facet) {
+  return F->offsets[facet + 1] - F->offsets[facet];
+}
+
+/**
+ * @brief Facet vertex
+ *
+ * @param F Facets of the object
+ * @param facet Number of the facet starting from 0
+ * @param k Position of the vertex in the facet starting from 0
+ *
+ * @return Vertex number starting from 1
+ */
+static inline size_t facet_vertex(const facets_t* F, size_t facet, size_t k) {
+  size_t i = F->offsets[facet] + k;
+  return F->wide_indices ? (size_t)((const uint64_t*)F->indices)[i]
+                         : (size_t)((const uint32_t*)F->indices)[i];
+}
+
 // -------------------------AFFINE-START-------------------------
 
 // перемещение по оси X
@@ -108,6 +406,277 @@ void scale_by_oz(matrix_t* A, float scale);
 // ограничение значения масштабирования
 float limit_scale(float scale);
 
+// -------------------------POOL-START---------------------------
+
+// количество потоков пула вместе с вызывающим
+size_t pool_threads(void);
+// параллельный цикл по элементам от 0 до count
+void pool_parallel_for(size_t count, size_t serial_threshold,
+                       void (*body)(void* arg, size_t begin, size_t end),
+                       void* arg);
+
+// -------------------------KERNELS-START------------------------
+
+// наборы ядер в порядке расширения набора инструкций
+#define KERNELS_SCALAR 0
+#define KERNELS_SSE2 1
+#define KERNELS_AVX2 2
+#define KERNELS_AVX512 3
+#define KERNELS_COUNT 4
+
+/**
+ * @brief Vertex kernels
+ *
+ * Loops over the vertex buffer for one instruction set. Vertices are
+ * count * 3 consecutive floats. All sets give results equal bit by bit to
+ * the scalar one.
+ *
+ * @param name Name of the instruction set
+ * @param add Adds offsets[k] to coordinate k of every vertex
+ * @param multiply Multiplies coordinate k of every vertex by scales[k]
+ * @param rotate Rotates vertices in the plane of axes u and w
+ * @param transform Multiplies vertices by a 4x4 matrix stored by columns
+ * @param bounds Grows the box from min to max to hold vertices
+ */
+typedef struct VertexKernels_ {
+  const char* name;
+  void (*add)(float* vertices, size_t count, const float offsets[3]);
+  void (*multiply)(float* vertices, size_t count, const float scales[3]);
+  void (*rotate)(float* vertices, size_t count, int u, int w, float cosine,
+                 float sine);
+  void (*transform)(float* vertices, size_t count, const float matrix[16]);
+  void (*bounds)(const float* vertices, size_t count, float min[3],
+                 float max[3]);
+} vertex_kernels_t;
+
+// самые быстрые ядра, поддерживаемые процессором
+const vertex_kernels_t* vertex_kernels(void);
+// ядра заданного набора инструкций или NULL
+const vertex_kernels_t* vertex_kernels_by_level(int level);
+
+// объекты с меньшим количеством вершин изменяются одним потоком
+#define VERTEX_PARALLEL_MIN (1 << 16)
+
+// ядра для больших буферов, разделённых между потоками пула
+void vertices_add(float* vertices, size_t count, const float offsets[3]);
+void vertices_multiply(float* vertices, size_t count, const float scales[3]);
+void vertices_rotate(float* vertices, size_t count, int u, int w,
+                     float cosine, float sine);
+void vertices_transform(float* vertices, size_t count,
+                        const float matrix[16]);
+
+// -------------------------TRANSFORM-START----------------------
+
+/**
+ * @brief Transform of the object
+ *
+ * Model matrix composed of all moves, rotations and scales of the object.
+ * Vertices stay as they were loaded and the matrix is applied when the
+ * object is drawn. Elements are stored by columns as in OpenGL.
+ *
+ * @param model 4x4 model matrix by columns
+ */
+typedef struct Transform_ {
+  double model[16];
+} transform_t;
+
+// виды операций преобразования
+#define OPERATION_MOVE 0
+#define OPERATION_ROTATE 1
+#define OPERATION_SCALE 2
+// возврат к положению после загрузки, учитывается только историей
+#define OPERATION_RESET 3
+
+/**
+ * @brief Transform operation
+ *
+ * One move, rotation or scale of the object by three axes. A rotation turns
+ * the object by OX first, then by OY, then by OZ.
+ *
+ * @param type OPERATION_MOVE, OPERATION_ROTATE, OPERATION_SCALE or
+ * OPERATION_RESET
+ * @param x Offset, angle in degrees or scale by OX
+ * @param y Offset, angle in degrees or scale by OY
+ * @param z Offset, angle in degrees or scale by OZ
+ */
+typedef struct Operation_ {
+  int type;
+  float x;
+  float y;
+  float z;
+} operation_t;
+
+// тождественное преобразование
+void transform_reset(transform_t* T);
+// перемещение по трём осям
+void transform_move(transform_t* T, float x, float y, float z);
+// масштабирование по трём осям
+void transform_scale(transform_t* T, float x, float y, float z);
+// поворот на заданный угол по оси X
+void transform_rotate_by_ox(transform_t* T, float angle);
+// поворот на заданный угол по оси Y
+void transform_rotate_by_oy(transform_t* T, float angle);
+// поворот на заданный угол по оси Z
+void transform_rotate_by_oz(transform_t* T, float angle);
+// матрица для OpenGL
+void transform_matrix(const transform_t* T, float matrix[16]);
+// преобразование одной вершины
+void transform_vertex(const transform_t* T, const float vertex[3],
+                      float result[3]);
+// применение преобразования ко всем вершинам
+void transform_apply(const transform_t* T, matrix_t* A);
+// добавление нескольких операций за один раз
+void transform_compose(transform_t* T, const operation_t* operations,
+                       size_t count);
+// применение нескольких операций к вершинам за один проход
+void apply_operations(matrix_t* A, const operation_t* operations,
+                      size_t count);
+
+// -------------------------CAMERA-START-------------------------
+
+// пределы увеличения камеры
+#define CAMERA_ZOOM_MIN 0.01
+#define CAMERA_ZOOM_MAX 100.0
+
+/**
+ * @brief Camera
+ *
+ * View of the object controlled by the mouse: rotation as a unit quaternion,
+ * zoom and pan. Changing the camera never touches vertices, its matrix is
+ * applied by OpenGL after the transform of the object.
+ *
+ * @param orientation Unit quaternion w, x, y, z of the rotation
+ * @param pan Offset of the view by OX, OY and OZ
+ * @param zoom Scale of the view
+ */
+typedef struct Camera_ {
+  double orientation[4];
+  double pan[3];
+  double zoom;
+} camera_t;
+
+// камера без поворота, сдвига и увеличения
+void camera_reset(camera_t* C);
+// точка на сфере арбола для точки окна от -1 до 1
+void arcball_point(float x, float y, double point[3]);
+// поворот, переводящий одну точку сферы в другую
+void camera_rotate(camera_t* C, const double from[3], const double to[3]);
+// сдвиг камеры
+void camera_pan(camera_t* C, double x, double y, double z);
+// изменение увеличения в factor раз
+void camera_zoom(camera_t* C, double factor);
+// матрица камеры для OpenGL
+void camera_matrix(const camera_t* C, float matrix[16]);
+
+// -------------------------HISTORY-START------------------------
+
+// количество операций между сохранёнными преобразованиями истории
+#define HISTORY_SNAPSHOT_INTERVAL 256
+
+/**
+ * @brief Transform history
+ *
+ * Operations of the object in the order they were made, grouped into steps
+ * that are undone and redone together. Vertices are never stored, so the
+ * size depends only on the number of operations. Every
+ * HISTORY_SNAPSHOT_INTERVAL operations their composed transform is kept, so
+ * any point of the history is reached by at most that many operations.
+ *
+ * @param operations Operations of all steps
+ * @param count_of_operations Number of operations
+ * @param capacity Allocated number of operations
+ * @param steps Number of operations up to the end of every step
+ * @param count_of_steps Number of steps, including undone ones
+ * @param steps_capacity Allocated number of steps
+ * @param position Number of steps that are not undone
+ * @param snapshots Transforms from the identity after the first (i + 1) *
+ * HISTORY_SNAPSHOT_INTERVAL operations, starting over at every reset
+ * @param count_of_snapshots Number of snapshots matching the operations
+ * @param snapshots_capacity Allocated number of snapshots
+ */
+typedef struct History_ {
+  operation_t* operations;
+  size_t count_of_operations;
+  size_t capacity;
+  size_t* steps;
+  size_t count_of_steps;
+  size_t steps_capacity;
+  size_t position;
+  transform_t* snapshots;
+  size_t count_of_snapshots;
+  size_t snapshots_capacity;
+} history_t;
+
+// сложение операции с предыдущей, если результат не меняется
+int merge_operation(operation_t* last, const operation_t* next);
+// запись шага, отменённые шаги забываются
+int history_record(history_t* H, const operation_t* operations, size_t count,
+                   int merge);
+// отмена последнего шага
+int history_undo(history_t* H);
+// повтор отменённого шага
+int history_redo(history_t* H);
+// операции неотменённых шагов
+const operation_t* history_operations(const history_t* H, size_t* count);
+// преобразование после неотменённых шагов
+void history_transform(const history_t* H, const transform_t* base,
+                       transform_t* T);
+// освобождение истории
+void history_free(history_t* H);
+
+// -------------------------BOUNDS-START-------------------------
+
+// количество вершин в блоке, границы которого считаются за раз
+#define BOUNDS_BLOCK 1024
+
+/**
+ * @brief Block bounds
+ *
+ * Boxes of consecutive blocks of BOUNDS_BLOCK vertices. When only some
+ * vertices change, only boxes of their blocks are computed again and the box
+ * of the object is merged from the boxes of blocks.
+ *
+ * @param boxes Six floats for every block: min by OX, OY, OZ, then max
+ * @param count_of_blocks Number of blocks
+ */
+typedef struct BlockBounds_ {
+  float* boxes;
+  size_t count_of_blocks;
+} block_bounds_t;
+
+// пустые границы
+void bounds_reset(bounds_t* B);
+// объединение границ
+void bounds_merge(bounds_t* B, const bounds_t* other);
+// расширение коробки вершинами одним потоком
+void bounds_grow(bounds_t* B, const float* vertices, size_t count);
+// расширение коробки вершинами с first по first + count на пуле потоков
+void bounds_compute(bounds_t* B, const matrix_t* A, size_t first,
+                    size_t count);
+// центр и радиус сферы по вершинам, NULL - по коробке
+void bounds_finish(bounds_t* B, const matrix_t* A);
+// границы всех блоков вершин
+int block_bounds_build(block_bounds_t* BB, const matrix_t* A);
+// пересчёт блоков, в которые попадают изменённые вершины
+void block_bounds_update(block_bounds_t* BB, const matrix_t* A, size_t first,
+                         size_t count);
+// коробка объекта по границам блоков
+void block_bounds_box(const block_bounds_t* BB, bounds_t* B);
+// освобождение границ блоков
+void block_bounds_free(block_bounds_t* BB);
+
+// -------------------------NUMBERS-START------------------------
+
+// чтение десятичного разделителя локали до запуска потоков разбора
+void prepare_number_parser(void);
+// пропуск пробелов и табуляций
+const char* skip_blanks(const char* str, const char* end);
+// разбор числа с плавающей точкой независимо от локали
+const char* parse_double(const char* str, const char* end, double* value);
+const char* parse_float(const char* str, const char* end, float* value);
+// разбор беззнакового целого (номера вершины)
+const char* parse_index(const char* str, const char* end, size_t* value);
+
 // -------------------------PARSER-START-------------------------
 
 FILE* open_obj_file(const char* filename);
@@ -117,6 +686,108 @@ int matrix_mem_alloc(data_t* data);
 void copy_vertices_from_obj_to_matrix(FILE* file, data_t* data);
 int count_vertices_in_facets(FILE* file, data_t* data);
 void copy_indexes_from_obj_to_struct(FILE* file, data_t* data);
+// однопроходная загрузка файла через отображение в память
+int parse_obj_file(const char* filename, data_t* data);
+// многопоточная загрузка файла по кускам
+int parse_obj_file_parallel(const char* filename, data_t* data, size_t threads,
+                            progress_t* progress);
+// прерывание загрузки из другого потока
+void progress_cancel(progress_t* progress);
+// доля выполненной работы от 0 до 1
+double progress_fraction(const progress_t* progress);
+// загрузка из нескольких проходов, первый из которых - чтение файла
+void progress_set_stages(progress_t* progress, int count_of_stages);
+// переход к следующему проходу, 1 если загрузку отменили
+int progress_next_stage(progress_t* progress);
+// доступ к частично загруженному объекту для предпросмотра
+int progress_acquire_partial(progress_t* progress, partial_t* partial);
+void progress_release_partial(progress_t* progress);
+int partial_vertex_parsed(const partial_t* partial, size_t vertex);
 void free_memory(FILE* file, data_t* data);
+// буфер вершин, выровненный для ядер и OpenGL
+float* alloc_vertex_buffer(size_t count);
+
+// -------------------------CACHE-START--------------------------
+
+// запись двоичного кэша объекта рядом с файлом
+int write_mesh_cache(const char* filename, const data_t* data);
+// чтение объекта из кэша, если он соответствует файлу
+int read_mesh_cache(const char* filename, data_t* data);
+// загрузка из кэша или разбор файла с записью кэша
+int load_obj_file(const char* filename, data_t* data, size_t threads,
+                  progress_t* progress);
+
+// -------------------------EDGES-START--------------------------
+
+// построение списка уникальных рёбер полигонов
+int build_edges(data_t* data, size_t threads);
+
+// -------------------------LOD-START----------------------------
+
+// построение уровней детализации упрощением поверхности
+int build_lod(data_t* data, progress_t* progress);
+// уровень для заданного количества пикселей на единицу объекта, 0 - объект
+size_t lod_select(const lod_chain_t* L, double pixels_per_unit,
+                  double max_pixel_error);
+// самый подробный уровень не подробнее level, укладывающийся в бюджет
+size_t lod_fit_budget(const lod_chain_t* L, size_t level,
+                      size_t object_primitives, double max_primitives);
+// освобождение уровней детализации
+void lod_free(lod_chain_t* L);
+
+// -------------------------BVH-START----------------------------
+
+/**
+ * @brief Visible edge ranges
+ *
+ * Ranges of unique edges inside the view, kept between frames to reuse the
+ * memory.
+ *
+ * @param ranges First edge and number of edges of every range
+ * @param count_of_ranges Number of ranges
+ * @param capacity Number of ranges that fit into ranges
+ */
+typedef struct BvhRanges_ {
+  size_t* ranges;
+  size_t count_of_ranges;
+  size_t capacity;
+} bvh_ranges_t;
+
+/**
+ * @brief Ray hit
+ *
+ * @param distance Distance along the ray in lengths of its direction
+ * @param facet Number of the hit facet from 0
+ * @param point Hit point
+ */
+typedef struct BvhHit_ {
+  float distance;
+  size_t facet;
+  float point[3];
+} bvh_hit_t;
+
+// построение иерархии коробок вокруг полигонов и упорядочивание рёбер по ней
+int build_bvh(data_t* data, size_t threads);
+// диапазоны рёбер в пирамиде видимости матрицы по столбцам
+int bvh_cull(const bvh_t* B, const float mvp[16], bvh_ranges_t* R);
+// добавление диапазона рёбер после предыдущих
+int bvh_ranges_add(bvh_ranges_t* R, size_t first, size_t count);
+// ближайшее пересечение луча с полигонами
+int bvh_raycast(const data_t* data, const float origin[3],
+                const float direction[3], bvh_hit_t* hit);
+// освобождение иерархии
+void bvh_free(bvh_t* B);
+void bvh_ranges_free(bvh_ranges_t* R);
+
+// -------------------------MESHLETS-START-----------------------
+
+// разбиение полигонов на кластеры по порядку иерархии коробок
+int build_meshlets(data_t* data, size_t threads);
+// диапазоны рёбер кластеров в окне, обращённых к камере, и граничных рёбер
+// пропущенных кластеров, только для поверхности с проверкой глубины
+int meshlets_cull(const data_t* data, const float mvp[16], bvh_ranges_t* R,
+                  bvh_ranges_t* boundary);
+// освобождение кластеров
+void meshlets_free(meshlets_t* M);
 
 #endif
@@ -0,0 +1,338 @@
+#include "backend.h"
+
+/**
+ * @brief Reset bounds
+ *
+ * Makes the bounds empty, so the first added vertex sets the box.
+ *
+ * @param B Bounds to reset
+ */
+void bounds_reset(bounds_t *B) {
+  for (int k = 0; k < 3; k++) {
+    B->min[k] = INFINITY;
+    B->max[k] = -INFINITY;
+    B->center[k] = 0.0f;
+  }
+  B->radius = 0.0f;
+}
+
+/**
+ * @brief Merge bounds
+ *
+ * Grows the box to hold another box, for example of a part of the object.
+ *
+ * @param B Bounds to grow
+ * @param other Bounds to add
+ */
+void bounds_merge(bounds_t *B, const bounds_t *other) {
+  for (int k = 0; k < 3; k++) {
+    if (other->min[k] < B->min[k]) B->min[k] = other->min[k];
+    if (other->max[k] > B->max[k]) B->max[k] = other->max[k];
+  }
+}
+
+/**
+ * @brief Grow bounds
+ *
+ * Grows the box to hold vertices with the fastest vertex kernels, on the
+ * calling thread. Used by parsers right after a block of vertices is parsed.
+ *
+ * @param B Bounds to grow
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ */
+void bounds_grow(bounds_t *B, const float *vertices, size_t count) {
+  if (count != 0) vertex_kernels()->bounds(vertices, count, B->min, B->max);
+}
+
+/**
+ * @brief Box loop
+ *
+ * Vertices and the box of one bounds_compute call. The box is kept as bits
+ * of floats, so threads can merge their boxes with atomic operations.
+ *
+ * @param vertices Coordinates of the first vertex of the range
+ * @param min Smallest coordinates found so far
+ * @param max Largest coordinates found so far
+ */
+typedef struct BoxLoop_ {
+  const float *vertices;
+  uint32_t min[3];
+  uint32_t max[3];
+} box_loop_t;
+
+/**
+ * @brief Merge float
+ *
+ * Replaces the shared value with a smaller or larger one without locks.
+ *
+ * @param target Bits of the shared float
+ * @param value Value to merge
+ * @param smaller Keep the smaller value, otherwise the larger one
+ */
+static void merge_float(uint32_t *target, float value, int smaller) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+
+  for (int done = 0; !done;) {
+    float stored;
+    memcpy(&stored, &current, sizeof(stored));
+    done = smaller ? !(value < stored) : !(value > stored);
+    if (!done) {
+      done = __atomic_compare_exchange_n(target, &current, bits, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+/**
+ * @brief Box range
+ *
+ * Finds the box of vertices from begin to end and merges it into the shared
+ * one, body of pool_parallel_for.
+ *
+ * @param arg Box loop
+ * @param begin First vertex
+ * @param end Vertex after the last one
+ */
+static void box_range(void *arg, size_t begin, size_t end) {
+  box_loop_t *loop = arg;
+  bounds_t box;
+  bounds_reset(&box);
+  bounds_grow(&box, loop->vertices + begin * 3, end - begin);
+
+  for (int k = 0; k < 3; k++) {
+    merge_float(&loop->min[k], box.min[k], 1);
+    merge_float(&loop->max[k], box.max[k], 0);
+  }
+}
+
+/**
+ * @brief Compute bounds
+ *
+ * Grows the box to hold vertices from first to first + count. Large ranges
+ * are split between the pool threads. Used to bring bounds up to date after
+ * vertices are changed.
+ *
+ * @param B Bounds to grow
+ * @param A Vertices of the object
+ * @param first First vertex
+ * @param count Number of vertices
+ */
+void bounds_compute(bounds_t *B, const matrix_t *A, size_t first,
+                    size_t count) {
+  box_loop_t loop = {matrix_vertex(A, first), {0}, {0}};
+  memcpy(loop.min, B->min, sizeof(loop.min));
+  memcpy(loop.max, B->max, sizeof(loop.max));
+
+  pool_parallel_for(count, VERTEX_PARALLEL_MIN, box_range, &loop);
+
+  memcpy(B->min, loop.min, sizeof(B->min));
+  memcpy(B->max, loop.max, sizeof(B->max));
+}
+
+/**
+ * @brief Radius loop
+ *
+ * Vertices and center of one bounds_finish call.
+ *
+ * @param vertices Coordinates of all vertices
+ * @param center Center of the sphere
+ * @param squared Largest squared distance found so far, bits of a float
+ */
+typedef struct RadiusLoop_ {
+  const float *vertices;
+  const float *center;
+  uint32_t squared;
+} radius_loop_t;
+
+/**
+ * @brief Measure range
+ *
+ * Finds the farthest vertex from the center among vertices from begin to
+ * end, body of pool_parallel_for.
+ *
+ * @param arg Radius loop
+ * @param begin First vertex
+ * @param end Vertex after the last one
+ */
+static void measure_range(void *arg, size_t begin, size_t end) {
+  radius_loop_t *loop = arg;
+  const float *center = loop->center;
+  float farthest = 0.0f;
+
+  for (size_t i = begin; i < end; i++) {
+    const float *vertex = loop->vertices + i * 3;
+    float dx = vertex[0] - center[0];
+    float dy = vertex[1] - center[1];
+    float dz = vertex[2] - center[2];
+    float squared = dx * dx + dy * dy + dz * dz;
+    if (squared > farthest) farthest = squared;
+  }
+
+  // неотрицательные числа с плавающей точкой сравниваются как целые
+  uint32_t bits;
+  memcpy(&bits, &farthest, sizeof(bits));
+  uint32_t current = __atomic_load_n(&loop->squared, __ATOMIC_RELAXED);
+  while (bits > current &&
+         !__atomic_compare_exchange_n(&loop->squared, &current, bits, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+/**
+ * @brief Finish bounds
+ *
+ * Puts the center into the middle of the box and finds the radius of the
+ * sphere around it. With vertices the radius is the distance to the
+ * farthest one, found in one pass split between the pool threads; without
+ * them it is half of the box diagonal. Empty bounds become zero.
+ *
+ * @param B Bounds with the box of all vertices
+ * @param A Vertices of the object or NULL
+ */
+void bounds_finish(bounds_t *B, const matrix_t *A) {
+  if (!(B->min[0] <= B->max[0] && B->min[1] <= B->max[1] &&
+        B->min[2] <= B->max[2])) {
+    *B = (bounds_t){0};
+  } else {
+    float squared = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      B->center[k] = B->min[k] * 0.5f + B->max[k] * 0.5f;
+      float half = B->max[k] * 0.5f - B->min[k] * 0.5f;
+      squared += half * half;
+    }
+
+    if (A != NULL && A->rows != 0) {
+      radius_loop_t loop = {A->matrix, B->center, 0};
+      pool_parallel_for(A->rows, VERTEX_PARALLEL_MIN, measure_range, &loop);
+      memcpy(&squared, &loop.squared, sizeof(squared));
+    }
+    B->radius = sqrtf(squared);
+  }
+}
+
+/**
+ * @brief Block loop
+ *
+ * Blocks of one block_bounds_build or block_bounds_update call.
+ *
+ * @param BB Block bounds to fill
+ * @param A Vertices of the object
+ * @param first First block to compute
+ */
+typedef struct BlockLoop_ {
+  block_bounds_t *BB;
+  const matrix_t *A;
+  size_t first;
+} block_loop_t;
+
+/**
+ * @brief Block range
+ *
+ * Computes boxes of blocks from first + begin to first + end, body of
+ * pool_parallel_for. Every block has its own box, so no merging is needed.
+ *
+ * @param arg Block loop
+ * @param begin First block of the range
+ * @param end Block after the last one
+ */
+static void block_range(void *arg, size_t begin, size_t end) {
+  block_loop_t *loop = arg;
+
+  for (size_t block = loop->first + begin; block < loop->first + end;
+       block++) {
+    size_t vertex = block * BOUNDS_BLOCK;
+    size_t count = loop->A->rows - vertex < BOUNDS_BLOCK
+                       ? loop->A->rows - vertex
+                       : BOUNDS_BLOCK;
+    bounds_t box;
+    bounds_reset(&box);
+    bounds_grow(&box, matrix_vertex(loop->A, vertex), count);
+    memcpy(loop->BB->boxes + block * 6, box.min, sizeof(box.min));
+    memcpy(loop->BB->boxes + block * 6 + 3, box.max, sizeof(box.max));
+  }
+}
+
+/**
+ * @brief Build block bounds
+ *
+ * Computes boxes of all blocks of vertices, split between the pool threads.
+ * The previous boxes are freed.
+ *
+ * @param BB Block bounds to fill
+ * @param A Vertices of the object
+ *
+ * @return 0 on success, 1 on error
+ */
+int block_bounds_build(block_bounds_t *BB, const matrix_t *A) {
+  block_bounds_free(BB);
+  size_t count = (A->rows + BOUNDS_BLOCK - 1) / BOUNDS_BLOCK;
+  int error_code = 0;
+
+  if (count != 0) {
+    BB->boxes = malloc(count * 6 * sizeof(float));
+    if (BB->boxes == NULL) error_code = 1;
+  }
+  if (error_code == 0) {
+    BB->count_of_blocks = count;
+    block_bounds_update(BB, A, 0, A->rows);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Update block bounds
+ *
+ * Computes again boxes of the blocks holding vertices from first to
+ * first + count, the other boxes are kept. The number of vertices must be
+ * the same as when the boxes were built.
+ *
+ * @param BB Block bounds to update
+ * @param A Vertices of the object
+ * @param first First changed vertex
+ * @param count Number of changed vertices
+ */
+void block_bounds_update(block_bounds_t *BB, const matrix_t *A, size_t first,
+                         size_t count) {
+  if (count != 0 && first < A->rows) {
+    size_t last = count < A->rows - first ? first + count - 1 : A->rows - 1;
+    block_loop_t loop = {BB, A, first / BOUNDS_BLOCK};
+    // в блоке достаточно вершин, чтобы каждый блок был отдельной порцией
+    pool_parallel_for(last / BOUNDS_BLOCK - loop.first + 1,
+                      VERTEX_PARALLEL_MIN / BOUNDS_BLOCK, block_range, &loop);
+  }
+}
+
+/**
+ * @brief Block bounds box
+ *
+ * Merges boxes of all blocks into the box of the object. The sphere is
+ * cleared, bounds_finish computes it.
+ *
+ * @param BB Block bounds
+ * @param B Bounds to fill
+ */
+void block_bounds_box(const block_bounds_t *BB, bounds_t *B) {
+  bounds_reset(B);
+  for (size_t block = 0; block < BB->count_of_blocks; block++) {
+    bounds_t box;
+    memcpy(box.min, BB->boxes + block * 6, sizeof(box.min));
+    memcpy(box.max, BB->boxes + block * 6 + 3, sizeof(box.max));
+    bounds_merge(B, &box);
+  }
+}
+
+/**
+ * @brief Free block bounds
+ *
+ * Frees boxes of blocks and makes the block bounds empty.
+ *
+ * @param BB Block bounds
+ */
+void block_bounds_free(block_bounds_t *BB) {
+  free(BB->boxes);
+  *BB = (block_bounds_t){0};
+}
@@ -0,0 +1,1224 @@
+#include "backend.h"
+
+// количество корзин при поиске разбиения узла
+#define BVH_BINS 16
+// узлы с таким количеством полигонов не делятся
+#define BVH_LEAF_SIZE 4
+// меньшие узлы строятся целиком одним потоком
+#define BVH_PARALLEL_MIN (1 << 15)
+// количество порций, на которые делятся полигоны крупного узла
+#define BVH_CHUNKS 64
+// глубже узлы делятся пополам без поиска разбиения, так глубина не больше 64
+#define BVH_SAH_DEPTH 32
+// размер стека обхода, больше глубины дерева
+#define BVH_STACK_SIZE 128
+// соседние диапазоны рёбер с меньшим промежутком рисуются одним вызовом
+#define BVH_RANGE_GAP 256
+// пустая ячейка таблицы, пара (UINT32_MAX, UINT32_MAX) невозможна
+#define EMPTY_KEY UINT64_MAX
+
+/**
+ * @brief Bin
+ *
+ * Facets whose centers fall into one slice of a node along one axis.
+ *
+ * @param min Smallest coordinates of boxes of the facets
+ * @param max Largest coordinates of boxes of the facets
+ * @param count Number of facets
+ */
+typedef struct Bin_ {
+  float min[3];
+  float max[3];
+  size_t count;
+} bin_t;
+
+/**
+ * @brief Primitive
+ *
+ * Box of a facet, moved together with the number of the facet while nodes
+ * are split, so scans read boxes in order.
+ *
+ * @param min Smallest coordinates of the box
+ * @param max Largest coordinates of the box
+ * @param facet Number of the facet from 0
+ */
+typedef struct Primitive_ {
+  float min[3];
+  float max[3];
+  uint32_t facet;
+} primitive_t;
+
+/**
+ * @brief Node scan
+ *
+ * Boxes of a range of facets and of their centers, then bins of the range
+ * along the axis where centers are spread the most.
+ *
+ * @param min Smallest coordinates of boxes of the facets
+ * @param max Largest coordinates of boxes of the facets
+ * @param center_min Smallest coordinates of centers of the facets
+ * @param center_max Largest coordinates of centers of the facets
+ * @param axis Axis of bins
+ * @param scale Number of bins per unit of length, 0 if centers do not
+ * spread along any axis
+ * @param bins Bins along the axis
+ */
+typedef struct NodeScan_ {
+  float min[3];
+  float max[3];
+  float center_min[3];
+  float center_max[3];
+  int axis;
+  float scale;
+  bin_t bins[BVH_BINS];
+} node_scan_t;
+
+/**
+ * @brief Build node
+ *
+ * Node of a subtree being built. Children are in the same list.
+ *
+ * @param min Smallest coordinates of the box
+ * @param max Largest coordinates of the box
+ * @param left Index of the left child
+ * @param right Index of the right child, 0 for a leaf
+ * @param first First facet of the node
+ * @param count Number of facets of the node
+ * @param task Number of the task from 1 that builds the node, 0 if the node
+ * is built in this list
+ */
+typedef struct BuildNode_ {
+  float min[3];
+  float max[3];
+  uint32_t left;
+  uint32_t right;
+  uint32_t first;
+  uint32_t count;
+  uint32_t task;
+} build_node_t;
+
+/**
+ * @brief Node list
+ *
+ * Nodes of a subtree built by one thread, the root is the first node.
+ *
+ * @param nodes Nodes of the subtree
+ * @param count Number of nodes
+ * @param capacity Number of nodes that fit into nodes
+ * @param first First facet of the subtree
+ * @param count_of_facets Number of facets of the subtree
+ * @param depth Depth of the root of the subtree
+ * @param error_code 1 if memory could not be allocated
+ */
+typedef struct NodeList_ {
+  build_node_t *nodes;
+  size_t count;
+  size_t capacity;
+  uint32_t first;
+  uint32_t count_of_facets;
+  int depth;
+  int error_code;
+} node_list_t;
+
+/**
+ * @brief Builder
+ *
+ * The top of the tree is built by the calling thread, which splits large
+ * nodes with bins counted by the pool. Nodes with fewer than
+ * BVH_PARALLEL_MIN facets become tasks built in parallel, each by one
+ * thread into its own list.
+ *
+ * @param data Object with facets
+ * @param primitives Boxes of facets, reordered so every node has a range
+ * @param top Nodes of the top of the tree
+ * @param tasks Subtrees built in parallel
+ * @param count_of_tasks Number of tasks
+ * @param capacity_of_tasks Number of tasks that fit into tasks
+ * @param chunks Scans of portions of the node split by the pool
+ * @param scan_first First facet of the node split by the pool
+ * @param scan_count Number of facets of the node split by the pool
+ * @param scan_ref Scan with boxes of centers to count bins, NULL to find
+ * the boxes
+ * @param error_code 1 if memory could not be allocated
+ */
+typedef struct BvhBuilder_ {
+  const data_t *data;
+  primitive_t *primitives;
+
+  node_list_t top;
+  node_list_t *tasks;
+  size_t count_of_tasks;
+  size_t capacity_of_tasks;
+
+  node_scan_t *chunks;
+  size_t scan_first;
+  size_t scan_count;
+  const node_scan_t *scan_ref;
+  int error_code;
+} bvh_builder_t;
+
+/**
+ * @brief Edge order
+ *
+ * Owners of unique edges: every edge belongs to the first facet in the
+ * order of the hierarchy that has it.
+ *
+ * @param data Object with facets and edges
+ * @param bvh Hierarchy of the object
+ * @param keys Open addressing table of vertex pairs of edges
+ * @param values Number of the edge in every cell of the table
+ * @param mask Number of cells in the table minus one
+ * @param owners Position of the owning facet of every edge
+ */
+typedef struct EdgeOrder_ {
+  const data_t *data;
+  const bvh_t *bvh;
+  uint64_t *keys;
+  uint32_t *values;
+  size_t mask;
+  uint32_t *owners;
+} edge_order_t;
+
+/**
+ * @brief Reset box
+ *
+ * Makes the box empty, so the first added point sets it.
+ */
+static void box_reset(float min[3], float max[3]) {
+  for (int k = 0; k < 3; k++) {
+    min[k] = INFINITY;
+    max[k] = -INFINITY;
+  }
+}
+
+/**
+ * @brief Grow box
+ *
+ * Grows the box to hold another box. Coordinates that are not numbers are
+ * skipped.
+ *
+ * @param min Smallest coordinates of the box to grow
+ * @param max Largest coordinates of the box to grow
+ * @param other_min Smallest coordinates of the added box
+ * @param other_max Largest coordinates of the added box
+ */
+static void box_grow(float min[3], float max[3], const float *other_min,
+                     const float *other_max) {
+  // сравнения без ветвлений: не числа оставляют прежнее значение
+  for (int k = 0; k < 3; k++) {
+    min[k] = other_min[k] < min[k] ? other_min[k] : min[k];
+    max[k] = other_max[k] > max[k] ? other_max[k] : max[k];
+  }
+}
+
+/**
+ * @brief Half area
+ *
+ * @return Half of the surface area of the box, 0 for an empty box
+ */
+static float half_area(const float min[3], const float max[3]) {
+  float area = 0.0f;
+  if (min[0] <= max[0]) {
+    float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+    area = dx * dy + dy * dz + dz * dx;
+  }
+  return area;
+}
+
+/**
+ * @brief Facet boxes
+ *
+ * Finds boxes of facets from begin to end by their valid vertices, body of
+ * pool_parallel_for. Facets without valid vertices get empty boxes.
+ *
+ * @param arg Builder
+ * @param begin First facet
+ * @param end Facet after the last one
+ */
+static void facet_boxes(void *arg, size_t begin, size_t end) {
+  bvh_builder_t *B = arg;
+  const data_t *data = B->data;
+
+  for (size_t i = begin; i < end; i++) {
+    primitive_t *primitive = &B->primitives[i];
+    float *min = primitive->min, *max = primitive->max;
+    primitive->facet = (uint32_t)i;
+    box_reset(min, max);
+    size_t count = facet_size(&data->obj_facets, i);
+    for (size_t k = 0; k < count; k++) {
+      size_t vertex = facet_vertex(&data->obj_facets, i, k);
+      if (vertex != 0 && vertex <= data->count_of_vertices) {
+        const float *point = matrix_vertex(&data->obj_matrix, vertex - 1);
+        box_grow(min, max, point, point);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Bin index
+ *
+ * @param scan Scan with the box of centers of the node
+ * @param primitive Facet of the node
+ *
+ * @return Bin of the center of the facet
+ */
+static int bin_index(const node_scan_t *scan, const primitive_t *primitive) {
+  int axis = scan->axis;
+  float center = (primitive->min[axis] + primitive->max[axis]) * 0.5f;
+  float position = (center - scan->center_min[axis]) * scan->scale;
+
+  // центры вне коробки и не числа попадают в крайние корзины
+  position = position < BVH_BINS - 1 ? position : BVH_BINS - 1;
+  return position >= 1.0f ? (int)position : 0;
+}
+
+/**
+ * @brief Scale bins
+ *
+ * Chooses the axis along which centers are spread the most and the number
+ * of bins per unit of length along it. Binning one axis costs a third of
+ * binning all of them and rarely gives a worse split.
+ *
+ * @param scan Scan with the box of centers
+ */
+static void scale_bins(node_scan_t *scan) {
+  float longest = 0.0f;
+  scan->axis = 0;
+  scan->scale = 0.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    float extent = scan->center_max[axis] - scan->center_min[axis];
+    if (extent > longest && isfinite(extent)) {
+      longest = extent;
+      scan->axis = axis;
+      scan->scale = BVH_BINS / extent;
+    }
+  }
+}
+
+/**
+ * @brief Reset scan
+ *
+ * @param scan Scan to reset
+ * @param bins Reset bins, otherwise boxes
+ */
+static void scan_reset(node_scan_t *scan, int bins) {
+  if (bins) {
+    for (int b = 0; b < BVH_BINS; b++) {
+      box_reset(scan->bins[b].min, scan->bins[b].max);
+      scan->bins[b].count = 0;
+    }
+  } else {
+    box_reset(scan->min, scan->max);
+    box_reset(scan->center_min, scan->center_max);
+  }
+}
+
+/**
+ * @brief Scan range
+ *
+ * Grows boxes of facets and of their centers or adds facets to bins.
+ *
+ * @param B Builder
+ * @param ref Scan with the box of centers to count bins, NULL to grow boxes
+ * @param begin First position of facets
+ * @param end Position after the last one
+ * @param scan Scan to add the facets to, may be ref
+ */
+static void scan_range(const bvh_builder_t *B, const node_scan_t *ref,
+                       size_t begin, size_t end, node_scan_t *scan) {
+  for (size_t i = begin; i < end; i++) {
+    const primitive_t *primitive = &B->primitives[i];
+    if (ref == NULL) {
+      float center[3];
+      for (int k = 0; k < 3; k++) {
+        center[k] = (primitive->min[k] + primitive->max[k]) * 0.5f;
+      }
+      box_grow(scan->min, scan->max, primitive->min, primitive->max);
+      box_grow(scan->center_min, scan->center_max, center, center);
+    } else {
+      bin_t *bin = &scan->bins[bin_index(ref, primitive)];
+      box_grow(bin->min, bin->max, primitive->min, primitive->max);
+      bin->count++;
+    }
+  }
+}
+
+/**
+ * @brief Scan chunks
+ *
+ * Scans portions of the node split by the pool, body of pool_parallel_for.
+ *
+ * @param arg Builder
+ * @param begin First portion
+ * @param end Portion after the last one
+ */
+static void scan_chunks(void *arg, size_t begin, size_t end) {
+  bvh_builder_t *B = arg;
+
+  for (size_t c = begin; c < end; c++) {
+    size_t from = B->scan_first + B->scan_count * c / BVH_CHUNKS;
+    size_t to = B->scan_first + B->scan_count * (c + 1) / BVH_CHUNKS;
+    scan_reset(&B->chunks[c], B->scan_ref != NULL);
+    scan_range(B, B->scan_ref, from, to, &B->chunks[c]);
+  }
+}
+
+/**
+ * @brief Scan node
+ *
+ * Finds boxes of facets of the node and of their centers, or counts bins
+ * of the node when the boxes are known. Large nodes are split between the
+ * pool threads.
+ *
+ * @param B Builder
+ * @param first First facet of the node
+ * @param count Number of facets of the node
+ * @param bins Count bins, otherwise find boxes
+ * @param parallel Use the pool threads
+ * @param scan Scan to fill
+ */
+static void scan_node(bvh_builder_t *B, size_t first, size_t count, int bins,
+                      int parallel, node_scan_t *scan) {
+  scan_reset(scan, bins);
+
+  if (parallel) {
+    B->scan_first = first;
+    B->scan_count = count;
+    B->scan_ref = bins ? scan : NULL;
+    pool_parallel_for(BVH_CHUNKS, 2, scan_chunks, B);
+
+    for (size_t c = 0; c < BVH_CHUNKS; c++) {
+      const node_scan_t *chunk = &B->chunks[c];
+      if (bins) {
+        for (int b = 0; b < BVH_BINS; b++) {
+          bin_t *bin = &scan->bins[b];
+          box_grow(bin->min, bin->max, chunk->bins[b].min, chunk->bins[b].max);
+          bin->count += chunk->bins[b].count;
+        }
+      } else {
+        box_grow(scan->min, scan->max, chunk->min, chunk->max);
+        box_grow(scan->center_min, scan->center_max, chunk->center_min,
+                 chunk->center_max);
+      }
+    }
+  } else {
+    scan_range(B, bins ? scan : NULL, first, first + count, scan);
+  }
+  if (!bins) scale_bins(scan);
+}
+
+/**
+ * @brief Find split
+ *
+ * Chooses the boundary between bins with the smallest surface area
+ * heuristic: the sum of areas of both children times their numbers of
+ * facets.
+ *
+ * @param scan Scan of the node with bins
+ *
+ * @return First bin of the right child, 0 if no split separates the facets
+ */
+static int find_split(const node_scan_t *scan) {
+  const bin_t *bins = scan->bins;
+  float right_area[BVH_BINS];
+  size_t right_count[BVH_BINS];
+  float min[3], max[3];
+  size_t count = 0;
+  box_reset(min, max);
+  for (int b = BVH_BINS - 1; b > 0; b--) {
+    box_grow(min, max, bins[b].min, bins[b].max);
+    count += bins[b].count;
+    right_area[b] = half_area(min, max);
+    right_count[b] = count;
+  }
+
+  int split = 0;
+  float best_cost = INFINITY;
+  count = 0;
+  box_reset(min, max);
+  for (int b = 1; b < BVH_BINS; b++) {
+    box_grow(min, max, bins[b - 1].min, bins[b - 1].max);
+    count += bins[b - 1].count;
+    if (count != 0 && right_count[b] != 0) {
+      float cost = half_area(min, max) * (float)count +
+                   right_area[b] * (float)right_count[b];
+      if (cost < best_cost) {
+        best_cost = cost;
+        split = b;
+      }
+    }
+  }
+
+  return split;
+}
+
+/**
+ * @brief Split node
+ *
+ * Finds the box of the node and moves facets of its left child before
+ * facets of the right one.
+ *
+ * @param B Builder
+ * @param node Node to fill with the box
+ * @param depth Depth of the node
+ * @param parallel Use the pool threads
+ *
+ * @return Number of facets of the left child, 0 for a leaf
+ */
+static uint32_t split_node(bvh_builder_t *B, build_node_t *node, int depth,
+                           int parallel) {
+  node_scan_t scan;
+  scan_node(B, node->first, node->count, 0, parallel, &scan);
+  memcpy(node->min, scan.min, sizeof(node->min));
+  memcpy(node->max, scan.max, sizeof(node->max));
+
+  uint32_t left = 0;
+  if (node->count > BVH_LEAF_SIZE) {
+    int split = 0;
+    if (depth < BVH_SAH_DEPTH && scan.scale != 0.0f) {
+      scan_node(B, node->first, node->count, 1, parallel, &scan);
+      split = find_split(&scan);
+    }
+
+    if (split != 0) {
+      primitive_t *primitives = B->primitives;
+      size_t i = node->first, j = (size_t)node->first + node->count;
+      while (i < j) {
+        if (bin_index(&scan, &primitives[i]) < split) {
+          i++;
+        } else {
+          primitive_t primitive = primitives[i];
+          primitives[i] = primitives[--j];
+          primitives[j] = primitive;
+        }
+      }
+      left = (uint32_t)(i - node->first);
+    } else {
+      // центры совпадают, полигоны делятся поровну в порядке следования
+      left = node->count / 2;
+    }
+  }
+
+  return left;
+}
+
+/**
+ * @brief Push node
+ *
+ * Adds a node to the list.
+ *
+ * @param L List of nodes
+ *
+ * @return Index of the node
+ */
+static uint32_t push_node(node_list_t *L) {
+  if (L->count == L->capacity) {
+    size_t capacity = L->capacity != 0 ? L->capacity * 2 : 64;
+    build_node_t *nodes = realloc(L->nodes, capacity * sizeof(build_node_t));
+    if (nodes != NULL) {
+      L->nodes = nodes;
+      L->capacity = capacity;
+    } else {
+      L->error_code = 1;
+    }
+  }
+
+  uint32_t index = 0;
+  if (L->error_code == 0) {
+    index = (uint32_t)L->count++;
+    L->nodes[index] = (build_node_t){0};
+  }
+  return index;
+}
+
+/**
+ * @brief Push task
+ *
+ * Leaves a subtree to be built by one thread later.
+ *
+ * @param B Builder
+ * @param first First facet of the subtree
+ * @param count Number of facets of the subtree
+ * @param depth Depth of the root of the subtree
+ *
+ * @return Number of the task from 1, 0 if memory could not be allocated
+ */
+static uint32_t push_task(bvh_builder_t *B, uint32_t first, uint32_t count,
+                          int depth) {
+  if (B->count_of_tasks == B->capacity_of_tasks) {
+    size_t capacity = B->capacity_of_tasks != 0 ? B->capacity_of_tasks * 2 : 16;
+    node_list_t *tasks = realloc(B->tasks, capacity * sizeof(node_list_t));
+    if (tasks != NULL) {
+      B->tasks = tasks;
+      B->capacity_of_tasks = capacity;
+    } else {
+      B->error_code = 1;
+    }
+  }
+
+  uint32_t task = 0;
+  if (B->error_code == 0) {
+    B->tasks[B->count_of_tasks] = (node_list_t){.first = first,
+                                                .count_of_facets = count,
+                                                .depth = depth};
+    task = (uint32_t)++B->count_of_tasks;
+  }
+  return task;
+}
+
+/**
+ * @brief Build node
+ *
+ * Builds the subtree of facets from first to first + count into the list.
+ * On the top of the tree small subtrees are left to tasks.
+ *
+ * @param B Builder
+ * @param L List of nodes
+ * @param first First facet
+ * @param count Number of facets
+ * @param depth Depth of the node
+ * @param parallel Build the top of the tree
+ *
+ * @return Index of the node in the list
+ */
+static uint32_t build_node(bvh_builder_t *B, node_list_t *L, uint32_t first,
+                           uint32_t count, int depth, int parallel) {
+  uint32_t index = push_node(L);
+  if (L->error_code != 0) return 0;
+  L->nodes[index].first = first;
+  L->nodes[index].count = count;
+
+  if (parallel && count < BVH_PARALLEL_MIN) {
+    L->nodes[index].task = push_task(B, first, count, depth);
+  } else {
+    uint32_t left = split_node(B, &L->nodes[index], depth, parallel);
+    if (left != 0) {
+      // узлы списка могут переехать при добавлении детей
+      uint32_t left_index = build_node(B, L, first, left, depth + 1, parallel);
+      uint32_t right_index =
+          build_node(B, L, first + left, count - left, depth + 1, parallel);
+      if (L->error_code == 0) {
+        L->nodes[index].left = left_index;
+        L->nodes[index].right = right_index;
+      }
+    }
+  }
+
+  return index;
+}
+
+/**
+ * @brief Build tasks
+ *
+ * Builds subtrees of tasks, body of pool_parallel_for.
+ *
+ * @param arg Builder
+ * @param begin First task
+ * @param end Task after the last one
+ */
+static void build_tasks(void *arg, size_t begin, size_t end) {
+  bvh_builder_t *B = arg;
+  for (size_t i = begin; i < end; i++) {
+    node_list_t *task = &B->tasks[i];
+    build_node(B, task, task->first, task->count_of_facets, task->depth, 0);
+  }
+}
+
+/**
+ * @brief Emit node
+ *
+ * Copies the subtree into the hierarchy in depth-first order, replacing
+ * nodes left to tasks with subtrees of the tasks.
+ *
+ * @param bvh Hierarchy with room for all nodes
+ * @param B Builder
+ * @param L List of the node
+ * @param index Index of the node in the list
+ *
+ * @return Index of the node in the hierarchy
+ */
+static uint32_t emit_node(bvh_t *bvh, const bvh_builder_t *B,
+                          const node_list_t *L, uint32_t index) {
+  const build_node_t *node = &L->nodes[index];
+  if (node->task != 0) {
+    L = &B->tasks[node->task - 1];
+    node = &L->nodes[0];
+  }
+
+  uint32_t out = (uint32_t)bvh->count_of_nodes++;
+  bvh_node_t *target = &bvh->nodes[out];
+  *target = (bvh_node_t){0};
+  memcpy(target->min, node->min, sizeof(target->min));
+  memcpy(target->max, node->max, sizeof(target->max));
+  target->first_facet = node->first;
+  target->count_of_facets = node->count;
+
+  if (node->right != 0) {
+    emit_node(bvh, B, L, node->left);
+    // массив узлов выделен заранее и не переезжает
+    target->right = emit_node(bvh, B, L, node->right);
+  }
+  return out;
+}
+
+/**
+ * @brief Hash edge
+ *
+ * Mixes bits of the packed vertex pair.
+ *
+ * @param key Smaller vertex number in the high half, larger in the low half
+ */
+static uint64_t hash_edge(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+/**
+ * @brief Insert edges
+ *
+ * Puts edges from begin to end into the table without locks, body of
+ * pool_parallel_for.
+ *
+ * @param arg Edge order
+ * @param begin First edge
+ * @param end Edge after the last one
+ */
+static void insert_edges(void *arg, size_t begin, size_t end) {
+  edge_order_t *order = arg;
+  const uint32_t *edges = order->data->obj_edges.indices;
+
+  for (size_t e = begin; e < end; e++) {
+    uint64_t key = (uint64_t)edges[e * 2] << 32 | edges[e * 2 + 1];
+    size_t cell = hash_edge(key) & order->mask;
+    uint64_t expected = EMPTY_KEY;
+    while (!__atomic_compare_exchange_n(&order->keys[cell], &expected, key, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      cell = (cell + 1) & order->mask;
+      expected = EMPTY_KEY;
+    }
+    order->values[cell] = (uint32_t)e;
+  }
+}
+
+/**
+ * @brief Own edges
+ *
+ * Marks edges of facets from positions begin to end as owned by the
+ * earliest of them, body of pool_parallel_for. Edges are skipped the same
+ * way as by build_edges.
+ *
+ * @param arg Edge order
+ * @param begin First position of facets
+ * @param end Position after the last one
+ */
+static void own_edges(void *arg, size_t begin, size_t end) {
+  edge_order_t *order = arg;
+  const data_t *data = order->data;
+  const facets_t *facets = &data->obj_facets;
+
+  for (size_t p = begin; p < end; p++) {
+    size_t facet = order->bvh->facets[p];
+    size_t count = facet_size(facets, facet);
+    size_t previous = count != 0 ? facet_vertex(facets, facet, count - 1) : 0;
+
+    for (size_t k = 0; k < count; k++) {
+      size_t current = facet_vertex(facets, facet, k);
+      size_t a = previous < current ? previous : current;
+      size_t b = previous < current ? current : previous;
+      previous = current;
+      if (a == 0 || a == b || b > data->count_of_vertices) continue;
+
+      uint64_t key = (uint64_t)(a - 1) << 32 | (uint64_t)(b - 1);
+      size_t cell = hash_edge(key) & order->mask;
+      while (order->keys[cell] != key && order->keys[cell] != EMPTY_KEY) {
+        cell = (cell + 1) & order->mask;
+      }
+      if (order->keys[cell] == key) {
+        uint32_t *owner = &order->owners[order->values[cell]];
+        uint32_t current_owner = __atomic_load_n(owner, __ATOMIC_RELAXED);
+        while (p < current_owner &&
+               !__atomic_compare_exchange_n(owner, &current_owner, (uint32_t)p,
+                                            1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Order edges
+ *
+ * Reorders unique edges of the object by the positions of their owning
+ * facets in the hierarchy, so edges of every node are one range, and fills
+ * edge ranges of the nodes.
+ *
+ * @param data Object with edges
+ * @param bvh Built hierarchy of the object
+ *
+ * @return 0 on success, 1 on error
+ */
+static int order_edges(data_t *data, bvh_t *bvh) {
+  size_t count_of_edges = data->obj_edges.count_of_edges;
+  size_t count_of_facets = bvh->count_of_facets;
+  edge_order_t order = {data, bvh, NULL, NULL, 0, NULL};
+
+  size_t capacity = 64;
+  while (capacity < count_of_edges * 2) capacity *= 2;
+  order.mask = capacity - 1;
+  order.keys = malloc(capacity * sizeof(uint64_t));
+  order.values = malloc(capacity * sizeof(uint32_t));
+  order.owners = malloc((count_of_edges + 1) * sizeof(uint32_t));
+  uint32_t *starts = calloc(count_of_facets + 1, sizeof(uint32_t));
+  uint32_t *edges = malloc((count_of_edges + 1) * 2 * sizeof(uint32_t));
+  int error_code = order.keys == NULL || order.values == NULL ||
+                           order.owners == NULL || starts == NULL ||
+                           edges == NULL
+                       ? 1
+                       : 0;
+
+  if (error_code == 0) {
+    memset(order.keys, 0xFF, capacity * sizeof(uint64_t));
+    memset(order.owners, 0xFF, count_of_edges * sizeof(uint32_t));
+    pool_parallel_for(count_of_edges, BVH_PARALLEL_MIN, insert_edges, &order);
+    pool_parallel_for(count_of_facets, BVH_PARALLEL_MIN, own_edges, &order);
+
+    // сортировка подсчётом по позиции полигона-владельца
+    for (size_t e = 0; e < count_of_edges; e++) {
+      if (order.owners[e] == UINT32_MAX) order.owners[e] = 0;
+      starts[order.owners[e] + 1]++;
+    }
+    for (size_t p = 1; p <= count_of_facets; p++) starts[p] += starts[p - 1];
+    const uint32_t *source = data->obj_edges.indices;
+    for (size_t e = 0; e < count_of_edges; e++) {
+      uint32_t target = starts[order.owners[e]]++;
+      edges[(size_t)target * 2] = source[e * 2];
+      edges[(size_t)target * 2 + 1] = source[e * 2 + 1];
+    }
+    // после раскладки начало каждой позиции сдвинуто на следующую
+    memmove(starts + 1, starts, count_of_facets * sizeof(uint32_t));
+    starts[0] = 0;
+
+    for (size_t i = 0; i < bvh->count_of_nodes; i++) {
+      bvh_node_t *node = &bvh->nodes[i];
+      node->first_edge = starts[node->first_facet];
+      node->count_of_edges =
+          starts[node->first_facet + node->count_of_facets] - node->first_edge;
+    }
+    free(data->obj_edges.indices);
+    data->obj_edges.indices = edges;
+    edges = NULL;
+    bvh->ordered_edges = 1;
+  }
+
+  free(order.keys);
+  free(order.values);
+  free(order.owners);
+  free(starts);
+  free(edges);
+
+  return error_code;
+}
+
+/**
+ * @brief Free builder
+ *
+ * @param B Builder
+ */
+static void free_builder(bvh_builder_t *B) {
+  free(B->primitives);
+  free(B->top.nodes);
+  for (size_t i = 0; i < B->count_of_tasks; i++) free(B->tasks[i].nodes);
+  free(B->tasks);
+  free(B->chunks);
+}
+
+/**
+ * @brief Build hierarchy
+ *
+ * Builds the bounding volume hierarchy over boxes of facets with binned
+ * splits by the surface area heuristic. Large nodes are split by the
+ * calling thread with bins counted on the pool, then subtrees are built in
+ * parallel. Unique edges, if built, are reordered so edges of every node
+ * are one range for drawing only visible nodes. The result is stored in
+ * data->obj_bvh and replaces the previous hierarchy. The hierarchy is built
+ * only when numbers of facets and edges fit into 32 bits.
+ *
+ * @param data Data structure with all parameters
+ * @param threads Number of threads, 1 to build on the calling thread
+ *
+ * @return 0 on success, 1 on error
+ */
+int build_bvh(data_t *data, size_t threads) {
+  size_t count_of_facets = data->count_of_facets;
+  int error_code = count_of_facets > UINT32_MAX ||
+                           data->obj_edges.count_of_edges >= UINT32_MAX
+                       ? 1
+                       : 0;
+  int parallel = threads != 1;
+  bvh_builder_t B = {.data = data};
+  bvh_t bvh = {0};
+
+  if (error_code == 0) {
+    B.primitives = malloc((count_of_facets + 1) * sizeof(primitive_t));
+    bvh.facets = malloc((count_of_facets + 1) * sizeof(uint32_t));
+    B.chunks = malloc(BVH_CHUNKS * sizeof(node_scan_t));
+    if (B.primitives == NULL || bvh.facets == NULL || B.chunks == NULL) {
+      error_code = 1;
+    }
+  }
+
+  if (error_code == 0) {
+    pool_parallel_for(count_of_facets, parallel ? 4096 : SIZE_MAX,
+                      facet_boxes, &B);
+    // полигоны без допустимых вершин в иерархию не входят
+    for (size_t i = 0; i < count_of_facets; i++) {
+      if (B.primitives[i].min[0] <= B.primitives[i].max[0]) {
+        B.primitives[bvh.count_of_facets++] = B.primitives[i];
+      }
+    }
+
+    if (bvh.count_of_facets != 0) {
+      build_node(&B, &B.top, 0, (uint32_t)bvh.count_of_facets, 0, parallel);
+      pool_parallel_for(B.count_of_tasks, 2, build_tasks, &B);
+    }
+    for (size_t i = 0; i < bvh.count_of_facets; i++) {
+      bvh.facets[i] = B.primitives[i].facet;
+    }
+    size_t count_of_nodes = B.top.count;
+    if (B.top.error_code != 0) error_code = 1;
+    for (size_t i = 0; i < B.count_of_tasks; i++) {
+      if (B.tasks[i].error_code != 0) error_code = 1;
+      count_of_nodes += B.tasks[i].count;
+    }
+    if (B.error_code != 0) error_code = 1;
+
+    if (error_code == 0) {
+      bvh.nodes = malloc((count_of_nodes + 1) * sizeof(bvh_node_t));
+      if (bvh.nodes == NULL) error_code = 1;
+    }
+    if (error_code == 0 && bvh.count_of_facets != 0) {
+      emit_node(&bvh, &B, &B.top, 0);
+    }
+  }
+
+  if (error_code == 0 && data->obj_edges.indices != NULL) {
+    error_code = order_edges(data, &bvh);
+  }
+
+  free_builder(&B);
+  if (error_code == 0) {
+    bvh_free(&data->obj_bvh);
+    data->obj_bvh = bvh;
+  } else {
+    bvh_free(&bvh);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Add range
+ *
+ * Adds a range of edges after the previous ones, joining it with the last
+ * range when they are close. Ranges must be added in increasing order.
+ *
+ * @param R Ranges
+ * @param first First edge
+ * @param count Number of edges
+ *
+ * @return 0 on success, 1 on error
+ */
+int bvh_ranges_add(bvh_ranges_t *R, size_t first, size_t count) {
+  int error_code = 0;
+  size_t *last =
+      R->count_of_ranges != 0 ? R->ranges + (R->count_of_ranges - 1) * 2
+                              : NULL;
+
+  if (count == 0) {
+    // пустой узел
+  } else if (last != NULL && first <= last[0] + last[1] + BVH_RANGE_GAP) {
+    last[1] = first + count - last[0];
+  } else {
+    if (R->count_of_ranges == R->capacity) {
+      size_t capacity = R->capacity != 0 ? R->capacity * 2 : 64;
+      size_t *ranges = realloc(R->ranges, capacity * 2 * sizeof(size_t));
+      if (ranges != NULL) {
+        R->ranges = ranges;
+        R->capacity = capacity;
+      } else {
+        error_code = 1;
+      }
+    }
+    if (error_code == 0) {
+      R->ranges[R->count_of_ranges * 2] = first;
+      R->ranges[R->count_of_ranges * 2 + 1] = count;
+      R->count_of_ranges++;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Cull hierarchy
+ *
+ * Collects ranges of edges of nodes whose boxes are at least partly inside
+ * the view volume of the matrix. Nodes entirely inside are taken whole
+ * without visiting their children. Ranges are in increasing order and close
+ * ones are joined, so they are drawn with few calls.
+ *
+ * @param B Hierarchy with ordered edges
+ * @param mvp Model-view-projection matrix by columns
+ * @param R Ranges to fill, previous ranges are dropped
+ *
+ * @return 0 on success, 1 on error or if edges are not ordered
+ */
+int bvh_cull(const bvh_t *B, const float mvp[16], bvh_ranges_t *R) {
+  int error_code = B->ordered_edges ? 0 : 1;
+  R->count_of_ranges = 0;
+
+  // плоскости пирамиды: от -w до w по каждой оси пространства отсечения
+  float planes[6][4];
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < 4; i++) {
+      planes[axis * 2][i] = mvp[i * 4 + 3] + mvp[i * 4 + axis];
+      planes[axis * 2 + 1][i] = mvp[i * 4 + 3] - mvp[i * 4 + axis];
+    }
+  }
+
+  uint32_t stack[BVH_STACK_SIZE];
+  size_t top = 0;
+  if (B->count_of_nodes != 0) stack[top++] = 0;
+
+  while (error_code == 0 && top != 0) {
+    uint32_t index = stack[--top];
+    const bvh_node_t *node = &B->nodes[index];
+    int inside = 1, outside = 0;
+
+    for (int p = 0; p < 6 && !outside; p++) {
+      const float *plane = planes[p];
+      float near = plane[3], far = plane[3];
+      for (int k = 0; k < 3; k++) {
+        near += plane[k] * (plane[k] > 0.0f ? node->min[k] : node->max[k]);
+        far += plane[k] * (plane[k] > 0.0f ? node->max[k] : node->min[k]);
+      }
+      // коробки с бесконечными координатами проверяются по детям
+      if (far < 0.0f) {
+        outside = 1;
+      } else if (!(near >= 0.0f)) {
+        inside = 0;
+      }
+    }
+
+    if (outside) {
+      // узел вне окна
+    } else if (inside || node->right == 0) {
+      error_code = bvh_ranges_add(R, node->first_edge, node->count_of_edges);
+    } else {
+      stack[top++] = node->right;
+      stack[top++] = index + 1;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Box entry
+ *
+ * @param node Node with the box
+ * @param origin Start of the ray
+ * @param direction Direction of the ray
+ *
+ * @return Distance to the box along the ray, 0 if the start is inside,
+ * INFINITY if the ray misses it
+ */
+static double box_entry(const bvh_node_t *node, const float origin[3],
+                        const float direction[3]) {
+  double near = 0.0, far = INFINITY;
+
+  for (int k = 0; k < 3 && near <= far; k++) {
+    if (direction[k] != 0.0f) {
+      double t1 = (node->min[k] - (double)origin[k]) / direction[k];
+      double t2 = (node->max[k] - (double)origin[k]) / direction[k];
+      if (t1 > t2) {
+        double t = t1;
+        t1 = t2;
+        t2 = t;
+      }
+      if (t1 > near) near = t1;
+      if (t2 < far) far = t2;
+    } else if (!(origin[k] >= node->min[k] && origin[k] <= node->max[k])) {
+      // луч параллелен граням и проходит мимо
+      far = -INFINITY;
+    }
+  }
+
+  return near <= far ? near : INFINITY;
+}
+
+/**
+ * @brief Triangle hit
+ *
+ * Intersects the ray with a triangle from both sides by the Moller-Trumbore
+ * algorithm.
+ *
+ * @return Distance along the ray, INFINITY if it misses the triangle
+ */
+static double triangle_hit(const float *a, const float *b, const float *c,
+                           const float origin[3], const float direction[3]) {
+  double e1[3], e2[3], s[3];
+  for (int k = 0; k < 3; k++) {
+    e1[k] = (double)b[k] - a[k];
+    e2[k] = (double)c[k] - a[k];
+    s[k] = (double)origin[k] - a[k];
+  }
+  double p[3] = {direction[1] * e2[2] - direction[2] * e2[1],
+                 direction[2] * e2[0] - direction[0] * e2[2],
+                 direction[0] * e2[1] - direction[1] * e2[0]};
+  double q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2],
+                 s[0] * e1[1] - s[1] * e1[0]};
+  double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+
+  double t = INFINITY;
+  if (det != 0.0) {
+    double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+    double v =
+        (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) /
+        det;
+    double distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+    if (u >= 0.0 && v >= 0.0 && u + v <= 1.0 && distance >= 0.0) {
+      t = distance;
+    }
+  }
+  return t;
+}
+
+/**
+ * @brief Facet hit
+ *
+ * Intersects the ray with triangles of the fan of a facet.
+ *
+ * @return Distance along the ray, INFINITY if it misses the facet
+ */
+static double facet_hit(const data_t *data, size_t facet,
+                        const float origin[3], const float direction[3]) {
+  const facets_t *facets = &data->obj_facets;
+  size_t count = facet_size(facets, facet);
+  double best = INFINITY;
+
+  for (size_t k = 1; k + 1 < count; k++) {
+    size_t v[3] = {facet_vertex(facets, facet, 0),
+                   facet_vertex(facets, facet, k),
+                   facet_vertex(facets, facet, k + 1)};
+    int valid = 1;
+    for (int i = 0; i < 3; i++) {
+      if (v[i] == 0 || v[i] > data->count_of_vertices) valid = 0;
+    }
+    if (valid) {
+      double t = triangle_hit(matrix_vertex(&data->obj_matrix, v[0] - 1),
+                              matrix_vertex(&data->obj_matrix, v[1] - 1),
+                              matrix_vertex(&data->obj_matrix, v[2] - 1),
+                              origin, direction);
+      if (t < best) best = t;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Cast ray
+ *
+ * Finds the nearest facet hit by the ray, for picking and measuring. Polygons
+ * are split into fans of triangles and hit from both sides. Nodes are
+ * visited nearest first and skipped when they are farther than the nearest
+ * hit found so far.
+ *
+ * @param data Object with the built hierarchy
+ * @param origin Start of the ray
+ * @param direction Direction of the ray, need not be of unit length
+ * @param hit Filled with the nearest hit
+ *
+ * @return 1 if the ray hits a facet, 0 otherwise
+ */
+int bvh_raycast(const data_t *data, const float origin[3],
+                const float direction[3], bvh_hit_t *hit) {
+  const bvh_t *B = &data->obj_bvh;
+  double best = INFINITY;
+  size_t best_facet = 0;
+  uint32_t stack[BVH_STACK_SIZE];
+  size_t top = 0;
+  if (B->count_of_nodes != 0 &&
+      box_entry(&B->nodes[0], origin, direction) < best) {
+    stack[top++] = 0;
+  }
+
+  while (top != 0) {
+    uint32_t index = stack[--top];
+    const bvh_node_t *node = &B->nodes[index];
+    if (!(box_entry(node, origin, direction) < best)) continue;
+
+    if (node->right == 0) {
+      for (uint32_t i = 0; i < node->count_of_facets; i++) {
+        size_t facet = B->facets[node->first_facet + i];
+        double t = facet_hit(data, facet, origin, direction);
+        if (t < best) {
+          best = t;
+          best_facet = facet;
+        }
+      }
+    } else {
+      // ближний ребёнок проверяется первым
+      uint32_t near = index + 1, far = node->right;
+      double near_entry = box_entry(&B->nodes[near], origin, direction);
+      double far_entry = box_entry(&B->nodes[far], origin, direction);
+      if (far_entry < near_entry) {
+        uint32_t child = near;
+        near = far;
+        far = child;
+        double entry = near_entry;
+        near_entry = far_entry;
+        far_entry = entry;
+      }
+      if (far_entry < best) stack[top++] = far;
+      if (near_entry < best) stack[top++] = near;
+    }
+  }
+
+  int found = best < INFINITY;
+  if (found) {
+    hit->distance = (float)best;
+    hit->facet = best_facet;
+    for (int k = 0; k < 3; k++) {
+      hit->point[k] = (float)(origin[k] + direction[k] * best);
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Free hierarchy
+ *
+ * @param B Hierarchy to free, becomes empty
+ */
+void bvh_free(bvh_t *B) {
+  free(B->nodes);
+  free(B->facets);
+  *B = (bvh_t){0};
+}
+
+/**
+ * @brief Free ranges
+ *
+ * @param R Ranges to free, become empty
+ */
+void bvh_ranges_free(bvh_ranges_t *R) {
+  free(R->ranges);
+  *R = (bvh_ranges_t){0};
+}
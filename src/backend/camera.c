@@ -0,0 +1,152 @@
+#include "backend.h"
+
+/**
+ * @brief Reset camera
+ *
+ * Makes the camera identity: no rotation, no pan and zoom 1.
+ *
+ * @param C Camera to reset
+ */
+void camera_reset(camera_t *C) {
+  *C = (camera_t){{1.0, 0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, 1.0};
+}
+
+/**
+ * @brief Arcball point
+ *
+ * Maps a point of the window to the arcball. Points near the center lie on
+ * a sphere of radius 1, farther ones on a hyperbolic sheet joined to it
+ * smoothly, so dragging outside the ball still rotates without jumps.
+ *
+ * @param x Horizontal position from -1 to 1, right is positive
+ * @param y Vertical position from -1 to 1, up is positive
+ * @param point Unit vector towards the point, z looks at the viewer
+ */
+void arcball_point(float x, float y, double point[3]) {
+  double squared = (double)x * x + (double)y * y;
+  double z = squared <= 0.5 ? sqrt(1.0 - squared) : 0.5 / sqrt(squared);
+  double length = sqrt(squared + z * z);
+
+  point[0] = x / length;
+  point[1] = y / length;
+  point[2] = z / length;
+}
+
+/**
+ * @brief Normalize quaternion
+ *
+ * Brings the quaternion back to unit length, so rounding errors of many
+ * small rotations do not add up into a scale.
+ *
+ * @param q Quaternion w, x, y, z
+ */
+static void normalize_quaternion(double q[4]) {
+  double length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+  if (length > 0.0) {
+    for (int i = 0; i < 4; i++) q[i] /= length;
+  } else {
+    q[0] = 1.0;
+    q[1] = q[2] = q[3] = 0.0;
+  }
+}
+
+/**
+ * @brief Rotate camera
+ *
+ * Adds the shortest rotation that turns one arcball point into another.
+ * The rotation is applied after the current one, so it follows the mouse
+ * whatever the object was turned to before. Opposite points give no
+ * rotation, the axis between them is not defined.
+ *
+ * @param C Camera to update
+ * @param from Unit vector where the drag started
+ * @param to Unit vector where the drag is now
+ */
+void camera_rotate(camera_t *C, const double from[3], const double to[3]) {
+  // кватернион поворота на удвоенный угол нормализуется к нужному
+  double delta[4] = {1.0 + from[0] * to[0] + from[1] * to[1] + from[2] * to[2],
+                     from[1] * to[2] - from[2] * to[1],
+                     from[2] * to[0] - from[0] * to[2],
+                     from[0] * to[1] - from[1] * to[0]};
+
+  if (delta[0] > 1e-9) {
+    normalize_quaternion(delta);
+    const double *q = C->orientation;
+    double result[4] = {
+        delta[0] * q[0] - delta[1] * q[1] - delta[2] * q[2] - delta[3] * q[3],
+        delta[0] * q[1] + delta[1] * q[0] + delta[2] * q[3] - delta[3] * q[2],
+        delta[0] * q[2] - delta[1] * q[3] + delta[2] * q[0] + delta[3] * q[1],
+        delta[0] * q[3] + delta[1] * q[2] - delta[2] * q[1] + delta[3] * q[0]};
+    normalize_quaternion(result);
+    memcpy(C->orientation, result, sizeof(result));
+  }
+}
+
+/**
+ * @brief Pan camera
+ *
+ * Moves the view. Offsets are in view units and do not depend on zoom.
+ *
+ * @param C Camera to update
+ * @param x Offset by OX
+ * @param y Offset by OY
+ * @param z Offset by OZ
+ */
+void camera_pan(camera_t *C, double x, double y, double z) {
+  C->pan[0] += x;
+  C->pan[1] += y;
+  C->pan[2] += z;
+}
+
+/**
+ * @brief Zoom camera
+ *
+ * Multiplies the zoom by factor, limited by CAMERA_ZOOM_MIN and
+ * CAMERA_ZOOM_MAX.
+ *
+ * @param C Camera to update
+ * @param factor Value to multiply the zoom by
+ */
+void camera_zoom(camera_t *C, double factor) {
+  double zoom = C->zoom * factor;
+
+  if (!(zoom >= CAMERA_ZOOM_MIN))
+    zoom = CAMERA_ZOOM_MIN;
+  else if (zoom > CAMERA_ZOOM_MAX)
+    zoom = CAMERA_ZOOM_MAX;
+
+  C->zoom = zoom;
+}
+
+/**
+ * @brief Camera matrix
+ *
+ * Converts the camera to a 4x4 matrix by columns: rotation first, then
+ * zoom, then pan.
+ *
+ * @param C Camera to convert
+ * @param matrix Array of 16 floats to fill
+ */
+void camera_matrix(const camera_t *C, float matrix[16]) {
+  double w = C->orientation[0], x = C->orientation[1], y = C->orientation[2],
+         z = C->orientation[3];
+  const double rotation[9] = {1.0 - 2.0 * (y * y + z * z),
+                              2.0 * (x * y + w * z),
+                              2.0 * (x * z - w * y),
+                              2.0 * (x * y - w * z),
+                              1.0 - 2.0 * (x * x + z * z),
+                              2.0 * (y * z + w * x),
+                              2.0 * (x * z + w * y),
+                              2.0 * (y * z - w * x),
+                              1.0 - 2.0 * (x * x + y * y)};
+
+  for (int col = 0; col < 3; col++) {
+    for (int row = 0; row < 3; row++) {
+      matrix[col * 4 + row] = (float)(C->zoom * rotation[col * 3 + row]);
+    }
+    matrix[col * 4 + 3] = 0.0f;
+    matrix[12 + col] = (float)C->pan[col];
+  }
+  matrix[15] = 1.0f;
+}
@@ -0,0 +1,390 @@
+#include "backend.h"
+
+// объекты с меньшим количеством номеров вершин обрабатываются одним потоком
+#define EDGES_PARALLEL_MIN (1 << 18)
+// пустая ячейка таблицы, пара (UINT32_MAX, UINT32_MAX) невозможна
+#define EMPTY_KEY UINT64_MAX
+
+/**
+ * @brief Edge range
+ *
+ * Facets from first to last are walked by one thread, which sorts their
+ * edges into buckets of partitions. Each facet is walked by one thread only.
+ *
+ * @param data Object with facets
+ * @param first First facet of the range
+ * @param last Facet after the last one
+ * @param count_of_partitions Number of partitions
+ * @param counts Number of edges of the range in each partition, then the
+ * position of the next edge of each partition in keys
+ * @param keys Packed vertex pairs of all ranges grouped by partition
+ */
+typedef struct EdgeRange_ {
+  const data_t* data;
+  size_t first;
+  size_t last;
+  size_t count_of_partitions;
+  size_t* counts;
+  uint64_t* keys;
+} edge_range_t;
+
+/**
+ * @brief Edge partition
+ *
+ * Edges whose hash falls into one partition are deduplicated by one thread
+ * with its own hash table, so threads never share a table.
+ *
+ * @param source Packed vertex pairs of the partition, with repeats
+ * @param count_of_source Number of pairs in source
+ * @param keys Open addressing table of sorted vertex pairs
+ * @param capacity Number of cells in the table, a power of two
+ * @param used Number of occupied cells
+ * @param edges Unique edges of the partition, two vertex numbers each
+ * @param error_code 1 if memory could not be allocated
+ */
+typedef struct EdgePartition_ {
+  const uint64_t* source;
+  size_t count_of_source;
+
+  uint64_t* keys;
+  size_t capacity;
+  size_t used;
+
+  uint32_t* edges;
+  int error_code;
+} edge_partition_t;
+
+/**
+ * @brief Hash edge
+ *
+ * Mixes bits of the packed vertex pair.
+ *
+ * @param key Smaller vertex number in the high half, larger in the low half
+ */
+static uint64_t hash_edge(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+/**
+ * @brief Edge partition number
+ *
+ * @param hash Hash of the packed vertex pair
+ * @param count_of_partitions Number of partitions
+ */
+static size_t edge_partition(uint64_t hash, size_t count_of_partitions) {
+  return (size_t)((hash >> 32) % count_of_partitions);
+}
+
+/**
+ * @brief Walk edges
+ *
+ * Passes every edge of facets from first to last to visit as a packed
+ * sorted vertex pair. Edges with a vertex number out of range and degenerate
+ * edges are skipped.
+ *
+ * @param data Object with facets
+ * @param first First facet
+ * @param last Facet after the last one
+ * @param visit Function called for each edge with arg, key and its hash
+ * @param arg Argument of visit
+ */
+static void walk_edges(const data_t* data, size_t first, size_t last,
+                       void (*visit)(void*, uint64_t, uint64_t), void* arg) {
+  const facets_t* facets = &data->obj_facets;
+
+  for (size_t i = first; i < last; i++) {
+    size_t count = facet_size(facets, i);
+    size_t previous = count != 0 ? facet_vertex(facets, i, count - 1) : 0;
+
+    for (size_t k = 0; k < count; k++) {
+      size_t current = facet_vertex(facets, i, k);
+      size_t a = previous < current ? previous : current;
+      size_t b = previous < current ? current : previous;
+      previous = current;
+
+      if (a != 0 && a != b && b <= data->count_of_vertices) {
+        // номера в рёбрах начинаются с нуля, как в OpenGL
+        uint64_t key = (uint64_t)(a - 1) << 32 | (uint64_t)(b - 1);
+        visit(arg, key, hash_edge(key));
+      }
+    }
+  }
+}
+
+/**
+ * @brief Count edge
+ *
+ * Counts the edge in the bucket of its partition, visitor of walk_edges.
+ *
+ * @param arg Range of facets
+ */
+static void count_edge(void* arg, uint64_t key, uint64_t hash) {
+  edge_range_t* range = arg;
+  (void)key;
+  range->counts[edge_partition(hash, range->count_of_partitions)]++;
+}
+
+/**
+ * @brief Store edge
+ *
+ * Writes the edge into the bucket of its partition, visitor of walk_edges.
+ *
+ * @param arg Range of facets
+ */
+static void store_edge(void* arg, uint64_t key, uint64_t hash) {
+  edge_range_t* range = arg;
+  range->keys[range->counts[edge_partition(
+      hash, range->count_of_partitions)]++] = key;
+}
+
+/**
+ * @brief Count ranges
+ *
+ * Counts edges of ranges from begin to end, body of pool_parallel_for.
+ *
+ * @param arg Array of ranges
+ * @param begin First range
+ * @param end Range after the last one
+ */
+static void count_ranges(void* arg, size_t begin, size_t end) {
+  edge_range_t* ranges = arg;
+  for (size_t i = begin; i < end; i++) {
+    walk_edges(ranges[i].data, ranges[i].first, ranges[i].last, count_edge,
+               &ranges[i]);
+  }
+}
+
+/**
+ * @brief Store ranges
+ *
+ * Writes edges of ranges from begin to end into buckets, body of
+ * pool_parallel_for.
+ *
+ * @param arg Array of ranges
+ * @param begin First range
+ * @param end Range after the last one
+ */
+static void store_ranges(void* arg, size_t begin, size_t end) {
+  edge_range_t* ranges = arg;
+  for (size_t i = begin; i < end; i++) {
+    walk_edges(ranges[i].data, ranges[i].first, ranges[i].last, store_edge,
+               &ranges[i]);
+  }
+}
+
+/**
+ * @brief Prepare partition
+ *
+ * Allocates the table and the edges of a partition. Unique edges are not
+ * more than pairs, so neither has to grow.
+ *
+ * @param part Partition to prepare
+ * @param count_of_pairs Number of vertex pairs with repeats
+ */
+static void prepare_partition(edge_partition_t* part, size_t count_of_pairs) {
+  // заполненность таблицы не больше половины
+  part->capacity = 64;
+  while (part->capacity < count_of_pairs * 2) part->capacity *= 2;
+  part->keys = malloc(part->capacity * sizeof(uint64_t));
+  part->edges = malloc((count_of_pairs + 1) * 2 * sizeof(uint32_t));
+  if (part->keys != NULL) {
+    memset(part->keys, 0xFF, part->capacity * sizeof(uint64_t));
+  }
+  if (part->keys == NULL || part->edges == NULL) part->error_code = 1;
+}
+
+/**
+ * @brief Add edge
+ *
+ * Adds the edge to the partition unless it was added before, visitor of
+ * walk_edges.
+ *
+ * @param arg Partition of the edge
+ * @param key Packed sorted vertex pair
+ * @param hash Hash of the key
+ */
+static void add_edge(void* arg, uint64_t key, uint64_t hash) {
+  edge_partition_t* part = arg;
+  size_t mask = part->capacity - 1;
+  size_t cell = hash & mask;
+  while (part->keys[cell] != EMPTY_KEY && part->keys[cell] != key) {
+    cell = (cell + 1) & mask;
+  }
+
+  if (part->keys[cell] == EMPTY_KEY) {
+    part->keys[cell] = key;
+    part->edges[part->used * 2] = (uint32_t)(key >> 32);
+    part->edges[part->used * 2 + 1] = (uint32_t)key;
+    part->used++;
+  }
+}
+
+/**
+ * @brief Collect edges
+ *
+ * Deduplicates the vertex pairs of one partition.
+ *
+ * @param part Partition to fill
+ */
+static void collect_edges(edge_partition_t* part) {
+  prepare_partition(part, part->count_of_source);
+  for (size_t i = 0; part->error_code == 0 && i < part->count_of_source; i++) {
+    add_edge(part, part->source[i], hash_edge(part->source[i]));
+  }
+
+  free(part->keys);
+  part->keys = NULL;
+}
+
+/**
+ * @brief Collect range
+ *
+ * Collects edges of partitions from begin to end, body of pool_parallel_for.
+ *
+ * @param arg Array of partitions
+ * @param begin First partition
+ * @param end Partition after the last one
+ */
+static void collect_range(void* arg, size_t begin, size_t end) {
+  edge_partition_t* parts = arg;
+  for (size_t i = begin; i < end; i++) collect_edges(&parts[i]);
+}
+
+/**
+ * @brief Split edges
+ *
+ * Splits the object into ranges of facets and sorts their edges by
+ * partition in two passes: ranges count edges of each partition, then write
+ * them into one array, where every partition gets a contiguous part in the
+ * order of facets. Each facet is walked twice in total, whatever the number
+ * of threads.
+ *
+ * @param data Object with facets
+ * @param parts Partitions, source is set on success
+ * @param count_of_parts Number of partitions and ranges
+ * @param keys Array of all vertex pairs, to be freed by the caller
+ *
+ * @return 0 on success, 1 on error
+ */
+static int split_edges(const data_t* data, edge_partition_t* parts,
+                       size_t count_of_parts, uint64_t** keys) {
+  edge_range_t* ranges = calloc(count_of_parts, sizeof(edge_range_t));
+  size_t* counts = calloc(count_of_parts * count_of_parts, sizeof(size_t));
+  int error_code = ranges != NULL && counts != NULL ? 0 : 1;
+
+  if (error_code == 0) {
+    for (size_t i = 0; i < count_of_parts; i++) {
+      ranges[i].data = data;
+      ranges[i].first = data->count_of_facets * i / count_of_parts;
+      ranges[i].last = data->count_of_facets * (i + 1) / count_of_parts;
+      ranges[i].count_of_partitions = count_of_parts;
+      ranges[i].counts = counts + i * count_of_parts;
+    }
+    pool_parallel_for(count_of_parts, 2, count_ranges, ranges);
+
+    // начало каждой части в общем массиве, диапазоны идут по порядку
+    size_t total = 0;
+    for (size_t p = 0; p < count_of_parts; p++) {
+      parts[p].count_of_source = 0;
+      for (size_t r = 0; r < count_of_parts; r++) {
+        size_t count = ranges[r].counts[p];
+        ranges[r].counts[p] = total;
+        total += count;
+        parts[p].count_of_source += count;
+      }
+    }
+
+    *keys = malloc((total != 0 ? total : 1) * sizeof(uint64_t));
+    if (*keys == NULL) error_code = 1;
+  }
+  if (error_code == 0) {
+    for (size_t i = 0; i < count_of_parts; i++) ranges[i].keys = *keys;
+    pool_parallel_for(count_of_parts, 2, store_ranges, ranges);
+
+    const uint64_t* source = *keys;
+    for (size_t p = 0; p < count_of_parts; p++) {
+      parts[p].source = source;
+      source += parts[p].count_of_source;
+    }
+  }
+
+  free(counts);
+  free(ranges);
+
+  return error_code;
+}
+
+/**
+ * @brief Build edges
+ *
+ * Builds the list of unique edges of all facets, so an edge shared by two
+ * facets is drawn once. Vertex pairs are sorted and deduplicated with hash
+ * tables; for large objects threads walk ranges of facets, sort their edges
+ * into partitions by edge hash and deduplicate one partition each. The result
+ * is stored in data->obj_edges and replaces the previous list. Edges are
+ * built only when vertex numbers fit into 32 bits.
+ *
+ * @param data Data structure with all parameters
+ * @param threads Number of threads, 0 to use all processors
+ *
+ * @return 0 on success, 1 on error
+ */
+int build_edges(data_t* data, size_t threads) {
+  int error_code = data->count_of_vertices > UINT32_MAX ? 1 : 0;
+  edge_partition_t parts[MAX_PARSER_THREADS] = {0};
+  size_t count_of_parts = 1;
+
+  if (threads == 0) threads = pool_threads();
+  if (data->obj_facets.count_of_indices >= EDGES_PARALLEL_MIN) {
+    count_of_parts =
+        threads < MAX_PARSER_THREADS ? threads : MAX_PARSER_THREADS;
+  }
+
+  // один поток собирает рёбра прямо из полигонов
+  uint64_t* keys = NULL;
+  if (error_code == 0 && count_of_parts == 1) {
+    prepare_partition(&parts[0], data->obj_facets.count_of_indices);
+    if (parts[0].error_code == 0) {
+      walk_edges(data, 0, data->count_of_facets, add_edge, &parts[0]);
+    }
+    free(parts[0].keys);
+  } else if (error_code == 0) {
+    error_code = split_edges(data, parts, count_of_parts, &keys);
+    if (error_code == 0) {
+      pool_parallel_for(count_of_parts, 2, collect_range, parts);
+    }
+  }
+  free(keys);
+
+  size_t count_of_edges = 0;
+  for (size_t i = 0; i < count_of_parts; i++) {
+    if (parts[i].error_code != 0) error_code = 1;
+    count_of_edges += parts[i].used;
+  }
+
+  uint32_t* edges = NULL;
+  if (error_code == 0) {
+    edges = malloc((count_of_edges != 0 ? count_of_edges : 1) * 2 *
+                   sizeof(uint32_t));
+    if (edges == NULL) error_code = 1;
+  }
+  if (error_code == 0) {
+    uint32_t* out = edges;
+    for (size_t i = 0; i < count_of_parts; i++) {
+      memcpy(out, parts[i].edges, parts[i].used * 2 * sizeof(uint32_t));
+      out += parts[i].used * 2;
+    }
+    free(data->obj_edges.indices);
+    data->obj_edges.indices = edges;
+    data->obj_edges.count_of_edges = count_of_edges;
+  }
+
+  for (size_t i = 0; i < count_of_parts; i++) free(parts[i].edges);
+
+  return error_code;
+}
@@ -0,0 +1,288 @@
+#include "backend.h"
+
+/**
+ * @brief Reserve history
+ *
+ * Makes room for at least needed items of an array, doubling its capacity.
+ *
+ * @param array Array to grow, replaced on success
+ * @param capacity Current capacity in items, updated on success
+ * @param needed Number of items that must fit
+ * @param item_size Size of one item
+ *
+ * @return 0 on success, 1 on error (the old array stays valid)
+ */
+static int reserve_history(void **array, size_t *capacity, size_t needed,
+                           size_t item_size) {
+  int error_code = 0;
+
+  if (needed > *capacity) {
+    size_t new_capacity = *capacity != 0 ? *capacity * 2 : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    void *grown = realloc(*array, new_capacity * item_size);
+    if (grown != NULL) {
+      *array = grown;
+      *capacity = new_capacity;
+    } else {
+      error_code = 1;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Merge operation
+ *
+ * Adds an operation into the previous one when the result is the same as
+ * making them one after another: moves inside the offset limit and
+ * rotations by one and the same axis.
+ *
+ * @param last Previous operation, updated on success
+ * @param next Operation to add
+ *
+ * @return 1 if the operation was merged, 0 otherwise
+ */
+int merge_operation(operation_t *last, const operation_t *next) {
+  int merged = 0;
+
+  if (last->type == OPERATION_MOVE && next->type == OPERATION_MOVE) {
+    float x = last->x + next->x, y = last->y + next->y, z = last->z + next->z;
+    merged = fabsf(x) <= OFFSET_LIMIT && fabsf(y) <= OFFSET_LIMIT &&
+             fabsf(z) <= OFFSET_LIMIT && fabsf(next->x) <= OFFSET_LIMIT &&
+             fabsf(next->y) <= OFFSET_LIMIT && fabsf(next->z) <= OFFSET_LIMIT;
+  } else if (last->type == OPERATION_ROTATE &&
+             next->type == OPERATION_ROTATE) {
+    // повороты по разным осям не переставляются
+    int axes = (last->x != 0.0f || next->x != 0.0f) +
+               (last->y != 0.0f || next->y != 0.0f) +
+               (last->z != 0.0f || next->z != 0.0f);
+    merged = axes <= 1;
+  }
+  if (merged) {
+    last->x += next->x;
+    last->y += next->y;
+    last->z += next->z;
+  }
+
+  return merged;
+}
+
+/**
+ * @brief Compose after resets
+ *
+ * Adds operations to the transform, starting over from the identity at
+ * every reset.
+ *
+ * @param T Transform to update
+ * @param operations Operations to add
+ * @param count Number of operations
+ */
+static void compose_after_resets(transform_t *T, const operation_t *operations,
+                                 size_t count) {
+  size_t begin = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    if (operations[i].type == OPERATION_RESET) begin = i + 1;
+  }
+  if (begin != 0) transform_reset(T);
+  if (begin < count) transform_compose(T, operations + begin, count - begin);
+}
+
+/**
+ * @brief Update snapshots
+ *
+ * Drops snapshots that cover changed operations and adds the ones for new
+ * operations. Snapshots only speed up history_transform, so without memory
+ * for them the history still works.
+ *
+ * @param H History
+ * @param changed First operation that was written or changed
+ */
+static void update_snapshots(history_t *H, size_t changed) {
+  const size_t interval = HISTORY_SNAPSHOT_INTERVAL;
+  size_t valid = changed / interval;
+
+  if (H->count_of_snapshots > valid) H->count_of_snapshots = valid;
+  while ((H->count_of_snapshots + 1) * interval <= H->count_of_operations &&
+         reserve_history((void **)&H->snapshots, &H->snapshots_capacity,
+                         H->count_of_snapshots + 1, sizeof(transform_t)) == 0) {
+    size_t n = H->count_of_snapshots;
+    transform_t snapshot;
+    if (n != 0) {
+      snapshot = H->snapshots[n - 1];
+    } else {
+      transform_reset(&snapshot);
+    }
+    compose_after_resets(&snapshot, H->operations + n * interval, interval);
+    H->snapshots[n] = snapshot;
+    H->count_of_snapshots++;
+  }
+}
+
+/**
+ * @brief Record step
+ *
+ * Adds operations to the history as a new step. Undone steps are forgotten.
+ * With merge the operations are added to the last step instead, so a slider
+ * drag is undone at once; a step that was undone is never merged into. A
+ * merged operation that continues the last one of the step is added into
+ * it, so a long drag keeps the history small.
+ *
+ * @param H History
+ * @param operations Operations of the step
+ * @param count Number of operations
+ * @param merge Add operations to the last step
+ *
+ * @return 0 on success, 1 on error
+ */
+int history_record(history_t *H, const operation_t *operations, size_t count,
+                   int merge) {
+  size_t kept = H->position != 0 ? H->steps[H->position - 1] : 0;
+  int error_code = 0;
+
+  merge = merge && H->position != 0 && H->position == H->count_of_steps;
+  if (!merge) {
+    error_code = reserve_history((void **)&H->steps, &H->steps_capacity,
+                                 H->position + 1, sizeof(size_t));
+  }
+  if (error_code == 0) {
+    error_code = reserve_history((void **)&H->operations, &H->capacity,
+                                 kept + count, sizeof(operation_t));
+  }
+
+  if (error_code == 0) {
+    // с новыми объединяются только операции того же шага
+    size_t first = kept;
+    if (merge) first = H->position > 1 ? H->steps[H->position - 2] : 0;
+    size_t end = kept, changed = kept;
+
+    for (size_t i = 0; i < count; i++) {
+      if (end > first && merge_operation(&H->operations[end - 1],
+                                         &operations[i])) {
+        if (end - 1 < changed) changed = end - 1;
+      } else {
+        H->operations[end++] = operations[i];
+      }
+    }
+    H->count_of_operations = end;
+    if (!merge) H->position++;
+    H->steps[H->position - 1] = H->count_of_operations;
+    H->count_of_steps = H->position;
+    update_snapshots(H, changed);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Undo step
+ *
+ * Marks the last step that is not undone as undone.
+ *
+ * @param H History
+ *
+ * @return 0 on success, 1 if there is nothing to undo
+ */
+int history_undo(history_t *H) {
+  int error_code = H->position != 0 ? 0 : 1;
+  if (error_code == 0) H->position--;
+
+  return error_code;
+}
+
+/**
+ * @brief Redo step
+ *
+ * Marks the first undone step as done again.
+ *
+ * @param H History
+ *
+ * @return 0 on success, 1 if there is nothing to redo
+ */
+int history_redo(history_t *H) {
+  int error_code = H->position < H->count_of_steps ? 0 : 1;
+  if (error_code == 0) H->position++;
+
+  return error_code;
+}
+
+/**
+ * @brief History operations
+ *
+ * Returns operations of the steps that are not undone, in their order.
+ *
+ * @param H History
+ * @param count Number of returned operations
+ *
+ * @return Operations, NULL if there are none
+ */
+const operation_t *history_operations(const history_t *H, size_t *count) {
+  *count = H->position != 0 ? H->steps[H->position - 1] : 0;
+
+  return *count != 0 ? H->operations : NULL;
+}
+
+/**
+ * @brief History transform
+ *
+ * Composes the transform after the steps that are not undone. Only matrices
+ * are multiplied, vertices are not touched, so any point of the history is
+ * reached without a pass over the object. Operations are composed from the
+ * nearest snapshot, not from the first one.
+ *
+ * @param H History
+ * @param base Transform before the first step and after every reset
+ * @param T Resulting transform
+ */
+void history_transform(const history_t *H, const transform_t *base,
+                       transform_t *T) {
+  size_t count = 0;
+  const operation_t *operations = history_operations(H, &count);
+  size_t snapshot = count / HISTORY_SNAPSHOT_INTERVAL;
+  if (snapshot > H->count_of_snapshots) snapshot = H->count_of_snapshots;
+  size_t first = snapshot * HISTORY_SNAPSHOT_INTERVAL;
+  size_t begin = 0;
+
+  // операции до последнего сброса ни на что не влияют
+  for (size_t i = first; i < count; i++) {
+    if (operations[i].type == OPERATION_RESET) begin = i + 1;
+  }
+
+  if (begin == 0 && snapshot != 0) {
+    // сохранённое преобразование применяется после исходного
+    transform_t after = H->snapshots[snapshot - 1];
+    transform_compose(&after, operations + first, count - first);
+    transform_t result;
+    for (int col = 0; col < 4; col++) {
+      for (int row = 0; row < 4; row++) {
+        double sum = 0.0;
+        for (int k = 0; k < 4; k++) {
+          sum += after.model[k * 4 + row] * base->model[col * 4 + k];
+        }
+        result.model[col * 4 + row] = sum;
+      }
+    }
+    *T = result;
+  } else {
+    *T = *base;
+    if (begin < count) {
+      transform_compose(T, operations + begin, count - begin);
+    }
+  }
+}
+
+/**
+ * @brief Free history
+ *
+ * Frees memory of the history and makes it empty.
+ *
+ * @param H History
+ */
+void history_free(history_t *H) {
+  free(H->operations);
+  free(H->steps);
+  free(H->snapshots);
+  *H = (history_t){0};
+}
@@ -0,0 +1,889 @@
+#include "backend.h"
+
+#include <float.h>
+
+// объекты с меньшим количеством треугольников не упрощаются
+#define LOD_MIN_TRIANGLES 1024
+// во сколько раз у следующего уровня меньше треугольников
+#define LOD_RATIO 4
+// вес плоскостей, удерживающих край открытой поверхности
+#define LOD_BORDER_WEIGHT 10.0f
+// рёбра меньших объектов оцениваются одним потоком
+#define LOD_PARALLEL_MIN (1 << 14)
+// количество чисел квадрики: верхний треугольник матрицы 4x4 и вес
+#define QUADRIC_SIZE 11
+// разрядность цифры поразрядной сортировки
+#define RADIX_BITS 16
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+/**
+ * @brief Collapse
+ *
+ * Edge that can be collapsed into one vertex.
+ *
+ * @param cost Mean squared distance of the new vertex from planes of the
+ * merged vertices
+ * @param a Vertex that stays
+ * @param b Vertex merged into a
+ */
+typedef struct Collapse_ {
+  float cost;
+  uint32_t a;
+  uint32_t b;
+} collapse_t;
+
+/**
+ * @brief Simplifier
+ *
+ * Triangles of the object being simplified by edge collapses. Positions are
+ * moved into the unit sphere around the object, so float quadrics keep
+ * their precision far from the origin. Buffers used by every pass are
+ * allocated once for the object before simplification.
+ *
+ * @param positions Three coordinates of every vertex
+ * @param quadrics QUADRIC_SIZE numbers of the error quadric of every vertex
+ * @param count_of_vertices Number of vertices
+ * @param triangles Three vertex numbers from 0 of every triangle
+ * @param sides Bit k is set if side k of the triangle is an edge of a facet
+ * @param count_of_triangles Number of triangles
+ * @param center Center of the object
+ * @param scale Radius of the object, positions are divided by it
+ * @param keys Sorted vertex pairs of sides of triangles, then collapses
+ * ordered by cost
+ * @param scratch Second buffer of radix sort, as large as keys
+ * @param histograms Histograms of all digits of radix sort
+ * @param collapses Edges with the cost of collapsing them
+ * @param adjacency Triangles of every vertex, from offsets[v] to
+ * offsets[v + 1]
+ * @param offsets Offsets into adjacency
+ * @param remap Vertex every vertex is merged into
+ * @param locked Vertices already collapsed in this pass
+ */
+typedef struct Simplifier_ {
+  float *positions;
+  float *quadrics;
+  size_t count_of_vertices;
+  uint32_t *triangles;
+  uint8_t *sides;
+  size_t count_of_triangles;
+  float center[3];
+  float scale;
+
+  uint64_t *keys;
+  uint64_t *scratch;
+  size_t *histograms;
+  collapse_t *collapses;
+  uint32_t *adjacency;
+  size_t *offsets;
+  uint32_t *remap;
+  uint8_t *locked;
+} simplifier_t;
+
+/**
+ * @brief Add plane
+ *
+ * Adds the squared distance to the plane n * p + d = 0 to the quadric.
+ *
+ * @param q Quadric
+ * @param n Unit normal of the plane
+ * @param d Offset of the plane
+ * @param weight Weight of the plane
+ */
+static void add_plane(float *q, const float n[3], float d, float weight) {
+  q[0] += weight * n[0] * n[0];
+  q[1] += weight * n[0] * n[1];
+  q[2] += weight * n[0] * n[2];
+  q[3] += weight * n[0] * d;
+  q[4] += weight * n[1] * n[1];
+  q[5] += weight * n[1] * n[2];
+  q[6] += weight * n[1] * d;
+  q[7] += weight * n[2] * n[2];
+  q[8] += weight * n[2] * d;
+  q[9] += weight * d * d;
+  q[10] += weight;
+}
+
+/**
+ * @brief Quadric error
+ *
+ * Returns the weighted mean squared distance from the point to the planes
+ * of the quadric.
+ *
+ * @param q Quadric
+ * @param p Point
+ */
+static double quadric_error(const double *q, const double p[3]) {
+  double x = p[0], y = p[1], z = p[2];
+  double error = q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z +
+                 2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z +
+                 2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+
+  return q[10] > 0.0 && error > 0.0 ? error / q[10] : 0.0;
+}
+
+/**
+ * @brief Collapse position
+ *
+ * Finds the position of the vertex left after collapsing an edge. It is the
+ * point with the smallest error of the summed quadric; when that point is
+ * not defined or lies far from the edge, the best of the ends and the middle
+ * of the edge is taken.
+ *
+ * @param S Simplifier
+ * @param a First vertex of the edge
+ * @param b Second vertex of the edge
+ * @param p Position to fill
+ *
+ * @return Error of the position
+ */
+static double collapse_position(const simplifier_t *S, uint32_t a, uint32_t b,
+                                double p[3]) {
+  const float *qa = S->quadrics + (size_t)a * QUADRIC_SIZE;
+  const float *qb = S->quadrics + (size_t)b * QUADRIC_SIZE;
+  const float *pa = S->positions + (size_t)a * 3;
+  const float *pb = S->positions + (size_t)b * 3;
+  double q[QUADRIC_SIZE];
+  for (int i = 0; i < QUADRIC_SIZE; i++) q[i] = (double)qa[i] + qb[i];
+
+  // минимум квадрики по правилу Крамера
+  double det = q[0] * (q[4] * q[7] - q[5] * q[5]) -
+               q[1] * (q[1] * q[7] - q[5] * q[2]) +
+               q[2] * (q[1] * q[5] - q[4] * q[2]);
+  double trace = (q[0] + q[4] + q[7]) / 3.0;
+  double length = 0.0, middle[3];
+  for (int k = 0; k < 3; k++) {
+    middle[k] = ((double)pa[k] + pb[k]) * 0.5;
+    length += ((double)pa[k] - pb[k]) * ((double)pa[k] - pb[k]);
+  }
+
+  double error = INFINITY;
+  if (fabs(det) > 1e-9 * trace * trace * trace) {
+    p[0] = (-q[3] * (q[4] * q[7] - q[5] * q[5]) +
+            q[6] * (q[1] * q[7] - q[5] * q[2]) -
+            q[8] * (q[1] * q[5] - q[4] * q[2])) / det;
+    p[1] = (q[0] * (-q[6] * q[7] + q[5] * q[8]) -
+            q[1] * (-q[3] * q[7] + q[8] * q[2]) +
+            q[2] * (-q[3] * q[5] + q[6] * q[2])) / det;
+    p[2] = (q[0] * (-q[4] * q[8] + q[6] * q[5]) -
+            q[1] * (-q[1] * q[8] + q[3] * q[5]) +
+            q[2] * (-q[1] * q[6] + q[3] * q[4])) / det;
+    double distance = 0.0;
+    for (int k = 0; k < 3; k++) {
+      distance += (p[k] - middle[k]) * (p[k] - middle[k]);
+    }
+    if (distance <= length) error = quadric_error(q, p);
+  }
+
+  if (!(error < INFINITY)) {
+    memcpy(p, middle, sizeof(middle));
+    const double ends[3][3] = {{pa[0], pa[1], pa[2]},
+                               {pb[0], pb[1], pb[2]},
+                               {middle[0], middle[1], middle[2]}};
+    for (int i = 0; i < 3; i++) {
+      double candidate = quadric_error(q, ends[i]);
+      if (candidate < error) {
+        error = candidate;
+        memcpy(p, ends[i], sizeof(ends[i]));
+      }
+    }
+  }
+
+  return error;
+}
+
+/**
+ * @brief Compare keys
+ *
+ * Orders packed vertex pairs for bsearch.
+ */
+static int compare_keys(const void *x, const void *y) {
+  uint64_t a = *(const uint64_t *)x, b = *(const uint64_t *)y;
+  return (a > b) - (a < b);
+}
+
+/**
+ * @brief Radix sort
+ *
+ * Sorts keys by bits from first_bit to the highest one, RADIX_BITS bits at
+ * a time. Digits equal in all keys are skipped, so small vertex numbers cost
+ * fewer passes. Keys equal in the sorted bits keep their order.
+ *
+ * @param S Simplifier with scratch and histograms
+ * @param keys Keys to sort
+ * @param count Number of keys
+ * @param first_bit Lowest bit to sort by, a multiple of RADIX_BITS
+ */
+static void radix_sort(simplifier_t *S, uint64_t *keys, size_t count,
+                       int first_bit) {
+  const int digits = (64 - first_bit) / RADIX_BITS;
+  size_t *histograms = S->histograms;
+  uint64_t *from = keys, *to = S->scratch;
+
+  memset(histograms, 0, (size_t)digits * RADIX_SIZE * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    for (int d = 0; d < digits; d++) {
+      int shift = first_bit + d * RADIX_BITS;
+      histograms[d * RADIX_SIZE + (keys[i] >> shift & (RADIX_SIZE - 1))]++;
+    }
+  }
+
+  for (int d = 0; d < digits; d++) {
+    size_t *histogram = histograms + d * RADIX_SIZE;
+    int shift = first_bit + d * RADIX_BITS;
+    // все ключи в одной корзине, цифра ничего не меняет
+    if (count == 0 || histogram[from[0] >> shift & (RADIX_SIZE - 1)] == count) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < RADIX_SIZE; i++) {
+      size_t bucket = histogram[i];
+      histogram[i] = offset;
+      offset += bucket;
+    }
+    for (size_t i = 0; i < count; i++) {
+      to[histogram[from[i] >> shift & (RADIX_SIZE - 1)]++] = from[i];
+    }
+    uint64_t *swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if (from != keys) memcpy(keys, from, count * sizeof(uint64_t));
+}
+
+/**
+ * @brief Side key
+ *
+ * Packs the vertices of side k of a triangle, the smaller one first.
+ *
+ * @param triangle Three vertex numbers
+ * @param k Number of the side from 0 to 2
+ */
+static uint64_t side_key(const uint32_t *triangle, int k) {
+  uint32_t a = triangle[k], b = triangle[(k + 1) % 3];
+  return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+/**
+ * @brief Fill keys
+ *
+ * Packs sides of all triangles into keys and sorts them, so equal sides
+ * are next to each other.
+ *
+ * @param S Simplifier
+ */
+static void fill_keys(simplifier_t *S) {
+  size_t count = S->count_of_triangles;
+
+  for (size_t t = 0; t < count; t++) {
+    for (int k = 0; k < 3; k++) {
+      S->keys[t * 3 + k] = side_key(S->triangles + t * 3, k);
+    }
+  }
+  radix_sort(S, S->keys, count * 3, 0);
+}
+
+/**
+ * @brief Triangle normal
+ *
+ * Computes the normal of a triangle, its length is twice the area.
+ *
+ * @param p0 First corner
+ * @param p1 Second corner
+ * @param p2 Third corner
+ * @param n Normal to fill
+ */
+static void triangle_normal(const double p0[3], const double p1[3],
+                            const double p2[3], double n[3]) {
+  double u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  double v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+
+  n[0] = u[1] * v[2] - u[2] * v[1];
+  n[1] = u[2] * v[0] - u[0] * v[2];
+  n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+/**
+ * @brief Corner position
+ *
+ * Returns a corner of a triangle as doubles.
+ *
+ * @param S Simplifier
+ * @param vertex Vertex number
+ * @param p Position to fill
+ */
+static void corner_position(const simplifier_t *S, uint32_t vertex,
+                            double p[3]) {
+  for (int k = 0; k < 3; k++) p[k] = S->positions[(size_t)vertex * 3 + k];
+}
+
+/**
+ * @brief Free simplifier
+ *
+ * Frees all buffers of the simplifier.
+ *
+ * @param S Simplifier
+ */
+static void free_simplifier(simplifier_t *S) {
+  free(S->positions);
+  free(S->quadrics);
+  free(S->triangles);
+  free(S->sides);
+  free(S->keys);
+  free(S->scratch);
+  free(S->histograms);
+  free(S->collapses);
+  free(S->adjacency);
+  free(S->offsets);
+  free(S->remap);
+  free(S->locked);
+  *S = (simplifier_t){0};
+}
+
+/**
+ * @brief Triangulate facets
+ *
+ * Splits every facet into a fan of triangles and marks sides of triangles
+ * that are edges of the facet, so inner sides of the fan are never drawn.
+ * Facets with vertex numbers out of range and degenerate triangles are
+ * skipped.
+ *
+ * @param S Simplifier with allocated triangles
+ * @param data Object
+ */
+static void triangulate_facets(simplifier_t *S, const data_t *data) {
+  const facets_t *facets = &data->obj_facets;
+  size_t count = 0;
+
+  for (size_t i = 0; i < data->count_of_facets; i++) {
+    size_t size = facet_size(facets, i);
+    int valid = size >= 3;
+    for (size_t k = 0; valid && k < size; k++) {
+      size_t vertex = facet_vertex(facets, i, k);
+      valid = vertex != 0 && vertex <= data->count_of_vertices;
+    }
+
+    for (size_t k = 1; valid && k + 1 < size; k++) {
+      uint32_t *triangle = S->triangles + count * 3;
+      triangle[0] = (uint32_t)(facet_vertex(facets, i, 0) - 1);
+      triangle[1] = (uint32_t)(facet_vertex(facets, i, k) - 1);
+      triangle[2] = (uint32_t)(facet_vertex(facets, i, k + 1) - 1);
+      if (triangle[0] != triangle[1] && triangle[1] != triangle[2] &&
+          triangle[2] != triangle[0]) {
+        S->sides[count] = (uint8_t)(2 | (k == 1 ? 1 : 0) |
+                                    (k + 2 == size ? 4 : 0));
+        count++;
+      }
+    }
+  }
+
+  S->count_of_triangles = count;
+}
+
+/**
+ * @brief Build quadrics
+ *
+ * Sums planes of triangles around every vertex, weighted by their area.
+ * Sides used by one triangle lie on the border of an open surface; they get
+ * a heavy plane across the triangle, so the border does not shrink.
+ *
+ * @param S Simplifier with triangles and positions
+ */
+static void build_quadrics(simplifier_t *S) {
+  size_t count = S->count_of_triangles;
+
+  memset(S->quadrics, 0,
+         S->count_of_vertices * QUADRIC_SIZE * sizeof(float));
+  fill_keys(S);
+
+  for (size_t t = 0; t < count; t++) {
+    const uint32_t *triangle = S->triangles + t * 3;
+    double p[3][3], n[3];
+    for (int k = 0; k < 3; k++) corner_position(S, triangle[k], p[k]);
+    triangle_normal(p[0], p[1], p[2], n);
+    double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (area == 0.0) continue;
+
+    float unit[3] = {(float)(n[0] / area), (float)(n[1] / area),
+                     (float)(n[2] / area)};
+    float d = -(float)(unit[0] * p[0][0] + unit[1] * p[0][1] +
+                       unit[2] * p[0][2]);
+    for (int k = 0; k < 3; k++) {
+      add_plane(S->quadrics + (size_t)triangle[k] * QUADRIC_SIZE, unit, d,
+                (float)(area * 0.5));
+    }
+
+    for (int k = 0; k < 3; k++) {
+      uint64_t key = side_key(triangle, k);
+      const uint64_t *found =
+          bsearch(&key, S->keys, count * 3, sizeof(uint64_t), compare_keys);
+      // bsearch находит любую из равных пар, соседние проверяются
+      int border = (found == S->keys || found[-1] != key) &&
+                   (found + 1 == S->keys + count * 3 || found[1] != key);
+      if (!border) continue;
+
+      const double *a = p[k], *b = p[(k + 1) % 3];
+      double edge[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      double across[3] = {unit[1] * edge[2] - unit[2] * edge[1],
+                          unit[2] * edge[0] - unit[0] * edge[2],
+                          unit[0] * edge[1] - unit[1] * edge[0]};
+      double length = sqrt(across[0] * across[0] + across[1] * across[1] +
+                           across[2] * across[2]);
+      if (length == 0.0) continue;
+      float plane[3] = {(float)(across[0] / length),
+                        (float)(across[1] / length),
+                        (float)(across[2] / length)};
+      float offset = -(float)(plane[0] * a[0] + plane[1] * a[1] +
+                              plane[2] * a[2]);
+      float weight = LOD_BORDER_WEIGHT * (float)(length * length);
+      add_plane(S->quadrics + (size_t)triangle[k] * QUADRIC_SIZE, plane,
+                offset, weight);
+      add_plane(S->quadrics + (size_t)triangle[(k + 1) % 3] * QUADRIC_SIZE,
+                plane, offset, weight);
+    }
+  }
+}
+
+/**
+ * @brief Initialize simplifier
+ *
+ * Copies vertices of the object into the unit sphere, splits facets into
+ * triangles, builds quadrics and allocates buffers of passes.
+ *
+ * @param S Simplifier to fill
+ * @param data Object
+ *
+ * @return 0 on success, 1 on error
+ */
+static int init_simplifier(simplifier_t *S, const data_t *data) {
+  size_t vertices = data->count_of_vertices;
+  size_t triangles = 0;
+  int error_code = vertices > UINT32_MAX ? 1 : 0;
+
+  for (size_t i = 0; i < data->count_of_facets; i++) {
+    size_t size = facet_size(&data->obj_facets, i);
+    if (size >= 3) triangles += size - 2;
+  }
+
+  *S = (simplifier_t){0};
+  if (error_code == 0) {
+    S->positions = malloc((vertices * 3 + 1) * sizeof(float));
+    S->quadrics = malloc((vertices * QUADRIC_SIZE + 1) * sizeof(float));
+    S->triangles = malloc((triangles * 3 + 1) * sizeof(uint32_t));
+    S->sides = malloc(triangles + 1);
+    S->keys = malloc((triangles * 3 + 1) * sizeof(uint64_t));
+    S->scratch = malloc((triangles * 3 + 1) * sizeof(uint64_t));
+    S->histograms = malloc(64 / RADIX_BITS * RADIX_SIZE * sizeof(size_t));
+    S->collapses = malloc((triangles * 3 + 1) * sizeof(collapse_t));
+    S->adjacency = malloc((triangles * 3 + 1) * sizeof(uint32_t));
+    S->offsets = malloc((vertices + 1) * sizeof(size_t));
+    S->remap = malloc((vertices + 1) * sizeof(uint32_t));
+    S->locked = malloc(vertices + 1);
+    error_code = S->positions == NULL || S->quadrics == NULL ||
+                 S->triangles == NULL || S->sides == NULL ||
+                 S->keys == NULL || S->scratch == NULL ||
+                 S->histograms == NULL || S->collapses == NULL ||
+                 S->adjacency == NULL || S->offsets == NULL ||
+                 S->remap == NULL || S->locked == NULL;
+  }
+
+  if (error_code == 0) {
+    float scale = data->bounds.radius;
+    if (!(scale > 0.0f) || !isfinite(1.0f / scale)) scale = 1.0f;
+    S->scale = scale;
+    for (int k = 0; k < 3; k++) {
+      S->center[k] = isfinite(data->bounds.center[k]) ? data->bounds.center[k]
+                                                      : 0.0f;
+    }
+    S->count_of_vertices = vertices;
+    for (size_t v = 0; v < vertices; v++) {
+      const float *vertex = matrix_vertex(&data->obj_matrix, v);
+      for (int k = 0; k < 3; k++) {
+        S->positions[v * 3 + k] = (vertex[k] - S->center[k]) / scale;
+      }
+    }
+
+    triangulate_facets(S, data);
+    build_quadrics(S);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Cost range
+ *
+ * Computes costs of collapses from begin to end, body of pool_parallel_for.
+ *
+ * @param arg Simplifier with edges in keys
+ * @param begin First edge
+ * @param end Edge after the last one
+ */
+static void cost_range(void *arg, size_t begin, size_t end) {
+  simplifier_t *S = arg;
+
+  for (size_t i = begin; i < end; i++) {
+    collapse_t *collapse = &S->collapses[i];
+    double p[3];
+    collapse->a = (uint32_t)(S->keys[i] >> 32);
+    collapse->b = (uint32_t)S->keys[i];
+    collapse->cost = (float)collapse_position(S, collapse->a, collapse->b, p);
+    if (!(collapse->cost <= FLT_MAX)) collapse->cost = INFINITY;
+  }
+}
+
+/**
+ * @brief Collapse flips
+ *
+ * Checks whether moving both vertices of an edge to a new position turns
+ * any triangle around them over. Triangles are taken as they are after the
+ * collapses already made in this pass.
+ *
+ * @param S Simplifier with adjacency and remap of this pass
+ * @param a First vertex of the edge
+ * @param b Second vertex of the edge
+ * @param p New position
+ *
+ * @return 1 if a triangle turns over, 0 otherwise
+ */
+static int collapse_flips(const simplifier_t *S, uint32_t a, uint32_t b,
+                          const double p[3]) {
+  int flips = 0;
+  const uint32_t ends[2] = {a, b};
+
+  for (int e = 0; !flips && e < 2; e++) {
+    uint32_t v = ends[e];
+    for (size_t i = S->offsets[v]; !flips && i < S->offsets[v + 1]; i++) {
+      const uint32_t *triangle = S->triangles + (size_t)S->adjacency[i] * 3;
+      uint32_t corners[3];
+      int shared = 0;
+      double before[3][3], after[3][3], n0[3], n1[3];
+      for (int k = 0; k < 3; k++) {
+        corners[k] = S->remap[triangle[k]];
+        shared += corners[k] == a || corners[k] == b;
+        corner_position(S, corners[k], before[k]);
+        if (corners[k] == v) {
+          memcpy(after[k], p, sizeof(after[k]));
+        } else {
+          memcpy(after[k], before[k], sizeof(after[k]));
+        }
+      }
+      // треугольник с обеими вершинами ребра или уже схлопнутый исчезает
+      if (shared == 2 || corners[0] == corners[1] ||
+          corners[1] == corners[2] || corners[2] == corners[0]) {
+        continue;
+      }
+
+      triangle_normal(before[0], before[1], before[2], n0);
+      triangle_normal(after[0], after[1], after[2], n1);
+      flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+    }
+  }
+
+  return flips;
+}
+
+/**
+ * @brief Build adjacency
+ *
+ * Lists triangles of every vertex.
+ *
+ * @param S Simplifier
+ */
+static void build_adjacency(simplifier_t *S) {
+  size_t count = S->count_of_triangles;
+
+  memset(S->offsets, 0, (S->count_of_vertices + 1) * sizeof(size_t));
+  for (size_t i = 0; i < count * 3; i++) S->offsets[S->triangles[i] + 1]++;
+  for (size_t v = 0; v < S->count_of_vertices; v++) {
+    S->offsets[v + 1] += S->offsets[v];
+  }
+  // смещения сдвигаются при заполнении и возвращаются обратно
+  for (size_t i = 0; i < count * 3; i++) {
+    S->adjacency[S->offsets[S->triangles[i]]++] = (uint32_t)(i / 3);
+  }
+  for (size_t v = S->count_of_vertices; v > 0; v--) {
+    S->offsets[v] = S->offsets[v - 1];
+  }
+  S->offsets[0] = 0;
+}
+
+/**
+ * @brief Simplify pass
+ *
+ * Collapses the cheapest edges with no shared vertices, until the number of
+ * triangles may reach the target. Collapses that would turn a triangle over
+ * are skipped. Degenerate triangles are removed afterwards.
+ *
+ * @param S Simplifier
+ * @param target Wanted number of triangles
+ * @param error Largest error of collapses, updated
+ */
+static void simplify_pass(simplifier_t *S, size_t target, float *error) {
+  size_t count = S->count_of_triangles;
+  size_t edges = 0;
+
+  fill_keys(S);
+  for (size_t i = 0; i < count * 3; i++) {
+    if (edges == 0 || S->keys[i] != S->keys[edges - 1]) {
+      S->keys[edges++] = S->keys[i];
+    }
+  }
+
+  pool_parallel_for(edges, LOD_PARALLEL_MIN, cost_range, S);
+  // биты неотрицательных float упорядочены так же, как сами числа
+  for (size_t i = 0; i < edges; i++) {
+    uint32_t bits;
+    memcpy(&bits, &S->collapses[i].cost, sizeof(bits));
+    S->keys[i] = (uint64_t)bits << 32 | i;
+  }
+  radix_sort(S, S->keys, edges, 32);
+  build_adjacency(S);
+
+  // каждый коллапс внутри поверхности убирает два треугольника
+  size_t needed = (count - target + 1) / 2;
+  size_t collapsed = 0;
+  memset(S->locked, 0, S->count_of_vertices);
+  for (size_t v = 0; v < S->count_of_vertices; v++) S->remap[v] = (uint32_t)v;
+
+  for (size_t i = 0; i < edges && collapsed < needed; i++) {
+    const collapse_t *collapse = &S->collapses[(uint32_t)S->keys[i]];
+    uint32_t a = collapse->a, b = collapse->b;
+    if (S->locked[a] || S->locked[b] || isinf(collapse->cost)) continue;
+
+    double p[3];
+    double cost = collapse_position(S, a, b, p);
+    if (collapse_flips(S, a, b, p)) continue;
+
+    // вершина участвует не больше чем в одном коллапсе за проход
+    S->locked[a] = 1;
+    S->locked[b] = 1;
+    S->remap[b] = a;
+    for (int k = 0; k < 3; k++) S->positions[(size_t)a * 3 + k] = (float)p[k];
+    float *qa = S->quadrics + (size_t)a * QUADRIC_SIZE;
+    const float *qb = S->quadrics + (size_t)b * QUADRIC_SIZE;
+    for (int k = 0; k < QUADRIC_SIZE; k++) qa[k] += qb[k];
+    if ((float)sqrt(cost) > *error) *error = (float)sqrt(cost);
+    collapsed++;
+  }
+
+  size_t kept = 0;
+  for (size_t t = 0; t < count; t++) {
+    uint32_t *triangle = S->triangles + kept * 3;
+    for (int k = 0; k < 3; k++) {
+      triangle[k] = S->remap[S->triangles[t * 3 + k]];
+    }
+    S->sides[kept] = S->sides[t];
+    if (triangle[0] != triangle[1] && triangle[1] != triangle[2] &&
+        triangle[2] != triangle[0]) {
+      kept++;
+    }
+  }
+  S->count_of_triangles = kept;
+}
+
+/**
+ * @brief Emit level
+ *
+ * Removes vertices no triangle uses and copies the simplified object into a
+ * level. Only sides that are edges of facets become edges of the level.
+ *
+ * @param S Simplifier
+ * @param level Level to fill
+ * @param error Error of the level in units of the unit sphere
+ *
+ * @return 0 on success, 1 on error
+ */
+static int emit_level(simplifier_t *S, lod_t *level, float error) {
+  size_t count = S->count_of_triangles;
+  size_t vertices = 0;
+  int error_code = 0;
+
+  // номера сохраняют порядок, поэтому вершины сдвигаются только назад
+  memset(S->locked, 0, S->count_of_vertices);
+  for (size_t i = 0; i < count * 3; i++) S->locked[S->triangles[i]] = 1;
+  for (size_t v = 0; v < S->count_of_vertices; v++) {
+    if (S->locked[v]) {
+      S->remap[v] = (uint32_t)vertices;
+      memmove(S->positions + vertices * 3, S->positions + v * 3,
+              3 * sizeof(float));
+      memmove(S->quadrics + vertices * QUADRIC_SIZE,
+              S->quadrics + v * QUADRIC_SIZE, QUADRIC_SIZE * sizeof(float));
+      vertices++;
+    }
+  }
+  S->count_of_vertices = vertices;
+  for (size_t i = 0; i < count * 3; i++) {
+    S->triangles[i] = S->remap[S->triangles[i]];
+  }
+
+  size_t edges = 0;
+  for (size_t t = 0; t < count; t++) {
+    for (int k = 0; k < 3; k++) {
+      if (S->sides[t] & (1 << k)) {
+        S->keys[edges++] = side_key(S->triangles + t * 3, k);
+      }
+    }
+  }
+  radix_sort(S, S->keys, edges, 0);
+  size_t unique = 0;
+  for (size_t i = 0; i < edges; i++) {
+    if (unique == 0 || S->keys[i] != S->keys[unique - 1]) {
+      S->keys[unique++] = S->keys[i];
+    }
+  }
+
+  *level = (lod_t){0};
+  level->vertices.matrix = alloc_vertex_buffer(vertices * 3);
+  level->edges.indices = malloc((unique + 1) * 2 * sizeof(uint32_t));
+  if (level->vertices.matrix == NULL || level->edges.indices == NULL) {
+    free(level->vertices.matrix);
+    free(level->edges.indices);
+    *level = (lod_t){0};
+    error_code = 1;
+  }
+
+  if (error_code == 0) {
+    level->vertices.rows = vertices;
+    level->vertices.cols = 3;
+    for (size_t v = 0; v < vertices; v++) {
+      for (int k = 0; k < 3; k++) {
+        level->vertices.matrix[v * 3 + k] =
+            S->positions[v * 3 + k] * S->scale + S->center[k];
+      }
+    }
+    for (size_t i = 0; i < unique; i++) {
+      level->edges.indices[i * 2] = (uint32_t)(S->keys[i] >> 32);
+      level->edges.indices[i * 2 + 1] = (uint32_t)S->keys[i];
+    }
+    level->edges.count_of_edges = unique;
+    level->error = error * S->scale;
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Build levels of detail
+ *
+ * Simplifies the surface of the object by collapsing edges with the
+ * smallest quadric error and keeps a copy after every 4-fold reduction of
+ * triangles. Facets are split into triangles for simplification, but only
+ * edges of facets are drawn. Objects with less than LOD_MIN_TRIANGLES
+ * triangles get no levels. The result replaces data->obj_lod. Only
+ * data->obj_lod is written, so the levels can be built on a shallow copy of
+ * an object that is being drawn.
+ *
+ * @param data Object with vertices, facets and bounds
+ * @param progress Progress to check for cancellation between passes or NULL
+ *
+ * @return 0 on success, 1 on error, LOAD_CANCELLED if cancelled through
+ * progress
+ */
+int build_lod(data_t *data, progress_t *progress) {
+  simplifier_t S;
+  lod_chain_t *L = &data->obj_lod;
+
+  lod_free(L);
+  int error_code = init_simplifier(&S, data);
+
+  float error = 0.0f;
+  size_t previous = S.count_of_triangles;
+  while (error_code == 0 && L->count_of_levels < LOD_MAX_LEVELS &&
+         S.count_of_triangles >= LOD_MIN_TRIANGLES) {
+    size_t target = S.count_of_triangles / LOD_RATIO;
+    size_t removed = previous;
+    // проходы, почти не приближающие к цели, прекращаются
+    while (error_code == 0 && S.count_of_triangles > target &&
+           removed * 50 >= S.count_of_triangles - target) {
+      size_t before = S.count_of_triangles;
+      simplify_pass(&S, target, &error);
+      removed = before - S.count_of_triangles;
+      if (progress != NULL &&
+          __atomic_load_n(&progress->cancelled, __ATOMIC_RELAXED)) {
+        error_code = LOAD_CANCELLED;
+      }
+    }
+
+    // уровень, почти не отличающийся от предыдущего, не нужен
+    if (error_code != 0 || S.count_of_triangles * 10 > previous * 9) break;
+    error_code = emit_level(&S, &L->levels[L->count_of_levels], error);
+    if (error_code == 0) L->count_of_levels++;
+    previous = S.count_of_triangles;
+  }
+
+  free_simplifier(&S);
+  if (error_code != 0) lod_free(L);
+
+  return error_code;
+}
+
+/**
+ * @brief Select level of detail
+ *
+ * Chooses the coarsest level whose error is not visible: the error of the
+ * level projected to the screen is at most max_pixel_error pixels.
+ *
+ * @param L Levels of the object
+ * @param pixels_per_unit Pixels of the screen in one unit of the object
+ * @param max_pixel_error Largest error allowed on the screen, in pixels
+ *
+ * @return Number of the level from 1, 0 to draw the object itself
+ */
+size_t lod_select(const lod_chain_t *L, double pixels_per_unit,
+                  double max_pixel_error) {
+  size_t level = L->count_of_levels;
+
+  while (level != 0 &&
+         !(L->levels[level - 1].error * pixels_per_unit <= max_pixel_error)) {
+    level--;
+  }
+
+  return level;
+}
+
+/**
+ * @brief Fit level into budget
+ *
+ * Chooses the finest level, starting from the given one, whose vertices and
+ * edges together do not exceed the budget. If none fits, the coarsest level
+ * is chosen. Used to keep the frame time while the object is moved.
+ *
+ * @param L Levels of the object
+ * @param level Finest level allowed, 0 for the object itself
+ * @param object_primitives Number of vertices and edges of the object
+ * @param max_primitives Number of vertices and edges that fit into a frame
+ *
+ * @return Number of the level from 1, 0 to draw the object itself
+ */
+size_t lod_fit_budget(const lod_chain_t *L, size_t level,
+                      size_t object_primitives, double max_primitives) {
+  size_t primitives = object_primitives;
+  if (level != 0 && level <= L->count_of_levels) {
+    const lod_t *lod = &L->levels[level - 1];
+    primitives = lod->vertices.rows + lod->edges.count_of_edges;
+  }
+
+  while (level < L->count_of_levels && !(primitives <= max_primitives)) {
+    const lod_t *lod = &L->levels[level++];
+    primitives = lod->vertices.rows + lod->edges.count_of_edges;
+  }
+
+  return level;
+}
+
+/**
+ * @brief Free levels of detail
+ *
+ * Frees memory of all levels and makes the chain empty.
+ *
+ * @param L Levels
+ */
+void lod_free(lod_chain_t *L) {
+  for (size_t i = 0; i < L->count_of_levels; i++) {
+    free(L->levels[i].vertices.matrix);
+    free(L->levels[i].edges.indices);
+  }
+  *L = (lod_chain_t){0};
+}
@@ -0,0 +1,619 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+// сигнатура файла кэша
+#define CACHE_MAGIC "3DVCACHE"
+// версия формата, увеличивается при любом изменении разметки или разбора
+#define CACHE_VERSION 5u
+// отличает файлы, записанные на машине с другим порядком байт
+#define CACHE_BYTE_ORDER 0x01020304u
+// суффикс файла кэша рядом с исходным файлом
+#define CACHE_SUFFIX ".3dvcache"
+// шаблон имени временного файла при записи кэша
+#define CACHE_TEMP_SUFFIX ".XXXXXX"
+
+#if defined(__APPLE__)
+#define st_mtim st_mtimespec
+#endif
+
+/**
+ * @brief Cache header
+ *
+ * Header at the beginning of the cache file. It is followed by vertices as
+ * three floats each, aligned to VERTEX_ALIGNMENT bytes, facet offsets as
+ * count_of_facets + 1 size_t numbers and vertex numbers of all facets of
+ * index_size bytes each, both aligned to 8 bytes. The sections have the same
+ * layout as facets_t and are used in place.
+ *
+ * @param magic File signature
+ * @param version Format version
+ * @param byte_order Byte order marker
+ * @param index_size Size of a vertex number of a facet, 4 or 8
+ * @param offset_size Size of a facet offset, sizeof(size_t) of the writer
+ * @param source_size Size of the source .obj file
+ * @param source_mtime_sec Modification time of the source, seconds
+ * @param source_mtime_nsec Modification time of the source, nanoseconds
+ * @param source_hash Hash of the source contents
+ * @param count_of_vertices Number of vertices
+ * @param count_of_facets Number of facets
+ * @param count_of_indices Number of vertex indices of all facets
+ * @param bounds Box and sphere around all vertices
+ */
+typedef struct CacheHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t index_size;
+  uint32_t offset_size;
+  uint64_t source_size;
+  int64_t source_mtime_sec;
+  int64_t source_mtime_nsec;
+  uint64_t source_hash;
+  uint64_t count_of_vertices;
+  uint64_t count_of_facets;
+  uint64_t count_of_indices;
+  bounds_t bounds;
+} cache_header_t;
+
+/**
+ * @brief Source hash
+ *
+ * Hash of the source contents, computed at most once per load.
+ *
+ * @param value Hash of the contents
+ * @param known Hash has been computed
+ */
+typedef struct SourceHash_ {
+  uint64_t value;
+  int known;
+} source_hash_t;
+
+/**
+ * @brief Cache layout
+ *
+ * Offsets of cache sections in bytes.
+ *
+ * @param vertices Offset of vertices
+ * @param offsets Offset of facet offsets
+ * @param indices Offset of vertex indices
+ * @param size Size of the whole file
+ */
+typedef struct CacheLayout_ {
+  size_t vertices;
+  size_t offsets;
+  size_t indices;
+  size_t size;
+} cache_layout_t;
+
+/**
+ * @brief Cache path
+ *
+ * Builds the name of the cache file next to the source file.
+ *
+ * @param filename Name of the source file
+ *
+ * @return Allocated name to be freed or NULL
+ */
+static char* cache_path(const char* filename) {
+  size_t length = strlen(filename);
+  char* path = malloc(length + sizeof(CACHE_SUFFIX));
+  if (path != NULL) {
+    memcpy(path, filename, length);
+    memcpy(path + length, CACHE_SUFFIX, sizeof(CACHE_SUFFIX));
+  }
+  return path;
+}
+
+/**
+ * @brief Align
+ *
+ * Rounds offset up to a multiple of alignment.
+ *
+ * @param offset Offset in bytes
+ * @param alignment Power of two
+ */
+static size_t align_offset(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Cache layout
+ *
+ * Computes offsets of sections for given counts.
+ *
+ * @param header Header with counts
+ * @param layout Layout to fill
+ *
+ * @return 0 if the counts fit into memory, 1 otherwise
+ */
+static int compute_layout(const cache_header_t* header,
+                          cache_layout_t* layout) {
+  int error_code = 0;
+  const uint64_t limit = SIZE_MAX / 16;
+
+  if (header->count_of_vertices > limit || header->count_of_facets >= limit ||
+      header->count_of_indices > limit) {
+    error_code = 1;
+  } else {
+    layout->vertices = align_offset(sizeof(cache_header_t), VERTEX_ALIGNMENT);
+    layout->offsets = align_offset(
+        layout->vertices + header->count_of_vertices * 3 * sizeof(float), 8);
+    layout->indices = align_offset(
+        layout->offsets + (header->count_of_facets + 1) * sizeof(size_t), 8);
+    layout->size =
+        layout->indices + header->count_of_indices * header->index_size;
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Hash contents
+ *
+ * Hashes the file contents eight bytes per step.
+ *
+ * @param text Contents of the file
+ * @param size Size of the contents
+ */
+static uint64_t hash_contents(const char* text, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+  size_t i = 0;
+
+  for (; size - i >= 8; i += 8) {
+    uint64_t word = 0;
+    memcpy(&word, text + i, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ (unsigned char)text[i]) * 0x100000001b3ULL;
+  }
+  // перемешивание старших бит в младшие
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+/**
+ * @brief Hash source
+ *
+ * Hashes contents of the source file.
+ *
+ * @param filename Name of the source file
+ * @param size Expected size of the file
+ * @param hash Resulting hash
+ *
+ * @return 0 on success, 1 if the file can not be read or has another size
+ */
+static int hash_source(const char* filename, size_t size, uint64_t* hash) {
+  int error_code = 1;
+  int fd = open(filename, O_RDONLY);
+
+  if (fd != -1) {
+    struct stat info;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size == size) {
+      if (size == 0) {
+        *hash = hash_contents("", 0);
+        error_code = 0;
+      } else {
+        void* text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text != MAP_FAILED) {
+          posix_madvise(text, size, POSIX_MADV_SEQUENTIAL);
+          *hash = hash_contents(text, size);
+          munmap(text, size);
+          error_code = 0;
+        }
+      }
+    }
+    close(fd);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Same source
+ *
+ * Checks whether the source file has the size and modification time recorded
+ * earlier.
+ *
+ * @param a State of the source file
+ * @param size Recorded size
+ * @param mtime_sec Recorded modification time, seconds
+ * @param mtime_nsec Recorded modification time, nanoseconds
+ */
+static int same_source(const struct stat* a, uint64_t size, int64_t mtime_sec,
+                       int64_t mtime_nsec) {
+  return (uint64_t)a->st_size == size &&
+         (int64_t)a->st_mtim.tv_sec == mtime_sec &&
+         (int64_t)a->st_mtim.tv_nsec == mtime_nsec;
+}
+
+/**
+ * @brief Write cache
+ *
+ * Writes the object into a temporary file and renames it over the cache, so
+ * readers never see a partially written cache.
+ *
+ * @param filename Name of the source file
+ * @param data Object to be cached
+ * @param source State of the source file at the moment of parsing
+ * @param hash Hash of the source found when looking for the cache, hashed
+ * here if it is not known yet
+ *
+ * @return 0 on success, 1 on error
+ */
+static int write_cache(const char* filename, const data_t* data,
+                       const struct stat* source, source_hash_t* hash) {
+  cache_header_t header = {0};
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.version = CACHE_VERSION;
+  header.byte_order = CACHE_BYTE_ORDER;
+  header.source_size = (uint64_t)source->st_size;
+  header.source_mtime_sec = (int64_t)source->st_mtim.tv_sec;
+  header.source_mtime_nsec = (int64_t)source->st_mtim.tv_nsec;
+  header.count_of_vertices = data->count_of_vertices;
+  header.count_of_facets = data->count_of_facets;
+  header.count_of_indices = data->obj_facets.count_of_indices;
+  header.index_size =
+      data->obj_facets.wide_indices ? sizeof(uint64_t) : sizeof(uint32_t);
+  header.offset_size = sizeof(size_t);
+  header.bounds = data->bounds;
+
+  cache_layout_t layout = {0};
+  int error_code = compute_layout(&header, &layout);
+  if (error_code == 0 && !hash->known) {
+    error_code = hash_source(filename, (size_t)source->st_size, &hash->value);
+    hash->known = error_code == 0;
+  }
+  header.source_hash = hash->value;
+
+  // файл мог измениться во время разбора
+  struct stat current;
+  if (error_code == 0 &&
+      (stat(filename, &current) != 0 ||
+       !same_source(&current, header.source_size, header.source_mtime_sec,
+                    header.source_mtime_nsec))) {
+    error_code = 1;
+  }
+
+  char* path = error_code == 0 ? cache_path(filename) : NULL;
+  char* temp = NULL;
+  if (path != NULL) {
+    temp = malloc(strlen(path) + sizeof(CACHE_TEMP_SUFFIX));
+    if (temp != NULL) {
+      strcpy(temp, path);
+      strcat(temp, CACHE_TEMP_SUFFIX);
+    }
+  }
+
+  int fd = temp != NULL ? mkstemp(temp) : -1;
+  // mkstemp создаёт файл, доступный только владельцу
+  if (fd != -1) fchmod(fd, 0644);
+  FILE* file = fd != -1 ? fdopen(fd, "wb") : NULL;
+  if (file == NULL) {
+    if (fd != -1) close(fd);
+    error_code = 1;
+  }
+
+  if (error_code == 0) {
+    static const char padding[VERTEX_ALIGNMENT] = {0};
+    size_t written = fwrite(&header, sizeof(header), 1, file);
+    if (written != 0 && layout.vertices != sizeof(header)) {
+      written = fwrite(padding, layout.vertices - sizeof(header), 1, file);
+    }
+    if (written != 0 && data->count_of_vertices != 0) {
+      written = fwrite(data->obj_matrix.matrix, 3 * sizeof(float),
+                       data->count_of_vertices, file);
+    }
+    size_t position =
+        layout.vertices + data->count_of_vertices * 3 * sizeof(float);
+    if (written != 0 && layout.offsets != position) {
+      written = fwrite(padding, layout.offsets - position, 1, file);
+    }
+
+    // у объекта без полигонов может не быть массива смещений
+    static const size_t no_offsets[1] = {0};
+    const size_t* offsets = data->obj_facets.offsets != NULL
+                                ? data->obj_facets.offsets
+                                : no_offsets;
+    if (written != 0) {
+      written = fwrite(offsets, sizeof(size_t), data->count_of_facets + 1,
+                       file);
+    }
+    position = layout.offsets + (data->count_of_facets + 1) * sizeof(size_t);
+    if (written != 0 && layout.indices != position) {
+      written = fwrite(padding, layout.indices - position, 1, file);
+    }
+    if (written != 0 && header.count_of_indices != 0) {
+      written = fwrite(data->obj_facets.indices, header.index_size,
+                       header.count_of_indices, file);
+    }
+    if (written == 0) error_code = 1;
+  }
+
+  if (file != NULL && fclose(file) != 0) error_code = 1;
+  if (file != NULL && error_code == 0 && rename(temp, path) != 0) {
+    error_code = 1;
+  }
+  if (file != NULL && error_code != 0) unlink(temp);
+
+  free(temp);
+  free(path);
+
+  return error_code;
+}
+
+/**
+ * @brief Map cache
+ *
+ * Maps the cache file of the source into memory and checks that it belongs
+ * to the current contents of the source. If only the modification time of
+ * the source has changed, its contents are hashed and the cache is kept when
+ * the hash matches. The mapping is private, so the object can be transformed
+ * in place without changing the file.
+ *
+ * @param filename Name of the source file
+ * @param source Current state of the source file
+ * @param map Mapped cache file
+ * @param layout Layout of the mapped cache
+ * @param hash Hash of the source, filled if the source had to be hashed
+ *
+ * @return 0 if the cache is valid, 1 otherwise
+ */
+static int map_cache(const char* filename, const struct stat* source,
+                     char** map, cache_layout_t* layout,
+                     source_hash_t* hash) {
+  int error_code = 1;
+  char* path = cache_path(filename);
+  int fd = path != NULL ? open(path, O_RDWR) : -1;
+  if (fd == -1 && path != NULL) fd = open(path, O_RDONLY);
+
+  struct stat info;
+  void* mapped = MAP_FAILED;
+  if (fd != -1 && fstat(fd, &info) == 0 &&
+      (size_t)info.st_size >= sizeof(cache_header_t)) {
+    mapped = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE, fd, 0);
+  }
+
+  if (mapped != MAP_FAILED) {
+    cache_header_t header;
+    memcpy(&header, mapped, sizeof(header));
+
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == CACHE_VERSION &&
+        header.byte_order == CACHE_BYTE_ORDER &&
+        header.offset_size == sizeof(size_t) &&
+        (header.index_size == sizeof(uint32_t) ||
+         header.index_size == sizeof(uint64_t)) &&
+        compute_layout(&header, layout) == 0 &&
+        layout->size == (size_t)info.st_size &&
+        header.source_size == (uint64_t)source->st_size) {
+      if (same_source(source, header.source_size, header.source_mtime_sec,
+                      header.source_mtime_nsec)) {
+        error_code = 0;
+      } else {
+        // время изменено без изменения содержимого
+        hash->known =
+            hash_source(filename, (size_t)source->st_size, &hash->value) == 0;
+        if (hash->known && hash->value == header.source_hash) {
+          error_code = 0;
+          header.source_mtime_sec = (int64_t)source->st_mtim.tv_sec;
+          header.source_mtime_nsec = (int64_t)source->st_mtim.tv_nsec;
+          // без обновления времени кэш проверится по хэшу ещё раз
+          (void)pwrite(fd, &header, sizeof(header), 0);
+        }
+      }
+    }
+
+    if (error_code == 0) {
+      *map = mapped;
+    } else {
+      munmap(mapped, (size_t)info.st_size);
+    }
+  }
+
+  if (fd != -1) close(fd);
+  free(path);
+
+  return error_code;
+}
+
+/**
+ * @brief Check indices
+ *
+ * Checks that every vertex number of facets is 0 or a vertex of the object,
+ * as the parser stores them. A stale or damaged cache must not pass other
+ * numbers to the edges, the hierarchy and the video card.
+ *
+ * @param data Object built from the cache
+ *
+ * @return 0 if all numbers are valid, 1 otherwise
+ */
+static int check_indices(const data_t* data) {
+  const facets_t* facets = &data->obj_facets;
+  uint64_t limit = data->count_of_vertices;
+  int invalid = 0;
+
+  // без ветвлений в цикле, проверка идёт со скоростью чтения памяти
+  if (facets->wide_indices) {
+    const uint64_t* indices = facets->indices;
+    for (size_t i = 0; i < facets->count_of_indices; i++) {
+      invalid |= indices[i] > limit;
+    }
+  } else {
+    const uint32_t* indices = facets->indices;
+    for (size_t i = 0; i < facets->count_of_indices; i++) {
+      invalid |= indices[i] > limit;
+    }
+  }
+
+  return invalid ? 1 : 0;
+}
+
+/**
+ * @brief Build from cache
+ *
+ * Builds the object from the mapped cache, checking facet offsets and vertex
+ * numbers once. Vertices and facets are used in place.
+ *
+ * @param map Mapped cache file, owned by data from now on
+ * @param layout Layout of the mapped cache
+ * @param data Data structure to fill
+ *
+ * @return 0 on success, 1 on error
+ */
+static int build_from_cache(char* map, const cache_layout_t* layout,
+                            data_t* data) {
+  int error_code = 0;
+  cache_header_t header;
+  memcpy(&header, map, sizeof(header));
+  size_t* offsets = (size_t*)(map + layout->offsets);
+
+  data->count_of_vertices = header.count_of_vertices;
+  data->count_of_facets = header.count_of_facets;
+  data->obj_matrix.rows = header.count_of_vertices;
+  data->obj_matrix.cols = 3;
+  data->bounds = header.bounds;
+  data->obj_matrix.matrix = (float*)(map + layout->vertices);
+  data->mapping = map;
+  data->mapping_size = layout->size;
+  data->obj_facets.offsets = offsets;
+  data->obj_facets.indices = map + layout->indices;
+  data->obj_facets.count_of_indices = header.count_of_indices;
+  data->obj_facets.wide_indices = header.index_size == sizeof(uint64_t);
+
+  // смещения повреждённого кэша могут указывать за пределы файла
+  if (offsets[0] != 0 ||
+      offsets[header.count_of_facets] != header.count_of_indices) {
+    error_code = 1;
+  }
+  for (size_t i = 0; error_code == 0 && i < data->count_of_facets; i++) {
+    if (offsets[i + 1] < offsets[i]) error_code = 1;
+  }
+  if (error_code == 0) error_code = check_indices(data);
+
+  return error_code;
+}
+
+/**
+ * @brief Write mesh cache
+ *
+ * Writes the binary cache of the parsed object next to its source file.
+ *
+ * @param filename Name of the source file
+ * @param data Object parsed from the current contents of the source
+ *
+ * @return 0 on success, 1 on error
+ */
+int write_mesh_cache(const char* filename, const data_t* data) {
+  struct stat source;
+  source_hash_t hash = {0};
+  int error_code = stat(filename, &source) == 0 ? 0 : 1;
+  if (error_code == 0) error_code = write_cache(filename, data, &source, &hash);
+  return error_code;
+}
+
+/**
+ * @brief Read cache
+ *
+ * Reads the object from its binary cache if the cache matches the state of
+ * the source file. Data is written only on success.
+ *
+ * @param filename Name of the source file
+ * @param source Current state of the source file
+ * @param data Data structure with all parameters
+ * @param hash Hash of the source, filled if the source had to be hashed
+ *
+ * @return 0 on success, 1 if there is no valid cache
+ */
+static int read_cache(const char* filename, const struct stat* source,
+                      data_t* data, source_hash_t* hash) {
+  char* map = NULL;
+  cache_layout_t layout = {0};
+  data_t cached = {0};
+
+  int error_code = map_cache(filename, source, &map, &layout, hash);
+  if (error_code == 0) {
+    posix_madvise(map, layout.size, POSIX_MADV_WILLNEED);
+    error_code = build_from_cache(map, &layout, &cached);
+  }
+
+  if (error_code == 0) {
+    *data = cached;
+  } else {
+    free_memory(NULL, &cached);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Read mesh cache
+ *
+ * Reads the object from its binary cache if the cache matches the current
+ * contents of the source file. Vertices stay in the mapped cache and are
+ * released by free_memory. Data is written only on success.
+ *
+ * @param filename Name of the source file
+ * @param data Data structure with all parameters
+ *
+ * @return 0 on success, 1 if there is no valid cache
+ */
+int read_mesh_cache(const char* filename, data_t* data) {
+  struct stat source;
+  source_hash_t hash = {0};
+  int error_code = stat(filename, &source) == 0 ? 0 : 1;
+  if (error_code == 0) error_code = read_cache(filename, &source, data, &hash);
+  return error_code;
+}
+
+/**
+ * @brief Load object file
+ *
+ * Reads the object from its binary cache if it is valid, otherwise parses
+ * the source file and writes the cache for later loads. The source is hashed
+ * at most once: a hash found while checking a stale cache is written into
+ * the new one. Failure to write the cache, for example in a read-only
+ * directory, is not an error.
+ *
+ * @param filename Name of the object to be opened
+ * @param data Data structure with all parameters
+ * @param threads Number of parsing threads, 0 to use all processors
+ * @param progress Loading progress to update, may be NULL
+ *
+ * @return 0 on success, LOAD_CANCELLED if loading was cancelled through
+ * progress, 1 on any other error
+ */
+int load_obj_file(const char* filename, data_t* data, size_t threads,
+                  progress_t* progress) {
+  // состояние файла до разбора, чтобы не закэшировать изменённый файл
+  struct stat source;
+  int have_source = stat(filename, &source) == 0;
+  source_hash_t hash = {0};
+  int error_code =
+      have_source ? read_cache(filename, &source, data, &hash) : 1;
+
+  if (error_code == 0) {
+    if (progress != NULL) {
+      __atomic_store_n(&progress->total_bytes, 1, __ATOMIC_RELAXED);
+      __atomic_store_n(&progress->done_bytes, 1, __ATOMIC_RELAXED);
+    }
+  } else {
+    error_code = parse_obj_file_parallel(filename, data, threads, progress);
+    if (error_code == 0 && have_source) {
+      write_cache(filename, data, &source, &hash);
+    }
+  }
+
+  return error_code;
+}
@@ -0,0 +1,706 @@
+#include "backend.h"
+
+/**
+ * @brief Meshlet builder
+ *
+ * @param data Object with the built hierarchy
+ * @param meshlets Clusters whose bounds and cones are found
+ * @param volumes Signed volumes under facets of each cluster
+ * @param origin Point the volumes are measured from
+ */
+typedef struct Meshlet_builder_ {
+  const data_t *data;
+  meshlet_t *meshlets;
+  double *volumes;
+  double origin[3];
+} meshlet_builder_t;
+
+/**
+ * @brief Boundary builder
+ *
+ * @param data Object with ordered edges
+ * @param M Clusters with their edge ranges
+ * @param starts First edge of every vertex in by_vertex
+ * @param by_vertex Edges grouped by their smaller vertex
+ * @param owners Cluster owning every edge
+ * @param shared Marks of edges that are sides of facets of another cluster
+ */
+typedef struct Boundary_builder_ {
+  const data_t *data;
+  const meshlets_t *M;
+  uint32_t *starts;
+  uint32_t *by_vertex;
+  uint32_t *owners;
+  unsigned char *shared;
+} boundary_builder_t;
+
+/**
+ * @brief Count leaf
+ *
+ * Adds vertices not yet marked and triangles of facets of a leaf to the
+ * counts of a cluster, marking the vertices with the mark of the cluster.
+ *
+ * @param data Object with the built hierarchy
+ * @param leaf Leaf of the hierarchy
+ * @param marks Marks of vertices
+ * @param mark Mark of the cluster
+ * @param vertices Number of different vertices of the cluster
+ * @param triangles Number of triangles of the cluster
+ */
+static void count_leaf(const data_t *data, const bvh_node_t *leaf,
+                       uint32_t *marks, uint32_t mark, uint32_t *vertices,
+                       uint32_t *triangles) {
+  const facets_t *facets = &data->obj_facets;
+
+  for (uint32_t p = 0; p < leaf->count_of_facets; p++) {
+    size_t facet = data->obj_bvh.facets[leaf->first_facet + p];
+    size_t count = facet_size(facets, facet);
+    if (count >= 3) *triangles += (uint32_t)(count - 2);
+    for (size_t k = 0; k < count; k++) {
+      size_t vertex = facet_vertex(facets, facet, k);
+      if (vertex != 0 && vertex <= data->count_of_vertices &&
+          marks[vertex - 1] != mark) {
+        marks[vertex - 1] = mark;
+        (*vertices)++;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Push meshlet
+ *
+ * @param M Clusters
+ * @param capacity Number of clusters the array has room for
+ * @param meshlet Cluster to add
+ *
+ * @return 0 on success, 1 on error
+ */
+static int push_meshlet(meshlets_t *M, size_t *capacity,
+                        const meshlet_t *meshlet) {
+  int error_code = 0;
+
+  if (M->count_of_meshlets == *capacity) {
+    size_t size = *capacity != 0 ? *capacity * 2 : 64;
+    meshlet_t *meshlets = realloc(M->meshlets, size * sizeof(meshlet_t));
+    if (meshlets != NULL) {
+      M->meshlets = meshlets;
+      *capacity = size;
+    } else {
+      error_code = 1;
+    }
+  }
+  if (error_code == 0) M->meshlets[M->count_of_meshlets++] = *meshlet;
+
+  return error_code;
+}
+
+/**
+ * @brief Group leaves
+ *
+ * Splits the hierarchy into the largest subtrees with at most
+ * MESHLET_MAX_TRIANGLES triangles and joins consecutive leaves of each
+ * subtree into clusters until a cluster would get more than
+ * MESHLET_MAX_VERTICES vertices. Leaves of different subtrees may lie far
+ * apart, so they never share a cluster. A leaf is never split, so a leaf of
+ * large polygons may exceed the limits alone. Leaves go in the order of
+ * edges, so edges of a cluster form one range.
+ *
+ * @param data Object with the built hierarchy
+ * @param M Clusters to fill
+ *
+ * @return 0 on success, 1 on error
+ */
+static int group_leaves(const data_t *data, meshlets_t *M) {
+  const bvh_t *B = &data->obj_bvh;
+  uint32_t *marks = calloc(data->count_of_vertices + 1, sizeof(uint32_t));
+  size_t *triangles = malloc((B->count_of_facets + 1) * sizeof(size_t));
+  int error_code = marks != NULL && triangles != NULL ? 0 : 1;
+  meshlet_t current = {0};
+  size_t capacity = 0, group_end = 0;
+  uint32_t mark = 1;
+  int fresh = 1;
+
+  // количество треугольников полигонов до каждого места в иерархии
+  for (size_t p = 0; error_code == 0 && p <= B->count_of_facets; p++) {
+    size_t count = p != 0 ? facet_size(&data->obj_facets, B->facets[p - 1])
+                          : 0;
+    triangles[p] = (p != 0 ? triangles[p - 1] : 0) + (count >= 3 ? count - 2
+                                                                   : 0);
+  }
+
+  for (size_t i = 0; error_code == 0 && i < B->count_of_nodes; i++) {
+    const bvh_node_t *node = &B->nodes[i];
+    size_t end = (size_t)node->first_facet + node->count_of_facets;
+    if (node->first_facet >= group_end &&
+        (triangles[end] - triangles[node->first_facet] <=
+             MESHLET_MAX_TRIANGLES ||
+         node->right == 0)) {
+      // начало поддерева, которое делится на кластеры отдельно
+      group_end = end;
+      fresh = 1;
+    }
+    if (node->right != 0) continue;
+
+    uint32_t vertices = current.count_of_vertices;
+    uint32_t count = current.count_of_triangles;
+    if (!fresh) count_leaf(data, node, marks, mark, &vertices, &count);
+    if (fresh || vertices > MESHLET_MAX_VERTICES ||
+        count > MESHLET_MAX_TRIANGLES) {
+      if (current.count_of_facets != 0) {
+        error_code = push_meshlet(M, &capacity, &current);
+      }
+      // вершины листа считаются заново для нового кластера
+      current = (meshlet_t){.first_facet = node->first_facet,
+                            .first_edge = node->first_edge};
+      vertices = count = 0;
+      count_leaf(data, node, marks, ++mark, &vertices, &count);
+      fresh = 0;
+    }
+    current.count_of_facets += node->count_of_facets;
+    current.count_of_edges =
+        node->first_edge + node->count_of_edges - current.first_edge;
+    current.count_of_vertices = vertices;
+    current.count_of_triangles = count;
+  }
+  if (error_code == 0 && current.count_of_facets != 0) {
+    error_code = push_meshlet(M, &capacity, &current);
+  }
+
+  free(marks);
+  free(triangles);
+  return error_code;
+}
+
+/**
+ * @brief Triangle normal
+ *
+ * @param data Object
+ * @param facet Facet of the fan
+ * @param k Second vertex of the triangle in the facet
+ * @param normal Unit normal, by the order of vertices
+ * @param corners Vertices of the triangle
+ *
+ * @return 1 if the triangle has valid vertices and a normal, 0 otherwise
+ */
+static int triangle_normal(const data_t *data, size_t facet, size_t k,
+                           double normal[3], const float *corners[3]) {
+  size_t v[3] = {facet_vertex(&data->obj_facets, facet, 0),
+                 facet_vertex(&data->obj_facets, facet, k),
+                 facet_vertex(&data->obj_facets, facet, k + 1)};
+  int valid = 1;
+
+  for (int i = 0; i < 3 && valid; i++) {
+    if (v[i] == 0 || v[i] > data->count_of_vertices) {
+      valid = 0;
+    } else {
+      corners[i] = matrix_vertex(&data->obj_matrix, v[i] - 1);
+    }
+  }
+  if (valid) {
+    double u[3], w[3];
+    for (int i = 0; i < 3; i++) {
+      u[i] = (double)corners[1][i] - corners[0][i];
+      w[i] = (double)corners[2][i] - corners[0][i];
+    }
+    normal[0] = u[1] * w[2] - u[2] * w[1];
+    normal[1] = u[2] * w[0] - u[0] * w[2];
+    normal[2] = u[0] * w[1] - u[1] * w[0];
+    double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                         normal[2] * normal[2]);
+    // вырожденные треугольники не влияют на конус
+    if (length > 0.0) {
+      for (int i = 0; i < 3; i++) normal[i] /= length;
+    } else {
+      valid = 0;
+    }
+  }
+  return valid;
+}
+
+/**
+ * @brief Meshlet bounds
+ *
+ * Finds bounding spheres, normal cones and signed volumes of clusters from
+ * begin to end, body of pool_parallel_for. The axis of the cone is the mean
+ * of unit normals of the triangles and the cone is as wide as the normal
+ * farthest from it. Clusters whose normals span a half-space or more get a
+ * cutoff greater than 1 and are never culled by the cone.
+ *
+ * @param arg Builder
+ * @param begin First cluster
+ * @param end Cluster after the last one
+ */
+static void meshlet_bounds(void *arg, size_t begin, size_t end) {
+  const meshlet_builder_t *B = arg;
+  const data_t *data = B->data;
+
+  for (size_t m = begin; m < end; m++) {
+    meshlet_t *meshlet = &B->meshlets[m];
+    const uint32_t *facets = data->obj_bvh.facets + meshlet->first_facet;
+    float min[3] = {INFINITY, INFINITY, INFINITY};
+    float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    double axis[3] = {0.0, 0.0, 0.0}, volume = 0.0, radius = 0.0;
+
+    for (uint32_t p = 0; p < meshlet->count_of_facets; p++) {
+      size_t count = facet_size(&data->obj_facets, facets[p]);
+      for (size_t k = 0; k < count; k++) {
+        size_t vertex = facet_vertex(&data->obj_facets, facets[p], k);
+        if (vertex != 0 && vertex <= data->count_of_vertices) {
+          const float *point = matrix_vertex(&data->obj_matrix, vertex - 1);
+          for (int i = 0; i < 3; i++) {
+            min[i] = fminf(min[i], point[i]);
+            max[i] = fmaxf(max[i], point[i]);
+          }
+        }
+      }
+      for (size_t k = 1; k + 1 < count; k++) {
+        double normal[3];
+        const float *c[3];
+        if (triangle_normal(data, facets[p], k, normal, c)) {
+          double a[3], b[3], d[3];
+          for (int i = 0; i < 3; i++) {
+            axis[i] += normal[i];
+            a[i] = c[0][i] - B->origin[i];
+            b[i] = c[1][i] - B->origin[i];
+            d[i] = c[2][i] - B->origin[i];
+          }
+          volume += a[0] * (b[1] * d[2] - b[2] * d[1]) +
+                    a[1] * (b[2] * d[0] - b[0] * d[2]) +
+                    a[2] * (b[0] * d[1] - b[1] * d[0]);
+        }
+      }
+    }
+
+    for (int i = 0; i < 3; i++) {
+      meshlet->center[i] = min[i] <= max[i] ? (min[i] + max[i]) * 0.5f : 0.0f;
+    }
+    double length =
+        sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double spread = length > 0.0 ? 1.0 : -1.0;
+    for (int i = 0; i < 3; i++) {
+      axis[i] = length > 0.0 ? axis[i] / length : 0.0;
+      meshlet->cone_axis[i] = (float)axis[i];
+    }
+
+    for (uint32_t p = 0; p < meshlet->count_of_facets; p++) {
+      size_t count = facet_size(&data->obj_facets, facets[p]);
+      for (size_t k = 0; k < count; k++) {
+        size_t vertex = facet_vertex(&data->obj_facets, facets[p], k);
+        if (vertex != 0 && vertex <= data->count_of_vertices) {
+          const float *point = matrix_vertex(&data->obj_matrix, vertex - 1);
+          double distance = 0.0;
+          for (int i = 0; i < 3; i++) {
+            double delta = (double)point[i] - meshlet->center[i];
+            distance += delta * delta;
+          }
+          if (distance > radius) radius = distance;
+        }
+      }
+      for (size_t k = 1; k + 1 < count && spread > 0.0; k++) {
+        double normal[3];
+        const float *c[3];
+        if (triangle_normal(data, facets[p], k, normal, c)) {
+          double dot =
+              normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2];
+          if (dot < spread) spread = dot;
+        }
+      }
+    }
+
+    // запас на округление, чтобы вершины не оказались вне сферы
+    meshlet->radius = (float)(sqrt(radius) * (1.0 + 1e-5));
+    meshlet->cone_cutoff =
+        spread > 0.0 ? (float)sqrt(1.0 - spread * spread) : 2.0f;
+    B->volumes[m] = volume;
+  }
+}
+
+/**
+ * @brief Mark boundary
+ *
+ * Marks sides of facets of clusters from begin to end that are owned by
+ * another cluster, body of pool_parallel_for. Sides are skipped the same
+ * way as by build_edges.
+ *
+ * @param arg Boundary builder
+ * @param begin First cluster
+ * @param end Cluster after the last one
+ */
+static void mark_boundary(void *arg, size_t begin, size_t end) {
+  const boundary_builder_t *B = arg;
+  const data_t *data = B->data;
+  const facets_t *facets = &data->obj_facets;
+  const uint32_t *edges = data->obj_edges.indices;
+
+  for (size_t m = begin; m < end; m++) {
+    const meshlet_t *meshlet = &B->M->meshlets[m];
+    for (uint32_t p = 0; p < meshlet->count_of_facets; p++) {
+      size_t facet = data->obj_bvh.facets[meshlet->first_facet + p];
+      size_t count = facet_size(facets, facet);
+      size_t previous = count != 0 ? facet_vertex(facets, facet, count - 1)
+                                   : 0;
+
+      for (size_t k = 0; k < count; k++) {
+        size_t current = facet_vertex(facets, facet, k);
+        size_t a = previous < current ? previous : current;
+        size_t b = previous < current ? current : previous;
+        previous = current;
+        if (a == 0 || a == b || b > data->count_of_vertices) continue;
+
+        // рёбра вершины перебираются до ребра с той же второй вершиной
+        for (uint32_t i = B->starts[a - 1]; i < B->starts[a]; i++) {
+          uint32_t e = B->by_vertex[i];
+          uint32_t from = edges[(size_t)e * 2], to = edges[(size_t)e * 2 + 1];
+          if ((from > to ? from : to) == b - 1) {
+            if (B->owners[e] != m) {
+              __atomic_store_n(&B->shared[e], 1, __ATOMIC_RELAXED);
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Find boundary
+ *
+ * Copies edges that are sides of facets of two different clusters into
+ * boundary_edges, grouped by the cluster that owns them. When the owner
+ * faces away from the camera, such an edge can still be on the outline of
+ * the neighbour, so meshlets_cull returns it separately.
+ *
+ * @param data Object with ordered edges
+ * @param M Clusters with their edge ranges
+ * @param threads Number of threads, 1 to find without the pool
+ *
+ * @return 0 on success, 1 on error
+ */
+static int find_boundary(const data_t *data, meshlets_t *M, size_t threads) {
+  size_t count_of_edges = data->obj_edges.count_of_edges;
+  const uint32_t *edges = data->obj_edges.indices;
+  boundary_builder_t B = {.data = data, .M = M};
+  B.starts = calloc(data->count_of_vertices + 1, sizeof(uint32_t));
+  B.by_vertex = malloc((count_of_edges + 1) * sizeof(uint32_t));
+  B.owners = malloc((count_of_edges + 1) * sizeof(uint32_t));
+  B.shared = calloc(count_of_edges + 1, 1);
+  int error_code = B.starts != NULL && B.by_vertex != NULL &&
+                           B.owners != NULL && B.shared != NULL
+                       ? 0
+                       : 1;
+
+  if (error_code == 0) {
+    // сортировка рёбер подсчётом по меньшей вершине
+    for (size_t e = 0; e < count_of_edges; e++) {
+      uint32_t from = edges[e * 2], to = edges[e * 2 + 1];
+      B.starts[(from < to ? from : to) + 1]++;
+    }
+    for (size_t v = 1; v <= data->count_of_vertices; v++) {
+      B.starts[v] += B.starts[v - 1];
+    }
+    for (size_t e = 0; e < count_of_edges; e++) {
+      uint32_t from = edges[e * 2], to = edges[e * 2 + 1];
+      B.by_vertex[B.starts[from < to ? from : to]++] = (uint32_t)e;
+    }
+    // после раскладки начало каждой вершины сдвинуто на следующую
+    memmove(B.starts + 1, B.starts,
+            data->count_of_vertices * sizeof(uint32_t));
+    B.starts[0] = 0;
+
+    for (size_t m = 0; m < M->count_of_meshlets; m++) {
+      const meshlet_t *meshlet = &M->meshlets[m];
+      for (uint32_t e = 0; e < meshlet->count_of_edges; e++) {
+        B.owners[meshlet->first_edge + e] = (uint32_t)m;
+      }
+    }
+    pool_parallel_for(M->count_of_meshlets, threads != 1 ? 64 : SIZE_MAX,
+                      mark_boundary, &B);
+
+    size_t count = 0;
+    for (size_t e = 0; e < count_of_edges; e++) count += B.shared[e];
+    M->boundary_edges = malloc((count + 1) * 2 * sizeof(uint32_t));
+    if (M->boundary_edges == NULL) error_code = 1;
+  }
+
+  for (size_t m = 0; error_code == 0 && m < M->count_of_meshlets; m++) {
+    meshlet_t *meshlet = &M->meshlets[m];
+    meshlet->first_boundary_edge = (uint32_t)M->count_of_boundary_edges;
+    for (uint32_t i = 0; i < meshlet->count_of_edges; i++) {
+      size_t e = meshlet->first_edge + i;
+      if (B.shared[e]) {
+        M->boundary_edges[M->count_of_boundary_edges * 2] = edges[e * 2];
+        M->boundary_edges[M->count_of_boundary_edges * 2 + 1] =
+            edges[e * 2 + 1];
+        M->count_of_boundary_edges++;
+      }
+    }
+    meshlet->count_of_boundary_edges =
+        (uint32_t)M->count_of_boundary_edges - meshlet->first_boundary_edge;
+  }
+
+  free(B.starts);
+  free(B.by_vertex);
+  free(B.owners);
+  free(B.shared);
+  return error_code;
+}
+
+/**
+ * @brief Build meshlets
+ *
+ * Splits facets into clusters of neighbouring facets following leaves of the
+ * hierarchy and finds their bounding spheres and normal cones. The surface
+ * counts as closed when there are twice as many sides of facets as edges.
+ * Cones of a closed surface wound inwards are turned over by the sign of the
+ * volume it encloses, and edges shared by two clusters of it are collected
+ * by find_boundary.
+ *
+ * @param data Object with the hierarchy built by build_bvh
+ * @param threads Number of threads, 1 to build without the pool
+ *
+ * @return 0 on success, 1 on error or if edges are not ordered
+ */
+int build_meshlets(data_t *data, size_t threads) {
+  const bvh_t *bvh = &data->obj_bvh;
+  int error_code = bvh->ordered_edges ? 0 : 1;
+  meshlets_t M = {0};
+  meshlet_builder_t B = {.data = data};
+
+  if (error_code == 0) error_code = group_leaves(data, &M);
+  if (error_code == 0) {
+    B.meshlets = M.meshlets;
+    B.volumes = malloc((M.count_of_meshlets + 1) * sizeof(double));
+    if (B.volumes == NULL) error_code = 1;
+  }
+
+  if (error_code == 0 && M.count_of_meshlets != 0) {
+    for (int i = 0; i < 3; i++) {
+      B.origin[i] = ((double)bvh->nodes[0].min[i] + bvh->nodes[0].max[i]) / 2;
+    }
+    pool_parallel_for(M.count_of_meshlets, threads != 1 ? 64 : SIZE_MAX,
+                      meshlet_bounds, &B);
+
+    double volume = 0.0;
+    for (size_t m = 0; m < M.count_of_meshlets; m++) volume += B.volumes[m];
+    M.closed = data->obj_facets.count_of_indices ==
+               2 * data->obj_edges.count_of_edges;
+    // полигоны обходятся по часовой стрелке, если смотреть снаружи
+    if (M.closed && volume < 0.0) {
+      for (size_t m = 0; m < M.count_of_meshlets; m++) {
+        for (int i = 0; i < 3; i++) {
+          M.meshlets[m].cone_axis[i] = -M.meshlets[m].cone_axis[i];
+        }
+      }
+    }
+    if (M.closed) error_code = find_boundary(data, &M, threads);
+  }
+
+  free(B.volumes);
+  if (error_code == 0) {
+    meshlets_free(&data->obj_meshlets);
+    data->obj_meshlets = M;
+  } else {
+    meshlets_free(&M);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Camera of matrix
+ *
+ * Finds the point of the object space projected to the center of the view
+ * from every depth, the only point sent to zero by the rows x, y and w of
+ * the matrix. For an orthographic projection the point is at infinity and
+ * the direction of view is found instead.
+ *
+ * @param mvp Model-view-projection matrix by columns
+ * @param eye Position of the camera or direction of view
+ *
+ * @return 1 for the position of a perspective camera, 0 for a direction
+ */
+static int matrix_camera(const float mvp[16], double eye[3]) {
+  double rows[3][4];
+  for (int c = 0; c < 4; c++) {
+    rows[0][c] = mvp[c * 4];
+    rows[1][c] = mvp[c * 4 + 1];
+    rows[2][c] = mvp[c * 4 + 3];
+  }
+
+  // векторное произведение трёх строк в четырёхмерном пространстве
+  double point[4];
+  for (int c = 0; c < 4; c++) {
+    int k[3], n = 0;
+    for (int j = 0; j < 4; j++) {
+      if (j != c) k[n++] = j;
+    }
+    double minor =
+        rows[0][k[0]] * (rows[1][k[1]] * rows[2][k[2]] -
+                         rows[1][k[2]] * rows[2][k[1]]) -
+        rows[0][k[1]] * (rows[1][k[0]] * rows[2][k[2]] -
+                         rows[1][k[2]] * rows[2][k[0]]) +
+        rows[0][k[2]] * (rows[1][k[0]] * rows[2][k[1]] -
+                         rows[1][k[1]] * rows[2][k[0]]);
+    point[c] = c % 2 == 0 ? minor : -minor;
+  }
+
+  double length = sqrt(point[0] * point[0] + point[1] * point[1] +
+                       point[2] * point[2]);
+  int perspective = fabs(point[3]) > length * 1e-6;
+  if (perspective) {
+    for (int i = 0; i < 3; i++) eye[i] = point[i] / point[3];
+  } else {
+    // направление, вдоль которого растёт глубина
+    double depth = 0.0;
+    for (int c = 0; c < 3; c++) depth += mvp[c * 4 + 2] * point[c];
+    double scale = length > 0.0 ? (depth < 0.0 ? -1.0 : 1.0) / length : 0.0;
+    for (int i = 0; i < 3; i++) eye[i] = point[i] * scale;
+  }
+  return perspective;
+}
+
+/**
+ * @brief Surface cut
+ *
+ * Checks whether vertices of clusters reaching the plane lie behind it, so
+ * that the plane cuts the surface.
+ *
+ * @param data Object with built clusters
+ * @param plane Plane with the normal of unit length into the view
+ *
+ * @return 1 if a vertex is behind the plane, 0 otherwise
+ */
+static int surface_cut(const data_t *data, const float plane[4]) {
+  const meshlets_t *M = &data->obj_meshlets;
+  int cut = 0;
+
+  for (size_t m = 0; !cut && m < M->count_of_meshlets; m++) {
+    const meshlet_t *meshlet = &M->meshlets[m];
+    const float *center = meshlet->center;
+    float distance = plane[3] + plane[0] * center[0] + plane[1] * center[1] +
+                     plane[2] * center[2];
+    // вершины проверяются только у кластеров, задевающих плоскость
+    for (uint32_t p = 0;
+         !cut && distance < meshlet->radius && p < meshlet->count_of_facets;
+         p++) {
+      size_t facet = data->obj_bvh.facets[meshlet->first_facet + p];
+      size_t count = facet_size(&data->obj_facets, facet);
+      for (size_t k = 0; !cut && k < count; k++) {
+        size_t vertex = facet_vertex(&data->obj_facets, facet, k);
+        if (vertex != 0 && vertex <= data->count_of_vertices) {
+          const float *point = matrix_vertex(&data->obj_matrix, vertex - 1);
+          cut = plane[3] + plane[0] * point[0] + plane[1] * point[1] +
+                    plane[2] * point[2] <
+                0.0f;
+        }
+      }
+    }
+  }
+
+  return cut;
+}
+
+/**
+ * @brief Cull meshlets
+ *
+ * Collects ranges of edges of clusters whose spheres are at least partly
+ * inside the view volume of the matrix. Clusters of a closed surface whose
+ * normal cones all point away from the camera are skipped as well. Their
+ * edges are on the back of the surface, so the ranges match the picture
+ * only when the surface itself is drawn with the depth test and hides
+ * them; edges drawn without it must be culled by bvh_cull. Edges a skipped
+ * cluster shares with its neighbours may lie on the outline, so their
+ * ranges in boundary_edges are collected separately. When the near plane
+ * cuts the surface, as it does with the camera inside, the back of the
+ * surface is seen through the cut and no cluster is skipped by its cone.
+ *
+ * @param data Object with clusters built by build_meshlets
+ * @param mvp Model-view-projection matrix by columns
+ * @param R Ranges of edges to fill, previous ranges are dropped
+ * @param boundary Ranges of boundary_edges to fill, previous ranges are
+ * dropped
+ *
+ * @return 0 on success, 1 on error
+ */
+int meshlets_cull(const data_t *data, const float mvp[16], bvh_ranges_t *R,
+                  bvh_ranges_t *boundary) {
+  const meshlets_t *M = &data->obj_meshlets;
+  int error_code = 0;
+  R->count_of_ranges = 0;
+  boundary->count_of_ranges = 0;
+
+  // плоскости пирамиды с нормалями единичной длины
+  float planes[6][4];
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < 4; i++) {
+      planes[axis * 2][i] = mvp[i * 4 + 3] + mvp[i * 4 + axis];
+      planes[axis * 2 + 1][i] = mvp[i * 4 + 3] - mvp[i * 4 + axis];
+    }
+  }
+  for (int p = 0; p < 6; p++) {
+    float length = sqrtf(planes[p][0] * planes[p][0] +
+                         planes[p][1] * planes[p][1] +
+                         planes[p][2] * planes[p][2]);
+    for (int i = 0; i < 4; i++) {
+      planes[p][i] = length > 0.0f ? planes[p][i] / length : 0.0f;
+    }
+  }
+  double eye[3];
+  int perspective = matrix_camera(mvp, eye);
+
+  // поверхность, разрезанная ближней плоскостью, видна и изнутри
+  int closed = M->closed && !surface_cut(data, planes[4]);
+
+  for (size_t m = 0; error_code == 0 && m < M->count_of_meshlets; m++) {
+    const meshlet_t *meshlet = &M->meshlets[m];
+    const float *center = meshlet->center;
+    int visible = 1;
+
+    for (int p = 0; p < 6 && visible; p++) {
+      float distance = planes[p][3] + planes[p][0] * center[0] +
+                       planes[p][1] * center[1] + planes[p][2] * center[2];
+      if (distance < -meshlet->radius) visible = 0;
+    }
+
+    int facing = 1;
+    if (visible && closed && meshlet->cone_cutoff <= 1.0f) {
+      const float *axis = meshlet->cone_axis;
+      double dot = 0.0, length = 0.0;
+      for (int i = 0; i < 3; i++) {
+        double view = perspective ? center[i] - eye[i] : eye[i];
+        dot += view * axis[i];
+        length += view * view;
+      }
+      // для перспективы конус смещается на радиус сферы к камере
+      if (perspective) {
+        facing = dot < meshlet->cone_cutoff * sqrt(length) + meshlet->radius;
+      } else {
+        facing = dot < meshlet->cone_cutoff;
+      }
+    }
+
+    if (visible && facing) {
+      error_code =
+          bvh_ranges_add(R, meshlet->first_edge, meshlet->count_of_edges);
+    } else if (visible) {
+      // общие с соседями рёбра могут быть на контуре
+      error_code = bvh_ranges_add(boundary, meshlet->first_boundary_edge,
+                                  meshlet->count_of_boundary_edges);
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Free meshlets
+ *
+ * @param M Clusters to free, become empty
+ */
+void meshlets_free(meshlets_t *M) {
+  free(M->meshlets);
+  free(M->boundary_edges);
+  *M = (meshlets_t){0};
+}
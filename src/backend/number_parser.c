@@ -0,0 +1,471 @@
+#include "backend.h"
+
+#include <float.h>
+#include <locale.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// максимальное количество значащих цифр, помещающееся в uint64_t
+#define MAX_MANTISSA_DIGITS 19
+// длина буфера для медленного разбора через strtod
+#define SLOW_PATH_BUFFER 128
+// наибольшая длина десятичного разделителя локали
+#define DECIMAL_POINT_SIZE 8
+
+/**
+ * @brief Decimal number
+ *
+ * Decimal number split into mantissa and power of ten.
+ *
+ * @param mantissa Significant digits of the number
+ * @param digits Number of significant digits in mantissa
+ * @param exponent Power of ten to multiply mantissa by
+ * @param truncated Non-zero digits did not fit into mantissa
+ */
+typedef struct Decimal_ {
+  uint64_t mantissa;
+  int digits;
+  int exponent;
+  int truncated;
+} decimal_t;
+
+// десятичный разделитель локали, читается до запуска потоков разбора
+static char decimal_point[DECIMAL_POINT_SIZE] = ".";
+
+static const double powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * @brief Is digit
+ *
+ * Checks whether character is a decimal digit regardless of the locale.
+ *
+ * @param c Character to check
+ */
+static int is_digit(char c) { return (unsigned char)(c - '0') <= 9; }
+
+/**
+ * @brief Is hexadecimal digit
+ *
+ * Checks whether character is a hexadecimal digit regardless of the locale.
+ *
+ * @param c Character to check
+ */
+static int is_hex_digit(char c) {
+  return is_digit(c) || (unsigned char)((c | 0x20) - 'a') <= 5;
+}
+
+/**
+ * @brief Prepare number parser
+ *
+ * Reads the decimal point of the current locale for the slow path.
+ * localeconv is not thread-safe, so it is called here before parser threads
+ * start and never from the threads. The point is written only when the
+ * locale has changed.
+ */
+void prepare_number_parser(void) {
+  const struct lconv* conv = localeconv();
+  const char* point = conv->decimal_point;
+  if (point != NULL && strlen(point) < DECIMAL_POINT_SIZE &&
+      strcmp(point, decimal_point) != 0) {
+    strcpy(decimal_point, point);
+  }
+}
+
+/**
+ * @brief Skip blanks
+ *
+ * Skips spaces, tabs and carriage returns.
+ *
+ * @param str First character to check
+ * @param end Character after the last one of the string
+ *
+ * @return First character that is not a blank
+ */
+const char* skip_blanks(const char* str, const char* end) {
+  while (str < end && (*str == ' ' || *str == '\t' || *str == '\r')) str++;
+  return str;
+}
+
+/**
+ * @brief Digit run length
+ *
+ * Counts consecutive digits, checking 16 characters at once when SSE2 is
+ * available.
+ *
+ * @param str First character of the run
+ * @param end Character after the last one of the string
+ */
+static size_t digit_run(const char* str, const char* end) {
+  const char* p = str;
+
+#if defined(__SSE2__)
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8('9');
+  while (end - p >= 16) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)p);
+    __m128i not_digits = _mm_or_si128(_mm_cmplt_epi8(chars, zero),
+                                      _mm_cmpgt_epi8(chars, nine));
+    unsigned mask = (unsigned)_mm_movemask_epi8(not_digits);
+    if (mask != 0) return (size_t)(p - str) + (size_t)__builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+
+  while (p < end && is_digit(*p)) p++;
+
+  return (size_t)(p - str);
+}
+
+/**
+ * @brief Parse eight digits
+ *
+ * Converts eight digits into a number with a few multiplications on one
+ * 64-bit word instead of eight loop iterations.
+ *
+ * @param str First of eight digits
+ */
+static uint64_t parse_eight_digits(const char* str) {
+  uint64_t value = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(&value, str, sizeof(value));
+  value = ((value & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+  value = ((value & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+  value = ((value & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+#else
+  for (int i = 0; i < 8; i++) value = value * 10 + (uint64_t)(str[i] - '0');
+#endif
+
+  return value;
+}
+
+/**
+ * @brief Scan digits
+ *
+ * Adds a run of digits to the decimal number.
+ *
+ * @param str First character of the run
+ * @param end Character after the last one of the string
+ * @param number Decimal number to update
+ * @param fraction Digits are after the decimal point
+ *
+ * @return Character after the run
+ */
+static const char* scan_digits(const char* str, const char* end,
+                               decimal_t* number, int fraction) {
+  const char* stop = str + digit_run(str, end);
+
+  // ведущие нули не являются значащими
+  if (number->digits == 0) {
+    while (str < stop && *str == '0') {
+      str++;
+      if (fraction) number->exponent--;
+    }
+  }
+
+  size_t room = (size_t)(MAX_MANTISSA_DIGITS - number->digits);
+  size_t take = (size_t)(stop - str) < room ? (size_t)(stop - str) : room;
+  const char* take_end = str + take;
+  for (; take_end - str >= 8; str += 8) {
+    number->mantissa = number->mantissa * 100000000 + parse_eight_digits(str);
+  }
+  for (; str < take_end; str++) {
+    number->mantissa = number->mantissa * 10 + (uint64_t)(*str - '0');
+  }
+  number->digits += (int)take;
+  if (fraction) number->exponent -= (int)take;
+
+  // цифры, не поместившиеся в мантиссу
+  for (; str < stop; str++) {
+    if (!fraction) number->exponent++;
+    if (*str != '0') number->truncated = 1;
+  }
+
+  return stop;
+}
+
+/**
+ * @brief Scan exponent
+ *
+ * Parses the exponent part of a number if it is present.
+ *
+ * @param str Character after the mantissa
+ * @param end Character after the last one of the string
+ * @param number Decimal number to update
+ *
+ * @return Character after the exponent
+ */
+static const char* scan_exponent(const char* str, const char* end,
+                                 decimal_t* number) {
+  const char* p = str;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    if (p < end && is_digit(*p)) {
+      int exponent = 0;
+      for (; p < end && is_digit(*p); p++) {
+        // большие порядки дают ноль или бесконечность в любом случае
+        if (exponent < 100000) exponent = exponent * 10 + (*p - '0');
+      }
+      number->exponent += negative ? -exponent : exponent;
+      str = p;
+    }
+  }
+
+  return str;
+}
+
+/**
+ * @brief Slow path
+ *
+ * Converts a number with strtod when the fast path is not exact, replacing
+ * the decimal point with the one read by prepare_number_parser.
+ *
+ * @param str First character of the number
+ * @param end Character after the number
+ * @param single Round the result to float
+ */
+static double parse_slow(const char* str, const char* end, int single) {
+  char local[SLOW_PATH_BUFFER];
+  const char* point = decimal_point;
+  size_t point_length = strlen(point);
+  size_t length = (size_t)(end - str);
+  size_t size = length * point_length + 1;
+  char* buffer = size <= sizeof(local) ? local : malloc(size);
+  double value = 0.0;
+
+  if (buffer != NULL) {
+    char* out = buffer;
+    for (const char* p = str; p < end; p++) {
+      if (*p == '.') {
+        memcpy(out, point, point_length);
+        out += point_length;
+      } else {
+        *out++ = *p;
+      }
+    }
+    *out = '\0';
+
+    value = single ? strtof(buffer, NULL) : strtod(buffer, NULL);
+    if (buffer != local) free(buffer);
+  }
+
+  return value;
+}
+
+/**
+ * @brief Scan hexadecimal number
+ *
+ * Finds the end of a number in hexadecimal notation accepted by strtod.
+ *
+ * @param str Character "0" of the "0x" prefix
+ * @param end Character after the last one of the string
+ *
+ * @return Character after the number or str if there are no hex digits
+ */
+static const char* scan_hex(const char* str, const char* end) {
+  const char* p = str + 2;
+  size_t digits = 0;
+
+  for (; p < end && is_hex_digit(*p); p++) digits++;
+  if (p < end && *p == '.') {
+    for (p++; p < end && is_hex_digit(*p); p++) digits++;
+  }
+
+  if (digits == 0) {
+    p = str;
+  } else if (p < end && (*p == 'p' || *p == 'P')) {
+    const char* exponent = p + 1;
+    if (exponent < end && (*exponent == '-' || *exponent == '+')) exponent++;
+    if (exponent < end && is_digit(*exponent)) {
+      p = exponent;
+      while (p < end && is_digit(*p)) p++;
+    }
+  }
+
+  return p;
+}
+
+/**
+ * @brief Scan number
+ *
+ * Splits a number in decimal or inf/nan notation into its parts. Numbers in
+ * hexadecimal notation are only delimited and left to the slow path.
+ *
+ * @param str First character of the number
+ * @param end Character after the last one of the string
+ * @param number Decimal number to fill
+ * @param negative Number has a minus sign
+ * @param special Number is inf, nan or hexadecimal and needs the slow path
+ *
+ * @return Character after the number or str if there is no number
+ */
+static const char* scan_number(const char* str, const char* end,
+                               decimal_t* number, int* negative,
+                               int* special) {
+  const char* p = str;
+  *negative = 0;
+  *special = 0;
+
+  if (p < end && (*p == '-' || *p == '+')) *negative = *p++ == '-';
+
+  const char* digits_start = p;
+  const char* hex_end =
+      end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')
+          ? scan_hex(p, end)
+          : p;
+  int has_digits = 0;
+  if (hex_end == digits_start) {
+    p = scan_digits(p, end, number, 0);
+    has_digits = p != digits_start;
+    if (p < end && *p == '.') {
+      const char* fraction_start = p + 1;
+      const char* fraction_end = scan_digits(fraction_start, end, number, 1);
+      if (has_digits || fraction_end != fraction_start) {
+        has_digits = 1;
+        p = fraction_end;
+      }
+    }
+  }
+
+  if (hex_end != digits_start) {
+    // шестнадцатеричные числа разбирает strtod
+    p = hex_end;
+    *special = 1;
+  } else if (has_digits) {
+    p = scan_exponent(p, end, number);
+  } else if (p < end && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N')) {
+    // inf и nan разбирает strtod
+    char word[9] = {0};
+    size_t length = 0;
+    while (length < 8 && p + length < end) {
+      word[length] = p[length];
+      length++;
+    }
+    char* word_end = word;
+    strtod(word, &word_end);
+    p = word_end != word ? p + (word_end - word) : str;
+    *special = word_end != word;
+  } else {
+    p = str;
+  }
+
+  return p;
+}
+
+/**
+ * @brief Parse double
+ *
+ * Locale-independent replacement of strtod. Decimal numbers that fit into
+ * 53 bits with a power of ten up to 22 are converted exactly with one
+ * multiplication or division, the rest go through strtod.
+ *
+ * @param str First character of the number
+ * @param end Character after the last one of the string
+ * @param value Parsed value, untouched if there is no number
+ *
+ * @return Character after the number or str if there is no number
+ */
+const char* parse_double(const char* str, const char* end, double* value) {
+  decimal_t number = {0};
+  int negative = 0;
+  int special = 0;
+  const char* stop = scan_number(str, end, &number, &negative, &special);
+
+  if (stop != str) {
+    if (special || number.truncated) {
+      *value = parse_slow(str, stop, 0);
+    } else if (number.mantissa == 0) {
+      *value = negative ? -0.0 : 0.0;
+    } else if (number.mantissa <= (1ULL << 53) && number.exponent >= -22 &&
+               number.exponent <= 22) {
+      double result = (double)number.mantissa;
+      if (number.exponent < 0)
+        result /= powers_of_ten[-number.exponent];
+      else
+        result *= powers_of_ten[number.exponent];
+      *value = negative ? -result : result;
+    } else {
+      *value = parse_slow(str, stop, 0);
+    }
+  }
+
+  return stop;
+}
+
+/**
+ * @brief Parse float
+ *
+ * Locale-independent replacement of strtof for decimal notation. The exact
+ * double result is rounded to float unless it lies exactly between two
+ * floats, where double rounding could differ from strtof.
+ *
+ * @param str First character of the number
+ * @param end Character after the last one of the string
+ * @param value Parsed value, untouched if there is no number
+ *
+ * @return Character after the number or str if there is no number
+ */
+const char* parse_float(const char* str, const char* end, float* value) {
+  double result = 0.0;
+  const char* stop = parse_double(str, end, &result);
+
+  if (stop != str) {
+    double magnitude = fabs(result);
+    uint64_t bits = 0;
+    memcpy(&bits, &result, sizeof(bits));
+    // середина между соседними float в младших 29 битах double
+    int halfway = (bits & ((1ULL << 29) - 1)) == (1ULL << 28);
+
+    if (magnitude != 0.0 && (halfway || magnitude < 2.0 * FLT_MIN ||
+                             magnitude > FLT_MAX / 2.0)) {
+      *value = (float)parse_slow(str, stop, 1);
+    } else {
+      *value = (float)result;
+    }
+  }
+
+  return stop;
+}
+
+/**
+ * @brief Parse index
+ *
+ * Parses unsigned decimal integer such as vertex index of a facet.
+ *
+ * @param str First character of the number
+ * @param end Character after the last one of the string
+ * @param value Parsed value, untouched if there is no number
+ *
+ * @return Character after the number or str if there is no number
+ */
+const char* parse_index(const char* str, const char* end, size_t* value) {
+  const char* p = str;
+  if (p < end && *p == '+') p++;
+
+  const char* stop = p + digit_run(p, end);
+  if (stop != p) {
+    size_t result = 0;
+    for (; stop - p >= 8 && result < SIZE_MAX / 100000000; p += 8) {
+      result = result * 100000000 + (size_t)parse_eight_digits(p);
+    }
+    for (; p < stop; p++) {
+      size_t digit = (size_t)(*p - '0');
+      result =
+          result > (SIZE_MAX - digit) / 10 ? SIZE_MAX : result * 10 + digit;
+    }
+    *value = result;
+  } else {
+    stop = str;
+  }
+
+  return stop;
+}
@@ -1,5 +1,96 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "backend.h"
 
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// минимальный размер куска файла для отдельного потока
+#define MIN_CHUNK_SIZE (1 << 20)
+// шаг обновления прогресса загрузки в байтах
+#define PROGRESS_STEP (1 << 16)
+
+// состояние однопроходного загрузчика
+typedef struct ObjBuilder_ {
+  data_t data;
+  size_t vertices_capacity;
+  // начала полигонов в массиве номеров вершин
+  size_t* offsets;
+  size_t offsets_capacity;
+  // номера вершин всех полигонов до выбора их разрядности
+  size_t* indexes;
+  size_t indexes_capacity;
+  // вершины, уже учтённые в границах
+  size_t bounded;
+} obj_builder_t;
+
+/**
+ * @brief Relative index
+ *
+ * Negative vertex number of a facet of a chunk.
+ *
+ * @param position Position of the number in vertex numbers of the chunk
+ * @param defined Number of vertices of the chunk before the facet line
+ */
+typedef struct Relative_ {
+  size_t position;
+  size_t defined;
+} relative_t;
+
+/**
+ * @brief File chunk
+ *
+ * Newline-aligned part of the mapped file parsed by one thread.
+ *
+ * @param begin First character of the chunk
+ * @param end Character after the last one of the chunk
+ * @param count_of_vertices Number of vertices in the chunk
+ * @param count_of_facets Number of facets in the chunk
+ * @param count_of_indices Number of vertex numbers of facets in the chunk
+ * @param vertex_base Global number of the first vertex of the chunk
+ * @param facet_base Global number of the first facet of the chunk
+ * @param index_base Global position of the first vertex number of the chunk
+ * @param data Data structure to fill
+ * @param progress Loading progress shared between threads, may be NULL
+ * @param part Published part of the chunk for the preview, may be NULL
+ * @param error_code 1 if memory could not be allocated, LOAD_CANCELLED if
+ * loading was cancelled
+ * @param indexes Vertex numbers of facets of the chunk parsed by the count
+ * pass, negative ones as the number of steps back
+ * @param ends Ends of facets of the chunk in indexes
+ * @param relatives Negative vertex numbers to resolve once the number of the
+ * first vertex of the chunk is known
+ */
+typedef struct Chunk_ {
+  const char* begin;
+  const char* end;
+  size_t count_of_vertices;
+  size_t count_of_facets;
+  size_t count_of_indices;
+  size_t vertex_base;
+  size_t facet_base;
+  size_t index_base;
+  data_t* data;
+  progress_t* progress;
+  part_t* part;
+  int error_code;
+
+  // границы вершин куска
+  bounds_t bounds;
+
+  size_t* indexes;
+  size_t indexes_capacity;
+  size_t* ends;
+  size_t ends_capacity;
+  relative_t* relatives;
+  size_t count_of_relatives;
+  size_t relatives_capacity;
+} chunk_t;
+
 /**
  * @brief Open file
  *
@@ -45,31 +136,53 @@ int initialize_obj_matrix(data_t* data) {
   return error_code;
 }
 
+/**
+ * @brief Allocate vertex buffer
+ *
+ * Allocates uninitialized buffer of floats aligned to VERTEX_ALIGNMENT
+ * bytes. The buffer is freed with free().
+ *
+ * @param count Number of floats
+ *
+ * @return Allocated buffer or NULL
+ */
+float* alloc_vertex_buffer(size_t count) {
+  void* buffer = NULL;
+
+  if (count <= (SIZE_MAX - VERTEX_ALIGNMENT) / sizeof(float)) {
+    size_t size = (count * sizeof(float) + VERTEX_ALIGNMENT - 1) /
+                  VERTEX_ALIGNMENT * VERTEX_ALIGNMENT;
+    if (posix_memalign(&buffer, VERTEX_ALIGNMENT,
+                       size != 0 ? size : VERTEX_ALIGNMENT) != 0) {
+      buffer = NULL;
+    }
+  }
+
+  return buffer;
+}
+
 /**
  * @brief Allocate memory for object matrix
  *
- * Allocates memory for object matrix.
+ * Allocates one zeroed buffer for all vertices of the object matrix.
  *
  * @param data Data structure with all parameters
  */
 int matrix_mem_alloc(data_t* data) {
   int error_code = 0;
+  size_t count = data->obj_matrix.rows * data->obj_matrix.cols;
 
-  data->obj_matrix.matrix = calloc(data->obj_matrix.rows, sizeof(float*));
+  data->mapping = NULL;
+  data->mapping_size = 0;
+  data->obj_edges.indices = NULL;
+  data->obj_edges.count_of_edges = 0;
+  data->obj_lod = (lod_chain_t){0};
+  data->obj_bvh = (bvh_t){0};
+  data->obj_meshlets = (meshlets_t){0};
+  data->obj_matrix.matrix = alloc_vertex_buffer(count);
 
   if (data->obj_matrix.matrix != NULL) {
-    for (size_t i = 0; i < data->obj_matrix.rows; i++) {
-      data->obj_matrix.matrix[i] = calloc(data->obj_matrix.cols, sizeof(float));
-
-      if (data->obj_matrix.matrix[i] == NULL) {
-        error_code = 1;
-        for (size_t k = 0; k < i; k++) {
-          free(data->obj_matrix.matrix[k]);
-        }
-        free(data->obj_matrix.matrix);
-        data->obj_matrix.matrix = NULL;
-      }
-    }
+    memset(data->obj_matrix.matrix, 0, count * sizeof(float));
   } else {
     error_code = 1;
   }
@@ -77,6 +190,79 @@ int matrix_mem_alloc(data_t* data) {
   return error_code;
 }
 
+/**
+ * @brief Parse vertex line
+ *
+ * Parses coordinates of the vertex line. Coordinates that are missing stay
+ * untouched.
+ *
+ * @param line First character of the line
+ * @param end Character after the last one of the line
+ * @param vertex Vertex coordinates to fill
+ */
+static void parse_vertex_line(const char* line, const char* end,
+                              float* vertex) {
+  // пропуск ключевого слова "v"
+  while (line < end && *line != ' ' && *line != '\t') line++;
+
+  for (int k = 0; k < 3; k++) {
+    line = parse_float(skip_blanks(line, end), end, &vertex[k]);
+  }
+}
+
+/**
+ * @brief Next facet index
+ *
+ * Finds the next vertex index in the facet line, skipping tokens that do not
+ * start with a number. Texture and normal indexes after '/' are ignored.
+ * Negative indexes are returned as the number of steps back from the last
+ * vertex read before the line, see resolve_index.
+ *
+ * @param line Current position in the line
+ * @param end Character after the last one of the line
+ * @param vertex Vertex index
+ * @param relative Index is negative
+ *
+ * @return Position after the token or NULL if there are no more indexes
+ */
+static const char* next_facet_index(const char* line, const char* end,
+                                    size_t* vertex, int* relative) {
+  const char* next = NULL;
+
+  while (next == NULL && (line = skip_blanks(line, end)) < end) {
+    *relative = *line == '-';
+    const char* number = line + *relative;
+    const char* number_end = parse_index(number, end, vertex);
+    int found = number_end != number;
+    while (line < end && *line != ' ' && *line != '\t' && *line != '\r') {
+      line++;
+    }
+    if (found) next = line;
+  }
+
+  return next;
+}
+
+/**
+ * @brief Resolve index
+ *
+ * Turns a negative vertex number into a vertex number from 1. Numbers
+ * reaching before the first vertex become 0 as any other invalid one.
+ *
+ * @param vertex Vertex index returned by next_facet_index
+ * @param relative Index is negative
+ * @param defined Number of vertices read before the facet line
+ *
+ * @return Vertex number
+ */
+static size_t resolve_index(size_t vertex, int relative, size_t defined) {
+  size_t resolved = vertex;
+  if (relative) {
+    resolved = vertex != 0 && vertex <= defined ? defined + 1 - vertex : 0;
+  }
+  return resolved;
+}
+
 /**
  * @brief Copy vertices from object to matrix
  *
@@ -88,84 +274,111 @@ int matrix_mem_alloc(data_t* data) {
 void copy_vertices_from_obj_to_matrix(FILE* file, data_t* data) {
   char line[256];
   size_t v_lines_counter = 0;
-  data->rightest_vertex = 0.0f;
-  data->leftest_vertex = 0.0f;
-  data->highest_vertex = 0.0f;
-  data->lowest_vertex = 0.0f;
+  bounds_reset(&data->bounds);
+  prepare_number_parser();
 
   while (fgets(line, sizeof(line), file)) {
     if (line[0] == 'v' && line[1] != 'n' && line[1] != 't') {
-      sscanf(line, "%*s %f %f %f\n",
-             &data->obj_matrix.matrix[v_lines_counter][0],
-             &data->obj_matrix.matrix[v_lines_counter][1],
-             &data->obj_matrix.matrix[v_lines_counter][2]);
-
-      // вычисление граничных значений для масштабирования
-      if (data->obj_matrix.matrix[v_lines_counter][0] > data->rightest_vertex) {
-        data->rightest_vertex = data->obj_matrix.matrix[v_lines_counter][0];
-      } else if (data->obj_matrix.matrix[v_lines_counter][0] <
-                 data->leftest_vertex) {
-        data->leftest_vertex = data->obj_matrix.matrix[v_lines_counter][0];
-      }
-
-      if (data->obj_matrix.matrix[v_lines_counter][1] > data->highest_vertex) {
-        data->highest_vertex = data->obj_matrix.matrix[v_lines_counter][1];
-      } else if (data->obj_matrix.matrix[v_lines_counter][1] <
-                 data->lowest_vertex) {
-        data->lowest_vertex = data->obj_matrix.matrix[v_lines_counter][1];
-      }
+      float* vertex = matrix_vertex(&data->obj_matrix, v_lines_counter);
+      parse_vertex_line(line, line + strlen(line), vertex);
 
       v_lines_counter++;
     }
   }
+
+  // границы только по прочитанным вершинам
+  matrix_t read = {data->obj_matrix.matrix, v_lines_counter, 3};
+  bounds_compute(&data->bounds, &read, 0, v_lines_counter);
+  bounds_finish(&data->bounds, &read);
+}
+
+/**
+ * @brief Allocate facet indices
+ *
+ * Allocates the array of vertex numbers of facets, 32-bit unless the number
+ * of vertices needs 64 bits. The array is left uninitialized.
+ *
+ * @param facets Facets with allocated offsets
+ * @param count_of_indices Number of vertex numbers of all facets
+ * @param count_of_vertices Number of vertices of the object
+ */
+static int alloc_facet_indices(facets_t* facets, size_t count_of_indices,
+                               size_t count_of_vertices) {
+  facets->wide_indices = count_of_vertices > UINT32_MAX;
+  facets->count_of_indices = count_of_indices;
+  size_t index_size =
+      facets->wide_indices ? sizeof(uint64_t) : sizeof(uint32_t);
+  facets->indices = malloc(count_of_indices != 0 ? count_of_indices * index_size
+                                                 : index_size);
+
+  return facets->indices != NULL ? 0 : 1;
+}
+
+/**
+ * @brief Store facet index
+ *
+ * Writes a vertex number into the array of facet indices. Numbers past the
+ * last vertex are stored as 0, so every stored number is either 0 or a
+ * valid vertex and the cache can check this.
+ *
+ * @param facets Facets of the object
+ * @param position Position in the array of vertex numbers
+ * @param vertex Vertex number starting from 1
+ * @param count_of_vertices Number of vertices of the object
+ */
+static void store_facet_index(facets_t* facets, size_t position,
+                              size_t vertex, size_t count_of_vertices) {
+  if (vertex > count_of_vertices) vertex = 0;
+  // узкие номера выбираются, только если вершин не больше UINT32_MAX
+  if (facets->wide_indices) {
+    ((uint64_t*)facets->indices)[position] = vertex;
+  } else {
+    ((uint32_t*)facets->indices)[position] = (uint32_t)vertex;
+  }
 }
 
 /**
  * @brief Count vertices in facets
  *
- * Counts vertices in facets from file and writes it to data.
+ * Counts vertices in facets from file, fills facet offsets and allocates
+ * memory for vertex numbers.
  *
  * @param file Opened file pointer
  * @param data Data structure with all parameters
  */
 int count_vertices_in_facets(FILE* file, data_t* data) {
   int error_code = 0;
-  data->obj_polygons = calloc((data->count_of_facets), sizeof(polygon_t));
+  facets_t* facets = &data->obj_facets;
+  facets->offsets = calloc(data->count_of_facets + 1, sizeof(size_t));
 
-  if (data->obj_polygons != NULL) {
+  if (facets->offsets != NULL) {
     size_t f_lines_counter = 0;
     char line[256];
-    int count_of_vertices = 0;
+    size_t count_of_vertices = 0;
 
     while (fgets(line, sizeof(line), file)) {
-      if (line[0] == 'f') {
-        char* token = strtok(line, " ");
-        while (token != NULL) {
-          size_t vertex = 0;
-          if (sscanf(token, "%zu", &vertex) == 1) {
-            count_of_vertices++;
-          }
-          token = strtok(NULL, " ");
+      if (line[0] == 'f' && f_lines_counter < data->count_of_facets) {
+        const char* end = line + strlen(line);
+        size_t vertex = 0;
+        int relative = 0;
+        for (const char* p =
+                 next_facet_index(line + 1, end, &vertex, &relative);
+             p != NULL; p = next_facet_index(p, end, &vertex, &relative)) {
+          count_of_vertices++;
         }
-        data->obj_polygons[f_lines_counter].numbers_of_vertices_in_facets =
-            count_of_vertices;
+        facets->offsets[f_lines_counter + 1] =
+            facets->offsets[f_lines_counter] + count_of_vertices;
         count_of_vertices = 0;
         f_lines_counter++;
       }
     }
 
-    for (size_t i = 0; i < data->count_of_facets; i++) {
-      data->obj_polygons[i].vertices = calloc(
-          data->obj_polygons[i].numbers_of_vertices_in_facets, sizeof(size_t));
-
-      if (data->obj_polygons[i].vertices == NULL) {
-        error_code = 1;
-        for (size_t k = 0; k < i; k++) {
-          free(data->obj_polygons[k].vertices);
-        }
-        free(data->obj_polygons);
-        data->obj_polygons = NULL;
-      }
+    error_code =
+        alloc_facet_indices(facets, facets->offsets[data->count_of_facets],
+                            data->count_of_vertices);
+    if (error_code != 0) {
+      free(facets->offsets);
+      facets->offsets = NULL;
     }
   } else {
     error_code = 1;
@@ -176,26 +389,31 @@ int count_vertices_in_facets(FILE* file, data_t* data) {
 /**
  * @brief Copy indexes from object to struct
  *
- * Copies indexes from object file to polygon array.
+ * Copies indexes from object file to vertex numbers of facets.
  *
  * @param file Opened file pointer
  * @param data Data structure with all parameters
  */
 void copy_indexes_from_obj_to_struct(FILE* file, data_t* data) {
   size_t f_lines_counter = 0;
+  size_t v_lines_counter = 0;
   char line[256];
-  int counter = 0;
+  size_t counter = 0;
 
   while (fgets(line, sizeof(line), file)) {
-    if (line[0] == 'f') {
-      char* token = strtok(line, " ");
-      while (token != NULL) {
-        size_t vertex = 0;
-        if (sscanf(token, "%zu", &vertex) == 1) {
-          data->obj_polygons[f_lines_counter].vertices[counter] = vertex;
-          counter++;
-        }
-        token = strtok(NULL, " ");
+    if (line[0] == 'v' && line[1] != 'n' && line[1] != 't') {
+      v_lines_counter++;
+    } else if (line[0] == 'f') {
+      const char* end = line + strlen(line);
+      size_t vertex = 0;
+      int relative = 0;
+      for (const char* p = next_facet_index(line + 1, end, &vertex, &relative);
+           p != NULL; p = next_facet_index(p, end, &vertex, &relative)) {
+        store_facet_index(&data->obj_facets,
+                          data->obj_facets.offsets[f_lines_counter] + counter,
+                          resolve_index(vertex, relative, v_lines_counter),
+                          data->count_of_vertices);
+        counter++;
       }
       counter = 0;
 
@@ -204,6 +422,858 @@ void copy_indexes_from_obj_to_struct(FILE* file, data_t* data) {
   }
 }
 
+/**
+ * @brief Grow buffer
+ *
+ * Makes room for at least needed items, doubling the capacity.
+ *
+ * @param buffer Buffer to grow
+ * @param capacity Current capacity in items, updated on success
+ * @param needed Number of items that must fit
+ * @param item_size Size of one item
+ *
+ * @return Grown buffer or NULL if memory could not be allocated (the old
+ * buffer stays valid)
+ */
+static void* grow_buffer(void* buffer, size_t* capacity, size_t needed,
+                         size_t item_size) {
+  void* grown = buffer;
+
+  if (needed > *capacity) {
+    size_t new_capacity = *capacity != 0 ? *capacity * 2 : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+
+    grown = realloc(buffer, new_capacity * item_size);
+    if (grown != NULL) *capacity = new_capacity;
+  }
+
+  return grown;
+}
+
+/**
+ * @brief Map object file
+ *
+ * Maps the whole .obj file into memory for reading.
+ *
+ * @param filename Name of the object to be opened
+ * @param text Mapped file contents, NULL for an empty file
+ * @param size Size of the file in bytes
+ */
+static int map_obj_file(const char* filename, const char** text,
+                        size_t* size) {
+  int error_code = 0;
+  *text = NULL;
+  *size = 0;
+
+  int fd = open(filename, O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    error_code = 1;
+  } else if (file_stat.st_size > 0) {
+    *size = (size_t)file_stat.st_size;
+    void* mapped = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      error_code = 1;
+      *size = 0;
+    } else {
+      posix_madvise(mapped, *size, POSIX_MADV_SEQUENTIAL);
+      *text = mapped;
+    }
+  }
+
+  if (fd >= 0) close(fd);
+
+  return error_code;
+}
+
+/**
+ * @brief Record type
+ *
+ * Finds out which record the line holds.
+ *
+ * @param line First character of the line
+ * @param eol Character after the last one of the line
+ *
+ * @return 'v' for a vertex, 'f' for a facet and 0 for anything else
+ */
+static char record_type(const char* line, const char* eol) {
+  char type = 0;
+
+  if (eol - line > 1 && (line[1] == ' ' || line[1] == '\t') &&
+      (line[0] == 'v' || line[0] == 'f')) {
+    type = line[0];
+  }
+
+  return type;
+}
+
+/**
+ * @brief Add vertex
+ *
+ * Parses vertex line and appends it to the object matrix.
+ *
+ * @param builder Loader state
+ * @param line First character of the line
+ * @param end Character after the last one of the line
+ */
+static int add_vertex(obj_builder_t* builder, const char* line,
+                      const char* end) {
+  int error_code = 0;
+  data_t* data = &builder->data;
+  matrix_t* matrix = &data->obj_matrix;
+
+  if (matrix->rows == builder->vertices_capacity) {
+    // выровненный буфер растёт без realloc
+    size_t capacity = matrix->rows != 0 ? matrix->rows * 2 : 1024;
+    float* grown = alloc_vertex_buffer(capacity * 3);
+    if (grown != NULL) {
+      if (matrix->rows != 0) {
+        memcpy(grown, matrix->matrix, matrix->rows * 3 * sizeof(float));
+      }
+      free(matrix->matrix);
+      matrix->matrix = grown;
+      builder->vertices_capacity = capacity;
+    } else {
+      error_code = 1;
+    }
+  }
+
+  if (error_code == 0) {
+    float* vertex = matrix->matrix + matrix->rows++ * 3;
+    vertex[0] = vertex[1] = vertex[2] = 0.0f;
+    parse_vertex_line(line, end, vertex);
+
+    // границы растут блоками, пока вершины блока ещё в кэше
+    if (matrix->rows - builder->bounded == BOUNDS_BLOCK) {
+      bounds_grow(&data->bounds, matrix->matrix + builder->bounded * 3,
+                  BOUNDS_BLOCK);
+      builder->bounded = matrix->rows;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Add facet
+ *
+ * Parses facet line and appends its vertex numbers to the flat array.
+ *
+ * @param builder Loader state
+ * @param line First character of the line
+ * @param end Character after the last one of the line
+ */
+static int add_facet(obj_builder_t* builder, const char* line,
+                     const char* end) {
+  int error_code = 0;
+  data_t* data = &builder->data;
+  size_t start = builder->offsets[data->count_of_facets];
+  size_t count = 0;
+
+  size_t vertex = 0;
+  int relative = 0;
+  for (const char* p = next_facet_index(line + 1, end, &vertex, &relative);
+       p != NULL && error_code == 0;
+       p = next_facet_index(p, end, &vertex, &relative)) {
+    size_t* indexes = grow_buffer(builder->indexes, &builder->indexes_capacity,
+                                  start + count + 1, sizeof(size_t));
+    if (indexes != NULL) {
+      builder->indexes = indexes;
+      builder->indexes[start + count++] =
+          resolve_index(vertex, relative, data->obj_matrix.rows);
+    } else {
+      error_code = 1;
+    }
+  }
+
+  // полигоны без вершин не рисуются
+  if (error_code == 0 && count != 0) {
+    size_t* offsets =
+        grow_buffer(builder->offsets, &builder->offsets_capacity,
+                    data->count_of_facets + 2, sizeof(size_t));
+    if (offsets != NULL) {
+      builder->offsets = offsets;
+      builder->offsets[++data->count_of_facets] = start + count;
+    } else {
+      error_code = 1;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Finish facets
+ *
+ * Moves facets of the single-pass loader into the object, narrowing vertex
+ * numbers to 32 bits when the number of vertices allows it.
+ *
+ * @param builder Loader state
+ */
+static int finish_facets(obj_builder_t* builder) {
+  data_t* data = &builder->data;
+  facets_t* facets = &data->obj_facets;
+  size_t count_of_indices = builder->offsets[data->count_of_facets];
+  int error_code =
+      alloc_facet_indices(facets, count_of_indices, data->obj_matrix.rows);
+
+  if (error_code == 0) {
+    for (size_t i = 0; i < count_of_indices; i++) {
+      store_facet_index(facets, i, builder->indexes[i], data->obj_matrix.rows);
+    }
+    facets->offsets = builder->offsets;
+    builder->offsets = NULL;
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Parse object file
+ *
+ * Maps .obj file into memory once and builds vertices and facets in a single
+ * pass with growable buffers. Data is written only on success, so the caller
+ * keeps its previous object if the file can not be loaded.
+ *
+ * @param filename Name of the object to be opened
+ * @param data Data structure with all parameters
+ */
+int parse_obj_file(const char* filename, data_t* data) {
+  obj_builder_t builder = {0};
+  const char* text = NULL;
+  size_t size = 0;
+  int error_code = map_obj_file(filename, &text, &size);
+  bounds_reset(&builder.data.bounds);
+  prepare_number_parser();
+
+  if (error_code == 0) {
+    builder.offsets = grow_buffer(NULL, &builder.offsets_capacity, 1,
+                                  sizeof(size_t));
+    if (builder.offsets != NULL)
+      builder.offsets[0] = 0;
+    else
+      error_code = 1;
+  }
+
+  const char* end = text != NULL ? text + size : NULL;
+  for (const char* line = text; error_code == 0 && line < end;) {
+    const char* eol = memchr(line, '\n', (size_t)(end - line));
+    if (eol == NULL) eol = end;
+
+    char type = record_type(line, eol);
+    if (type == 'v') {
+      error_code = add_vertex(&builder, line, eol);
+    } else if (type == 'f') {
+      error_code = add_facet(&builder, line, eol);
+    }
+
+    line = eol + 1;
+  }
+
+  if (text != NULL) munmap((void*)text, size);
+  if (error_code == 0) error_code = finish_facets(&builder);
+  free(builder.offsets);
+  free(builder.indexes);
+
+  if (error_code == 0) {
+    builder.data.obj_matrix.cols = 3;
+    builder.data.count_of_vertices = builder.data.obj_matrix.rows;
+    bounds_grow(&builder.data.bounds,
+                matrix_vertex(&builder.data.obj_matrix, builder.bounded),
+                builder.data.obj_matrix.rows - builder.bounded);
+    bounds_finish(&builder.data.bounds, &builder.data.obj_matrix);
+    *data = builder.data;
+  } else {
+    builder.data.count_of_vertices = builder.data.obj_matrix.rows;
+    free_memory(NULL, &builder.data);
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Cancel loading
+ *
+ * Asks loading threads to stop. Can be called from any thread.
+ *
+ * @param progress Loading progress
+ */
+void progress_cancel(progress_t* progress) {
+  __atomic_store_n(&progress->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Loading progress fraction
+ *
+ * Returns the part of the work already done. Can be called from any thread.
+ * With several stages each takes an equal part; only reading the file
+ * reports progress inside its stage.
+ *
+ * @param progress Loading progress
+ *
+ * @return Value from 0 to 1
+ */
+double progress_fraction(const progress_t* progress) {
+  size_t total = __atomic_load_n(&progress->total_bytes, __ATOMIC_RELAXED);
+  size_t done = __atomic_load_n(&progress->done_bytes, __ATOMIC_RELAXED);
+  int stages = __atomic_load_n(&progress->count_of_stages, __ATOMIC_RELAXED);
+  int stage = __atomic_load_n(&progress->stage, __ATOMIC_RELAXED);
+  double fraction = total != 0 ? (double)done / (double)total : 0.0;
+
+  if (stages > 1) {
+    fraction = stage == 0 ? fraction / stages : (double)stage / stages;
+  }
+
+  return fraction;
+}
+
+/**
+ * @brief Set loading stages
+ *
+ * Splits the progress into passes of equal parts, for loading that goes on
+ * after the file is read. Must be called before loading starts.
+ *
+ * @param progress Loading progress
+ * @param count_of_stages Number of passes, reading the file included
+ */
+void progress_set_stages(progress_t* progress, int count_of_stages) {
+  __atomic_store_n(&progress->count_of_stages, count_of_stages,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&progress->stage, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Next loading stage
+ *
+ * Starts the next pass, so the passes before it count as done, and checks
+ * for cancellation.
+ *
+ * @param progress Loading progress
+ *
+ * @return 0 to go on, 1 if loading was cancelled
+ */
+int progress_next_stage(progress_t* progress) {
+  __atomic_fetch_add(&progress->stage, 1, __ATOMIC_RELAXED);
+
+  return __atomic_load_n(&progress->cancelled, __ATOMIC_RELAXED) ? 1 : 0;
+}
+
+/**
+ * @brief Report progress
+ *
+ * Adds bytes processed by the chunk since the last report to the shared
+ * progress and checks for cancellation.
+ *
+ * @param chunk Chunk being processed
+ * @param reported Position of the last report, updated on report
+ * @param position Current position in the chunk
+ */
+static void report_progress(chunk_t* chunk, const char** reported,
+                            const char* position) {
+  if (chunk->progress != NULL) {
+    __atomic_fetch_add(&chunk->progress->done_bytes,
+                       (size_t)(position - *reported), __ATOMIC_RELAXED);
+    *reported = position;
+    if (__atomic_load_n(&chunk->progress->cancelled, __ATOMIC_RELAXED))
+      chunk->error_code = LOAD_CANCELLED;
+  }
+}
+
+/**
+ * @brief Publish chunk
+ *
+ * Makes vertices and facets parsed so far visible to the preview. Everything
+ * written before is visible to a thread that reads the counts afterwards.
+ *
+ * @param chunk Chunk being parsed
+ * @param v_lines_counter Global number of the next vertex of the chunk
+ * @param f_lines_counter Global number of the next facet of the chunk
+ */
+static void publish_chunk(chunk_t* chunk, size_t v_lines_counter,
+                          size_t f_lines_counter) {
+  if (chunk->part != NULL) {
+    __atomic_store_n(&chunk->part->parsed_vertices,
+                     v_lines_counter - chunk->vertex_base, __ATOMIC_RELEASE);
+    __atomic_store_n(&chunk->part->parsed_facets,
+                     f_lines_counter - chunk->facet_base, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * @brief Acquire partial object
+ *
+ * Gives access to the object being loaded for the preview. On success the
+ * arrays stay valid until progress_release_partial is called.
+ *
+ * @param progress Loading progress
+ * @param partial Snapshot of parsed parts to fill
+ *
+ * @return Non-zero if partial object is available
+ */
+int progress_acquire_partial(progress_t* progress, partial_t* partial) {
+  __atomic_add_fetch(&progress->readers, 1, __ATOMIC_SEQ_CST);
+  int ready = __atomic_load_n(&progress->ready, __ATOMIC_SEQ_CST);
+
+  if (ready) {
+    partial->data = &progress->partial;
+    partial->count_of_parts = progress->count_of_parts;
+    for (size_t i = 0; i < partial->count_of_parts; i++) {
+      part_t* part = &progress->parts[i];
+      partial->parts[i].vertex_base = part->vertex_base;
+      partial->parts[i].facet_base = part->facet_base;
+      partial->parts[i].parsed_vertices =
+          __atomic_load_n(&part->parsed_vertices, __ATOMIC_ACQUIRE);
+      partial->parts[i].parsed_facets =
+          __atomic_load_n(&part->parsed_facets, __ATOMIC_ACQUIRE);
+    }
+  } else {
+    __atomic_sub_fetch(&progress->readers, 1, __ATOMIC_SEQ_CST);
+  }
+
+  return ready;
+}
+
+/**
+ * @brief Release partial object
+ *
+ * Ends access started by a successful progress_acquire_partial.
+ *
+ * @param progress Loading progress
+ */
+void progress_release_partial(progress_t* progress) {
+  __atomic_sub_fetch(&progress->readers, 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Partial vertex is parsed
+ *
+ * Checks whether the vertex referenced by a facet is already parsed.
+ *
+ * @param partial Snapshot of parsed parts
+ * @param vertex Vertex number as in the facet, starting from 1
+ */
+int partial_vertex_parsed(const partial_t* partial, size_t vertex) {
+  int parsed = 0;
+
+  if (vertex != 0 && partial->count_of_parts != 0) {
+    size_t index = vertex - 1;
+    size_t low = 0;
+    size_t high = partial->count_of_parts;
+    // последний кусок, начинающийся не позже вершины
+    while (high - low > 1) {
+      size_t middle = (low + high) / 2;
+      if (partial->parts[middle].vertex_base <= index)
+        low = middle;
+      else
+        high = middle;
+    }
+    parsed = index - partial->parts[low].vertex_base <
+             partial->parts[low].parsed_vertices;
+  }
+
+  return parsed;
+}
+
+/**
+ * @brief Unpublish partial object
+ *
+ * Hides the partial object from the preview and waits until no reader uses
+ * it, so its arrays can be freed.
+ *
+ * @param progress Loading progress, may be NULL
+ */
+static void unpublish_partial(progress_t* progress) {
+  if (progress != NULL) {
+    __atomic_store_n(&progress->ready, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&progress->readers, __ATOMIC_SEQ_CST) != 0) {
+      sched_yield();
+    }
+  }
+}
+
+/**
+ * @brief Add chunk facet
+ *
+ * Parses facet line of the chunk and appends its vertex numbers to the
+ * arrays of the chunk. Negative numbers are kept until the number of the
+ * first vertex of the chunk is known.
+ *
+ * @param chunk Chunk being counted
+ * @param line First character of the line
+ * @param end Character after the last one of the line
+ *
+ * @return 0 on success, 1 if memory could not be allocated
+ */
+static int add_chunk_facet(chunk_t* chunk, const char* line, const char* end) {
+  int error_code = 0;
+  size_t start = chunk->count_of_indices;
+  size_t vertex = 0;
+  int relative = 0;
+
+  for (const char* p = next_facet_index(line + 1, end, &vertex, &relative);
+       p != NULL && error_code == 0;
+       p = next_facet_index(p, end, &vertex, &relative)) {
+    size_t position = chunk->count_of_indices;
+    size_t* indexes = grow_buffer(chunk->indexes, &chunk->indexes_capacity,
+                                  position + 1, sizeof(size_t));
+    if (indexes != NULL) {
+      chunk->indexes = indexes;
+      chunk->indexes[chunk->count_of_indices++] = vertex;
+    } else {
+      error_code = 1;
+    }
+    if (error_code == 0 && relative) {
+      relative_t* relatives =
+          grow_buffer(chunk->relatives, &chunk->relatives_capacity,
+                      chunk->count_of_relatives + 1, sizeof(relative_t));
+      if (relatives != NULL) {
+        chunk->relatives = relatives;
+        chunk->relatives[chunk->count_of_relatives++] =
+            (relative_t){position, chunk->count_of_vertices};
+      } else {
+        error_code = 1;
+      }
+    }
+  }
+
+  // полигоны без вершин не рисуются
+  if (error_code == 0 && chunk->count_of_indices != start) {
+    size_t* ends = grow_buffer(chunk->ends, &chunk->ends_capacity,
+                               chunk->count_of_facets + 1, sizeof(size_t));
+    if (ends != NULL) {
+      chunk->ends = ends;
+      chunk->ends[chunk->count_of_facets++] = chunk->count_of_indices;
+    } else {
+      error_code = 1;
+    }
+  }
+
+  return error_code;
+}
+
+/**
+ * @brief Count chunk
+ *
+ * Counts vertices of the chunk and parses its facets, so every facet line is
+ * read once. Facets are moved to their global places by parse_chunk.
+ *
+ * @param arg Chunk to count
+ */
+static void* count_chunk(void* arg) {
+  chunk_t* chunk = arg;
+  const char* reported = chunk->begin;
+
+  for (const char* line = chunk->begin;
+       chunk->error_code == 0 && line < chunk->end;) {
+    const char* eol = memchr(line, '\n', (size_t)(chunk->end - line));
+    if (eol == NULL) eol = chunk->end;
+
+    char type = record_type(line, eol);
+    if (type == 'v') {
+      chunk->count_of_vertices++;
+    } else if (type == 'f') {
+      chunk->error_code = add_chunk_facet(chunk, line, eol);
+    }
+
+    line = eol + 1;
+    if (line - reported >= PROGRESS_STEP) {
+      report_progress(chunk, &reported, line);
+    }
+  }
+  report_progress(chunk, &reported, chunk->end);
+
+  return NULL;
+}
+
+/**
+ * @brief Free chunk facets
+ *
+ * @param chunk Chunk whose facet arrays are freed
+ */
+static void free_chunk_facets(chunk_t* chunk) {
+  free(chunk->indexes);
+  free(chunk->ends);
+  free(chunk->relatives);
+  chunk->indexes = chunk->ends = NULL;
+  chunk->relatives = NULL;
+}
+
+/**
+ * @brief Move chunk facets
+ *
+ * Copies facets parsed by the count pass into their global places found by
+ * the prefix sum of counts of previous chunks and resolves negative vertex
+ * numbers. The offset of the first facet of every chunk is written before,
+ * so each chunk writes only the ends of its facets.
+ *
+ * @param chunk Chunk being parsed
+ */
+static void move_chunk_facets(chunk_t* chunk) {
+  facets_t* facets = &chunk->data->obj_facets;
+  size_t count_of_vertices = chunk->data->count_of_vertices;
+
+  for (size_t i = 0; i < chunk->count_of_indices; i++) {
+    store_facet_index(facets, chunk->index_base + i, chunk->indexes[i],
+                      count_of_vertices);
+  }
+  for (size_t i = 0; i < chunk->count_of_relatives; i++) {
+    const relative_t* relative = &chunk->relatives[i];
+    store_facet_index(facets, chunk->index_base + relative->position,
+                      resolve_index(chunk->indexes[relative->position], 1,
+                                    chunk->vertex_base + relative->defined),
+                      count_of_vertices);
+  }
+  for (size_t i = 0; i < chunk->count_of_facets; i++) {
+    facets->offsets[chunk->facet_base + i + 1] =
+        chunk->index_base + chunk->ends[i];
+  }
+  free_chunk_facets(chunk);
+}
+
+/**
+ * @brief Parse chunk
+ *
+ * Moves facets of the chunk into their global places and parses its
+ * vertices there. Facet lines are only skipped.
+ *
+ * @param arg Chunk to parse
+ */
+static void* parse_chunk(void* arg) {
+  chunk_t* chunk = arg;
+  data_t* data = chunk->data;
+  size_t v_lines_counter = chunk->vertex_base;
+  size_t bounded = chunk->vertex_base;
+  size_t f_lines_counter = chunk->facet_base + chunk->count_of_facets;
+  const char* reported = chunk->begin;
+
+  move_chunk_facets(chunk);
+
+  for (const char* line = chunk->begin;
+       chunk->error_code == 0 && line < chunk->end;) {
+    const char* eol = memchr(line, '\n', (size_t)(chunk->end - line));
+    if (eol == NULL) eol = chunk->end;
+
+    char type = record_type(line, eol);
+    if (type == 'v') {
+      float* vertex = matrix_vertex(&data->obj_matrix, v_lines_counter++);
+      vertex[0] = vertex[1] = vertex[2] = 0.0f;
+      parse_vertex_line(line, eol, vertex);
+
+      // границы растут блоками, пока вершины блока ещё в кэше
+      if (v_lines_counter - bounded == BOUNDS_BLOCK) {
+        bounds_grow(&chunk->bounds, matrix_vertex(&data->obj_matrix, bounded),
+                    BOUNDS_BLOCK);
+        bounded = v_lines_counter;
+      }
+    }
+
+    line = eol + 1;
+    if (line - reported >= PROGRESS_STEP) {
+      publish_chunk(chunk, v_lines_counter, f_lines_counter);
+      report_progress(chunk, &reported, line);
+    }
+  }
+  bounds_grow(&chunk->bounds, matrix_vertex(&data->obj_matrix, bounded),
+              v_lines_counter - bounded);
+  publish_chunk(chunk, v_lines_counter, f_lines_counter);
+  report_progress(chunk, &reported, chunk->end);
+
+  return NULL;
+}
+
+/**
+ * @brief Chunk loop
+ *
+ * Worker and chunks of one run_chunks call.
+ *
+ * @param chunks Array of chunks
+ * @param worker Function to run for each chunk
+ */
+typedef struct ChunkLoop_ {
+  chunk_t* chunks;
+  void* (*worker)(void*);
+} chunk_loop_t;
+
+/**
+ * @brief Run chunk range
+ *
+ * Runs the worker for chunks from begin to end, body of pool_parallel_for.
+ *
+ * @param arg Chunk loop
+ * @param begin First chunk
+ * @param end Chunk after the last one
+ */
+static void run_chunk_range(void* arg, size_t begin, size_t end) {
+  chunk_loop_t* loop = arg;
+  for (size_t i = begin; i < end; i++) loop->worker(&loop->chunks[i]);
+}
+
+/**
+ * @brief Run chunks
+ *
+ * Runs the worker for every chunk on the thread pool, the calling thread
+ * takes chunks too. Chunks are handled by the calling thread alone when the
+ * pool is busy.
+ *
+ * @param chunks Array of chunks
+ * @param count_of_chunks Number of chunks
+ * @param worker Function to run for each chunk
+ */
+static void run_chunks(chunk_t* chunks, size_t count_of_chunks,
+                       void* (*worker)(void*)) {
+  chunk_loop_t loop = {chunks, worker};
+  pool_parallel_for(count_of_chunks, 2, run_chunk_range, &loop);
+}
+
+/**
+ * @brief Split into chunks
+ *
+ * Splits the mapped file into chunks of about equal size that end right
+ * after a newline.
+ *
+ * @param text Mapped file contents
+ * @param size Size of the file in bytes
+ * @param chunks Array of chunks to fill
+ * @param count_of_chunks Number of chunks
+ */
+static void split_into_chunks(const char* text, size_t size, chunk_t* chunks,
+                              size_t count_of_chunks) {
+  const char* end = text + size;
+  const char* begin = text;
+
+  for (size_t i = 0; i < count_of_chunks; i++) {
+    const char* chunk_end = end;
+    if (i + 1 < count_of_chunks) {
+      chunk_end = text + size / count_of_chunks * (i + 1);
+      if (chunk_end < begin) chunk_end = begin;
+      const char* eol = memchr(chunk_end, '\n', (size_t)(end - chunk_end));
+      chunk_end = eol != NULL ? eol + 1 : end;
+    }
+    chunks[i].begin = begin;
+    chunks[i].end = chunk_end;
+    begin = chunk_end;
+  }
+}
+
+/**
+ * @brief Parse object file in parallel
+ *
+ * Maps .obj file into memory and splits it into newline-aligned chunks, one
+ * per thread. Threads count vertices and parse facets of their chunks
+ * first, then the prefix sum of the counts gives each chunk the global
+ * numbers of its first vertex, facet and facet vertex number, and threads
+ * move facets and parse vertices straight into the final arrays. Data is
+ * written only on success.
+ *
+ * @param filename Name of the object to be opened
+ * @param data Data structure with all parameters
+ * @param threads Number of threads, 0 to use all processors
+ * @param progress Loading progress to update, may be NULL
+ *
+ * @return 0 on success, LOAD_CANCELLED if loading was cancelled through
+ * progress, 1 on any other error
+ */
+int parse_obj_file_parallel(const char* filename, data_t* data, size_t threads,
+                            progress_t* progress) {
+  const char* text = NULL;
+  size_t size = 0;
+  int error_code = map_obj_file(filename, &text, &size);
+  data_t parsed = {0};
+  parsed.obj_matrix.cols = 3;
+  bounds_reset(&parsed.bounds);
+  // локаль читается до запуска потоков
+  prepare_number_parser();
+
+  if (error_code == 0 && text != NULL) {
+    // каждый байт просматривается при подсчёте и при разборе
+    if (progress != NULL) {
+      __atomic_store_n(&progress->total_bytes, 2 * size, __ATOMIC_RELAXED);
+    }
+    if (threads == 0) threads = pool_threads();
+    // маленьким файлам не нужны все потоки
+    size_t count_of_chunks = size / MIN_CHUNK_SIZE + 1;
+    if (count_of_chunks > threads) count_of_chunks = threads;
+    if (count_of_chunks > MAX_PARSER_THREADS)
+      count_of_chunks = MAX_PARSER_THREADS;
+
+    chunk_t chunks[MAX_PARSER_THREADS] = {0};
+    split_into_chunks(text, size, chunks, count_of_chunks);
+    for (size_t i = 0; i < count_of_chunks; i++) {
+      chunks[i].progress = progress;
+      bounds_reset(&chunks[i].bounds);
+    }
+    run_chunks(chunks, count_of_chunks, count_chunk);
+
+    // префиксная сумма количеств по кускам
+    for (size_t i = 0; i < count_of_chunks; i++) {
+      chunks[i].vertex_base = parsed.count_of_vertices;
+      chunks[i].facet_base = parsed.count_of_facets;
+      chunks[i].index_base = parsed.obj_facets.count_of_indices;
+      chunks[i].data = &parsed;
+      if (chunks[i].error_code != 0) error_code = chunks[i].error_code;
+      parsed.count_of_vertices += chunks[i].count_of_vertices;
+      parsed.count_of_facets += chunks[i].count_of_facets;
+      parsed.obj_facets.count_of_indices += chunks[i].count_of_indices;
+    }
+    parsed.obj_matrix.rows = parsed.count_of_vertices;
+
+    if (error_code == 0 && parsed.count_of_vertices != 0) {
+      parsed.obj_matrix.matrix =
+          alloc_vertex_buffer(parsed.count_of_vertices * 3);
+      if (parsed.obj_matrix.matrix == NULL) error_code = 1;
+    }
+    if (error_code == 0) {
+      facets_t* facets = &parsed.obj_facets;
+      facets->offsets = malloc((parsed.count_of_facets + 1) * sizeof(size_t));
+      if (facets->offsets == NULL ||
+          alloc_facet_indices(facets, facets->count_of_indices,
+                              parsed.count_of_vertices) != 0) {
+        error_code = 1;
+      } else {
+        // границы кусков известны заранее
+        for (size_t i = 0; i < count_of_chunks; i++) {
+          facets->offsets[chunks[i].facet_base] = chunks[i].index_base;
+        }
+        facets->offsets[parsed.count_of_facets] = facets->count_of_indices;
+      }
+    }
+
+    // массивы больше не перемещаются и доступны для предпросмотра
+    if (error_code == 0 && progress != NULL) {
+      progress->partial = parsed;
+      progress->count_of_parts = count_of_chunks;
+      for (size_t i = 0; i < count_of_chunks; i++) {
+        progress->parts[i].vertex_base = chunks[i].vertex_base;
+        progress->parts[i].facet_base = chunks[i].facet_base;
+        chunks[i].part = &progress->parts[i];
+      }
+      __atomic_store_n(&progress->ready, 1, __ATOMIC_SEQ_CST);
+    }
+
+    if (error_code == 0) {
+      run_chunks(chunks, count_of_chunks, parse_chunk);
+    }
+
+    for (size_t i = 0; i < count_of_chunks; i++) {
+      if (chunks[i].error_code > error_code) error_code = chunks[i].error_code;
+      bounds_merge(&parsed.bounds, &chunks[i].bounds);
+      free_chunk_facets(&chunks[i]);
+    }
+    if (error_code == 0) bounds_finish(&parsed.bounds, &parsed.obj_matrix);
+  }
+
+  if (text != NULL) munmap((void*)text, size);
+
+  if (error_code == 0) {
+    *data = parsed;
+  } else {
+    unpublish_partial(progress);
+    free_memory(NULL, &parsed);
+  }
+
+  return error_code;
+}
+
 /**
  * @brief Free memory
  *
@@ -219,25 +1289,29 @@ void free_memory(FILE* file, data_t* data) {
     file = NULL;
   }
 
-  // очистка матрицы вершин
-  if (data->obj_matrix.matrix != NULL) {
-    for (size_t i = 0; i < data->obj_matrix.rows; i++) {
-      free(data->obj_matrix.matrix[i]);
-      data->obj_matrix.matrix[i] = NULL;
-    }
+  // вершины и полигоны из кэша освобождаются вместе с отображением
+  if (data->mapping != NULL) {
+    munmap(data->mapping, data->mapping_size);
+    data->mapping = NULL;
+    data->mapping_size = 0;
+  } else {
+    // очистка матрицы вершин
     free(data->obj_matrix.matrix);
-    data->obj_matrix.matrix = NULL;
-  }
-
-  // очистка матрицы полигонов
-  if (data->obj_polygons != NULL) {
-    for (size_t i = 0; i < data->count_of_facets; i++) {
-      free(data->obj_polygons[i].vertices);
-      data->obj_polygons[i].vertices = NULL;
-    }
-    free(data->obj_polygons);
-    data->obj_polygons = NULL;
+    // очистка полигонов
+    free(data->obj_facets.offsets);
+    free(data->obj_facets.indices);
   }
+  data->obj_matrix.matrix = NULL;
+  data->obj_facets.offsets = NULL;
+  data->obj_facets.indices = NULL;
+  data->obj_facets.count_of_indices = 0;
+  // рёбра всегда лежат в отдельном буфере
+  free(data->obj_edges.indices);
+  data->obj_edges.indices = NULL;
+  data->obj_edges.count_of_edges = 0;
+  lod_free(&data->obj_lod);
+  bvh_free(&data->obj_bvh);
+  meshlets_free(&data->obj_meshlets);
 
   data->count_of_vertices = 0;
   data->count_of_facets = 0;
@@ -0,0 +1,194 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "backend.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+// каждому потоку достаётся несколько порций для выравнивания нагрузки
+#define POOL_BLOCKS_PER_THREAD 4
+// крупные порции кратны этому количеству элементов
+#define POOL_GRAIN_ALIGNMENT 64
+
+/**
+ * @brief Pool job
+ *
+ * One parallel loop. Threads take portions of grain elements until all
+ * elements are taken.
+ *
+ * @param body Function to run for a range of elements
+ * @param arg Argument of body
+ * @param count Number of elements
+ * @param grain Number of elements in one portion
+ * @param next First element that is not taken yet
+ * @param active Number of pool threads working on the job
+ */
+typedef struct PoolJob_ {
+  void (*body)(void* arg, size_t begin, size_t end);
+  void* arg;
+  size_t count;
+  size_t grain;
+  size_t next;
+  size_t active;
+} pool_job_t;
+
+/**
+ * @brief Thread pool
+ *
+ * Threads created once and sleeping between jobs. Only one job runs at a
+ * time, other callers run their loops serially.
+ *
+ * @param threads Pool threads
+ * @param count_of_threads Number of started pool threads
+ * @param lock Protects job, generation and active counters
+ * @param wake Signals a new job
+ * @param done Signals that a pool thread left the job
+ * @param submit Held by the caller whose job runs
+ * @param job Current job, NULL if there is none
+ * @param generation Number of submitted jobs
+ */
+typedef struct Pool_ {
+  pthread_t threads[MAX_PARSER_THREADS];
+  size_t count_of_threads;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  pthread_mutex_t submit;
+  pool_job_t* job;
+  size_t generation;
+} pool_t;
+
+static pool_t pool = {.lock = PTHREAD_MUTEX_INITIALIZER,
+                      .wake = PTHREAD_COND_INITIALIZER,
+                      .done = PTHREAD_COND_INITIALIZER,
+                      .submit = PTHREAD_MUTEX_INITIALIZER};
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Run job
+ *
+ * Takes portions of the job and runs its body until nothing is left.
+ *
+ * @param job Job to work on
+ */
+static void run_job(pool_job_t* job) {
+  size_t begin = __atomic_fetch_add(&job->next, job->grain, __ATOMIC_RELAXED);
+
+  while (begin < job->count) {
+    size_t end = job->count - begin > job->grain ? begin + job->grain
+                                                 : job->count;
+    job->body(job->arg, begin, end);
+    begin = __atomic_fetch_add(&job->next, job->grain, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * @brief Pool worker
+ *
+ * Waits for jobs and helps to run them.
+ *
+ * @param arg Unused
+ */
+static void* pool_worker(void* arg) {
+  (void)arg;
+  size_t seen = 0;
+
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == seen) pthread_cond_wait(&pool.wake, &pool.lock);
+    seen = pool.generation;
+
+    // задание могло уже закончиться, пока поток просыпался
+    pool_job_t* job = pool.job;
+    if (job != NULL) {
+      job->active++;
+      pthread_mutex_unlock(&pool.lock);
+      run_job(job);
+      pthread_mutex_lock(&pool.lock);
+      if (--job->active == 0) pthread_cond_broadcast(&pool.done);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Start pool
+ *
+ * Starts one pool thread less than there are processors, the caller of a
+ * loop is the last thread.
+ */
+static void start_pool(void) {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t count = processors > 1 ? (size_t)processors - 1 : 0;
+  if (count > MAX_PARSER_THREADS) count = MAX_PARSER_THREADS;
+
+  for (size_t i = 0; i < count; i++) {
+    if (pthread_create(&pool.threads[pool.count_of_threads], NULL,
+                       pool_worker, NULL) == 0) {
+      pthread_detach(pool.threads[pool.count_of_threads]);
+      pool.count_of_threads++;
+    }
+  }
+}
+
+/**
+ * @brief Pool threads
+ *
+ * Returns the number of threads running a parallel loop, including the
+ * calling one. The pool is started on the first call.
+ */
+size_t pool_threads(void) {
+  pthread_once(&pool_once, start_pool);
+  return pool.count_of_threads + 1;
+}
+
+/**
+ * @brief Parallel for
+ *
+ * Runs body over elements from 0 to count, split into ranges between the
+ * pool threads and the calling thread. The size of a range is chosen so that
+ * every thread gets several of them. Loops shorter than serial_threshold,
+ * loops started while another one runs and loops started from the body run
+ * serially on the calling thread. Returns when all ranges are done.
+ *
+ * @param count Number of elements
+ * @param serial_threshold Smallest number of elements worth threads
+ * @param body Function to run for elements from begin to end
+ * @param arg Argument of body
+ */
+void pool_parallel_for(size_t count, size_t serial_threshold,
+                       void (*body)(void* arg, size_t begin, size_t end),
+                       void* arg) {
+  size_t threads = count != 0 ? pool_threads() : 1;
+
+  if (count == 0) {
+    // пустой цикл
+  } else if (count < serial_threshold || threads == 1 ||
+             pthread_mutex_trylock(&pool.submit) != 0) {
+    body(arg, 0, count);
+  } else {
+    size_t grain = count / (threads * POOL_BLOCKS_PER_THREAD);
+    if (grain == 0) grain = 1;
+    if (grain > POOL_GRAIN_ALIGNMENT) {
+      grain = (grain + POOL_GRAIN_ALIGNMENT - 1) / POOL_GRAIN_ALIGNMENT *
+              POOL_GRAIN_ALIGNMENT;
+    }
+    pool_job_t job = {body, arg, count, grain, 0, 0};
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = &job;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_job(&job);
+
+    // задание лежит на стеке и живёт, пока им заняты потоки пула
+    pthread_mutex_lock(&pool.lock);
+    pool.job = NULL;
+    while (job.active != 0) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.submit);
+  }
+}
@@ -0,0 +1,232 @@
+#include "backend.h"
+
+/**
+ * @brief Multiply transform
+ *
+ * Applies an operation after the transform: model = operation * model.
+ *
+ * @param T Transform to update
+ * @param operation 4x4 matrix of the operation by columns
+ */
+static void multiply_transform(transform_t *T, const double operation[16]) {
+  double result[16];
+
+  for (int col = 0; col < 4; col++) {
+    for (int row = 0; row < 4; row++) {
+      double sum = 0.0;
+      for (int k = 0; k < 4; k++) {
+        sum += operation[k * 4 + row] * T->model[col * 4 + k];
+      }
+      result[col * 4 + row] = sum;
+    }
+  }
+
+  memcpy(T->model, result, sizeof(result));
+}
+
+/**
+ * @brief Identity matrix
+ *
+ * Fills a 4x4 matrix with the identity.
+ *
+ * @param matrix Matrix to fill
+ */
+static void identity(double matrix[16]) {
+  for (int i = 0; i < 16; i++) matrix[i] = i % 5 == 0 ? 1.0 : 0.0;
+}
+
+/**
+ * @brief Reset transform
+ *
+ * Makes the transform identity, so the object is drawn as it was loaded.
+ *
+ * @param T Transform to reset
+ */
+void transform_reset(transform_t *T) { identity(T->model); }
+
+/**
+ * @brief Move transform
+ *
+ * Adds a move by three axes. Every offset is limited as in move_by_ox.
+ *
+ * @param T Transform to update
+ * @param x Value to move the object by OX
+ * @param y Value to move the object by OY
+ * @param z Value to move the object by OZ
+ */
+void transform_move(transform_t *T, float x, float y, float z) {
+  double operation[16];
+  identity(operation);
+  operation[12] = limit_offset(x);
+  operation[13] = limit_offset(y);
+  operation[14] = limit_offset(z);
+  multiply_transform(T, operation);
+}
+
+/**
+ * @brief Scale transform
+ *
+ * Adds a scale by three axes. Every value is limited as in scale_even.
+ *
+ * @param T Transform to update
+ * @param x Value to scale the object by OX
+ * @param y Value to scale the object by OY
+ * @param z Value to scale the object by OZ
+ */
+void transform_scale(transform_t *T, float x, float y, float z) {
+  double operation[16];
+  identity(operation);
+  operation[0] = limit_scale(x);
+  operation[5] = limit_scale(y);
+  operation[10] = limit_scale(z);
+  multiply_transform(T, operation);
+}
+
+/**
+ * @brief Rotate transform by OX
+ *
+ * Adds a rotation by OX axis in the same direction as rotate_by_ox.
+ *
+ * @param T Transform to update
+ * @param angle Value to rotate the object by in degrees
+ */
+void transform_rotate_by_ox(transform_t *T, float angle) {
+  double radians = angle * PI_VAL / 180.0;
+  double operation[16];
+  identity(operation);
+  operation[5] = cos(radians);
+  operation[6] = sin(radians);
+  operation[9] = -sin(radians);
+  operation[10] = cos(radians);
+  multiply_transform(T, operation);
+}
+
+/**
+ * @brief Rotate transform by OY
+ *
+ * Adds a rotation by OY axis in the same direction as rotate_by_oy.
+ *
+ * @param T Transform to update
+ * @param angle Value to rotate the object by in degrees
+ */
+void transform_rotate_by_oy(transform_t *T, float angle) {
+  double radians = angle * PI_VAL / 180.0;
+  double operation[16];
+  identity(operation);
+  operation[0] = cos(radians);
+  operation[2] = -sin(radians);
+  operation[8] = sin(radians);
+  operation[10] = cos(radians);
+  multiply_transform(T, operation);
+}
+
+/**
+ * @brief Rotate transform by OZ
+ *
+ * Adds a rotation by OZ axis in the same direction as rotate_by_oz.
+ *
+ * @param T Transform to update
+ * @param angle Value to rotate the object by in degrees
+ */
+void transform_rotate_by_oz(transform_t *T, float angle) {
+  double radians = angle * PI_VAL / 180.0;
+  double operation[16];
+  identity(operation);
+  operation[0] = cos(radians);
+  operation[1] = sin(radians);
+  operation[4] = -sin(radians);
+  operation[5] = cos(radians);
+  multiply_transform(T, operation);
+}
+
+/**
+ * @brief Transform matrix
+ *
+ * Converts the model matrix to floats by columns, ready for glLoadMatrixf.
+ *
+ * @param T Transform to convert
+ * @param matrix Array of 16 floats to fill
+ */
+void transform_matrix(const transform_t *T, float matrix[16]) {
+  for (int i = 0; i < 16; i++) matrix[i] = (float)T->model[i];
+}
+
+/**
+ * @brief Transform vertex
+ *
+ * Computes where one vertex is drawn with the transform.
+ *
+ * @param T Transform to apply
+ * @param vertex Coordinates of the vertex
+ * @param result Transformed coordinates, may be the same array as vertex
+ */
+void transform_vertex(const transform_t *T, const float vertex[3],
+                      float result[3]) {
+  const double *m = T->model;
+  double x = vertex[0], y = vertex[1], z = vertex[2];
+
+  result[0] = (float)(m[0] * x + m[4] * y + m[8] * z + m[12]);
+  result[1] = (float)(m[1] * x + m[5] * y + m[9] * z + m[13]);
+  result[2] = (float)(m[2] * x + m[6] * y + m[10] * z + m[14]);
+}
+
+/**
+ * @brief Apply transform
+ *
+ * Writes the transform into the vertices in one pass, for when transformed
+ * coordinates are needed in memory. Uses the fastest vertex kernels, large
+ * objects are split between the pool threads.
+ *
+ * @param T Transform to apply
+ * @param A Object matrix
+ */
+void transform_apply(const transform_t *T, matrix_t *A) {
+  float matrix[16];
+  transform_matrix(T, matrix);
+  vertices_transform(A->matrix, A->rows, matrix);
+}
+
+/**
+ * @brief Compose transform
+ *
+ * Adds a batch of operations to the transform in their order. Resets are
+ * skipped, they only matter to the history.
+ *
+ * @param T Transform to update
+ * @param operations Operations to add
+ * @param count Number of operations
+ */
+void transform_compose(transform_t *T, const operation_t *operations,
+                       size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const operation_t *operation = &operations[i];
+    if (operation->type == OPERATION_MOVE) {
+      transform_move(T, operation->x, operation->y, operation->z);
+    } else if (operation->type == OPERATION_ROTATE) {
+      // нулевой поворот пропускается, чтобы не накапливать погрешность
+      if (operation->x != 0.0f) transform_rotate_by_ox(T, operation->x);
+      if (operation->y != 0.0f) transform_rotate_by_oy(T, operation->y);
+      if (operation->z != 0.0f) transform_rotate_by_oz(T, operation->z);
+    } else if (operation->type == OPERATION_SCALE) {
+      transform_scale(T, operation->x, operation->y, operation->z);
+    }
+  }
+}
+
+/**
+ * @brief Apply operations
+ *
+ * Composes a batch of operations into one matrix and applies it to the
+ * vertices in one pass instead of a pass per operation.
+ *
+ * @param A Object matrix
+ * @param operations Operations to apply
+ * @param count Number of operations
+ */
+void apply_operations(matrix_t *A, const operation_t *operations,
+                      size_t count) {
+  transform_t transform;
+  transform_reset(&transform);
+  transform_compose(&transform, operations, count);
+  transform_apply(&transform, A);
+}
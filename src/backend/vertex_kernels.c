@@ -0,0 +1,939 @@
+#include "backend.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Add scalar
+ *
+ * Adds an offset to every coordinate of vertices. Adding -0.0 keeps a
+ * coordinate unchanged bit by bit, so a move by one axis is an add with
+ * -0.0 for the other axes.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param offset Offsets by OX, OY and OZ
+ */
+static void add_scalar(float *vertices, size_t count, const float offset[3]) {
+  for (size_t i = 0; i < count; i++) {
+    vertices[i * 3] += offset[0];
+    vertices[i * 3 + 1] += offset[1];
+    vertices[i * 3 + 2] += offset[2];
+  }
+}
+
+/**
+ * @brief Multiply scalar
+ *
+ * Multiplies every coordinate of vertices by a scale, 1.0 keeps a
+ * coordinate unchanged.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param scale Scales by OX, OY and OZ
+ */
+static void multiply_scalar(float *vertices, size_t count,
+                            const float scale[3]) {
+  for (size_t i = 0; i < count; i++) {
+    vertices[i * 3] *= scale[0];
+    vertices[i * 3 + 1] *= scale[1];
+    vertices[i * 3 + 2] *= scale[2];
+  }
+}
+
+/**
+ * @brief Rotate scalar
+ *
+ * Rotates vertices in the plane of two axes: u = cosine * u - sine * w
+ * and w = sine * u + cosine * w.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param u First axis of the plane, 0 to 2
+ * @param w Second axis of the plane, 0 to 2
+ * @param cosine Cosine of the angle
+ * @param sine Sine of the angle
+ */
+static void rotate_scalar(float *vertices, size_t count, int u, int w,
+                          float cosine, float sine) {
+  for (size_t i = 0; i < count; i++) {
+    float *vertex = vertices + i * 3;
+    float temp_u = vertex[u];
+    float temp_w = vertex[w];
+    vertex[u] = cosine * temp_u - sine * temp_w;
+    vertex[w] = sine * temp_u + cosine * temp_w;
+  }
+}
+
+/**
+ * @brief Transform scalar
+ *
+ * Multiplies vertices by a 4x4 matrix stored by columns. Every SIMD kernel
+ * repeats the same order of operations, so all of them give equal results.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param m Matrix by columns
+ */
+static void transform_scalar(float *vertices, size_t count,
+                             const float m[16]) {
+  for (size_t i = 0; i < count; i++) {
+    float *vertex = vertices + i * 3;
+    float x = vertex[0], y = vertex[1], z = vertex[2];
+    vertex[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+    vertex[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+    vertex[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+  }
+}
+
+/**
+ * @brief Bounds scalar
+ *
+ * Grows a box to hold vertices. Coordinates that are not numbers are
+ * skipped.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param min Smallest coordinates by OX, OY and OZ, updated
+ * @param max Largest coordinates by OX, OY and OZ, updated
+ */
+static void bounds_scalar(const float *vertices, size_t count, float min[3],
+                          float max[3]) {
+  for (size_t i = 0; i < count; i++) {
+    const float *vertex = vertices + i * 3;
+    for (int k = 0; k < 3; k++) {
+      min[k] = vertex[k] < min[k] ? vertex[k] : min[k];
+      max[k] = vertex[k] > max[k] ? vertex[k] : max[k];
+    }
+  }
+}
+
+/**
+ * @brief Reduce lanes
+ *
+ * Adds minimums and maximums kept in SIMD lanes to a box. Lane i of the
+ * three stored registers holds coordinate i % 3 of the vertices.
+ *
+ * @param low Stored minimums of 3 * width lanes
+ * @param high Stored maximums of 3 * width lanes
+ * @param width Number of lanes in one register
+ * @param min Smallest coordinates by OX, OY and OZ, updated
+ * @param max Largest coordinates by OX, OY and OZ, updated
+ */
+static void reduce_lanes(const float *low, const float *high, int width,
+                         float min[3], float max[3]) {
+  for (int i = 0; i < 3 * width; i++) {
+    min[i % 3] = low[i] < min[i % 3] ? low[i] : min[i % 3];
+    max[i % 3] = high[i] > max[i % 3] ? high[i] : max[i % 3];
+  }
+}
+
+#if defined(KERNELS_X86)
+
+// ---------------------------------SSE2---------------------------------
+// четыре вершины занимают три регистра: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+
+/**
+ * @brief Split SSE2 block
+ *
+ * Rearranges three registers with four vertices into registers of X, Y and
+ * Z coordinates.
+ */
+__attribute__((target("sse2"))) static inline void split_sse2(
+    __m128 a, __m128 b, __m128 c, __m128 xyz[3]) {
+  __m128 q = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));
+  xyz[0] = _mm_shuffle_ps(a, q, _MM_SHUFFLE(2, 0, 3, 0));
+  xyz[1] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                          _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                          _MM_SHUFFLE(2, 0, 2, 0));
+  xyz[2] = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                          _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                          _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Join SSE2 block
+ *
+ * Rearranges registers of X, Y and Z coordinates back into three registers
+ * of four vertices.
+ */
+__attribute__((target("sse2"))) static inline void join_sse2(
+    const __m128 xyz[3], __m128 *a, __m128 *b, __m128 *c) {
+  __m128 x = xyz[0], y = xyz[1], z = xyz[2];
+  *a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                      _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                      _MM_SHUFFLE(2, 0, 2, 0));
+  *b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                      _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                      _MM_SHUFFLE(2, 0, 2, 0));
+  *c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                      _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                      _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Add SSE2
+ *
+ * Adds offsets to four vertices at a time, the rest as add_scalar.
+ */
+__attribute__((target("sse2"))) static void add_sse2(float *vertices,
+                                                     size_t count,
+                                                     const float offset[3]) {
+  const __m128 a = _mm_setr_ps(offset[0], offset[1], offset[2], offset[0]);
+  const __m128 b = _mm_setr_ps(offset[1], offset[2], offset[0], offset[1]);
+  const __m128 c = _mm_setr_ps(offset[2], offset[0], offset[1], offset[2]);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float *p = vertices + i * 3;
+    _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), a));
+    _mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), b));
+    _mm_storeu_ps(p + 8, _mm_add_ps(_mm_loadu_ps(p + 8), c));
+  }
+  add_scalar(vertices + i * 3, count - i, offset);
+}
+
+/**
+ * @brief Multiply SSE2
+ *
+ * Multiplies four vertices at a time, the rest as multiply_scalar.
+ */
+__attribute__((target("sse2"))) static void multiply_sse2(
+    float *vertices, size_t count, const float scale[3]) {
+  const __m128 a = _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]);
+  const __m128 b = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+  const __m128 c = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float *p = vertices + i * 3;
+    _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), a));
+    _mm_storeu_ps(p + 4, _mm_mul_ps(_mm_loadu_ps(p + 4), b));
+    _mm_storeu_ps(p + 8, _mm_mul_ps(_mm_loadu_ps(p + 8), c));
+  }
+  multiply_scalar(vertices + i * 3, count - i, scale);
+}
+
+/**
+ * @brief Rotate SSE2
+ *
+ * Rotates four vertices at a time, the rest as rotate_scalar.
+ */
+__attribute__((target("sse2"))) static void rotate_sse2(float *vertices,
+                                                        size_t count, int u,
+                                                        int w, float cosine,
+                                                        float sine) {
+  const __m128 c = _mm_set1_ps(cosine);
+  const __m128 s = _mm_set1_ps(sine);
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float *p = vertices + i * 3;
+    __m128 xyz[3];
+    split_sse2(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), xyz);
+    __m128 temp_u = xyz[u];
+    __m128 temp_w = xyz[w];
+    xyz[u] = _mm_sub_ps(_mm_mul_ps(c, temp_u), _mm_mul_ps(s, temp_w));
+    xyz[w] = _mm_add_ps(_mm_mul_ps(s, temp_u), _mm_mul_ps(c, temp_w));
+    __m128 a, b, d;
+    join_sse2(xyz, &a, &b, &d);
+    _mm_storeu_ps(p, a);
+    _mm_storeu_ps(p + 4, b);
+    _mm_storeu_ps(p + 8, d);
+  }
+  rotate_scalar(vertices + i * 3, count - i, u, w, cosine, sine);
+}
+
+/**
+ * @brief Transform SSE2
+ *
+ * Transforms four vertices at a time, the rest as transform_scalar.
+ */
+__attribute__((target("sse2"))) static void transform_sse2(float *vertices,
+                                                           size_t count,
+                                                           const float m[16]) {
+  size_t i = 0;
+
+  for (; i + 4 <= count; i += 4) {
+    float *p = vertices + i * 3;
+    __m128 xyz[3], out[3];
+    split_sse2(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), xyz);
+    for (int k = 0; k < 3; k++) {
+      __m128 sum = _mm_mul_ps(_mm_set1_ps(m[k]), xyz[0]);
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m[k + 4]), xyz[1]));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m[k + 8]), xyz[2]));
+      out[k] = _mm_add_ps(sum, _mm_set1_ps(m[k + 12]));
+    }
+    __m128 a, b, c;
+    join_sse2(out, &a, &b, &c);
+    _mm_storeu_ps(p, a);
+    _mm_storeu_ps(p + 4, b);
+    _mm_storeu_ps(p + 8, c);
+  }
+  transform_scalar(vertices + i * 3, count - i, m);
+}
+
+// ---------------------------------AVX2---------------------------------
+// каждая 128-битная половина регистра содержит блок из четырёх вершин SSE2
+
+/**
+ * @brief Load AVX2 block
+ *
+ * Loads eight vertices so that every half of the registers holds four
+ * consecutive vertices.
+ */
+__attribute__((target("avx2"))) static inline void load_avx2(const float *p,
+                                                             __m256 abc[3]) {
+  for (int k = 0; k < 3; k++) {
+    __m256 low = _mm256_castps128_ps256(_mm_loadu_ps(p + k * 4));
+    abc[k] = _mm256_insertf128_ps(low, _mm_loadu_ps(p + 12 + k * 4), 1);
+  }
+}
+
+/**
+ * @brief Store AVX2 block
+ *
+ * Stores eight vertices loaded by load_avx2.
+ */
+__attribute__((target("avx2"))) static inline void store_avx2(
+    float *p, const __m256 abc[3]) {
+  for (int k = 0; k < 3; k++) {
+    _mm_storeu_ps(p + k * 4, _mm256_castps256_ps128(abc[k]));
+    _mm_storeu_ps(p + 12 + k * 4, _mm256_extractf128_ps(abc[k], 1));
+  }
+}
+
+/**
+ * @brief Split AVX2 block
+ *
+ * Works as split_sse2 on every 128-bit part of the registers.
+ */
+__attribute__((target("avx2"))) static inline void split_avx2(
+    const __m256 abc[3], __m256 xyz[3]) {
+  __m256 a = abc[0], b = abc[1], c = abc[2];
+  __m256 q = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));
+  xyz[0] = _mm256_shuffle_ps(a, q, _MM_SHUFFLE(2, 0, 3, 0));
+  xyz[1] =
+      _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                        _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  xyz[2] =
+      _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                        _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Join AVX2 block
+ *
+ * Works as join_sse2 on every 128-bit part of the registers.
+ */
+__attribute__((target("avx2"))) static inline void join_avx2(
+    const __m256 xyz[3], __m256 abc[3]) {
+  __m256 x = xyz[0], y = xyz[1], z = xyz[2];
+  abc[0] =
+      _mm256_shuffle_ps(_mm256_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                        _mm256_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  abc[1] =
+      _mm256_shuffle_ps(_mm256_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                        _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  abc[2] =
+      _mm256_shuffle_ps(_mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                        _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Add AVX2
+ *
+ * Adds offsets to eight vertices at a time, the rest as add_scalar.
+ */
+__attribute__((target("avx2"))) static void add_avx2(float *vertices,
+                                                     size_t count,
+                                                     const float offset[3]) {
+  __m256 pattern[3];
+  for (int k = 0; k < 3; k++) {
+    float lanes[8];
+    for (int j = 0; j < 8; j++) lanes[j] = offset[(k * 8 + j) % 3];
+    pattern[k] = _mm256_loadu_ps(lanes);
+  }
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    float *p = vertices + i * 3;
+    for (int k = 0; k < 3; k++) {
+      __m256 v = _mm256_loadu_ps(p + k * 8);
+      _mm256_storeu_ps(p + k * 8, _mm256_add_ps(v, pattern[k]));
+    }
+  }
+  add_sse2(vertices + i * 3, count - i, offset);
+}
+
+/**
+ * @brief Multiply AVX2
+ *
+ * Multiplies eight vertices at a time, the rest as multiply_scalar.
+ */
+__attribute__((target("avx2"))) static void multiply_avx2(
+    float *vertices, size_t count, const float scale[3]) {
+  __m256 pattern[3];
+  for (int k = 0; k < 3; k++) {
+    float lanes[8];
+    for (int j = 0; j < 8; j++) lanes[j] = scale[(k * 8 + j) % 3];
+    pattern[k] = _mm256_loadu_ps(lanes);
+  }
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    float *p = vertices + i * 3;
+    for (int k = 0; k < 3; k++) {
+      __m256 v = _mm256_loadu_ps(p + k * 8);
+      _mm256_storeu_ps(p + k * 8, _mm256_mul_ps(v, pattern[k]));
+    }
+  }
+  multiply_sse2(vertices + i * 3, count - i, scale);
+}
+
+/**
+ * @brief Rotate AVX2
+ *
+ * Rotates eight vertices at a time, the rest as rotate_scalar.
+ */
+__attribute__((target("avx2"))) static void rotate_avx2(float *vertices,
+                                                        size_t count, int u,
+                                                        int w, float cosine,
+                                                        float sine) {
+  const __m256 c = _mm256_set1_ps(cosine);
+  const __m256 s = _mm256_set1_ps(sine);
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    float *p = vertices + i * 3;
+    __m256 abc[3], xyz[3];
+    load_avx2(p, abc);
+    split_avx2(abc, xyz);
+    __m256 temp_u = xyz[u];
+    __m256 temp_w = xyz[w];
+    xyz[u] = _mm256_sub_ps(_mm256_mul_ps(c, temp_u), _mm256_mul_ps(s, temp_w));
+    xyz[w] = _mm256_add_ps(_mm256_mul_ps(s, temp_u), _mm256_mul_ps(c, temp_w));
+    join_avx2(xyz, abc);
+    store_avx2(p, abc);
+  }
+  rotate_sse2(vertices + i * 3, count - i, u, w, cosine, sine);
+}
+
+/**
+ * @brief Transform AVX2
+ *
+ * Transforms eight vertices at a time, the rest as transform_scalar.
+ */
+__attribute__((target("avx2"))) static void transform_avx2(float *vertices,
+                                                           size_t count,
+                                                           const float m[16]) {
+  size_t i = 0;
+
+  for (; i + 8 <= count; i += 8) {
+    float *p = vertices + i * 3;
+    __m256 abc[3], xyz[3], out[3];
+    load_avx2(p, abc);
+    split_avx2(abc, xyz);
+    for (int k = 0; k < 3; k++) {
+      __m256 sum = _mm256_mul_ps(_mm256_set1_ps(m[k]), xyz[0]);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(m[k + 4]), xyz[1]));
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(m[k + 8]), xyz[2]));
+      out[k] = _mm256_add_ps(sum, _mm256_set1_ps(m[k + 12]));
+    }
+    join_avx2(out, abc);
+    store_avx2(p, abc);
+  }
+  transform_sse2(vertices + i * 3, count - i, m);
+}
+
+// --------------------------------AVX-512-------------------------------
+// каждая 128-битная четверть регистра содержит блок из четырёх вершин SSE2
+
+/**
+ * @brief Load AVX-512 block
+ *
+ * Loads sixteen vertices so that every quarter of the registers holds four
+ * consecutive vertices.
+ */
+__attribute__((target("avx512f"))) static inline void load_avx512(
+    const float *p, __m512 abc[3]) {
+  for (int k = 0; k < 3; k++) {
+    __m512 v = _mm512_castps128_ps512(_mm_loadu_ps(p + k * 4));
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(p + 12 + k * 4), 1);
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(p + 24 + k * 4), 2);
+    abc[k] = _mm512_insertf32x4(v, _mm_loadu_ps(p + 36 + k * 4), 3);
+  }
+}
+
+/**
+ * @brief Store AVX-512 block
+ *
+ * Stores sixteen vertices loaded by load_avx512.
+ */
+__attribute__((target("avx512f"))) static inline void store_avx512(
+    float *p, const __m512 abc[3]) {
+  for (int k = 0; k < 3; k++) {
+    _mm_storeu_ps(p + k * 4, _mm512_castps512_ps128(abc[k]));
+    _mm_storeu_ps(p + 12 + k * 4, _mm512_extractf32x4_ps(abc[k], 1));
+    _mm_storeu_ps(p + 24 + k * 4, _mm512_extractf32x4_ps(abc[k], 2));
+    _mm_storeu_ps(p + 36 + k * 4, _mm512_extractf32x4_ps(abc[k], 3));
+  }
+}
+
+/**
+ * @brief Split AVX-512 block
+ *
+ * Works as split_sse2 on every 128-bit part of the registers.
+ */
+__attribute__((target("avx512f"))) static inline void split_avx512(
+    const __m512 abc[3], __m512 xyz[3]) {
+  __m512 a = abc[0], b = abc[1], c = abc[2];
+  __m512 q = _mm512_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2));
+  xyz[0] = _mm512_shuffle_ps(a, q, _MM_SHUFFLE(2, 0, 3, 0));
+  xyz[1] =
+      _mm512_shuffle_ps(_mm512_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                        _mm512_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  xyz[2] =
+      _mm512_shuffle_ps(_mm512_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                        _mm512_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Join AVX-512 block
+ *
+ * Works as join_sse2 on every 128-bit part of the registers.
+ */
+__attribute__((target("avx512f"))) static inline void join_avx512(
+    const __m512 xyz[3], __m512 abc[3]) {
+  __m512 x = xyz[0], y = xyz[1], z = xyz[2];
+  abc[0] =
+      _mm512_shuffle_ps(_mm512_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                        _mm512_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  abc[1] =
+      _mm512_shuffle_ps(_mm512_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                        _mm512_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+  abc[2] =
+      _mm512_shuffle_ps(_mm512_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                        _mm512_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                        _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/**
+ * @brief Add AVX-512
+ *
+ * Adds offsets to sixteen vertices at a time, the rest as add_scalar.
+ */
+__attribute__((target("avx512f"))) static void add_avx512(
+    float *vertices, size_t count, const float offset[3]) {
+  __m512 pattern[3];
+  for (int k = 0; k < 3; k++) {
+    float lanes[16];
+    for (int j = 0; j < 16; j++) lanes[j] = offset[(k * 16 + j) % 3];
+    pattern[k] = _mm512_loadu_ps(lanes);
+  }
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    float *p = vertices + i * 3;
+    for (int k = 0; k < 3; k++) {
+      __m512 v = _mm512_loadu_ps(p + k * 16);
+      _mm512_storeu_ps(p + k * 16, _mm512_add_ps(v, pattern[k]));
+    }
+  }
+  add_sse2(vertices + i * 3, count - i, offset);
+}
+
+/**
+ * @brief Multiply AVX-512
+ *
+ * Multiplies sixteen vertices at a time, the rest as multiply_scalar.
+ */
+__attribute__((target("avx512f"))) static void multiply_avx512(
+    float *vertices, size_t count, const float scale[3]) {
+  __m512 pattern[3];
+  for (int k = 0; k < 3; k++) {
+    float lanes[16];
+    for (int j = 0; j < 16; j++) lanes[j] = scale[(k * 16 + j) % 3];
+    pattern[k] = _mm512_loadu_ps(lanes);
+  }
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    float *p = vertices + i * 3;
+    for (int k = 0; k < 3; k++) {
+      __m512 v = _mm512_loadu_ps(p + k * 16);
+      _mm512_storeu_ps(p + k * 16, _mm512_mul_ps(v, pattern[k]));
+    }
+  }
+  multiply_sse2(vertices + i * 3, count - i, scale);
+}
+
+/**
+ * @brief Rotate AVX-512
+ *
+ * Rotates sixteen vertices at a time, the rest as rotate_scalar.
+ */
+__attribute__((target("avx512f"))) static void rotate_avx512(
+    float *vertices, size_t count, int u, int w, float cosine, float sine) {
+  const __m512 c = _mm512_set1_ps(cosine);
+  const __m512 s = _mm512_set1_ps(sine);
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    float *p = vertices + i * 3;
+    __m512 abc[3], xyz[3];
+    load_avx512(p, abc);
+    split_avx512(abc, xyz);
+    __m512 temp_u = xyz[u];
+    __m512 temp_w = xyz[w];
+    xyz[u] = _mm512_sub_ps(_mm512_mul_ps(c, temp_u), _mm512_mul_ps(s, temp_w));
+    xyz[w] = _mm512_add_ps(_mm512_mul_ps(s, temp_u), _mm512_mul_ps(c, temp_w));
+    join_avx512(xyz, abc);
+    store_avx512(p, abc);
+  }
+  rotate_sse2(vertices + i * 3, count - i, u, w, cosine, sine);
+}
+
+/**
+ * @brief Transform AVX-512
+ *
+ * Transforms sixteen vertices at a time, the rest as transform_scalar.
+ */
+__attribute__((target("avx512f"))) static void transform_avx512(
+    float *vertices, size_t count, const float m[16]) {
+  size_t i = 0;
+
+  for (; i + 16 <= count; i += 16) {
+    float *p = vertices + i * 3;
+    __m512 abc[3], xyz[3], out[3];
+    load_avx512(p, abc);
+    split_avx512(abc, xyz);
+    for (int k = 0; k < 3; k++) {
+      __m512 sum = _mm512_mul_ps(_mm512_set1_ps(m[k]), xyz[0]);
+      sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(m[k + 4]), xyz[1]));
+      sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_set1_ps(m[k + 8]), xyz[2]));
+      out[k] = _mm512_add_ps(sum, _mm512_set1_ps(m[k + 12]));
+    }
+    join_avx512(out, abc);
+    store_avx512(p, abc);
+  }
+  transform_sse2(vertices + i * 3, count - i, m);
+}
+
+/**
+ * @brief Bounds SSE2
+ *
+ * Grows a box by four vertices at a time. The registers are not split into
+ * coordinates: every lane keeps the minimum and maximum of its own axis.
+ */
+__attribute__((target("sse2"))) static void bounds_sse2(
+    const float *vertices, size_t count, float min[3], float max[3]) {
+  size_t i = 0;
+
+  if (count >= 4) {
+    __m128 low[3], high[3];
+    for (int k = 0; k < 3; k++) {
+      float lanes_min[4], lanes_max[4];
+      for (int j = 0; j < 4; j++) {
+        lanes_min[j] = min[(k * 4 + j) % 3];
+        lanes_max[j] = max[(k * 4 + j) % 3];
+      }
+      low[k] = _mm_loadu_ps(lanes_min);
+      high[k] = _mm_loadu_ps(lanes_max);
+    }
+
+    for (; i + 4 <= count; i += 4) {
+      const float *p = vertices + i * 3;
+      for (int k = 0; k < 3; k++) {
+        __m128 v = _mm_loadu_ps(p + k * 4);
+        // v < low ? v : low, как в bounds_scalar
+        low[k] = _mm_min_ps(v, low[k]);
+        high[k] = _mm_max_ps(v, high[k]);
+      }
+    }
+
+    float stored_low[12], stored_high[12];
+    for (int k = 0; k < 3; k++) {
+      _mm_storeu_ps(stored_low + k * 4, low[k]);
+      _mm_storeu_ps(stored_high + k * 4, high[k]);
+    }
+    reduce_lanes(stored_low, stored_high, 4, min, max);
+  }
+  bounds_scalar(vertices + i * 3, count - i, min, max);
+}
+
+/**
+ * @brief Bounds AVX2
+ *
+ * Grows a box by eight vertices at a time, the rest as bounds_sse2.
+ */
+__attribute__((target("avx2"))) static void bounds_avx2(const float *vertices,
+                                                        size_t count,
+                                                        float min[3],
+                                                        float max[3]) {
+  size_t i = 0;
+
+  if (count >= 8) {
+    __m256 low[3], high[3];
+    for (int k = 0; k < 3; k++) {
+      float lanes_min[8], lanes_max[8];
+      for (int j = 0; j < 8; j++) {
+        lanes_min[j] = min[(k * 8 + j) % 3];
+        lanes_max[j] = max[(k * 8 + j) % 3];
+      }
+      low[k] = _mm256_loadu_ps(lanes_min);
+      high[k] = _mm256_loadu_ps(lanes_max);
+    }
+
+    for (; i + 8 <= count; i += 8) {
+      const float *p = vertices + i * 3;
+      for (int k = 0; k < 3; k++) {
+        __m256 v = _mm256_loadu_ps(p + k * 8);
+        low[k] = _mm256_min_ps(v, low[k]);
+        high[k] = _mm256_max_ps(v, high[k]);
+      }
+    }
+
+    float stored_low[24], stored_high[24];
+    for (int k = 0; k < 3; k++) {
+      _mm256_storeu_ps(stored_low + k * 8, low[k]);
+      _mm256_storeu_ps(stored_high + k * 8, high[k]);
+    }
+    reduce_lanes(stored_low, stored_high, 8, min, max);
+  }
+  bounds_sse2(vertices + i * 3, count - i, min, max);
+}
+
+/**
+ * @brief Bounds AVX-512
+ *
+ * Grows a box by sixteen vertices at a time, the rest as bounds_sse2.
+ */
+__attribute__((target("avx512f"))) static void bounds_avx512(
+    const float *vertices, size_t count, float min[3], float max[3]) {
+  size_t i = 0;
+
+  if (count >= 16) {
+    __m512 low[3], high[3];
+    for (int k = 0; k < 3; k++) {
+      float lanes_min[16], lanes_max[16];
+      for (int j = 0; j < 16; j++) {
+        lanes_min[j] = min[(k * 16 + j) % 3];
+        lanes_max[j] = max[(k * 16 + j) % 3];
+      }
+      low[k] = _mm512_loadu_ps(lanes_min);
+      high[k] = _mm512_loadu_ps(lanes_max);
+    }
+
+    for (; i + 16 <= count; i += 16) {
+      const float *p = vertices + i * 3;
+      for (int k = 0; k < 3; k++) {
+        __m512 v = _mm512_loadu_ps(p + k * 16);
+        low[k] = _mm512_min_ps(v, low[k]);
+        high[k] = _mm512_max_ps(v, high[k]);
+      }
+    }
+
+    float stored_low[48], stored_high[48];
+    for (int k = 0; k < 3; k++) {
+      _mm512_storeu_ps(stored_low + k * 16, low[k]);
+      _mm512_storeu_ps(stored_high + k * 16, high[k]);
+    }
+    reduce_lanes(stored_low, stored_high, 16, min, max);
+  }
+  bounds_sse2(vertices + i * 3, count - i, min, max);
+}
+
+#endif  // KERNELS_X86
+
+static const vertex_kernels_t kernels[KERNELS_COUNT] = {
+    {"scalar", add_scalar, multiply_scalar, rotate_scalar, transform_scalar,
+     bounds_scalar},
+#if defined(KERNELS_X86)
+    {"sse2", add_sse2, multiply_sse2, rotate_sse2, transform_sse2,
+     bounds_sse2},
+    {"avx2", add_avx2, multiply_avx2, rotate_avx2, transform_avx2,
+     bounds_avx2},
+    {"avx512", add_avx512, multiply_avx512, rotate_avx512, transform_avx512,
+     bounds_avx512},
+#endif
+};
+
+/**
+ * @brief Kernels by level
+ *
+ * Returns kernels of the given instruction set if the processor and the
+ * operating system support it, checked with CPUID.
+ *
+ * @param level One of KERNELS_SCALAR, KERNELS_SSE2, KERNELS_AVX2 and
+ * KERNELS_AVX512
+ *
+ * @return Kernels or NULL if they are not supported
+ */
+const vertex_kernels_t *vertex_kernels_by_level(int level) {
+  int supported = level == KERNELS_SCALAR;
+
+#if defined(KERNELS_X86)
+  __builtin_cpu_init();
+  if (level == KERNELS_SSE2) supported = __builtin_cpu_supports("sse2");
+  if (level == KERNELS_AVX2) supported = __builtin_cpu_supports("avx2");
+  if (level == KERNELS_AVX512) supported = __builtin_cpu_supports("avx512f");
+#endif
+
+  return supported ? &kernels[level] : NULL;
+}
+
+/**
+ * @brief Vertex kernels
+ *
+ * Returns kernels of the widest instruction set the processor supports.
+ * The choice is made on the first call.
+ */
+const vertex_kernels_t *vertex_kernels(void) {
+  static const vertex_kernels_t *selected = NULL;
+  const vertex_kernels_t *result =
+      __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+
+  if (result == NULL) {
+    for (int level = KERNELS_COUNT - 1; result == NULL && level >= 0;
+         level--) {
+      result = vertex_kernels_by_level(level);
+    }
+    __atomic_store_n(&selected, result, __ATOMIC_RELEASE);
+  }
+
+  return result;
+}
+
+// ядро, вызываемое циклом по вершинам
+#define VERTEX_ADD 0
+#define VERTEX_MULTIPLY 1
+#define VERTEX_ROTATE 2
+#define VERTEX_TRANSFORM 3
+
+/**
+ * @brief Vertex loop
+ *
+ * Arguments of one kernel call split between the pool threads.
+ *
+ * @param kernel Kernel to call, one of VERTEX_ADD, VERTEX_MULTIPLY,
+ * VERTEX_ROTATE and VERTEX_TRANSFORM
+ * @param vertices Coordinates of all vertices
+ * @param values Offsets, scales or the matrix of the kernel
+ * @param u First axis of the rotation plane
+ * @param w Second axis of the rotation plane
+ * @param cosine Cosine of the rotation angle
+ * @param sine Sine of the rotation angle
+ */
+typedef struct VertexLoop_ {
+  int kernel;
+  float *vertices;
+  const float *values;
+  int u;
+  int w;
+  float cosine;
+  float sine;
+} vertex_loop_t;
+
+/**
+ * @brief Run vertex range
+ *
+ * Calls the kernel of the loop for vertices from begin to end, body of
+ * pool_parallel_for.
+ *
+ * @param arg Vertex loop
+ * @param begin First vertex
+ * @param end Vertex after the last one
+ */
+static void run_vertex_range(void *arg, size_t begin, size_t end) {
+  const vertex_loop_t *loop = arg;
+  const vertex_kernels_t *selected = vertex_kernels();
+  float *vertices = loop->vertices + begin * 3;
+  size_t count = end - begin;
+
+  if (loop->kernel == VERTEX_ADD) {
+    selected->add(vertices, count, loop->values);
+  } else if (loop->kernel == VERTEX_MULTIPLY) {
+    selected->multiply(vertices, count, loop->values);
+  } else if (loop->kernel == VERTEX_ROTATE) {
+    selected->rotate(vertices, count, loop->u, loop->w, loop->cosine,
+                     loop->sine);
+  } else {
+    selected->transform(vertices, count, loop->values);
+  }
+}
+
+/**
+ * @brief Add to vertices
+ *
+ * Same as the add kernel, large buffers are split between the pool threads.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param offsets Offsets by OX, OY and OZ
+ */
+void vertices_add(float *vertices, size_t count, const float offsets[3]) {
+  vertex_loop_t loop = {VERTEX_ADD, vertices, offsets, 0, 0, 0.0f, 0.0f};
+  pool_parallel_for(count, VERTEX_PARALLEL_MIN, run_vertex_range, &loop);
+}
+
+/**
+ * @brief Multiply vertices
+ *
+ * Same as the multiply kernel, large buffers are split between the pool
+ * threads.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param scales Scales by OX, OY and OZ
+ */
+void vertices_multiply(float *vertices, size_t count, const float scales[3]) {
+  vertex_loop_t loop = {VERTEX_MULTIPLY, vertices, scales, 0, 0, 0.0f, 0.0f};
+  pool_parallel_for(count, VERTEX_PARALLEL_MIN, run_vertex_range, &loop);
+}
+
+/**
+ * @brief Rotate vertices
+ *
+ * Same as the rotate kernel, large buffers are split between the pool
+ * threads.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param u First axis of the rotation plane
+ * @param w Second axis of the rotation plane
+ * @param cosine Cosine of the rotation angle
+ * @param sine Sine of the rotation angle
+ */
+void vertices_rotate(float *vertices, size_t count, int u, int w,
+                     float cosine, float sine) {
+  vertex_loop_t loop = {VERTEX_ROTATE, vertices, NULL, u, w, cosine, sine};
+  pool_parallel_for(count, VERTEX_PARALLEL_MIN, run_vertex_range, &loop);
+}
+
+/**
+ * @brief Transform vertices
+ *
+ * Same as the transform kernel, large buffers are split between the pool
+ * threads.
+ *
+ * @param vertices Coordinates of count vertices, three floats each
+ * @param count Number of vertices
+ * @param matrix 4x4 matrix stored by columns
+ */
+void vertices_transform(float *vertices, size_t count,
+                        const float matrix[16]) {
+  vertex_loop_t loop = {VERTEX_TRANSFORM, vertices, matrix, 0, 0, 0.0f, 0.0f};
+  pool_parallel_for(count, VERTEX_PARALLEL_MIN, run_vertex_range, &loop);
+}
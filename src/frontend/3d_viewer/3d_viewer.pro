@@ -2,7 +2,7 @@ QT       += core gui
 include(./QtGifImage/src/gifimage/qtgifimage.pri)
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 lessThan(QT_MAJOR_VERSION, 6): QT += opengl
-greaterThan(QT_MAJOR_VERSION, 5): QT += openglwidgets
+greaterThan(QT_MAJOR_VERSION, 5): QT += opengl openglwidgets
 
 CONFIG += c++17
 
@@ -12,7 +12,19 @@ CONFIG += c++17
 
 SOURCES += \
     ../../backend/affine.c \
+    ../../backend/bounds.c \
+    ../../backend/bvh.c \
+    ../../backend/camera.c \
+    ../../backend/edges.c \
+    ../../backend/history.c \
+    ../../backend/lod.c \
+    ../../backend/meshlets.c \
+    ../../backend/mesh_cache.c \
+    ../../backend/number_parser.c \
     ../../backend/obj_file_work.c \
+    ../../backend/thread_pool.c \
+    ../../backend/transform.c \
+    ../../backend/vertex_kernels.c \
     glwidget.cpp \
     main.cpp \
     mainwindow.cpp
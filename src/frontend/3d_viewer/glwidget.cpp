@@ -1,200 +1,1409 @@
 #include "glwidget.h"
 
+#include <QLoggingCategory>
+#include <QVector4D>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 // файл для работы с openGLWidget
 
+// задержка ввода, включается QT_LOGGING_RULES="viewer.latency.debug=true"
+Q_LOGGING_CATEGORY(latencyLog, "viewer.latency", QtWarningMsg)
+// нарисованный уровень детализации, включается "viewer.lod.debug=true"
+Q_LOGGING_CATEGORY(lodLog, "viewer.lod", QtWarningMsg)
+
+/**
+ * @brief Buffer limit
+ *
+ * Size of video card buffers in bytes above which they are treated as not
+ * allocated, set by VIEWER_BUFFER_LIMIT_MB to check drawing without them.
+ *
+ * @return Limit in bytes, 0 if there is none
+ */
+static GLsizeiptr bufferLimit() {
+  static const GLsizeiptr limit =
+      (GLsizeiptr)qEnvironmentVariableIntValue("VIEWER_BUFFER_LIMIT_MB") << 20;
+  return limit;
+}
+
 GLWidget::GLWidget(QWidget *parent)
     : QOpenGLWidget{parent}, infoLabel(new QLabel(this)) {
   // Настройка позиции и размеров QLabel
-  infoLabel->setGeometry(10, 10, 700, 50);
+  infoLabel->setGeometry(10, 10, 700, 70);
   infoLabel->hide();
+  transform_reset(&transform);
+  camera_reset(&camera);
+
+  connect(&progressTimer, &QTimer::timeout, this, [this]() {
+    emit loadingProgress(qRound(progress_fraction(&loadProgress) * 100.0));
+  });
+  // предпросмотр загружаемого объекта
+  connect(&previewTimer, &QTimer::timeout, this,
+          static_cast<void (QWidget::*)()>(&QWidget::update));
+  // после паузы во вводе объект рисуется полностью
+  idleTimer.setSingleShot(true);
+  idleTimer.setInterval(IDLE_DELAY_MS);
+  connect(&idleTimer, &QTimer::timeout, this, [this]() {
+    interacting = false;
+    update();
+  });
+  // кадр с учётом ввода показан
+  connect(this, &QOpenGLWidget::frameSwapped, this, [this]() {
+    if (inputPending) {
+      inputPending = false;
+      double latency = inputClock.nsecsElapsed() / 1e6;
+      latencySum += latency;
+      latencyFrames++;
+      qCDebug(latencyLog, "input to frame %.2f ms, average %.2f ms", latency,
+              latencySum / latencyFrames);
+    }
+  });
+}
+
+GLWidget::~GLWidget() {
+  // окно уже удаляется, о прерванной загрузке сообщать некому
+  stopLoading();
+  cancelLevels();
+  makeCurrent();
+  releaseBuffers();
+  if (streamVertices != 0) glDeleteBuffers(1, &streamVertices);
+  if (streamIndices != 0) glDeleteBuffers(1, &streamIndices);
+  bvh_ranges_free(&visibleEdges);
+  bvh_ranges_free(&boundaryEdges);
+  vertexArray.destroy();
+  frameQuery.destroy();
+  program.removeAllShaders();
+  lineProgram.removeAllShaders();
+  doneCurrent();
+}
+
+// вершины переводятся в окно, позиции в пикселях нужны для штриха
+static const char *vertexShaderSource = R"(#version 330 core
+layout(location = 0) in vec3 vertex;
+uniform mat4 mvp;
+uniform float pointSize;
+uniform vec2 viewport;
+out Vertex {
+  flat vec2 lineStart;
+  noperspective vec2 pixel;
+} vertexOut;
+
+void main() {
+  gl_Position = mvp * vec4(vertex, 1.0);
+  gl_PointSize = pointSize;
+  vertexOut.pixel = (gl_Position.xy / gl_Position.w * 0.5 + 0.5) * viewport;
+  vertexOut.lineStart = vertexOut.pixel;
+}
+)";
+
+// линия становится прямоугольником заданной ширины в пикселях, так как
+// core profile рисует линии толщиной только в один пиксель; отрезок сначала
+// обрезается ближней плоскостью, чтобы перевести его концы в окно
+static const char *geometryShaderSource = R"(#version 330 core
+layout(lines) in;
+layout(triangle_strip, max_vertices = 4) out;
+uniform vec2 viewport;
+uniform float lineWidth;
+in Vertex {
+  flat vec2 lineStart;
+  noperspective vec2 pixel;
+} vertexIn[];
+out Vertex {
+  flat vec2 lineStart;
+  noperspective vec2 pixel;
+} lineOut;
+
+void main() {
+  vec4 from = gl_in[0].gl_Position;
+  vec4 to = gl_in[1].gl_Position;
+  float nearFrom = from.z + from.w, nearTo = to.z + to.w;
+  if (nearFrom < 0.0 && nearTo < 0.0) return;
+  if (nearFrom < 0.0) from = mix(from, to, nearFrom / (nearFrom - nearTo));
+  if (nearTo < 0.0) to = mix(to, from, nearTo / (nearTo - nearFrom));
+
+  vec2 start = (from.xy / from.w * 0.5 + 0.5) * viewport;
+  vec2 end = (to.xy / to.w * 0.5 + 0.5) * viewport;
+  vec2 direction = end - start;
+  direction = dot(direction, direction) > 1e-12 ? normalize(direction)
+                                                : vec2(1.0, 0.0);
+  // половина ширины поперёк линии в координатах отсечения
+  vec2 side = vec2(-direction.y, direction.x) * max(lineWidth, 1.0) /
+              viewport;
+
+  lineOut.lineStart = start;
+  lineOut.pixel = start;
+  gl_Position = from + vec4(side * from.w, 0.0, 0.0);
+  EmitVertex();
+  lineOut.lineStart = start;
+  lineOut.pixel = start;
+  gl_Position = from - vec4(side * from.w, 0.0, 0.0);
+  EmitVertex();
+  lineOut.lineStart = start;
+  lineOut.pixel = end;
+  gl_Position = to + vec4(side * to.w, 0.0, 0.0);
+  EmitVertex();
+  lineOut.lineStart = start;
+  lineOut.pixel = end;
+  gl_Position = to - vec4(side * to.w, 0.0, 0.0);
+  EmitVertex();
+  EndPrimitive();
 }
+)";
+
+// стиль 1 - круглые точки, 2 - штрих по 8 пикселей, как 0xFF00 у glLineStipple;
+// как и там, узор начинается заново на каждом ребре, поэтому рёбра короче
+// 8 пикселей в пунктире не видны
+static const char *fragmentShaderSource = R"(#version 330 core
+uniform vec4 color;
+uniform int style;
+in Vertex {
+  flat vec2 lineStart;
+  noperspective vec2 pixel;
+} fragmentIn;
+out vec4 fragment;
+
+void main() {
+  if (style == 1 && length(gl_PointCoord - vec2(0.5)) > 0.5) discard;
+  if (style == 2 &&
+      mod(distance(fragmentIn.pixel, fragmentIn.lineStart), 16.0) < 8.0) {
+    discard;
+  }
+  fragment = color;
+}
+)";
 
 /**
  * @brief Initialize the window
  *
- * Initialize openGL window.
+ * Initialize openGL window: compiles shaders that place vertices by the
+ * model-view-projection matrix and draw styles of points and lines, and
+ * creates the vertex array object required by the core profile. Lines are
+ * drawn by their own program that widens them into rectangles.
  */
-void GLWidget::initializeGL() {}
+void GLWidget::initializeGL() {
+  initializeOpenGLFunctions();
+
+  if (!program.addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                       vertexShaderSource) ||
+      !program.addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                       fragmentShaderSource) ||
+      !program.link()) {
+    qWarning() << "Failed to build shaders:" << program.log();
+  }
+  mvpLocation = program.uniformLocation("mvp");
+  pointSizeLocation = program.uniformLocation("pointSize");
+  viewportLocation = program.uniformLocation("viewport");
+  colorLocation = program.uniformLocation("color");
+  styleLocation = program.uniformLocation("style");
+
+  if (!lineProgram.addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                           vertexShaderSource) ||
+      !lineProgram.addShaderFromSourceCode(QOpenGLShader::Geometry,
+                                           geometryShaderSource) ||
+      !lineProgram.addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                           fragmentShaderSource) ||
+      !lineProgram.link()) {
+    qWarning() << "Failed to build line shaders:" << lineProgram.log();
+  }
+  lineMvpLocation = lineProgram.uniformLocation("mvp");
+  lineViewportLocation = lineProgram.uniformLocation("viewport");
+  lineWidthLocation = lineProgram.uniformLocation("lineWidth");
+  lineColorLocation = lineProgram.uniformLocation("color");
+  lineStyleLocation = lineProgram.uniformLocation("style");
+
+  vertexArray.create();
+  // без запросов времени объект во время движения не упрощается
+  frameQuery.create();
+  // размер точки задаёт вершинный шейдер
+  glEnable(GL_PROGRAM_POINT_SIZE);
+}
 
 /**
  * @brief Painting widget
  *
- * Rendering happens here.
+ * Rendering happens here. All matrices are multiplied into one
+ * model-view-projection matrix once per frame, vertices are transformed by
+ * the video card.
  */
 void GLWidget::paintGL() {
+  // ввод, накопленный с прошлого кадра, применяется один раз
+  emit frameStarting();
+
   glClearColor(bgColorArr[0] / 255.0f, bgColorArr[1] / 255.0f,
                bgColorArr[2] / 255.0f, 1);
-  glClear(GL_COLOR_BUFFER_BIT);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (!program.isLinked() || !lineProgram.isLinked()) return;
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
+  // та же проекция, что строилась функциями glOrtho и glFrustum
+  QMatrix4x4 view;
   if (projectionMode == PARALLEL) {
-    glOrtho(1.0f, -1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+    view.ortho(1.0f, -1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
   } else {
-    glFrustum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 10.0f);
-    glTranslatef(0.0f, 0.0f, -2.0f);
-    glRotatef(180, 0, 1, 0);
-    glRotatef(-15, 1, 0, 0);
-    glScalef(1.2, 1.2, 1.2);
+    view.frustum(-1.0f, 1.0f, -1.0f, 1.0f, 1.0f, 10.0f);
+    view.translate(0.0f, 0.0f, -2.0f);
+    view.rotate(180, 0, 1, 0);
+    view.rotate(-15, 1, 0, 0);
+    view.scale(1.2f);
+  }
+  // камера мыши применяется после преобразования объекта
+  GLfloat cameraMatrix[16];
+  camera_matrix(&camera, cameraMatrix);
+  view *= columnMatrix(cameraMatrix);
+
+  // программа точек или линий выбирается стилем перед рисованием
+  vertexArray.bind();
+  glEnableVertexAttribArray(0);
+  qreal ratio = devicePixelRatioF();
+  viewportSize = QVector2D(width() * ratio, height() * ratio);
+
+  // пока файл загружается, рисуется уже разобранная часть
+  if (loader != nullptr && progress_acquire_partial(&loadProgress, &preview)) {
+    drawPreview(view);
+    progress_release_partial(&loadProgress);
+  } else if (data.obj_matrix.matrix != NULL) {
+    // без буферов объект передаётся видеокарте на каждом кадре
+    bool retained = uploadGeometry();
+    // вершины не меняются, преобразование применяет видеокарта
+    GLfloat model[16];
+    transform_matrix(&transform, model);
+    objectMvp = view * columnMatrix(model) * columnMatrix(viewFit);
+    drawMvp = objectMvp;
+
+    // без списка рёбер полигоны рисуются со всеми общими сторонами
+    size_t objectPrimitives =
+        data.obj_matrix.rows + (data.obj_edges.indices != NULL
+                                    ? data.obj_edges.count_of_edges
+                                    : data.obj_facets.count_of_indices);
+    // детали меньше пикселя не видны, рисуется упрощённый объект
+    size_t level =
+        lod_select(&data.obj_lod, pixelsPerUnit(model), lodPixelError);
+    // у уровней нет граней, невидимые линии рисуются по самому объекту
+    size_t drawn = hiddenLines ? 0 : interactiveLevel(level, objectPrimitives);
+
+    measureFrame();
+    bool timed = frameQuery.isCreated() && !frameQueryPending;
+    if (timed) frameQuery.begin();
+    size_t primitives = objectPrimitives;
+    if (drawn != 0 && uploadLevel(drawn)) {
+      const lod_t &lod = data.obj_lod.levels[drawn - 1];
+      glBindBuffer(GL_ARRAY_BUFFER, levelBuffers[drawn - 1][0]);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, levelBuffers[drawn - 1][1]);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+      drawVertices(lod.vertices.rows);
+      setEdgeStyle();
+      drawEdges(lod.edges.count_of_edges);
+      primitives = lod.vertices.rows + lod.edges.count_of_edges;
+    } else {
+      // смещения вместо указателей отсчитываются от начала буферов
+      drawn = 0;
+      if (retained) {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+      } else {
+        streamGeometry();
+      }
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+      // грани закрывают вершины и рёбра за собой
+      bool hidden = hiddenLines && drawSurface();
+      drawVertices(data.obj_matrix.rows);
+      primitives = data.obj_matrix.rows + drawFacets(objectMvp, hidden);
+      if (hidden) glDisable(GL_DEPTH_TEST);
+    }
+    if (timed) {
+      frameQuery.end();
+      frameQueryPending = true;
+      queriedPrimitives = primitives;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    showDetail(drawn, drawn > level);
   }
 
-  drawVertices();
-  drawFacets();
+  glDisableVertexAttribArray(0);
+  vertexArray.release();
+  program.release();
 }
 
 /**
- * @brief Draw vertices
+ * @brief Column matrix
  *
- * Draws vertices of the object.
+ * Wraps a 4x4 matrix stored by columns, as the backend and OpenGL keep them.
+ *
+ * @param values 16 values by columns
+ *
+ * @return The same matrix
+ */
+QMatrix4x4 GLWidget::columnMatrix(const GLfloat values[16]) {
+  // конструктор QMatrix4x4 принимает значения по строкам
+  return QMatrix4x4(values).transposed();
+}
+
+/**
+ * @brief Upload geometry
+ *
+ * Copies vertices and edges into buffers of the video card when they have
+ * changed since the last frame. The immediate renderer copies them on every
+ * frame, as the core profile draws only from buffers. If the buffers can
+ * not be allocated, the object is streamed on every frame instead until
+ * another object is loaded.
+ *
+ * @return True if the buffers can be drawn, false to stream the object
  */
-void GLWidget::drawVertices() {
-  if (vertexMode == ROUND) {
-    glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
-    glEnable(GL_POINT_SMOOTH);
-  } else {  // SQUARE
-    glDisable(GL_POINT_SMOOTH);
+bool GLWidget::uploadGeometry() {
+  if (buffersFailed) return false;
+  GLsizeiptr vertexBytes = (GLsizeiptr)(data.obj_matrix.rows *
+                                        data.obj_matrix.cols * sizeof(GLfloat));
+  GLsizeiptr edgeBytes =
+      (GLsizeiptr)(data.obj_edges.count_of_edges * 2 * sizeof(GLuint));
+  GLsizeiptr limit = bufferLimit();
+  if (limit != 0 && (vertexBytes > limit || edgeBytes > limit)) {
+    qWarning() << "Object exceeds VIEWER_BUFFER_LIMIT_MB, it is streamed";
+    buffersFailed = true;
+    releaseBuffers();
+    return false;
+  }
+
+  if (vertexBuffer == 0) glGenBuffers(1, &vertexBuffer);
+  if (edgeBuffer == 0) glGenBuffers(1, &edgeBuffer);
+  // ошибки прошлых вызовов не относятся к загрузке буферов
+  for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++) {
   }
 
-  glPointSize(vertexSize);
-  glColor3ub(vertexColorArr[0], vertexColorArr[1], vertexColorArr[2]);
-  glBegin(GL_POINTS);
+  GLenum usage = GL_STATIC_DRAW;
+  if (rendererMode == IMMEDIATE) {
+    usage = GL_STREAM_DRAW;
+    vertexBufferDirty = true;
+    edgeBufferDirty = true;
+  }
+
+  if (vertexBufferDirty) {
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // буфер того же размера перезаписывается без выделения памяти
+    if (vertexBytes == vertexBufferSize && usage == GL_STATIC_DRAW) {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, data.obj_matrix.matrix);
+    } else {
+      glBufferData(GL_ARRAY_BUFFER, vertexBytes, data.obj_matrix.matrix,
+                   usage);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vertexBufferSize = vertexBytes;
+    vertexBufferDirty = false;
+  }
+
+  if (edgeBufferDirty) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, edgeBytes, data.obj_edges.indices,
+                 usage);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    edgeBufferDirty = false;
+  }
+
+  // без памяти на видеокарте объект передаётся на каждом кадре
+  if (glGetError() != GL_NO_ERROR) {
+    qWarning() << "Not enough video memory for the object, it is streamed";
+    buffersFailed = true;
+    releaseBuffers();
+  }
+
+  return !buffersFailed;
+}
+
+/**
+ * @brief Upload faces
+ *
+ * Splits polygons of the object into fans of triangles and copies them and
+ * edges shared by clusters into buffers of the video card the first time
+ * hidden lines are drawn after loading. Triangles are copied in batches,
+ * so the whole list is never kept in memory, and ones with missing vertices
+ * are skipped. Like levels of detail, faces stay in the buffers with both
+ * renderers.
+ *
+ * @return True if the buffer can be drawn
+ */
+bool GLWidget::uploadFaces() {
+  if (buffersFailed || faceBufferFailed) return false;
+  if (!faceBufferDirty) return faceIndices != 0;
+  faceBufferDirty = false;
+  faceIndices = 0;
+
+  const facets_t *facets = &data.obj_facets;
+  size_t triangles = 0;
+  for (size_t i = 0; facets->offsets != NULL && i < data.count_of_facets;
+       i++) {
+    size_t count = facet_size(facets, i);
+    if (count > 2) triangles += count - 2;
+  }
+  GLsizeiptr bytes = (GLsizeiptr)(triangles * 3 * sizeof(GLuint));
+  GLsizeiptr limit = bufferLimit();
+  if (triangles == 0 || (limit != 0 && bytes > limit)) {
+    if (triangles != 0) {
+      qWarning() << "Faces exceed VIEWER_BUFFER_LIMIT_MB, lines are not hidden";
+    }
+    faceBufferFailed = triangles != 0;
+    return false;
+  }
 
-  for (size_t i = 0; data.obj_matrix.matrix != NULL && vertexMode != NOTHING &&
-                     i < data.obj_matrix.rows;
+  for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++) {
+  }
+  if (faceBuffer == 0) glGenBuffers(1, &faceBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+  std::vector<GLuint> batch;
+  auto flush = [&]() {
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                    (GLintptr)(faceIndices * sizeof(GLuint)),
+                    (GLsizeiptr)(batch.size() * sizeof(GLuint)), batch.data());
+    faceIndices += batch.size();
+    batch.clear();
+  };
+  for (size_t i = 0; facets->offsets != NULL && i < data.count_of_facets;
        i++) {
-    drawOneVertex(data.obj_matrix.matrix[i]);
+    size_t count = facet_size(facets, i);
+    // веер треугольников из первой вершины полигона
+    for (size_t k = 1; k + 1 < count; k++) {
+      size_t first = facet_vertex(facets, i, 0);
+      size_t second = facet_vertex(facets, i, k);
+      size_t third = facet_vertex(facets, i, k + 1);
+      if (first == 0 || second == 0 || third == 0) continue;
+      batch.push_back((GLuint)(first - 1));
+      batch.push_back((GLuint)(second - 1));
+      batch.push_back((GLuint)(third - 1));
+    }
+    if (batch.size() >= LINE_BATCH) flush();
+  }
+  if (!batch.empty()) flush();
+
+  // рёбра между кластерами рисуются и для кластеров, обращённых от камеры
+  const meshlets_t &meshlets = data.obj_meshlets;
+  if (meshlets.count_of_boundary_edges != 0) {
+    if (boundaryBuffer == 0) glGenBuffers(1, &boundaryBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boundaryBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)(meshlets.count_of_boundary_edges * 2 *
+                              sizeof(GLuint)),
+                 meshlets.boundary_edges, GL_STATIC_DRAW);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  // без памяти на видеокарте рёбра рисуются без проверки глубины
+  if (glGetError() != GL_NO_ERROR) {
+    qWarning() << "Not enough video memory for faces, lines are not hidden";
+    glDeleteBuffers(1, &faceBuffer);
+    if (boundaryBuffer != 0) glDeleteBuffers(1, &boundaryBuffer);
+    faceBuffer = 0;
+    boundaryBuffer = 0;
+    faceIndices = 0;
+    faceBufferFailed = true;
   }
-  glEnd();
+
+  return faceIndices != 0;
 }
 
 /**
- * @brief Draw a vertex
+ * @brief Stream geometry
  *
- * Draws one vertex of the object.
+ * Copies vertices of the object into the buffer for data passed on every
+ * frame and binds it, for when the object has no buffers of its own. Edges
+ * are then streamed in batches by drawFacets.
+ */
+void GLWidget::streamGeometry() {
+  if (streamVertices == 0) glGenBuffers(1, &streamVertices);
+  glBindBuffer(GL_ARRAY_BUFFER, streamVertices);
+  glBufferData(GL_ARRAY_BUFFER,
+               (GLsizeiptr)(data.obj_matrix.rows * data.obj_matrix.cols *
+                            sizeof(GLfloat)),
+               data.obj_matrix.matrix, GL_STREAM_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Release buffers
+ *
+ * Deletes buffers of the video card. They are created again on the next
+ * frame.
+ */
+void GLWidget::releaseBuffers() {
+  if (vertexBuffer != 0) glDeleteBuffers(1, &vertexBuffer);
+  if (edgeBuffer != 0) glDeleteBuffers(1, &edgeBuffer);
+  vertexBuffer = 0;
+  edgeBuffer = 0;
+  if (faceBuffer != 0) glDeleteBuffers(1, &faceBuffer);
+  if (boundaryBuffer != 0) glDeleteBuffers(1, &boundaryBuffer);
+  faceBuffer = 0;
+  boundaryBuffer = 0;
+  faceIndices = 0;
+  vertexBufferSize = 0;
+  vertexBufferDirty = true;
+  edgeBufferDirty = true;
+  faceBufferDirty = true;
+  releaseLevelBuffers();
+}
+
+/**
+ * @brief Upload level
+ *
+ * Copies vertices and edges of a level of detail into buffers of the video
+ * card the first time it is drawn. Levels are at most a quarter of the
+ * object, so they stay in buffers with both renderers.
+ *
+ * @param level Number of the level from 1
+ *
+ * @return True if the buffers of the level can be drawn
+ */
+bool GLWidget::uploadLevel(size_t level) {
+  if (levelBuffersDirty) releaseLevelBuffers();
+  if (levelBuffersFailed) return false;
+
+  GLuint *buffers = levelBuffers[level - 1];
+  if (buffers[0] == 0) {
+    const lod_t &lod = data.obj_lod.levels[level - 1];
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++) {
+    }
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER,
+                 (GLsizeiptr)(lod.vertices.rows * 3 * sizeof(GLfloat)),
+                 lod.vertices.matrix, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)(lod.edges.count_of_edges * 2 * sizeof(GLuint)),
+                 lod.edges.indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // без памяти на видеокарте рисуется сам объект
+    if (glGetError() != GL_NO_ERROR) {
+      releaseLevelBuffers();
+      levelBuffersFailed = true;
+    }
+  }
+
+  return !levelBuffersFailed;
+}
+
+/**
+ * @brief Release level buffers
+ *
+ * Deletes buffers of levels of detail. They are created again when a level
+ * is drawn.
+ */
+void GLWidget::releaseLevelBuffers() {
+  for (size_t i = 0; i < LOD_MAX_LEVELS; i++) {
+    if (levelBuffers[i][0] != 0) glDeleteBuffers(2, levelBuffers[i]);
+    levelBuffers[i][0] = levelBuffers[i][1] = 0;
+  }
+  levelBuffersDirty = false;
+  levelBuffersFailed = false;
+}
+
+/**
+ * @brief Pixels per unit
+ *
+ * Estimates how many pixels of the window one unit of the object takes
+ * with the current projection, camera and transform.
+ *
+ * @param model Model matrix of the transform
+ *
+ * @return Number of pixels
+ */
+double GLWidget::pixelsPerUnit(const GLfloat model[16]) const {
+  // наибольшее растяжение преобразования - самый длинный столбец матрицы
+  double stretch = 0.0;
+  for (int col = 0; col < 3; col++) {
+    const GLfloat *axis = model + col * 4;
+    stretch = std::max(stretch, std::sqrt((double)axis[0] * axis[0] +
+                                          (double)axis[1] * axis[1] +
+                                          (double)axis[2] * axis[2]));
+  }
+  // в центральной проекции центр объекта на расстоянии 2 при увеличении 1.2
+  double projection = projectionMode == PARALLEL ? 1.0 : 1.2 / 2.0;
+  double pixels = std::max(width(), height()) * devicePixelRatioF() / 2.0;
+
+  return pixels * projection * camera.zoom * viewFit[0] * stretch;
+}
+
+/**
+ * @brief Interactive level
+ *
+ * While the object is moved, coarsens the level of detail until the
+ * object is expected to be drawn within the target frame time, by the time
+ * the video card took per vertex and edge in previous frames. Otherwise the
+ * level is kept.
  *
- * @param matrix_ Coordinates of a drawn vertex
+ * @param level Level chosen by the error on the screen
+ * @param primitives Number of vertices and edges of the object
+ *
+ * @return Number of the level from 1, 0 to draw the object itself
  */
-void GLWidget::drawOneVertex(float *matrix_) {
-  glVertex3f(matrix_[0], matrix_[1], matrix_[2]);
+size_t GLWidget::interactiveLevel(size_t level, size_t primitives) const {
+  if (!interacting || targetFrameMs <= 0.0 || nsPerPrimitive <= 0.0) {
+    return level;
+  }
+
+  return lod_fit_budget(&data.obj_lod, level, primitives,
+                        targetFrameMs * 1e6 / nsPerPrimitive);
+}
+
+/**
+ * @brief Measure frame
+ *
+ * Reads the time the video card spent drawing the object in an earlier
+ * frame, once it is known, without waiting for it.
+ */
+void GLWidget::measureFrame() {
+  if (!frameQueryPending || !frameQuery.isResultAvailable()) return;
+  frameQueryPending = false;
+  if (queriedPrimitives == 0) return;
+
+  double sample = frameQuery.waitForResult() / (double)queriedPrimitives;
+  // сглаживание убирает скачки отдельных кадров
+  nsPerPrimitive =
+      nsPerPrimitive > 0.0 ? nsPerPrimitive * 0.75 + sample * 0.25 : sample;
+}
+
+/**
+ * @brief Show detail
+ *
+ * Reports the drawn level of detail under the information about the file
+ * and to the "viewer.lod" log when it changes.
+ *
+ * @param level Number of the drawn level from 1, 0 for the object itself
+ * @param reduced The level was coarsened because the object is moved
+ */
+void GLWidget::showDetail(size_t level, bool reduced) {
+  if (level == shownLevel && reduced == shownReduced) return;
+  shownLevel = level;
+  shownReduced = reduced;
+
+  QString detail = level == 0 ? QString("Detail: full")
+                              : QString("Detail: level %1 of %2")
+                                    .arg(level)
+                                    .arg(data.obj_lod.count_of_levels);
+  if (reduced) detail += " while moving";
+  infoLabel->setText(fileInfo + "\n" + detail);
+  qCDebug(lodLog, "drawn level %zu of %zu%s", level,
+          data.obj_lod.count_of_levels, reduced ? " while moving" : "");
+}
+
+/**
+ * @brief Geometry changed
+ *
+ * Redraws the object after its vertices were changed, uploading them to
+ * the video card again.
+ */
+void GLWidget::geometryChanged() {
+  vertexBufferDirty = true;
+  update();
+}
+
+/**
+ * @brief Reset transform
+ *
+ * Returns the object to the position it had right after loading. Vertices
+ * are never changed by transforms and the fit into the view is done by the
+ * camera, so only the model and mouse camera matrices are made identity and
+ * neither the file nor the buffers are touched.
+ */
+void GLWidget::resetTransform() {
+  transform_reset(&transform);
+  camera_reset(&camera);
+  update();
+}
+
+/**
+ * @brief Input changed
+ *
+ * Called by input handlers instead of changing the transform right away.
+ * Schedules one repaint for all input until the next frame and starts
+ * measuring the time until the frame is shown. The object is drawn with
+ * reduced detail until there is no input for a short time.
+ */
+void GLWidget::inputChanged() {
+  if (!inputPending) {
+    inputPending = true;
+    inputClock.start();
+  }
+  // пока ввод продолжается, объект рисуется упрощённым
+  interacting = true;
+  idleTimer.start();
+  update();
+}
+
+/**
+ * @brief Cast ray
+ *
+ * Finds the facet under a point of the widget, for picking and measuring.
+ * The ray goes from the near to the far plane of the last drawn frame and
+ * the hit is in coordinates of the vertices of the object.
+ *
+ * @param position Point in the widget
+ * @param hit Filled with the nearest hit
+ *
+ * @return True if the ray hits a facet
+ */
+bool GLWidget::castRay(const QPointF &position, bvh_hit_t *hit) const {
+  bool invertible = false;
+  QMatrix4x4 inverse = objectMvp.inverted(&invertible);
+  if (!invertible || width() <= 0 || height() <= 0) return false;
+
+  float x = 2.0f * position.x() / width() - 1.0f;
+  float y = 1.0f - 2.0f * position.y() / height();
+  QVector3D from = (inverse * QVector4D(x, y, -1.0f, 1.0f)).toVector3DAffine();
+  QVector3D to = (inverse * QVector4D(x, y, 1.0f, 1.0f)).toVector3DAffine();
+  float origin[3] = {from.x(), from.y(), from.z()};
+  float direction[3] = {to.x() - from.x(), to.y() - from.y(),
+                        to.z() - from.z()};
+
+  return bvh_raycast(&data, origin, direction, hit) != 0;
+}
+
+/**
+ * @brief View point
+ *
+ * Converts a position in the widget to the view, from -1 to 1 across the
+ * window. Both projections mirror OX, so right of the window is negative.
+ *
+ * @param event Mouse event with the position in the widget
+ *
+ * @return Position in the view
+ */
+QPointF GLWidget::viewPoint(const QMouseEvent *event) const {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+  QPointF position = event->position();
+#else
+  QPointF position = event->localPos();
+#endif
+  qreal w = width() > 0 ? width() : 1;
+  qreal h = height() > 0 ? height() : 1;
+
+  return QPointF(1.0 - 2.0 * position.x() / w, 1.0 - 2.0 * position.y() / h);
+}
+
+/**
+ * @brief Mouse press
+ *
+ * Starts rotating the view with the left button or moving it with others.
+ *
+ * @param event Mouse event
+ */
+void GLWidget::mousePressEvent(QMouseEvent *event) {
+  dragPoint = viewPoint(event);
+  event->accept();
+}
+
+/**
+ * @brief Mouse move
+ *
+ * Rotates the view by the arcball with the left button and moves it with
+ * the right or middle one. Only the camera changes, so the cost does not
+ * depend on the number of vertices.
+ *
+ * @param event Mouse event
+ */
+void GLWidget::mouseMoveEvent(QMouseEvent *event) {
+  QPointF point = viewPoint(event);
+
+  if (event->buttons() & Qt::LeftButton) {
+    double from[3], to[3];
+    arcball_point(dragPoint.x(), dragPoint.y(), from);
+    arcball_point(point.x(), point.y(), to);
+    // в центральной проекции объект развёрнут к зрителю осью -OZ
+    if (projectionMode == CENTRAL) {
+      from[2] = -from[2];
+      to[2] = -to[2];
+    }
+    camera_rotate(&camera, from, to);
+    inputChanged();
+  } else if (event->buttons() & (Qt::RightButton | Qt::MiddleButton)) {
+    // в центральной проекции окно охватывает больше единиц вида
+    double scale = projectionMode == CENTRAL ? 2.0 / 1.2 : 1.0;
+    camera_pan(&camera, (point.x() - dragPoint.x()) * scale,
+               (point.y() - dragPoint.y()) * scale, 0.0);
+    inputChanged();
+  }
+
+  dragPoint = point;
+  event->accept();
+}
+
+/**
+ * @brief Mouse release
+ *
+ * Finishes dragging.
+ *
+ * @param event Mouse event
+ */
+void GLWidget::mouseReleaseEvent(QMouseEvent *event) { event->accept(); }
+
+/**
+ * @brief Mouse wheel
+ *
+ * Zooms the view by 10% for every step of the wheel.
+ *
+ * @param event Wheel event
+ */
+void GLWidget::wheelEvent(QWheelEvent *event) {
+  int steps = event->angleDelta().y();
+  if (steps != 0) {
+    camera_zoom(&camera, std::pow(1.1, steps / 120.0));
+    inputChanged();
+  }
+  event->accept();
+}
+
+/**
+ * @brief Set vertex style
+ *
+ * Binds the program of points and sets size, color and form of drawn
+ * vertices. Round vertices are cut out of square points by the fragment
+ * shader.
+ */
+void GLWidget::setVertexStyle() {
+  program.bind();
+  program.setUniformValue(mvpLocation, drawMvp);
+  program.setUniformValue(viewportLocation, viewportSize);
+  program.setUniformValue(styleLocation, vertexMode == ROUND ? 1 : 0);
+  program.setUniformValue(pointSizeLocation, vertexSize);
+  program.setUniformValue(colorLocation,
+                          QVector4D(vertexColorArr[0] / 255.0f,
+                                    vertexColorArr[1] / 255.0f,
+                                    vertexColorArr[2] / 255.0f, 1.0f));
+}
+
+/**
+ * @brief Set edge style
+ *
+ * Binds the program of lines and sets width, color and form of drawn
+ * edges. The geometry shader widens every line to the width in pixels,
+ * which glLineWidth can not do in the core profile. Dashes are cut out of
+ * lines by the fragment shader by the distance in pixels from the end of an
+ * edge.
+ */
+void GLWidget::setEdgeStyle() {
+  lineProgram.bind();
+  lineProgram.setUniformValue(lineMvpLocation, drawMvp);
+  lineProgram.setUniformValue(lineViewportLocation, viewportSize);
+  lineProgram.setUniformValue(lineWidthLocation, edgeWidthVal);
+  lineProgram.setUniformValue(lineStyleLocation, edgeMode == DASHED ? 2 : 0);
+  lineProgram.setUniformValue(lineColorLocation,
+                              QVector4D(edgeColorArr[0] / 255.0f,
+                                        edgeColorArr[1] / 255.0f,
+                                        edgeColorArr[2] / 255.0f, 1.0f));
+}
+
+/**
+ * @brief Draw vertices
+ *
+ * Draws vertices from the bound array buffer.
+ *
+ * @param count Number of vertices
+ */
+void GLWidget::drawVertices(size_t count) {
+  if (vertexMode != NOTHING) {
+    setVertexStyle();
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+  }
 }
 
 /**
  * @brief Draw polygons
  *
- * Draws polygons of the object.
+ * Draws polygons of the object. Unique edges from the bound element buffer
+ * are drawn once each with glDrawElements when they are built, otherwise
+ * edges of every polygon are streamed to the video card in batches. Edges
+ * ordered by the hierarchy of boxes are drawn only for nodes inside the
+ * view. When the surface was drawn by drawSurface, clusters of a closed
+ * surface facing away from the camera are skipped as well, since the depth
+ * test would hide them anyway, except for edges they share with other
+ * clusters, which may be on the outline. Without buffers of the object
+ * unique edges are streamed in batches too.
+ *
+ * @param mvp Model-view-projection matrix of the object
+ * @param hidden The surface is in the depth buffer
+ *
+ * @return Number of drawn edges
  */
-void GLWidget::drawFacets() {
-  if (edgeMode == DASHED) {
-    glEnable(GL_LINE_STIPPLE);
-    glLineStipple(1, 0xFF00);
-  } else {  // SOLID
-    glDisable(GL_LINE_STIPPLE);
+size_t GLWidget::drawFacets(const QMatrix4x4 &mvp, bool hidden) {
+  setEdgeStyle();
+  std::vector<GLuint> lines;
+  // без буфера рёбер они копируются частями, как рёбра полигонов
+  auto drawRange = [&](size_t count_of_edges, size_t first_edge) {
+    if (!buffersFailed) {
+      drawEdges(count_of_edges, first_edge);
+      return;
+    }
+    const GLuint *edges = data.obj_edges.indices + first_edge * 2;
+    const GLuint *end = edges + count_of_edges * 2;
+    while (edges != end) {
+      size_t part = std::min<size_t>(end - edges, LINE_BATCH - lines.size());
+      lines.insert(lines.end(), edges, edges + part);
+      edges += part;
+      if (lines.size() >= LINE_BATCH) drawLines(lines);
+    }
+  };
+  if (data.obj_edges.indices != NULL) {
+    size_t drawn = 0;
+    boundaryEdges.count_of_ranges = 0;
+    int error_code =
+        hidden && data.obj_meshlets.closed
+            ? meshlets_cull(&data, mvp.constData(), &visibleEdges,
+                            &boundaryEdges)
+            : bvh_cull(&data.obj_bvh, mvp.constData(), &visibleEdges);
+    if (error_code == 0) {
+      for (size_t i = 0; i < visibleEdges.count_of_ranges; i++) {
+        drawRange(visibleEdges.ranges[i * 2 + 1], visibleEdges.ranges[i * 2]);
+        drawn += visibleEdges.ranges[i * 2 + 1];
+      }
+      // рёбра пропущенных кластеров, общие с соседями, лежат в своём буфере
+      if (boundaryEdges.count_of_ranges != 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boundaryBuffer);
+        for (size_t i = 0; i < boundaryEdges.count_of_ranges; i++) {
+          drawEdges(boundaryEdges.ranges[i * 2 + 1],
+                    boundaryEdges.ranges[i * 2]);
+          drawn += boundaryEdges.ranges[i * 2 + 1];
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+      }
+    } else {
+      drawRange(data.obj_edges.count_of_edges, 0);
+      drawn = data.obj_edges.count_of_edges;
+    }
+    drawLines(lines);
+    return drawn;
   }
 
-  glLineWidth(edgeWidthVal);
-  glColor3ub(edgeColorArr[0], edgeColorArr[1], edgeColorArr[2]);
-  glBegin(GL_LINES);
+  for (size_t i = 0;
+       data.obj_facets.offsets != NULL && i < data.count_of_facets; i++) {
+    addFacetLines(lines, i);
+    if (lines.size() >= LINE_BATCH) drawLines(lines);
+  }
+  drawLines(lines);
+  return data.obj_facets.count_of_indices;
+}
 
-  for (size_t i = 0; data.obj_polygons != NULL && i < data.count_of_facets;
-       i++) {
-    drawOneFacet(i);
+/**
+ * @brief Draw surface
+ *
+ * Fills the depth buffer with faces of the object without changing colors
+ * of the window, so that vertices and edges behind the surface fail the
+ * depth test. Faces are pushed slightly away from the camera to keep edges
+ * lying on them visible. The depth test stays on for the rest of the
+ * object.
+ *
+ * @return True if the surface was drawn, false if lines can not be hidden
+ */
+bool GLWidget::drawSurface() {
+  if (!uploadFaces()) return false;
+
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(1.0f, 1.0f);
+  program.bind();
+  program.setUniformValue(mvpLocation, drawMvp);
+  program.setUniformValue(styleLocation, 0);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceBuffer);
+  // треугольники рисуются частями, чтобы количество поместилось в GLsizei
+  const size_t batch = (size_t)3 << 28;
+  for (size_t first = 0; first < faceIndices; first += batch) {
+    size_t part = std::min(batch, faceIndices - first);
+    uintptr_t offset = first * sizeof(GLuint);
+    glDrawElements(GL_TRIANGLES, (GLsizei)part, GL_UNSIGNED_INT,
+                   (const void *)offset);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  return true;
+}
+
+/**
+ * @brief Draw edges
+ *
+ * Draws edges from the bound element buffer.
+ *
+ * @param count_of_edges Number of edges
+ * @param first_edge First edge to draw
+ */
+void GLWidget::drawEdges(size_t count_of_edges, size_t first_edge) {
+  // рёбра рисуются частями, чтобы количество поместилось в GLsizei
+  const size_t batch = (size_t)1 << 30;
+  size_t count = count_of_edges * 2;
+  for (size_t first = 0; first < count; first += batch) {
+    size_t part = std::min(batch, count - first);
+    uintptr_t offset = (first_edge * 2 + first) * sizeof(GLuint);
+    glDrawElements(GL_LINES, (GLsizei)part, GL_UNSIGNED_INT,
+                   (const void *)offset);
+  }
+}
+
+/**
+ * @brief Add polygon lines
+ *
+ * Adds edges of one polygon of the object to a batch of lines.
+ *
+ * @param lines Pairs of vertex indices to add to
+ * @param index_ Index of a polygon
+ */
+void GLWidget::addFacetLines(std::vector<GLuint> &lines, size_t index_) {
+  const facets_t *facets = &data.obj_facets;
+  size_t count = facet_size(facets, index_);
+
+  // соединяем попарно вершины, последнюю с первой
+  for (size_t i = 0; i < count; i++) {
+    size_t next = (i + 1) % count;
+    lines.push_back((GLuint)(facet_vertex(facets, index_, i) - 1));
+    lines.push_back((GLuint)(facet_vertex(facets, index_, next) - 1));
   }
-  glEnd();
 }
 
 /**
- * @brief Draw a polygon
+ * @brief Draw lines
+ *
+ * Streams a batch of lines to the video card, draws it and empties it.
+ * Vertices must be in the bound array buffer.
+ *
+ * @param lines Pairs of vertex indices
+ */
+void GLWidget::drawLines(std::vector<GLuint> &lines) {
+  if (lines.empty()) return;
+  if (streamIndices == 0) glGenBuffers(1, &streamIndices);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, streamIndices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               (GLsizeiptr)(lines.size() * sizeof(GLuint)), lines.data(),
+               GL_STREAM_DRAW);
+  glDrawElements(GL_LINES, (GLsizei)lines.size(), GL_UNSIGNED_INT, nullptr);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuffer);
+  lines.clear();
+}
+
+/**
+ * @brief Draw preview
  *
- * Draws one polygon of the object.
+ * Draws vertices and facets of the object being loaded that are parsed so
+ * far. The object is fitted into the view by bounds of parsed vertices,
+ * without changing them. Parsed vertices are streamed to the video card on
+ * every preview frame.
  *
- * @param index_ Index of a drawn polygon
+ * @param view Projection and camera matrix
  */
-void GLWidget::drawOneFacet(size_t index_) {
-  // соединяем попарно вершины
-  size_t i = 0;
-  for (; i < data.obj_polygons[index_].numbers_of_vertices_in_facets - 1; i++) {
-    glVertex3f(
-        data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][0],
-        data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][1],
-        data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][2]);
+void GLWidget::drawPreview(const QMatrix4x4 &view) {
+  const matrix_t &matrix = preview.data->obj_matrix;
+
+  // границы уточняются только по новым вершинам
+  size_t end = 0;
+  for (size_t i = 0; i < preview.count_of_parts; i++) {
+    const part_t &part = preview.parts[i];
+    bounds_grow(&previewBounds,
+                matrix_vertex(&matrix, part.vertex_base + previewScanned[i]),
+                part.parsed_vertices - previewScanned[i]);
+    previewScanned[i] = part.parsed_vertices;
+    end = std::max(end, part.vertex_base + part.parsed_vertices);
+  }
+  if (end == 0) return;
+
+  // сфера по коробке не требует прохода по всем вершинам
+  bounds_t bounds = previewBounds;
+  bounds_finish(&bounds, NULL);
+  GLfloat fit[16];
+  fitIntoView(bounds, fit);
+  drawMvp = view * columnMatrix(fit);
+
+  // части копируются на свои места, промежутки между ними не рисуются
+  const size_t vertexSize_ = 3 * sizeof(GLfloat);
+  if (streamVertices == 0) glGenBuffers(1, &streamVertices);
+  glBindBuffer(GL_ARRAY_BUFFER, streamVertices);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(end * vertexSize_), nullptr,
+               GL_STREAM_DRAW);
+  for (size_t i = 0; i < preview.count_of_parts; i++) {
+    const part_t &part = preview.parts[i];
+    if (part.parsed_vertices != 0) {
+      glBufferSubData(GL_ARRAY_BUFFER,
+                      (GLintptr)(part.vertex_base * vertexSize_),
+                      (GLsizeiptr)(part.parsed_vertices * vertexSize_),
+                      matrix_vertex(&matrix, part.vertex_base));
+    }
+  }
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+  if (vertexMode != NOTHING) {
+    setVertexStyle();
+    for (size_t i = 0; i < preview.count_of_parts; i++) {
+      glDrawArrays(GL_POINTS, (GLint)preview.parts[i].vertex_base,
+                   (GLsizei)preview.parts[i].parsed_vertices);
+    }
+  }
 
-    glVertex3f(data.obj_matrix
-                   .matrix[data.obj_polygons[index_].vertices[i + 1] - 1][0],
-               data.obj_matrix
-                   .matrix[data.obj_polygons[index_].vertices[i + 1] - 1][1],
-               data.obj_matrix
-                   .matrix[data.obj_polygons[index_].vertices[i + 1] - 1][2]);
+  setEdgeStyle();
+  std::vector<GLuint> lines;
+  for (size_t i = 0; i < preview.count_of_parts; i++) {
+    const part_t &part = preview.parts[i];
+    for (size_t f = 0; f < part.parsed_facets; f++) {
+      const facets_t *facets = &preview.data->obj_facets;
+      size_t facet = part.facet_base + f;
+      size_t count = facet_size(facets, facet);
+      // рёбра к ещё не разобранным вершинам пропускаются
+      for (size_t k = 0; k < count; k++) {
+        size_t from = facet_vertex(facets, facet, k);
+        size_t to = facet_vertex(facets, facet, (k + 1) % count);
+        if (partial_vertex_parsed(&preview, from) &&
+            partial_vertex_parsed(&preview, to)) {
+          lines.push_back((GLuint)(from - 1));
+          lines.push_back((GLuint)(to - 1));
+        }
+      }
+      if (lines.size() >= LINE_BATCH) drawLines(lines);
+    }
   }
+  drawLines(lines);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-  // соединяем последнюю и первую вершины
-  glVertex3f(
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][0],
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][1],
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[i] - 1][2]);
+/**
+ * @brief Fit into view
+ *
+ * Builds the matrix that moves the center of the bounding sphere to the
+ * origin and shrinks the sphere to radius 1, so the object stays in the
+ * view at any rotation. It is applied to the vertices before the transform,
+ * like a camera looking at the object, and the vertices are not changed.
+ *
+ * @param bounds Bounds of the object
+ * @param matrix 4x4 matrix by columns to fill
+ */
+void GLWidget::fitIntoView(const bounds_t &bounds, GLfloat matrix[16]) {
+  // объект из одной точки или с бесконечными координатами не масштабируется
+  float scale = 1.0f;
+  if (bounds.radius > 0.0f && std::isfinite(1.0f / bounds.radius)) {
+    scale = 1.0f / bounds.radius;
+  }
 
-  glVertex3f(
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[0] - 1][0],
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[0] - 1][1],
-      data.obj_matrix.matrix[data.obj_polygons[index_].vertices[0] - 1][2]);
+  for (int i = 0; i < 16; i++) matrix[i] = i % 5 == 0 ? 1.0f : 0.0f;
+  for (int k = 0; k < 3; k++) {
+    matrix[k * 5] = scale;
+    matrix[12 + k] = std::isfinite(bounds.center[k])
+                         ? -bounds.center[k] * scale
+                         : 0.0f;
+  }
 }
 
 /**
  * @brief Open a file
  *
- * Opens a file before drawing an object.
+ * Starts loading a file on a background thread. The object is replaced only
+ * when loading succeeds, so a half-built object is never drawn. Levels of
+ * detail of the current object stop being built, so they do not take
+ * processors from the loader.
  *
  * @param filename Name of the file to be opened
  */
 void GLWidget::openFile(const char *filename) {
-  if (fp != NULL) {
-    free_memory(fp, &data);
-  }
-  fp = open_obj_file(filename);
-  if (fp != NULL) {
-    count_vertices_and_facets(fp, &data);
-    rewind(fp);
-    int error_code = initialize_obj_matrix(&data);
-    if (error_code == 0) {
-      copy_vertices_from_obj_to_matrix(fp, &data);
-      rewind(fp);
-      error_code = count_vertices_in_facets(fp, &data);
-      if (error_code == 0) {
-        rewind(fp);
-        copy_indexes_from_obj_to_struct(fp, &data);
-        // автомасштабирование
-        float init_scale;
-        if (fabsf(data.highest_vertex + data.lowest_vertex) < 1e-6)
-          init_scale = 1.0f / (fabsf(data.highest_vertex) + 0.1f);
-        else
-          init_scale = 2.0f / (fabsf(data.lowest_vertex) +
-                               fabsf(data.highest_vertex) + 0.1f);
-        scale_even(&data.obj_matrix, init_scale);
-        // перемещение фигуры в центр
-        data.rightest_vertex *= init_scale;
-        data.leftest_vertex *= init_scale;
-        move_by_ox(
-            &data.obj_matrix,
-            (fabsf(data.leftest_vertex) - fabsf(data.rightest_vertex)) / 2.0f);
-        data.highest_vertex *= init_scale;
-        data.lowest_vertex *= init_scale;
-        move_by_oy(
-            &data.obj_matrix,
-            (fabsf(data.lowest_vertex) - fabsf(data.highest_vertex)) / 2.0f);
-        update();
-        // отображение названия, количества вершин и граней
-        QString fileInfo =
-            QString(
-                "Opened file: %1\nCount of vertices: %2\nCount of facets: %3")
-                .arg(filename)
-                .arg(data.count_of_vertices)
-                .arg(data.count_of_facets);
-        infoLabel->setText(fileInfo);  // Установка текста для QLabel
-        infoLabel->show();             // Показываем QLabel
+  cancelLoading();
+  // уровни строятся заново, если загрузку отменят
+  if (lodBuilder != nullptr) levelsInterrupted = true;
+  cancelLevels();
+
+  loadProgress = progress_t{};
+  loadedData = data_t{};
+  loadError = 0;
+  loadingFilename = filename;
+  std::fill_n(previewScanned, MAX_PARSER_THREADS, 0);
+  bounds_reset(&previewBounds);
+
+  int generation = ++loadGeneration;
+  loader = QThread::create([this]() {
+    // без списка рёбер полигоны рисуются по одному, без иерархии коробок
+    // рёбра вне окна не отбрасываются, без кластеров - рёбра задней стороны
+    const struct {
+      int (*build)(data_t *, size_t);
+      const char *name;
+    } passes[] = {{build_edges, "edges"},
+                  {build_bvh, "hierarchy of boxes"},
+                  {build_meshlets, "clusters"}};
+    const int count_of_passes = sizeof(passes) / sizeof(passes[0]);
+
+    progress_set_stages(&loadProgress, 1 + count_of_passes);
+    loadError = load_obj_file(loadingFilename.constData(), &loadedData,
+                              parserThreads, &loadProgress);
+    for (int i = 0; loadError == 0 && i < count_of_passes; i++) {
+      if (progress_next_stage(&loadProgress) != 0) {
+        free_memory(NULL, &loadedData);
+        loadError = LOAD_CANCELLED;
+      } else if (passes[i].build(&loadedData, parserThreads) != 0) {
+        // объект рисуется и без них, только медленнее
+        qWarning() << "Failed to build" << passes[i].name << "of the object";
       }
     }
+  });
+  // результат забирается в потоке интерфейса
+  connect(loader, &QThread::finished, this, [this, generation]() {
+    if (generation == loadGeneration) finishLoading();
+  });
+  loader->start();
+
+  progressTimer.start(100);
+  previewTimer.start(300);
+  emit loadingProgress(0);
+}
+
+/**
+ * @brief Cancel loading
+ *
+ * Stops the background loading, if any, and waits for its thread. The
+ * current object stays untouched and building its levels of detail goes on
+ * if the loading interrupted it.
+ */
+void GLWidget::cancelLoading() {
+  if (stopLoading()) {
+    if (levelsInterrupted) buildLevels();
+    emit loadingFinished(false);
+  }
+}
+
+/**
+ * @brief Stop loading
+ *
+ * Stops the background loading, if any, and waits for its thread without
+ * emitting signals or building levels of detail again, so that it can be
+ * called while the window is destroyed.
+ *
+ * @return True if a loading was stopped
+ */
+bool GLWidget::stopLoading() {
+  if (loader == nullptr) return false;
+
+  progress_cancel(&loadProgress);
+  loader->wait();
+  loader->deleteLater();
+  loader = nullptr;
+  ++loadGeneration;
+  progressTimer.stop();
+  previewTimer.stop();
+
+  // загрузка могла успеть завершиться до отмены
+  if (loadError == 0) free_memory(NULL, &loadedData);
+  return true;
+}
+
+/**
+ * @brief Finish loading
+ *
+ * Swaps the loaded object in place of the current one and fits it into the
+ * view.
+ */
+void GLWidget::finishLoading() {
+  loader->deleteLater();
+  loader = nullptr;
+  progressTimer.stop();
+  previewTimer.stop();
+
+  if (loadError == 0) {
+    // уровни прошлого объекта строятся по его вершинам
+    cancelLevels();
+    free_memory(NULL, &data);
+    data = loadedData;
+    loadedData = data_t{};
+    vertexBufferDirty = true;
+    edgeBufferDirty = true;
+    buffersFailed = false;
+    faceBufferDirty = true;
+    faceBufferFailed = false;
+    levelBuffersDirty = true;
+    qstrncpy(filename, loadingFilename.constData(), sizeof(filename));
+
+    // объект вписывается в окно камерой, вершины и преобразование не меняются
+    fitIntoView(data.bounds, viewFit);
+    resetTransform();
+    // отображение названия, количества вершин и граней
+    fileInfo =
+        QString("Opened file: %1\nCount of vertices: %2\nCount of facets: %3")
+            .arg(filename)
+            .arg(data.count_of_vertices)
+            .arg(data.count_of_facets);
+    shownLevel = 0;
+    shownReduced = false;
+    // Установка текста для QLabel
+    infoLabel->setText(fileInfo + "\nDetail: full");
+    infoLabel->show();             // Показываем QLabel
+    buildLevels();
   } else {
-    qWarning() << "Failed to open file";
+    if (loadError != LOAD_CANCELLED) qWarning() << "Failed to open file";
+    // прежний объект остаётся, его уровни достраиваются
+    if (levelsInterrupted) buildLevels();
+  }
+
+  emit loadingFinished(loadError == 0);
+}
+
+/**
+ * @brief Build levels
+ *
+ * Starts building levels of detail of the object on a background thread.
+ * The object is drawn in full detail until they are ready. The thread gets
+ * a copy of the description of the object sharing its arrays and writes
+ * only levels of the copy.
+ */
+void GLWidget::buildLevels() {
+  cancelLevels();
+  levelsInterrupted = false;
+
+  lodProgress = progress_t{};
+  lodSource = data;
+  lodSource.obj_lod = lod_chain_t{};
+  lodError = 0;
+
+  int generation = ++lodGeneration;
+  lodBuilder = QThread::create(
+      [this]() { lodError = build_lod(&lodSource, &lodProgress); });
+  connect(lodBuilder, &QThread::finished, this, [this, generation]() {
+    if (generation == lodGeneration) finishLevels();
+  });
+  lodBuilder->start(QThread::LowPriority);
+}
+
+/**
+ * @brief Cancel levels
+ *
+ * Stops building levels of detail, if it runs, and waits for its thread.
+ * Must be called before arrays of the object are freed.
+ */
+void GLWidget::cancelLevels() {
+  if (lodBuilder != nullptr) {
+    progress_cancel(&lodProgress);
+    lodBuilder->wait();
+    lodBuilder->deleteLater();
+    lodBuilder = nullptr;
+    ++lodGeneration;
+
+    // построение могло успеть завершиться до отмены
+    lod_free(&lodSource.obj_lod);
+    lodSource = data_t{};
+  }
+}
+
+/**
+ * @brief Finish levels
+ *
+ * Moves built levels of detail to the object.
+ */
+void GLWidget::finishLevels() {
+  lodBuilder->deleteLater();
+  lodBuilder = nullptr;
+
+  if (lodError == 0) {
+    lod_free(&data.obj_lod);
+    data.obj_lod = lodSource.obj_lod;
+    levelBuffersDirty = true;
+    update();
+  } else if (lodError != LOAD_CANCELLED) {
+    qWarning() << "Failed to build levels of detail";
   }
+  lodSource = data_t{};
 }
 
 /**
@@ -206,7 +1415,6 @@ void GLWidget::openFile(const char *filename) {
  * @param h Window height
  */
 void GLWidget::resizeGL(int w, int h) {
+  // проекция строится на каждом кадре в paintGL
   glViewport(0, 0, w, h);
-  GLfloat aspectRatio = (GLfloat)w / (GLfloat)h;
-  glOrtho(aspectRatio, -aspectRatio, -1.0f, 1.0f, -1.0f, 1.0f);
 }
@@ -3,9 +3,19 @@
 
 #define GL_SILENCE_DEPRECATION
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QLabel>  // для отображения названия, количества вершин и граней
+#include <QMatrix4x4>
+#include <QMouseEvent>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLTimerQuery>
+#include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
+#include <QThread>
 #include <QTimer>
+#include <QVector2D>
+#include <vector>
 
 extern "C" {
 #include "../../backend/backend.h"
@@ -16,15 +26,19 @@ extern "C" {
  *
  * The widget for rendering and drawing the object.
  */
-class GLWidget : public QOpenGLWidget {
+class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
   Q_OBJECT
  public:
   explicit GLWidget(QWidget *parent = nullptr);
+  ~GLWidget();
 
   QLabel *infoLabel;
 
-  FILE *fp = NULL;
   data_t data = {};
+  // перемещения, повороты и масштаб объекта без изменения вершин
+  transform_t transform = {};
+  // поворот, сдвиг и увеличение вида мышью, не входят в историю
+  camera_t camera = {};
   char filename[256] = {};
 
   GLfloat vertexSize = 5.0;
@@ -39,20 +53,181 @@ class GLWidget : public QOpenGLWidget {
 
   enum projection_t { PARALLEL = 0, CENTRAL } projectionMode = PARALLEL;
 
+  // объект хранится в буферах видеокарты или передаётся на каждом кадре
+  enum renderer_t { RETAINED = 0, IMMEDIATE } rendererMode = RETAINED;
+
+  // количество потоков разбора файла, 0 - по числу процессоров
+  size_t parserThreads = 0;
+
+  // наибольшая ошибка упрощённого объекта на экране в пикселях
+  double lodPixelError = 1.0;
+
+  // время кадра в миллисекундах, которое держится во время движения объекта,
+  // 0 - объект всегда рисуется с полной детализацией
+  double targetFrameMs = 16.0;
+
+  // невидимые линии: грани закрывают рёбра за собой, а кластеры замкнутой
+  // поверхности, обращённые от камеры, не рисуются
+  bool hiddenLines = false;
+
   void openFile(const char *filename);
+  void cancelLoading();
+  bool stopLoading();
+  bool isLoading() const { return loader != nullptr; }
+  void cancelLevels();
+  void geometryChanged();
+  void resetTransform();
+  void inputChanged();
+  bool castRay(const QPointF &position, bvh_hit_t *hit) const;
 
   void initializeGL();
   void paintGL();
   void resizeGL(int w, int h);
 
-  void drawVertices();
-  void drawOneVertex(float *matrix_);
+  void mousePressEvent(QMouseEvent *event);
+  void mouseMoveEvent(QMouseEvent *event);
+  void mouseReleaseEvent(QMouseEvent *event);
+  void wheelEvent(QWheelEvent *event);
 
-  void drawFacets();
-  void drawOneFacet(size_t index_);
+  void drawVertices(size_t count);
+
+  size_t drawFacets(const QMatrix4x4 &mvp, bool hidden = false);
+  bool drawSurface();
+  void drawEdges(size_t count_of_edges, size_t first_edge = 0);
+  void addFacetLines(std::vector<GLuint> &lines, size_t index_);
+  void drawLines(std::vector<GLuint> &lines);
+
+  void setVertexStyle();
+  void setEdgeStyle();
+  void drawPreview(const QMatrix4x4 &view);
+  static void fitIntoView(const bounds_t &bounds, GLfloat matrix[16]);
+  static QMatrix4x4 columnMatrix(const GLfloat values[16]);
+
+ signals:
+  // процент загрузки файла
+  void loadingProgress(int percent);
+  // загрузка завершена, прервана или не удалась
+  void loadingFinished(bool success);
+  // кадр начинается, накопленный ввод ещё можно применить
+  void frameStarting();
 
  private:
+  void finishLoading();
+  void buildLevels();
+  void finishLevels();
+  bool uploadGeometry();
+  bool uploadFaces();
+  void streamGeometry();
+  bool uploadLevel(size_t level);
+  void releaseBuffers();
+  void releaseLevelBuffers();
+  double pixelsPerUnit(const GLfloat model[16]) const;
+  size_t interactiveLevel(size_t level, size_t primitives) const;
+  void measureFrame();
+  void showDetail(size_t level, bool reduced);
+  QPointF viewPoint(const QMouseEvent *event) const;
+
   QTimer timer;
+
+  // шейдеры преобразования вершин и стилей точек и линий
+  QOpenGLShaderProgram program;
+  QOpenGLVertexArrayObject vertexArray;
+  int mvpLocation = -1;
+  int pointSizeLocation = -1;
+  int viewportLocation = -1;
+  int colorLocation = -1;
+  int styleLocation = -1;
+  // шейдеры линий, расширяющие их до заданной толщины
+  QOpenGLShaderProgram lineProgram;
+  int lineMvpLocation = -1;
+  int lineViewportLocation = -1;
+  int lineWidthLocation = -1;
+  int lineColorLocation = -1;
+  int lineStyleLocation = -1;
+  // матрица и размер окна в пикселях для рисуемых точек и линий
+  QMatrix4x4 drawMvp;
+  QVector2D viewportSize;
+
+  // буферы вершин и рёбер в памяти видеокарты
+  GLuint vertexBuffer = 0;
+  GLuint edgeBuffer = 0;
+  GLsizeiptr vertexBufferSize = 0;
+  bool vertexBufferDirty = true;
+  bool edgeBufferDirty = true;
+  bool buffersFailed = false;
+  // треугольники граней для проверки глубины в режиме невидимых линий и
+  // рёбра между кластерами
+  GLuint faceBuffer = 0;
+  GLuint boundaryBuffer = 0;
+  size_t faceIndices = 0;
+  bool faceBufferDirty = true;
+  bool faceBufferFailed = false;
+  // буферы для данных, которые передаются на каждом кадре
+  GLuint streamVertices = 0;
+  GLuint streamIndices = 0;
+  // буферы вершин и рёбер уровней детализации
+  GLuint levelBuffers[LOD_MAX_LEVELS][2] = {};
+  bool levelBuffersDirty = false;
+  bool levelBuffersFailed = false;
+  // диапазоны рёбер внутри окна, память переиспользуется между кадрами
+  bvh_ranges_t visibleEdges = {};
+  // рёбра на границах пропущенных кластеров в буфере boundaryBuffer
+  bvh_ranges_t boundaryEdges = {};
+  // матрица объекта на последнем кадре для лучей из окна
+  QMatrix4x4 objectMvp;
+  // количество индексов линий, передаваемых за раз
+  static constexpr size_t LINE_BATCH = (size_t)1 << 20;
+
+  // время от первого необработанного ввода до показа кадра
+  QElapsedTimer inputClock;
+  bool inputPending = false;
+  double latencySum = 0.0;
+  size_t latencyFrames = 0;
+
+  // во время движения объект рисуется упрощённым, после паузы - полностью
+  bool interacting = false;
+  QTimer idleTimer;
+  static constexpr int IDLE_DELAY_MS = 250;
+  // время рисования объекта видеокартой на одну вершину или ребро
+  QOpenGLTimerQuery frameQuery;
+  bool frameQueryPending = false;
+  size_t queriedPrimitives = 0;
+  double nsPerPrimitive = 0.0;
+  // нарисованный уровень детализации для сообщения о нём
+  size_t shownLevel = 0;
+  bool shownReduced = false;
+  QString fileInfo;
+
+  // положение мыши в прошлом событии перетаскивания
+  QPointF dragPoint;
+
+  // камера, вписывающая сферу вокруг объекта в окно
+  GLfloat viewFit[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+  // фоновая загрузка файла
+  QThread *loader = nullptr;
+  int loadGeneration = 0;
+  progress_t loadProgress = {};
+  data_t loadedData = {};
+  int loadError = 0;
+  QByteArray loadingFilename;
+  QTimer progressTimer;
+
+  // фоновое построение уровней детализации по копии описания объекта
+  QThread *lodBuilder = nullptr;
+  int lodGeneration = 0;
+  progress_t lodProgress = {};
+  data_t lodSource = {};
+  int lodError = 0;
+  // построение прервано загрузкой другого файла
+  bool levelsInterrupted = false;
+
+  // предпросмотр загружаемого объекта
+  QTimer previewTimer;
+  partial_t preview = {};
+  size_t previewScanned[MAX_PARSER_THREADS] = {};
+  // границы уже разобранных вершин
+  bounds_t previewBounds = {};
 };
 
 #endif  // GLWIDGET_H
@@ -1,4 +1,5 @@
 #include <QApplication>
+#include <QSurfaceFormat>
 
 #include "mainwindow.h"
 
@@ -14,8 +15,15 @@
  * @return Program exit status
  */
 int main(int argc, char *argv[]) {
+  // объект рисуется шейдерами, устаревшие функции OpenGL не нужны
+  QSurfaceFormat format;
+  format.setVersion(3, 3);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  // буфер глубины нужен граням, закрывающим невидимые линии
+  format.setDepthBufferSize(24);
+  QSurfaceFormat::setDefaultFormat(format);
+
   QApplication a(argc, argv);
-  setlocale(LC_NUMERIC, "C");
   MainWindow w;
   w.show();
   return a.exec();
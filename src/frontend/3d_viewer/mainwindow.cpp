@@ -4,11 +4,29 @@ MainWindow::MainWindow(QWidget *parent)
     : QWidget(parent), ui(new Ui::MainWindow) {
   ui->setupUi(this);
   loadSettings();
+
+  ui->loadProgressBar->hide();
+  ui->cancelLoad->hide();
+  connect(ui->openGLWidget, &GLWidget::loadingProgress, ui->loadProgressBar,
+          &QProgressBar::setValue);
+  connect(ui->openGLWidget, &GLWidget::loadingFinished, this,
+          &MainWindow::loadingFinished);
+  // ползунки применяются один раз за кадр
+  connect(ui->openGLWidget, &GLWidget::frameStarting, this,
+          &MainWindow::applySliders);
+  connect(new QShortcut(QKeySequence::Undo, this), &QShortcut::activated, this,
+          &MainWindow::undoTransform);
+  connect(new QShortcut(QKeySequence::Redo, this), &QShortcut::activated, this,
+          &MainWindow::redoTransform);
 }
 
 MainWindow::~MainWindow() {
+  // фоновые потоки останавливаются, пока интерфейс окна ещё существует
+  ui->openGLWidget->stopLoading();
+  ui->openGLWidget->cancelLevels();
   saveSettings();
-  free_memory(ui->openGLWidget->fp, &ui->openGLWidget->data);
+  history_free(&history);
+  free_memory(NULL, &ui->openGLWidget->data);
   delete ui;
 }
 
@@ -29,12 +47,38 @@ void MainWindow::on_openFile_clicked() {
 
   // вызов функции открытия файла, если выбран конкретный файл
   if (c_filename[0] != '\0') {
-    resetSliders();
     paintButtons();
-    strcpy(ui->openGLWidget->filename, c_filename);
 
-    // открытие файла
+    // открытие файла в фоновом потоке
     ui->openGLWidget->openFile(c_filename);
+    ui->loadProgressBar->show();
+    ui->cancelLoad->show();
+  }
+}
+
+/**
+ * @brief Cancel loading event
+ *
+ * Event which happens when cancelLoad button is clicked.
+ */
+void MainWindow::on_cancelLoad_clicked() { ui->openGLWidget->cancelLoading(); }
+
+/**
+ * @brief Loading finished
+ *
+ * Hides loading progress. The new object is not transformed yet, so the
+ * sliders are reset.
+ *
+ * @param success Object was loaded and replaced the previous one
+ */
+void MainWindow::loadingFinished(bool success) {
+  ui->loadProgressBar->hide();
+  ui->cancelLoad->hide();
+  if (success) {
+    resetSliders();
+    // история прежнего объекта к новому не относится
+    history_free(&history);
+    draggingStep = false;
   }
 }
 
@@ -146,6 +190,11 @@ void MainWindow::saveSettings() {
   settings.setValue("edgeMode", ui->openGLWidget->edgeMode);
   settings.setValue("vertexSize", ui->openGLWidget->vertexSize);
   settings.setValue("edgeWidth", ui->openGLWidget->edgeWidthVal);
+  settings.setValue("parserThreads",
+                    static_cast<qulonglong>(ui->openGLWidget->parserThreads));
+  settings.setValue("rendererMode", ui->openGLWidget->rendererMode);
+  settings.setValue("targetFrameTime", ui->openGLWidget->targetFrameMs);
+  settings.setValue("hiddenLines", ui->openGLWidget->hiddenLines);
 
   settings.setValue("vertexColorR", ui->openGLWidget->vertexColorArr[0]);
   settings.setValue("vertexColorG", ui->openGLWidget->vertexColorArr[1]);
@@ -197,6 +246,22 @@ void MainWindow::loadSettings() {
 
   ui->verticeSize->setValue(settings.value("vertexSize").toFloat() * 20);
   ui->edgeSize->setValue(settings.value("edgeWidth").toFloat());
+  ui->openGLWidget->parserThreads =
+      settings.value("parserThreads").toULongLong();
+  ui->parserThreads->setValue(
+      static_cast<int>(ui->openGLWidget->parserThreads));
+  ui->openGLWidget->rendererMode =
+      static_cast<GLWidget::renderer_t>(settings.value("rendererMode").toInt());
+  if (ui->openGLWidget->rendererMode == GLWidget::RETAINED) {
+    ui->retained->setChecked(true);
+  } else {
+    ui->immediate->setChecked(true);
+  }
+  ui->openGLWidget->targetFrameMs =
+      settings.value("targetFrameTime", 16.0).toDouble();
+  ui->targetFrameTime->setValue(ui->openGLWidget->targetFrameMs);
+  ui->openGLWidget->hiddenLines = settings.value("hiddenLines").toBool();
+  ui->hiddenLines->setChecked(ui->openGLWidget->hiddenLines);
 
   ui->openGLWidget->vertexColorArr[0] = settings.value("vertexColorR").toUInt();
   ui->openGLWidget->vertexColorArr[1] = settings.value("vertexColorG").toUInt();
@@ -246,8 +311,7 @@ void MainWindow::paintButtons() {
 void MainWindow::on_pushButton_zoom_clicked() {
   float zoom_line = ui->edit_zoom->text().toFloat();
 
-  scale_even(&ui->openGLWidget->data.obj_matrix, zoom_line);
-  ui->openGLWidget->update();
+  addOperation({OPERATION_SCALE, zoom_line, zoom_line, zoom_line});
 }
 
 /**
@@ -256,8 +320,7 @@ void MainWindow::on_pushButton_zoom_clicked() {
  * Happens when scale+ button is pressed.
  */
 void MainWindow::on_zoomPlus_clicked() {
-  scale_even(&ui->openGLWidget->data.obj_matrix, 1.1111f);
-  ui->openGLWidget->update();
+  addOperation({OPERATION_SCALE, 1.1111f, 1.1111f, 1.1111f});
 }
 
 /**
@@ -266,8 +329,7 @@ void MainWindow::on_zoomPlus_clicked() {
  * Happens when scale- button is pressed.
  */
 void MainWindow::on_zoomMinus_clicked() {
-  scale_even(&ui->openGLWidget->data.obj_matrix, 0.9f);
-  ui->openGLWidget->update();
+  addOperation({OPERATION_SCALE, 0.9f, 0.9f, 0.9f});
 }
 
 /**
@@ -280,9 +342,11 @@ void MainWindow::on_pushButton_rotate_clicked() {
   float y_rotate_line = ui->edit_rotateY->text().toFloat();
   float z_rotate_line = ui->edit_rotateZ->text().toFloat();
 
-  ui->rotateX->setValue(rotateX_val_abs + x_rotate_line);
-  ui->rotateY->setValue(rotateY_val_abs + y_rotate_line);
-  ui->rotateZ->setValue(rotateZ_val_abs + z_rotate_line);
+  // три поворота применяются на ближайшем кадре одной операцией
+  setSliderSilently(ui->rotateX, ui->rotateX->value() + x_rotate_line);
+  setSliderSilently(ui->rotateY, ui->rotateY->value() + y_rotate_line);
+  setSliderSilently(ui->rotateZ, ui->rotateZ->value() + z_rotate_line);
+  queueSliders();
 }
 
 /**
@@ -290,33 +354,21 @@ void MainWindow::on_pushButton_rotate_clicked() {
  *
  * This is the logic of rotateX slider.
  */
-void MainWindow::on_rotateX_valueChanged(int value) {
-  rotate_by_ox(&ui->openGLWidget->data.obj_matrix, rotateX_val_abs - value);
-  rotateX_val_abs = value;
-  ui->openGLWidget->update();
-}
+void MainWindow::on_rotateX_valueChanged(int) { queueSliders(); }
 
 /**
  * @brief Rotate around OY slider
  *
  * This is the logic of rotateY slider.
  */
-void MainWindow::on_rotateY_valueChanged(int value) {
-  rotate_by_oy(&ui->openGLWidget->data.obj_matrix, rotateY_val_abs - value);
-  rotateY_val_abs = value;
-  ui->openGLWidget->update();
-}
+void MainWindow::on_rotateY_valueChanged(int) { queueSliders(); }
 
 /**
  * @brief Rotate around OZ slider
  *
  * This is the logic of rotateZ slider.
  */
-void MainWindow::on_rotateZ_valueChanged(int value) {
-  rotate_by_oz(&ui->openGLWidget->data.obj_matrix, rotateZ_val_abs - value);
-  rotateZ_val_abs = value;
-  ui->openGLWidget->update();
-}
+void MainWindow::on_rotateZ_valueChanged(int) { queueSliders(); }
 
 /**
  * @brief Move input field
@@ -328,9 +380,11 @@ void MainWindow::on_pushButton_move_clicked() {
   float y_move_line = ui->edit_moveY->text().toDouble();
   float z_move_line = ui->edit_moveZ->text().toDouble();
 
-  ui->moveX->setValue(moveX_val_abs + x_move_line);
-  ui->moveY->setValue(moveY_val_abs + y_move_line);
-  ui->moveZ->setValue(moveZ_val_abs + z_move_line);
+  // три перемещения применяются на ближайшем кадре одной операцией
+  setSliderSilently(ui->moveX, ui->moveX->value() + x_move_line);
+  setSliderSilently(ui->moveY, ui->moveY->value() + y_move_line);
+  setSliderSilently(ui->moveZ, ui->moveZ->value() + z_move_line);
+  queueSliders();
 }
 
 /**
@@ -338,35 +392,95 @@ void MainWindow::on_pushButton_move_clicked() {
  *
  * This is the logic of moveX slider.
  */
-void MainWindow::on_moveX_valueChanged(int value) {
-  move_by_ox(&ui->openGLWidget->data.obj_matrix,
-             (value - moveX_val_abs) * 0.01f);
-  moveX_val_abs = value;
-  ui->openGLWidget->update();
-}
+void MainWindow::on_moveX_valueChanged(int) { queueSliders(); }
 
 /**
  * @brief Move by OY slider
  *
  * This is the logic of moveY slider.
  */
-void MainWindow::on_moveY_valueChanged(int value) {
-  move_by_oy(&ui->openGLWidget->data.obj_matrix,
-             (value - moveY_val_abs) * 0.01f);
-  moveY_val_abs = value;
-  ui->openGLWidget->update();
-}
+void MainWindow::on_moveY_valueChanged(int) { queueSliders(); }
 
 /**
  * @brief Move by OZ slider
  *
  * This is the logic of moveZ slider.
  */
-void MainWindow::on_moveZ_valueChanged(int value) {
-  move_by_oz(&ui->openGLWidget->data.obj_matrix,
-             (value - moveZ_val_abs) * 0.01f);
-  moveZ_val_abs = value;
-  ui->openGLWidget->update();
+void MainWindow::on_moveZ_valueChanged(int) { queueSliders(); }
+
+/**
+ * @brief Queue sliders
+ *
+ * Sliders only remember where they were moved. Here the difference between
+ * their positions and the queued ones becomes an operation waiting for the
+ * next frame, so rotations and moves are applied in the order they were
+ * made.
+ */
+void MainWindow::queueSliders() {
+  float rotate_x = ui->rotateX->value(), rotate_y = ui->rotateY->value(),
+        rotate_z = ui->rotateZ->value();
+  float move_x = ui->moveX->value(), move_y = ui->moveY->value(),
+        move_z = ui->moveZ->value();
+
+  if (rotate_x != rotateX_val_abs || rotate_y != rotateY_val_abs ||
+      rotate_z != rotateZ_val_abs) {
+    queueOperation({OPERATION_ROTATE, rotateX_val_abs - rotate_x,
+                    rotateY_val_abs - rotate_y, rotateZ_val_abs - rotate_z});
+  }
+  if (move_x != moveX_val_abs || move_y != moveY_val_abs ||
+      move_z != moveZ_val_abs) {
+    queueOperation({OPERATION_MOVE, (move_x - moveX_val_abs) * 0.01f,
+                    (move_y - moveY_val_abs) * 0.01f,
+                    (move_z - moveZ_val_abs) * 0.01f});
+  }
+
+  rotateX_val_abs = rotate_x;
+  rotateY_val_abs = rotate_y;
+  rotateZ_val_abs = rotate_z;
+  moveX_val_abs = move_x;
+  moveY_val_abs = move_y;
+  moveZ_val_abs = move_z;
+  ui->openGLWidget->inputChanged();
+}
+
+/**
+ * @brief Queue operation
+ *
+ * Adds an operation to the ones waiting for the next frame. It is added
+ * into the last waiting one by merge_operation when that gives the same
+ * transform, so a drag along one axis makes one operation per frame however
+ * many steps it made. Rotations by different axes stay in their order.
+ *
+ * @param operation Operation to queue
+ */
+void MainWindow::queueOperation(const operation_t &operation) {
+  // складываются только операции, порядок которых не важен, как в истории
+  if (pendingOperations.isEmpty() ||
+      merge_operation(&pendingOperations.last(), &operation) == 0) {
+    pendingOperations.append(operation);
+  }
+}
+
+/**
+ * @brief Apply sliders
+ *
+ * Called once before every frame. Operations queued by the sliders since the
+ * previous frame are added to the transform as one batch in their order.
+ */
+void MainWindow::applySliders() {
+  if (!pendingOperations.isEmpty()) {
+    const operation_t *operations = pendingOperations.constData();
+    size_t count = pendingOperations.size();
+    transform_compose(&ui->openGLWidget->transform, operations, count);
+    // перетаскивание ползунка записывается в историю одним шагом
+    bool dragging = ui->rotateX->isSliderDown() ||
+                    ui->rotateY->isSliderDown() ||
+                    ui->rotateZ->isSliderDown() || ui->moveX->isSliderDown() ||
+                    ui->moveY->isSliderDown() || ui->moveZ->isSliderDown();
+    recordStep(operations, count, dragging && draggingStep);
+    draggingStep = dragging;
+    pendingOperations.clear();
+  }
 }
 
 /**
@@ -439,28 +553,113 @@ void MainWindow::on_solid_clicked() {
   ui->openGLWidget->update();
 }
 
+/**
+ * @brief Set parser threads
+ *
+ * This happens when the value of spin box parser threads is changed. The
+ * number is used for the next loaded file, 0 takes all processors.
+ *
+ * @param value Number of threads
+ */
+void MainWindow::on_parserThreads_valueChanged(int value) {
+  ui->openGLWidget->parserThreads = static_cast<size_t>(value);
+}
+
+/**
+ * @brief Keep the object in video memory
+ *
+ * This happens when radio button retained is pressed.
+ */
+void MainWindow::on_retained_clicked() {
+  ui->openGLWidget->rendererMode = GLWidget::RETAINED;
+  ui->openGLWidget->update();
+}
+
+/**
+ * @brief Pass the object on every frame
+ *
+ * This happens when radio button immediate is pressed.
+ */
+void MainWindow::on_immediate_clicked() {
+  ui->openGLWidget->rendererMode = GLWidget::IMMEDIATE;
+  ui->openGLWidget->update();
+}
+
+/**
+ * @brief Set target frame time
+ *
+ * This happens when the value of spin box frame time is changed. While the
+ * object is moved, its detail is reduced to keep this time, 0 keeps the
+ * full detail.
+ *
+ * @param value Time of a frame in milliseconds
+ */
+void MainWindow::on_targetFrameTime_valueChanged(double value) {
+  ui->openGLWidget->targetFrameMs = value;
+  ui->openGLWidget->update();
+}
+
+/**
+ * @brief Hide lines
+ *
+ * This happens when check box hidden lines is toggled. Faces of the object
+ * then hide vertices and edges behind them.
+ *
+ * @param checked The check box is checked
+ */
+void MainWindow::on_hiddenLines_toggled(bool checked) {
+  ui->openGLWidget->hiddenLines = checked;
+  ui->openGLWidget->update();
+}
+
 /**
  * @brief Reset object position
  *
- * Loads the object again hence resetting any changes to its position.
+ * Returns the object to its position after loading, without reading the
+ * file again.
  */
 void MainWindow::on_resetPosition_clicked() {
+  const operation_t reset = {OPERATION_RESET, 0.0f, 0.0f, 0.0f};
+  ui->openGLWidget->resetTransform();
   resetSliders();
-  ui->openGLWidget->openFile(ui->openGLWidget->filename);
+  recordStep(&reset, 1, false);
+}
+
+/**
+ * @brief Set slider silently
+ *
+ * Moves a slider without calling its handler.
+ *
+ * @param slider Slider to move
+ * @param value Wanted position, limited by the range of the slider
+ *
+ * @return Position the slider took
+ */
+int MainWindow::setSliderSilently(QScrollBar *slider, float value) {
+  slider->blockSignals(true);
+  slider->setValue(value);
+  slider->blockSignals(false);
+
+  return slider->value();
 }
 
 /**
  * @brief Reset slider positions
  *
- * Resets sliders to its normal positions.
+ * Resets sliders to its normal positions without transforming the object.
+ * Slider moves waiting for the next frame are dropped.
  */
 void MainWindow::resetSliders() {
-  ui->moveX->setValue(0);
-  ui->moveY->setValue(0);
-  ui->moveZ->setValue(0);
-  ui->rotateX->setValue(0);
-  ui->rotateY->setValue(0);
-  ui->rotateZ->setValue(0);
+  QScrollBar *sliders[] = {ui->moveX,   ui->moveY,   ui->moveZ,
+                           ui->rotateX, ui->rotateY, ui->rotateZ};
+  for (QScrollBar *slider : sliders) {
+    slider->blockSignals(true);
+    slider->setValue(0);
+    slider->blockSignals(false);
+  }
+  rotateX_val_abs = rotateY_val_abs = rotateZ_val_abs = 0.0f;
+  moveX_val_abs = moveY_val_abs = moveZ_val_abs = 0.0f;
+  pendingOperations.clear();
 }
 
 /**
@@ -545,3 +744,97 @@ void MainWindow::on_edgeColor_clicked() {
     ui->openGLWidget->update();
   }
 }
+
+/**
+ * @brief Add operation
+ *
+ * Adds an operation to the transform and to the history right away.
+ * Slider moves waiting for the next frame are applied before it.
+ *
+ * @param operation Operation to add
+ */
+void MainWindow::addOperation(const operation_t &operation) {
+  applySliders();
+  transform_compose(&ui->openGLWidget->transform, &operation, 1);
+  recordStep(&operation, 1, false);
+  ui->openGLWidget->update();
+}
+
+/**
+ * @brief Record step
+ *
+ * Adds applied operations to the history. If memory runs out the history is
+ * dropped, so undo never leads to a wrong position.
+ *
+ * @param operations Applied operations
+ * @param count Number of operations
+ * @param merge Add operations to the previous step
+ */
+void MainWindow::recordStep(const operation_t *operations, size_t count,
+                            bool merge) {
+  if (history_record(&history, operations, count, merge) != 0) {
+    history_free(&history);
+  }
+  if (!merge) draggingStep = false;
+}
+
+/**
+ * @brief Undo transform
+ *
+ * Returns the object to the position before the last step.
+ */
+void MainWindow::undoTransform() {
+  applySliders();
+  if (history_undo(&history) == 0) showHistory();
+}
+
+/**
+ * @brief Redo transform
+ *
+ * Repeats the last undone step.
+ */
+void MainWindow::redoTransform() {
+  applySliders();
+  if (history_redo(&history) == 0) showHistory();
+}
+
+/**
+ * @brief Show history
+ *
+ * Builds the transform of the current point of the history from the identity
+ * one the object has after loading, without a pass over vertices, and moves
+ * the sliders to the positions they had at that point.
+ */
+void MainWindow::showHistory() {
+  transform_t loaded;
+  transform_reset(&loaded);
+  history_transform(&history, &loaded, &ui->openGLWidget->transform);
+
+  // ползунки двигаются поворотами и перемещениями после последнего сброса
+  size_t count = 0;
+  const operation_t *operations = history_operations(&history, &count);
+  float rotate[3] = {0.0f, 0.0f, 0.0f}, move[3] = {0.0f, 0.0f, 0.0f};
+  for (size_t i = 0; i < count; i++) {
+    const operation_t &operation = operations[i];
+    if (operation.type == OPERATION_RESET) {
+      rotate[0] = rotate[1] = rotate[2] = 0.0f;
+      move[0] = move[1] = move[2] = 0.0f;
+    } else if (operation.type == OPERATION_ROTATE) {
+      rotate[0] -= operation.x;
+      rotate[1] -= operation.y;
+      rotate[2] -= operation.z;
+    } else if (operation.type == OPERATION_MOVE) {
+      move[0] += operation.x * 100.0f;
+      move[1] += operation.y * 100.0f;
+      move[2] += operation.z * 100.0f;
+    }
+  }
+  rotateX_val_abs = setSliderSilently(ui->rotateX, qRound(rotate[0]));
+  rotateY_val_abs = setSliderSilently(ui->rotateY, qRound(rotate[1]));
+  rotateZ_val_abs = setSliderSilently(ui->rotateZ, qRound(rotate[2]));
+  moveX_val_abs = setSliderSilently(ui->moveX, qRound(move[0]));
+  moveY_val_abs = setSliderSilently(ui->moveY, qRound(move[1]));
+  moveZ_val_abs = setSliderSilently(ui->moveZ, qRound(move[2]));
+  draggingStep = false;
+  ui->openGLWidget->update();
+}
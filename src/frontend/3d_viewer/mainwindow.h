@@ -8,6 +8,7 @@
 #include <QProcess>
 #include <QScreen>
 #include <QSettings>
+#include <QShortcut>
 #include <QWidget>
 #include <QtCore>
 #include <QtGui>
@@ -68,7 +69,20 @@ class MainWindow : public QWidget {
   void on_dashed_clicked();
   void on_solid_clicked();
 
+  void on_parserThreads_valueChanged(int value);
+  void on_retained_clicked();
+  void on_immediate_clicked();
+  void on_targetFrameTime_valueChanged(double value);
+  void on_hiddenLines_toggled(bool checked);
+
   void on_resetPosition_clicked();
+  void on_cancelLoad_clicked();
+  void loadingFinished(bool success);
+  void queueSliders();
+  void queueOperation(const operation_t &operation);
+  void applySliders();
+  void undoTransform();
+  void redoTransform();
 
   void on_verticeSize_valueChanged(int value);
   void on_edgeSize_valueChanged(int value);
@@ -84,6 +98,10 @@ class MainWindow : public QWidget {
   void saveSettings();
   void loadSettings();
   void resetSliders();
+  int setSliderSilently(QScrollBar *slider, float value);
+  void addOperation(const operation_t &operation);
+  void recordStep(const operation_t *operations, size_t count, bool merge);
+  void showHistory();
   void paintButtons();
 
  private:
@@ -95,6 +113,15 @@ class MainWindow : public QWidget {
   QTimer *timer_gif;
   QFile *save_file_gif;
 
+  // шаги преобразования для отмены и повтора
+  history_t history = {};
+  // последний шаг - ещё не законченное перетаскивание ползунка
+  bool draggingStep = false;
+
+  // операции ползунков до ближайшего кадра в порядке их движения
+  QVector<operation_t> pendingOperations;
+
+  // положения ползунков, уже поставленные в очередь
   float rotateX_val_abs = 0.0;
   float rotateY_val_abs = 0.0;
   float rotateZ_val_abs = 0.0;
@@ -0,0 +1,144 @@
+#include "tests.h"
+
+// несколько блоков и неполный последний
+#define COUNT (BOUNDS_BLOCK * 70 + 123)
+
+/**
+ * @brief Make vertices
+ *
+ * Allocates vertices on a spiral, so every block has its own box.
+ */
+static matrix_t make_vertices(void) {
+  data_t data = {.obj_matrix.rows = COUNT, .obj_matrix.cols = 3};
+  ck_assert_int_eq(matrix_mem_alloc(&data), 0);
+  for (size_t i = 0; i < COUNT; i++) {
+    float* vertex = matrix_vertex(&data.obj_matrix, i);
+    vertex[0] = cosf(i * 0.001f) * (float)i * 0.01f;
+    vertex[1] = sinf(i * 0.001f) * (float)i * 0.01f;
+    vertex[2] = (float)(i % 977) - 400.0f;
+  }
+
+  return data.obj_matrix;
+}
+
+/**
+ * @brief Scalar box
+ *
+ * Box of all vertices found by a plain loop.
+ */
+static bounds_t scalar_box(const matrix_t* A) {
+  bounds_t box;
+  bounds_reset(&box);
+  for (size_t i = 0; i < A->rows; i++) {
+    const float* vertex = matrix_vertex(A, i);
+    for (int k = 0; k < 3; k++) {
+      box.min[k] = fminf(box.min[k], vertex[k]);
+      box.max[k] = fmaxf(box.max[k], vertex[k]);
+    }
+  }
+
+  return box;
+}
+
+START_TEST(bounds_test1) {
+  // коробка на пуле потоков совпадает с простым циклом
+  matrix_t vertices = make_vertices();
+  bounds_t expected = scalar_box(&vertices);
+  bounds_t box;
+  bounds_reset(&box);
+  bounds_compute(&box, &vertices, 0, COUNT);
+  ck_assert_mem_eq(box.min, expected.min, sizeof(box.min));
+  ck_assert_mem_eq(box.max, expected.max, sizeof(box.max));
+
+  // часть вершин только расширяет уже найденную коробку
+  bounds_t part;
+  bounds_reset(&part);
+  bounds_compute(&part, &vertices, 0, 10);
+  bounds_compute(&part, &vertices, 10, COUNT - 10);
+  ck_assert_mem_eq(part.min, expected.min, sizeof(part.min));
+  ck_assert_mem_eq(part.max, expected.max, sizeof(part.max));
+
+  free(vertices.matrix);
+}
+
+START_TEST(bounds_test2) {
+  // пересчёт изменённых блоков даёт ту же коробку, что и полный
+  matrix_t vertices = make_vertices();
+  block_bounds_t blocks = {0};
+  ck_assert_int_eq(block_bounds_build(&blocks, &vertices), 0);
+  ck_assert_uint_eq(blocks.count_of_blocks, 71);
+
+  bounds_t box;
+  block_bounds_box(&blocks, &box);
+  bounds_t expected = scalar_box(&vertices);
+  ck_assert_mem_eq(box.min, expected.min, sizeof(box.min));
+  ck_assert_mem_eq(box.max, expected.max, sizeof(box.max));
+
+  // вершины сдвигаются внутрь, коробка должна уменьшиться
+  for (size_t i = COUNT - 3000; i < COUNT; i++) {
+    float* vertex = matrix_vertex(&vertices, i);
+    vertex[0] = vertex[1] = vertex[2] = 0.0f;
+  }
+  matrix_vertex(&vertices, 5)[2] = 5000.0f;
+  block_bounds_update(&blocks, &vertices, COUNT - 3000, 3000);
+  block_bounds_update(&blocks, &vertices, 5, 1);
+  block_bounds_box(&blocks, &box);
+  expected = scalar_box(&vertices);
+  ck_assert_mem_eq(box.min, expected.min, sizeof(box.min));
+  ck_assert_mem_eq(box.max, expected.max, sizeof(box.max));
+  ck_assert_float_eq(box.max[2], 5000.0f);
+
+  // диапазон за концом объекта обрезается
+  block_bounds_update(&blocks, &vertices, COUNT - 1, 100);
+  block_bounds_update(&blocks, &vertices, COUNT, 100);
+
+  block_bounds_free(&blocks);
+  ck_assert_ptr_null(blocks.boxes);
+  free(vertices.matrix);
+}
+
+START_TEST(bounds_test3) {
+  // границы разбора совпадают при любом количестве потоков
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/tree.obj", &data), 0);
+  bounds_t expected = scalar_box(&data.obj_matrix);
+  ck_assert_mem_eq(data.bounds.min, expected.min, sizeof(expected.min));
+  ck_assert_mem_eq(data.bounds.max, expected.max, sizeof(expected.max));
+
+  size_t threads[] = {1, 2, 7};
+  for (size_t t = 0; t < 3; t++) {
+    data_t parallel = {0};
+    ck_assert_int_eq(parse_obj_file_parallel("frontend/objects/tree.obj",
+                                             &parallel, threads[t], NULL),
+                     0);
+    ck_assert_mem_eq(&parallel.bounds, &data.bounds, sizeof(bounds_t));
+    free_memory(NULL, &parallel);
+  }
+
+  free_memory(NULL, &data);
+}
+
+Suite* bounds_test_suite() {
+  Suite* suite = suite_create("bounds_test");
+  TCase* tcase = tcase_create("bounds_test_case");
+
+  tcase_add_test(tcase, bounds_test1);
+  tcase_add_test(tcase, bounds_test2);
+  tcase_add_test(tcase, bounds_test3);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int bounds_tests() {
+  Suite* suite = bounds_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -0,0 +1,360 @@
+#include "tests.h"
+
+static int compare_edges(const void* a, const void* b) {
+  const uint32_t* x = a;
+  const uint32_t* y = b;
+  int result = (x[0] > y[0]) - (x[0] < y[0]);
+  return result != 0 ? result : (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/**
+ * @brief Sorted edges
+ *
+ * Copies edges of the object sorted by vertex numbers.
+ */
+static uint32_t* sorted_edges(const data_t* data) {
+  size_t count = data->obj_edges.count_of_edges;
+  uint32_t* edges = malloc((count + 1) * 2 * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(edges);
+  memcpy(edges, data->obj_edges.indices, count * 2 * sizeof(uint32_t));
+  qsort(edges, count, 2 * sizeof(uint32_t), compare_edges);
+  return edges;
+}
+
+/**
+ * @brief Facet has edge
+ *
+ * Checks that the edge with vertex numbers from 0 is a side of the facet.
+ */
+static int facet_has_edge(const data_t* data, size_t facet,
+                          const uint32_t* edge) {
+  size_t count = facet_size(&data->obj_facets, facet);
+  int found = 0;
+  for (size_t k = 0; k < count; k++) {
+    size_t a = facet_vertex(&data->obj_facets, facet, k) - 1;
+    size_t b = facet_vertex(&data->obj_facets, facet, (k + 1) % count) - 1;
+    if ((a == edge[0] && b == edge[1]) || (a == edge[1] && b == edge[0])) {
+      found = 1;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Check node
+ *
+ * The box of the node holds vertices of its facets, children split its
+ * facets and edges, and edges of a leaf are sides of its facets.
+ */
+static void check_node(const data_t* data, uint32_t index) {
+  const bvh_t* B = &data->obj_bvh;
+  const bvh_node_t* node = &B->nodes[index];
+  ck_assert_uint_lt(index, B->count_of_nodes);
+  ck_assert_uint_le(1, node->count_of_facets);
+
+  for (uint32_t i = 0; i < node->count_of_facets; i++) {
+    size_t facet = B->facets[node->first_facet + i];
+    for (size_t k = 0; k < facet_size(&data->obj_facets, facet); k++) {
+      const float* vertex = matrix_vertex(
+          &data->obj_matrix, facet_vertex(&data->obj_facets, facet, k) - 1);
+      for (int c = 0; c < 3; c++) {
+        ck_assert_float_le(node->min[c], vertex[c]);
+        ck_assert_float_le(vertex[c], node->max[c]);
+      }
+    }
+  }
+
+  if (node->right != 0) {
+    const bvh_node_t* left = &B->nodes[index + 1];
+    const bvh_node_t* right = &B->nodes[node->right];
+    ck_assert_uint_eq(left->first_facet, node->first_facet);
+    ck_assert_uint_eq(right->first_facet,
+                      left->first_facet + left->count_of_facets);
+    ck_assert_uint_eq(left->count_of_facets + right->count_of_facets,
+                      node->count_of_facets);
+    ck_assert_uint_eq(left->first_edge, node->first_edge);
+    ck_assert_uint_eq(right->first_edge,
+                      left->first_edge + left->count_of_edges);
+    ck_assert_uint_eq(left->count_of_edges + right->count_of_edges,
+                      node->count_of_edges);
+    check_node(data, index + 1);
+    check_node(data, node->right);
+  } else {
+    for (uint32_t e = 0; e < node->count_of_edges; e++) {
+      const uint32_t* edge =
+          data->obj_edges.indices + (size_t)(node->first_edge + e) * 2;
+      int found = 0;
+      for (uint32_t i = 0; i < node->count_of_facets; i++) {
+        found |= facet_has_edge(data, B->facets[node->first_facet + i], edge);
+      }
+      ck_assert_int_eq(found, 1);
+    }
+  }
+}
+
+/**
+ * @brief Check hierarchy
+ *
+ * Every facet is in the hierarchy once and edges are only reordered.
+ */
+static void check_bvh(const data_t* data, const uint32_t* edges) {
+  const bvh_t* B = &data->obj_bvh;
+  ck_assert_uint_eq(B->count_of_facets, data->count_of_facets);
+  ck_assert_int_eq(B->ordered_edges, 1);
+  ck_assert_uint_eq(B->nodes[0].first_edge, 0);
+  ck_assert_uint_eq(B->nodes[0].count_of_edges,
+                    data->obj_edges.count_of_edges);
+
+  char* seen = calloc(data->count_of_facets, 1);
+  ck_assert_ptr_nonnull(seen);
+  for (size_t i = 0; i < B->count_of_facets; i++) {
+    ck_assert_uint_lt(B->facets[i], data->count_of_facets);
+    ck_assert_int_eq(seen[B->facets[i]], 0);
+    seen[B->facets[i]] = 1;
+  }
+  free(seen);
+
+  uint32_t* ordered = sorted_edges(data);
+  ck_assert_int_eq(memcmp(ordered, edges,
+                          data->obj_edges.count_of_edges * 2 *
+                              sizeof(uint32_t)),
+                   0);
+  free(ordered);
+  check_node(data, 0);
+}
+
+// большая сетка строится параллельно, та же сетка - одним потоком
+START_TEST(bvh_test1) {
+  size_t threads[] = {0, 1};
+  for (size_t t = 0; t < 2; t++) {
+    data_t data;
+    make_grid(&data, 200, 0.2f);
+    ck_assert_int_eq(build_edges(&data, 0), 0);
+    uint32_t* edges = sorted_edges(&data);
+
+    ck_assert_int_eq(build_bvh(&data, threads[t]), 0);
+    check_bvh(&data, edges);
+    // листья не крупнее четырёх полигонов, кроме совпадающих центров
+    ck_assert_uint_le(data.count_of_facets / 4, data.obj_bvh.count_of_nodes);
+
+    free(edges);
+    free_memory(NULL, &data);
+  }
+}
+
+// отсечение по пирамиде видимости
+START_TEST(bvh_test2) {
+  data_t data;
+  make_grid(&data, 100, 0.0f);
+  ck_assert_int_eq(build_edges(&data, 0), 0);
+  ck_assert_int_eq(build_bvh(&data, 0), 0);
+  size_t count_of_edges = data.obj_edges.count_of_edges;
+  bvh_ranges_t ranges = {0};
+
+  // сетка целиком внутри куба от -1 до 1
+  float mvp[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  ck_assert_int_eq(bvh_cull(&data.obj_bvh, mvp, &ranges), 0);
+  ck_assert_uint_eq(ranges.count_of_ranges, 1);
+  ck_assert_uint_eq(ranges.ranges[0], 0);
+  ck_assert_uint_eq(ranges.ranges[1], count_of_edges);
+
+  // видна правая половина сетки
+  mvp[12] = -1.5f;
+  ck_assert_int_eq(bvh_cull(&data.obj_bvh, mvp, &ranges), 0);
+  char* drawn = calloc(count_of_edges, 1);
+  ck_assert_ptr_nonnull(drawn);
+  size_t total = 0, previous_end = 0;
+  for (size_t r = 0; r < ranges.count_of_ranges; r++) {
+    size_t first = ranges.ranges[r * 2], count = ranges.ranges[r * 2 + 1];
+    ck_assert_uint_le(previous_end, first);
+    ck_assert_uint_le(first + count, count_of_edges);
+    memset(drawn + first, 1, count);
+    previous_end = first + count;
+    total += count;
+  }
+  ck_assert_uint_lt(total, count_of_edges * 3 / 4);
+  for (size_t e = 0; e < count_of_edges; e++) {
+    const uint32_t* edge = data.obj_edges.indices + e * 2;
+    float x = matrix_vertex(&data.obj_matrix, edge[0])[0];
+    if (x > 0.51f) ck_assert_int_eq(drawn[e], 1);
+  }
+  free(drawn);
+
+  // сетка вне окна
+  mvp[12] = 10.0f;
+  ck_assert_int_eq(bvh_cull(&data.obj_bvh, mvp, &ranges), 0);
+  ck_assert_uint_eq(ranges.count_of_ranges, 0);
+
+  // без упорядоченных рёбер диапазоны не строятся
+  bvh_t unordered = data.obj_bvh;
+  unordered.ordered_edges = 0;
+  ck_assert_int_eq(bvh_cull(&unordered, mvp, &ranges), 1);
+
+  bvh_ranges_free(&ranges);
+  free_memory(NULL, &data);
+}
+
+/**
+ * @brief Brute force hit
+ *
+ * Intersects the ray with the plane of every triangle of every facet and
+ * checks barycentric coordinates.
+ */
+static double brute_force_hit(const data_t* data, const float origin[3],
+                              const float direction[3], size_t* facet) {
+  double best = INFINITY;
+  for (size_t f = 0; f < data->count_of_facets; f++) {
+    for (size_t k = 1; k + 1 < facet_size(&data->obj_facets, f); k++) {
+      const float* p[3] = {
+          matrix_vertex(&data->obj_matrix,
+                        facet_vertex(&data->obj_facets, f, 0) - 1),
+          matrix_vertex(&data->obj_matrix,
+                        facet_vertex(&data->obj_facets, f, k) - 1),
+          matrix_vertex(&data->obj_matrix,
+                        facet_vertex(&data->obj_facets, f, k + 1) - 1)};
+      double u[3], v[3], n[3];
+      for (int c = 0; c < 3; c++) {
+        u[c] = p[1][c] - p[0][c];
+        v[c] = p[2][c] - p[0][c];
+      }
+      n[0] = u[1] * v[2] - u[2] * v[1];
+      n[1] = u[2] * v[0] - u[0] * v[2];
+      n[2] = u[0] * v[1] - u[1] * v[0];
+      double along = n[0] * direction[0] + n[1] * direction[1] +
+                     n[2] * direction[2];
+      double t = (n[0] * (p[0][0] - origin[0]) + n[1] * (p[0][1] - origin[1]) +
+                  n[2] * (p[0][2] - origin[2])) /
+                 along;
+      if (along == 0.0 || !(t >= 0.0) || !(t < best)) continue;
+
+      // точка лежит по одну сторону от всех сторон треугольника
+      double point[3];
+      for (int c = 0; c < 3; c++) point[c] = origin[c] + direction[c] * t;
+      int inside = 1;
+      for (int s = 0; s < 3; s++) {
+        const float* a = p[s];
+        const float* b = p[(s + 1) % 3];
+        double e[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double w[3] = {point[0] - a[0], point[1] - a[1], point[2] - a[2]};
+        double side = n[0] * (e[1] * w[2] - e[2] * w[1]) +
+                      n[1] * (e[2] * w[0] - e[0] * w[2]) +
+                      n[2] * (e[0] * w[1] - e[1] * w[0]);
+        if (side < 0.0) inside = 0;
+      }
+      if (inside) {
+        best = t;
+        *facet = f;
+      }
+    }
+  }
+  return best;
+}
+
+// лучи сверху, снизу и сбоку совпадают с перебором всех полигонов
+START_TEST(bvh_test3) {
+  data_t data;
+  make_grid(&data, 48, 0.3f);
+  ck_assert_int_eq(build_edges(&data, 0), 0);
+  ck_assert_int_eq(build_bvh(&data, 0), 0);
+
+  srand(7);
+  for (int i = 0; i < 300; i++) {
+    float x = (float)rand() / RAND_MAX, y = (float)rand() / RAND_MAX;
+    float z = i % 2 == 0 ? 2.0f : -2.0f;
+    float origin[3] = {x, y, z};
+    float direction[3] = {((float)rand() / RAND_MAX - 0.5f) * 0.4f,
+                          ((float)rand() / RAND_MAX - 0.5f) * 0.4f, -z};
+    if (i % 3 == 0) {
+      // луч под малым углом к сетке
+      origin[0] = -1.0f;
+      origin[2] = 0.0f;
+      direction[0] = 1.0f;
+      direction[1] = 0.0f;
+      direction[2] = ((float)rand() / RAND_MAX - 0.5f) * 0.2f;
+    }
+
+    size_t expected_facet = 0;
+    double expected =
+        brute_force_hit(&data, origin, direction, &expected_facet);
+    bvh_hit_t hit = {0};
+    int found = bvh_raycast(&data, origin, direction, &hit);
+    ck_assert_int_eq(found, expected < INFINITY);
+    if (found) {
+      ck_assert_double_eq_tol(hit.distance, expected, 1e-4);
+      for (int c = 0; c < 3; c++) {
+        ck_assert_float_eq_tol(hit.point[c],
+                               origin[c] + direction[c] * expected, 1e-3f);
+      }
+      // на общей стороне полигонов подходит любой из них
+      const float* a = matrix_vertex(
+          &data.obj_matrix,
+          facet_vertex(&data.obj_facets, expected_facet, 0) - 1);
+      const float* b = matrix_vertex(
+          &data.obj_matrix, facet_vertex(&data.obj_facets, hit.facet, 0) - 1);
+      ck_assert_float_le(fabsf(a[0] - b[0]), 1.5f / 48.0f);
+      ck_assert_float_le(fabsf(a[1] - b[1]), 1.5f / 48.0f);
+    }
+  }
+
+  // луч от сетки
+  float origin[3] = {0.5f, 0.5f, 2.0f};
+  float up[3] = {0.0f, 0.0f, 1.0f};
+  bvh_hit_t hit = {0};
+  ck_assert_int_eq(bvh_raycast(&data, origin, up, &hit), 0);
+
+  free_memory(NULL, &data);
+}
+
+// полигоны без допустимых вершин и пустой объект
+START_TEST(bvh_test4) {
+  data_t data;
+  make_grid(&data, 2, 0.0f);
+  // последний полигон ссылается на несуществующие вершины
+  uint32_t* indices = data.obj_facets.indices;
+  for (int k = 0; k < 4; k++) indices[12 + k] = k % 2 == 0 ? 0 : 100;
+  ck_assert_int_eq(build_edges(&data, 1), 0);
+  ck_assert_int_eq(build_bvh(&data, 1), 0);
+  ck_assert_uint_eq(data.obj_bvh.count_of_facets, 3);
+  ck_assert_uint_eq(data.obj_bvh.nodes[0].count_of_edges,
+                    data.obj_edges.count_of_edges);
+  check_node(&data, 0);
+  free_memory(NULL, &data);
+
+  data_t empty = {0};
+  ck_assert_int_eq(build_bvh(&empty, 0), 0);
+  ck_assert_uint_eq(empty.obj_bvh.count_of_nodes, 0);
+  bvh_ranges_t ranges = {0};
+  float mvp[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  ck_assert_int_eq(bvh_cull(&empty.obj_bvh, mvp, &ranges), 1);
+  float origin[3] = {0.0f, 0.0f, 1.0f}, direction[3] = {0.0f, 0.0f, -1.0f};
+  bvh_hit_t hit = {0};
+  ck_assert_int_eq(bvh_raycast(&empty, origin, direction, &hit), 0);
+  bvh_ranges_free(&ranges);
+  free_memory(NULL, &empty);
+}
+
+Suite* bvh_test_suite() {
+  Suite* suite = suite_create("bvh_test");
+  TCase* tcase = tcase_create("bvh_test_case");
+
+  tcase_add_test(tcase, bvh_test1);
+  tcase_add_test(tcase, bvh_test2);
+  tcase_add_test(tcase, bvh_test3);
+  tcase_add_test(tcase, bvh_test4);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int bvh_tests() {
+  Suite* suite = bvh_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
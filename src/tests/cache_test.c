@@ -0,0 +1,210 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tests.h"
+
+#define SOURCE "tests/cache_test.obj"
+#define CACHE "tests/cache_test.obj.3dvcache"
+
+/**
+ * @brief Copy file
+ *
+ * Copies a file and appends a line to the copy.
+ */
+static void copy_file(const char* from, const char* to, const char* line) {
+  FILE* in = fopen(from, "rb");
+  FILE* out = fopen(to, "wb");
+  ck_assert_ptr_nonnull(in);
+  ck_assert_ptr_nonnull(out);
+
+  char buffer[4096];
+  size_t length = 0;
+  while ((length = fread(buffer, 1, sizeof(buffer), in)) != 0) {
+    fwrite(buffer, 1, length, out);
+  }
+  fputs(line, out);
+
+  fclose(in);
+  fclose(out);
+}
+
+/**
+ * @brief Check objects
+ *
+ * Compares vertices, facets and bounds of two objects.
+ */
+static void check_same_object(const data_t* data, const data_t* expected) {
+  ck_assert_int_eq(data->count_of_vertices, expected->count_of_vertices);
+  ck_assert_int_eq(data->count_of_facets, expected->count_of_facets);
+  if (data->count_of_vertices != 0) {
+    ck_assert_mem_eq(data->obj_matrix.matrix, expected->obj_matrix.matrix,
+                     data->count_of_vertices * 3 * sizeof(float));
+  }
+  for (size_t i = 0; i < data->count_of_facets; i++) {
+    size_t count = facet_size(&data->obj_facets, i);
+    ck_assert_int_eq(count, facet_size(&expected->obj_facets, i));
+    for (size_t k = 0; k < count; k++) {
+      ck_assert_int_eq(facet_vertex(&data->obj_facets, i, k),
+                       facet_vertex(&expected->obj_facets, i, k));
+    }
+  }
+  ck_assert_mem_eq(&data->bounds, &expected->bounds, sizeof(bounds_t));
+}
+
+START_TEST(cache_test1) {
+  // первая загрузка создаёт кэш, вторая читает его
+  copy_file("frontend/objects/tree.obj", SOURCE, "");
+  unlink(CACHE);
+  data_t expected = {0};
+  ck_assert_int_eq(parse_obj_file(SOURCE, &expected), 0);
+
+  data_t data = {0};
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 1);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 2, NULL), 0);
+  check_same_object(&data, &expected);
+  free_memory(NULL, &data);
+
+  ck_assert_int_eq(access(CACHE, F_OK), 0);
+  progress_t progress = {0};
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 0);
+  check_same_object(&data, &expected);
+  // вершины используются прямо из кэша и меняются только в памяти
+  ck_assert_ptr_nonnull(data.mapping);
+  ck_assert_int_eq((size_t)data.obj_matrix.matrix % VERTEX_ALIGNMENT, 0);
+  scale_even(&data.obj_matrix, 2.0f);
+  free_memory(NULL, &data);
+  ck_assert_ptr_null(data.mapping);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 2, &progress), 0);
+  ck_assert_double_eq(progress_fraction(&progress), 1.0);
+  check_same_object(&data, &expected);
+  free_memory(NULL, &data);
+
+  free_memory(NULL, &expected);
+  unlink(SOURCE);
+  unlink(CACHE);
+}
+
+START_TEST(cache_test2) {
+  // изменение файла делает кэш недействительным
+  copy_file("tests/test.obj", SOURCE, "");
+  unlink(CACHE);
+  data_t data = {0};
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 1, NULL), 0);
+  ck_assert_int_eq(data.count_of_vertices, 12);
+  free_memory(NULL, &data);
+
+  copy_file("tests/test.obj", SOURCE, "v 1.0 2.0 3.0\n");
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 1);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 1, NULL), 0);
+  ck_assert_int_eq(data.count_of_vertices, 13);
+  free_memory(NULL, &data);
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 0);
+  ck_assert_int_eq(data.count_of_vertices, 13);
+  free_memory(NULL, &data);
+
+  // изменение только времени проверяется по хэшу содержимого
+  struct timespec times[2] = {{1000000000, 0}, {1000000000, 0}};
+  ck_assert_int_eq(utimensat(AT_FDCWD, SOURCE, times, 0), 0);
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 0);
+  ck_assert_int_eq(data.count_of_vertices, 13);
+  free_memory(NULL, &data);
+
+  // тот же размер, другое содержимое
+  copy_file("tests/test.obj", SOURCE, "v 4.0 5.0 6.0\n");
+  times[1].tv_sec = 1100000000;
+  ck_assert_int_eq(utimensat(AT_FDCWD, SOURCE, times, 0), 0);
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 1);
+
+  unlink(SOURCE);
+  unlink(CACHE);
+}
+
+START_TEST(cache_test3) {
+  // повреждённый кэш не читается, а перезаписывается
+  copy_file("tests/test.obj", SOURCE, "");
+  unlink(CACHE);
+  data_t data = {0};
+  ck_assert_int_eq(write_mesh_cache(SOURCE, &data), 0);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 1, NULL), 0);
+  ck_assert_int_eq(data.count_of_vertices, 0);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 1, NULL), 0);
+  ck_assert_int_eq(data.count_of_vertices, 0);
+
+  ck_assert_int_eq(truncate(CACHE, 40), 0);
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 1);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 1, NULL), 0);
+  ck_assert_int_eq(data.count_of_vertices, 12);
+  free_memory(NULL, &data);
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 0);
+  ck_assert_int_eq(data.count_of_facets, 6);
+  free_memory(NULL, &data);
+
+  ck_assert_int_eq(read_mesh_cache("wrong_file.obj", &data), 1);
+  ck_assert_int_eq(load_obj_file("wrong_file.obj", &data, 1, NULL), 1);
+
+  unlink(SOURCE);
+  unlink(CACHE);
+}
+
+START_TEST(cache_test4) {
+  // номер вершины за пределами объекта отвергает кэш
+  copy_file("frontend/objects/tree.obj", SOURCE, "");
+  unlink(CACHE);
+  data_t expected = {0};
+  ck_assert_int_eq(load_obj_file(SOURCE, &expected, 2, NULL), 0);
+  struct stat cache;
+  ck_assert_int_eq(stat(CACHE, &cache), 0);
+
+  // номера лежат в конце кэша, последний из них портится
+  int descriptor = open(CACHE, O_WRONLY);
+  ck_assert_int_ne(descriptor, -1);
+  uint32_t invalid = UINT32_MAX;
+  ck_assert_int_eq(pwrite(descriptor, &invalid, sizeof(invalid),
+                          cache.st_size - (off_t)sizeof(invalid)),
+                   (ssize_t)sizeof(invalid));
+  close(descriptor);
+
+  data_t data = {0};
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 1);
+  ck_assert_ptr_null(data.obj_facets.offsets);
+  ck_assert_int_eq(load_obj_file(SOURCE, &data, 2, NULL), 0);
+  check_same_object(&data, &expected);
+  free_memory(NULL, &data);
+
+  // разбор переписал кэш
+  ck_assert_int_eq(read_mesh_cache(SOURCE, &data), 0);
+  check_same_object(&data, &expected);
+  free_memory(NULL, &data);
+  free_memory(NULL, &expected);
+
+  unlink(SOURCE);
+  unlink(CACHE);
+}
+
+Suite* cache_test_suite() {
+  Suite* suite = suite_create("cache_test");
+  TCase* tcase = tcase_create("cache_test_case");
+
+  tcase_add_test(tcase, cache_test1);
+  tcase_add_test(tcase, cache_test2);
+  tcase_add_test(tcase, cache_test3);
+  tcase_add_test(tcase, cache_test4);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int cache_tests() {
+  Suite* suite = cache_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -0,0 +1,118 @@
+#include "tests.h"
+
+START_TEST(camera_test1) {
+  // камера после сброса не меняет вершины
+  camera_t camera;
+  float matrix[16] = {0};
+  const float identity[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                              0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+
+  camera_reset(&camera);
+  camera_matrix(&camera, matrix);
+  ck_assert_mem_eq(matrix, identity, sizeof(identity));
+
+  // перетаскивание из центра в центр ничего не поворачивает
+  double center[3];
+  arcball_point(0.0f, 0.0f, center);
+  ck_assert_double_eq_tol(center[2], 1.0, 1e-12);
+  camera_rotate(&camera, center, center);
+  camera_matrix(&camera, matrix);
+  ck_assert_mem_eq(matrix, identity, sizeof(identity));
+}
+
+START_TEST(camera_test2) {
+  // перетаскивание вправо поворачивает вокруг OY, матрица ортонормирована
+  camera_t camera;
+  double from[3], to[3];
+  float matrix[16];
+
+  camera_reset(&camera);
+  arcball_point(0.0f, 0.0f, from);
+  arcball_point(0.5f, 0.0f, to);
+  camera_rotate(&camera, from, to);
+  camera_matrix(&camera, matrix);
+
+  // передняя точка объекта уходит вправо
+  ck_assert_float_eq_tol(matrix[8], 0.5f, 1e-6f);
+  ck_assert_float_eq_tol(matrix[9], 0.0f, 1e-6f);
+  ck_assert_float_eq_tol(matrix[5], 1.0f, 1e-6f);
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      float dot = matrix[i * 4] * matrix[j * 4] +
+                  matrix[i * 4 + 1] * matrix[j * 4 + 1] +
+                  matrix[i * 4 + 2] * matrix[j * 4 + 2];
+      ck_assert_float_eq_tol(dot, i == j ? 1.0f : 0.0f, 1e-6f);
+    }
+  }
+
+  // много мелких поворотов туда и обратно возвращают к началу
+  double a[3], b[3];
+  for (int i = 0; i < 1000; i++) {
+    arcball_point(0.0005f * i, 0.0003f * i, a);
+    arcball_point(0.0005f * (i + 1), 0.0003f * (i + 1), b);
+    camera_rotate(&camera, a, b);
+  }
+  for (int i = 1000; i > 0; i--) {
+    arcball_point(0.0005f * i, 0.0003f * i, a);
+    arcball_point(0.0005f * (i - 1), 0.0003f * (i - 1), b);
+    camera_rotate(&camera, a, b);
+  }
+  camera_rotate(&camera, to, from);
+  ck_assert_double_eq_tol(camera.orientation[0], 1.0, 1e-9);
+  ck_assert_double_eq_tol(camera.orientation[1], 0.0, 1e-9);
+  ck_assert_double_eq_tol(camera.orientation[2], 0.0, 1e-9);
+  ck_assert_double_eq_tol(camera.orientation[3], 0.0, 1e-9);
+
+  // противоположные точки не дают поворота
+  const double back[3] = {-from[0], -from[1], -from[2]};
+  camera_rotate(&camera, from, back);
+  ck_assert_double_eq_tol(camera.orientation[0], 1.0, 1e-9);
+}
+
+START_TEST(camera_test3) {
+  // сдвиг и увеличение, увеличение ограничено
+  camera_t camera;
+  float matrix[16];
+
+  camera_reset(&camera);
+  camera_pan(&camera, 0.25, -0.5, 0.0);
+  camera_zoom(&camera, 2.0);
+  camera_matrix(&camera, matrix);
+  ck_assert_float_eq(matrix[0], 2.0f);
+  ck_assert_float_eq(matrix[10], 2.0f);
+  ck_assert_float_eq(matrix[12], 0.25f);
+  ck_assert_float_eq(matrix[13], -0.5f);
+
+  camera_zoom(&camera, 1e6);
+  ck_assert_double_eq(camera.zoom, CAMERA_ZOOM_MAX);
+  camera_zoom(&camera, 1e-12);
+  ck_assert_double_eq(camera.zoom, CAMERA_ZOOM_MIN);
+  camera_zoom(&camera, NAN);
+  ck_assert_double_eq(camera.zoom, CAMERA_ZOOM_MIN);
+}
+
+Suite* camera_test_suite() {
+  Suite* suite = suite_create("camera_test");
+  TCase* tcase = tcase_create("camera_test_case");
+
+  tcase_add_test(tcase, camera_test1);
+  tcase_add_test(tcase, camera_test2);
+  tcase_add_test(tcase, camera_test3);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int camera_tests() {
+  Suite* suite = camera_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -0,0 +1,198 @@
+#include "tests.h"
+
+/**
+ * @brief Fill facets
+ *
+ * Builds facets of the object from sizes and vertex numbers.
+ */
+static void fill_facets(data_t* data, size_t count_of_vertices,
+                        const size_t* sizes, size_t count_of_facets,
+                        const uint32_t* indices) {
+  data->count_of_vertices = count_of_vertices;
+  data->count_of_facets = count_of_facets;
+  data->obj_facets.offsets = malloc((count_of_facets + 1) * sizeof(size_t));
+  ck_assert_ptr_nonnull(data->obj_facets.offsets);
+
+  data->obj_facets.offsets[0] = 0;
+  for (size_t i = 0; i < count_of_facets; i++) {
+    data->obj_facets.offsets[i + 1] = data->obj_facets.offsets[i] + sizes[i];
+  }
+  size_t count = data->obj_facets.offsets[count_of_facets];
+  data->obj_facets.count_of_indices = count;
+  data->obj_facets.indices = malloc((count + 1) * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(data->obj_facets.indices);
+  memcpy(data->obj_facets.indices, indices, count * sizeof(uint32_t));
+}
+
+static int compare_edges(const void* a, const void* b) {
+  const uint32_t* x = a;
+  const uint32_t* y = b;
+  int result = (x[0] > y[0]) - (x[0] < y[0]);
+  return result != 0 ? result : (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+/**
+ * @brief Sorted edges
+ *
+ * Copies edges of the object sorted by vertex numbers.
+ */
+static uint32_t* sorted_edges(const data_t* data) {
+  size_t count = data->obj_edges.count_of_edges;
+  uint32_t* edges = malloc((count + 1) * 2 * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(edges);
+  memcpy(edges, data->obj_edges.indices, count * 2 * sizeof(uint32_t));
+  qsort(edges, count, 2 * sizeof(uint32_t), compare_edges);
+  return edges;
+}
+
+/**
+ * @brief Brute force edges
+ *
+ * Collects all sorted vertex pairs of facets and removes repeats.
+ */
+static uint32_t* brute_force_edges(const data_t* data, size_t* count) {
+  const facets_t* facets = &data->obj_facets;
+  uint32_t* edges = malloc((facets->count_of_indices + 1) * 2 *
+                           sizeof(uint32_t));
+  ck_assert_ptr_nonnull(edges);
+
+  size_t total = 0;
+  for (size_t i = 0; i < data->count_of_facets; i++) {
+    size_t size = facet_size(facets, i);
+    for (size_t k = 0; k < size; k++) {
+      size_t a = facet_vertex(facets, i, k);
+      size_t b = facet_vertex(facets, i, (k + 1) % size);
+      if (a != b && a != 0 && b != 0 && a <= data->count_of_vertices &&
+          b <= data->count_of_vertices) {
+        edges[total * 2] = (uint32_t)(a < b ? a : b) - 1;
+        edges[total * 2 + 1] = (uint32_t)(a < b ? b : a) - 1;
+        total++;
+      }
+    }
+  }
+  qsort(edges, total, 2 * sizeof(uint32_t), compare_edges);
+
+  *count = 0;
+  for (size_t i = 0; i < total; i++) {
+    if (*count == 0 || compare_edges(edges + i * 2,
+                                     edges + (*count - 1) * 2) != 0) {
+      edges[*count * 2] = edges[i * 2];
+      edges[*count * 2 + 1] = edges[i * 2 + 1];
+      (*count)++;
+    }
+  }
+
+  return edges;
+}
+
+START_TEST(edges_test1) {
+  // общее ребро двух треугольников рисуется один раз, плохие рёбра пропадают
+  const size_t sizes[] = {3, 3, 2, 3, 0};
+  const uint32_t indices[] = {1, 2, 3, 3, 2, 4, 4, 4, 1, 9, 0};
+  data_t data = {0};
+  fill_facets(&data, 4, sizes, 5, indices);
+
+  ck_assert_int_eq(build_edges(&data, 1), 0);
+  ck_assert_int_eq(data.obj_edges.count_of_edges, 5);
+  uint32_t* edges = sorted_edges(&data);
+  const uint32_t expected[] = {0, 1, 0, 2, 1, 2, 1, 3, 2, 3};
+  ck_assert_mem_eq(edges, expected, sizeof(expected));
+  free(edges);
+
+  // повторное построение заменяет список
+  ck_assert_int_eq(build_edges(&data, 4), 0);
+  ck_assert_int_eq(data.obj_edges.count_of_edges, 5);
+
+  free_memory(NULL, &data);
+  ck_assert_ptr_null(data.obj_edges.indices);
+  ck_assert_int_eq(data.obj_edges.count_of_edges, 0);
+
+  // объект без полигонов
+  ck_assert_int_eq(build_edges(&data, 1), 0);
+  ck_assert_int_eq(data.obj_edges.count_of_edges, 0);
+  free_memory(NULL, &data);
+}
+
+START_TEST(edges_test2) {
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/tree.obj", &data), 0);
+
+  size_t count = 0;
+  uint32_t* expected = brute_force_edges(&data, &count);
+  const size_t threads[] = {1, 3, 0};
+  for (size_t i = 0; i < 3; i++) {
+    ck_assert_int_eq(build_edges(&data, threads[i]), 0);
+    ck_assert_int_eq(data.obj_edges.count_of_edges, count);
+    uint32_t* edges = sorted_edges(&data);
+    ck_assert_mem_eq(edges, expected, count * 2 * sizeof(uint32_t));
+    free(edges);
+  }
+
+  free(expected);
+  free_memory(NULL, &data);
+}
+
+START_TEST(edges_test3) {
+  // сетка из четырёхугольников достаточно велика для нескольких потоков
+  const size_t side = 300;
+  const size_t row = side + 1;
+  size_t* sizes = malloc(side * side * sizeof(size_t));
+  uint32_t* indices = malloc(side * side * 4 * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(sizes);
+  ck_assert_ptr_nonnull(indices);
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      size_t facet = y * side + x;
+      uint32_t corner = (uint32_t)(y * row + x + 1);
+      sizes[facet] = 4;
+      indices[facet * 4] = corner;
+      indices[facet * 4 + 1] = corner + 1;
+      indices[facet * 4 + 2] = corner + 1 + (uint32_t)row;
+      indices[facet * 4 + 3] = corner + (uint32_t)row;
+    }
+  }
+  data_t data = {0};
+  fill_facets(&data, row * row, sizes, side * side, indices);
+
+  size_t count = 0;
+  uint32_t* expected = brute_force_edges(&data, &count);
+  ck_assert_int_eq(count, 2 * side * row);
+  const size_t threads[] = {1, 3, 8, 0};
+  for (size_t i = 0; i < 4; i++) {
+    ck_assert_int_eq(build_edges(&data, threads[i]), 0);
+    ck_assert_int_eq(data.obj_edges.count_of_edges, count);
+    uint32_t* edges = sorted_edges(&data);
+    ck_assert_mem_eq(edges, expected, count * 2 * sizeof(uint32_t));
+    free(edges);
+  }
+
+  free(expected);
+  free(indices);
+  free(sizes);
+  free_memory(NULL, &data);
+}
+
+Suite* edges_test_suite() {
+  Suite* suite = suite_create("edges_test");
+  TCase* tcase = tcase_create("edges_test_case");
+
+  tcase_add_test(tcase, edges_test1);
+  tcase_add_test(tcase, edges_test2);
+  tcase_add_test(tcase, edges_test3);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int edges_tests() {
+  Suite* suite = edges_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -0,0 +1,258 @@
+#include "tests.h"
+
+START_TEST(history_test1) {
+  // отмена и повтор шагов, новый шаг забывает отменённые
+  history_t history = {0};
+  const operation_t first[2] = {{OPERATION_ROTATE, 10.0f, 0.0f, 0.0f},
+                                {OPERATION_MOVE, 0.1f, 0.0f, 0.0f}};
+  const operation_t second = {OPERATION_SCALE, 2.0f, 2.0f, 2.0f};
+  const operation_t third = {OPERATION_MOVE, 0.0f, -0.3f, 0.0f};
+  size_t count = 0;
+
+  ck_assert_int_eq(history_undo(&history), 1);
+  ck_assert_ptr_null(history_operations(&history, &count));
+  ck_assert_uint_eq(count, 0);
+
+  ck_assert_int_eq(history_record(&history, first, 2, 0), 0);
+  ck_assert_int_eq(history_record(&history, &second, 1, 0), 0);
+  ck_assert_int_eq(history_redo(&history), 1);
+  ck_assert_ptr_eq(history_operations(&history, &count), history.operations);
+  ck_assert_uint_eq(count, 3);
+
+  ck_assert_int_eq(history_undo(&history), 0);
+  history_operations(&history, &count);
+  ck_assert_uint_eq(count, 2);
+  ck_assert_int_eq(history_redo(&history), 0);
+  history_operations(&history, &count);
+  ck_assert_uint_eq(count, 3);
+
+  ck_assert_int_eq(history_undo(&history), 0);
+  ck_assert_int_eq(history_record(&history, &third, 1, 0), 0);
+  ck_assert_int_eq(history_redo(&history), 1);
+  const operation_t* operations = history_operations(&history, &count);
+  ck_assert_uint_eq(count, 3);
+  ck_assert_int_eq(operations[2].type, OPERATION_MOVE);
+
+  // перетаскивание ползунка отменяется одним шагом
+  ck_assert_int_eq(history_record(&history, &second, 1, 1), 0);
+  ck_assert_int_eq(history_record(&history, &second, 1, 1), 0);
+  ck_assert_uint_eq(history.count_of_steps, 2);
+  ck_assert_int_eq(history_undo(&history), 0);
+  history_operations(&history, &count);
+  ck_assert_uint_eq(count, 2);
+
+  // в отменённый шаг ничего не добавляется
+  ck_assert_int_eq(history_record(&history, &third, 1, 1), 0);
+  ck_assert_uint_eq(history.count_of_steps, 2);
+  history_operations(&history, &count);
+  ck_assert_uint_eq(count, 3);
+
+  history_free(&history);
+  ck_assert_ptr_null(history.operations);
+  ck_assert_uint_eq(history.position, 0);
+}
+
+START_TEST(history_test2) {
+  // преобразование любой точки истории равно тем же операциям подряд
+  history_t history = {0};
+  transform_t base;
+  transform_reset(&base);
+  transform_scale(&base, 0.5f, 0.5f, 0.5f);
+  transform_t expected[101];
+  expected[0] = base;
+
+  for (int i = 0; i < 100; i++) {
+    operation_t operation = {i % 3, 0.01f * i, -0.02f * i, 0.5f + 0.01f * i};
+    expected[i + 1] = expected[i];
+    transform_compose(&expected[i + 1], &operation, 1);
+    ck_assert_int_eq(history_record(&history, &operation, 1, 0), 0);
+  }
+
+  transform_t transform;
+  for (int i = 100; i >= 0; i--) {
+    history_transform(&history, &base, &transform);
+    ck_assert_mem_eq(transform.model, expected[i].model,
+                     sizeof(transform.model));
+    ck_assert_int_eq(history_undo(&history), i != 0 ? 0 : 1);
+  }
+
+  history_free(&history);
+}
+
+START_TEST(history_test3) {
+  // сброс возвращает к исходному преобразованию и тоже отменяется
+  history_t history = {0};
+  transform_t base;
+  transform_reset(&base);
+  transform_move(&base, 0.2f, 0.0f, 0.0f);
+  const operation_t rotation = {OPERATION_ROTATE, 30.0f, 0.0f, 45.0f};
+  const operation_t reset = {OPERATION_RESET, 0.0f, 0.0f, 0.0f};
+
+  ck_assert_int_eq(history_record(&history, &rotation, 1, 0), 0);
+  transform_t rotated = base;
+  transform_compose(&rotated, &rotation, 1);
+  ck_assert_int_eq(history_record(&history, &reset, 1, 0), 0);
+
+  transform_t transform;
+  history_transform(&history, &base, &transform);
+  ck_assert_mem_eq(transform.model, base.model, sizeof(base.model));
+  ck_assert_int_eq(history_undo(&history), 0);
+  history_transform(&history, &base, &transform);
+  ck_assert_mem_eq(transform.model, rotated.model, sizeof(rotated.model));
+
+  history_free(&history);
+}
+
+/**
+ * @brief Check transform
+ *
+ * Compares two transforms with a tolerance for the order of rounding.
+ */
+static void check_transform(const transform_t* transform,
+                            const transform_t* expected) {
+  for (int i = 0; i < 16; i++) {
+    double scale = fabs(expected->model[i]) > 1.0 ? fabs(expected->model[i])
+                                                   : 1.0;
+    ck_assert_double_eq_tol(transform->model[i], expected->model[i],
+                            1e-9 * scale);
+  }
+}
+
+START_TEST(history_test4) {
+  // перетаскивание по одной оси хранится одной операцией
+  history_t history = {0};
+  transform_t base, expected;
+  transform_reset(&base);
+  expected = base;
+  const operation_t step = {OPERATION_MOVE, 0.01f, 0.0f, -0.02f};
+  const operation_t turn = {OPERATION_ROTATE, 0.0f, 1.5f, 0.0f};
+  const operation_t tilt = {OPERATION_ROTATE, 0.5f, 0.0f, 0.0f};
+
+  ck_assert_int_eq(history_record(&history, &tilt, 1, 0), 0);
+  transform_compose(&expected, &tilt, 1);
+  for (int i = 0; i < 1000; i++) {
+    const operation_t* operation = i < 500 ? &step : &turn;
+    ck_assert_int_eq(history_record(&history, operation, 1, i != 0), 0);
+    transform_compose(&expected, operation, 1);
+  }
+  ck_assert_uint_eq(history.count_of_steps, 2);
+  ck_assert_uint_eq(history.count_of_operations, 3);
+  ck_assert_float_eq_tol(history.operations[1].x, 5.0f, 1e-3f);
+  ck_assert_float_eq_tol(history.operations[2].y, 750.0f, 1e-3f);
+
+  // поворот по другой оси не объединяется, первый шаг не затрагивается
+  ck_assert_int_eq(history_record(&history, &tilt, 1, 1), 0);
+  transform_compose(&expected, &tilt, 1);
+  ck_assert_uint_eq(history.count_of_operations, 4);
+  ck_assert_float_eq(history.operations[0].x, 0.5f);
+
+  transform_t transform;
+  history_transform(&history, &base, &transform);
+  for (int i = 0; i < 16; i++) {
+    ck_assert_double_eq_tol(transform.model[i], expected.model[i], 1e-4);
+  }
+
+  history_free(&history);
+  ck_assert_ptr_null(history.snapshots);
+}
+
+START_TEST(history_test5) {
+  // длинная история собирается от сохранённых преобразований
+  history_t history = {0};
+  transform_t base;
+  transform_reset(&base);
+  transform_rotate_by_oz(&base, 20.0f);
+  transform_move(&base, 0.3f, -0.1f, 0.0f);
+  const size_t count = 3 * HISTORY_SNAPSHOT_INTERVAL + 17;
+  transform_t* expected = malloc((count + 1) * sizeof(transform_t));
+  ck_assert_ptr_nonnull(expected);
+  expected[0] = base;
+
+  for (size_t i = 0; i < count; i++) {
+    operation_t operation = {(int)(i % 3), 0.01f * (float)(i % 7),
+                             -0.5f * (float)(i % 5), 0.0f};
+    if (operation.type == OPERATION_SCALE) {
+      operation.x = i % 2 ? 1.01f : 0.99f;
+      operation.y = operation.z = 1.0f;
+    }
+    if (i == HISTORY_SNAPSHOT_INTERVAL + 40) {
+      operation = (operation_t){OPERATION_RESET, 0.0f, 0.0f, 0.0f};
+    }
+    expected[i + 1] = expected[i];
+    if (operation.type == OPERATION_RESET) expected[i + 1] = base;
+    transform_compose(&expected[i + 1], &operation, 1);
+    ck_assert_int_eq(history_record(&history, &operation, 1, 0), 0);
+  }
+  ck_assert_uint_eq(history.count_of_snapshots, 3);
+
+  transform_t transform;
+  for (size_t i = count + 1; i-- > 0;) {
+    history_transform(&history, &base, &transform);
+    check_transform(&transform, &expected[i]);
+    ck_assert_int_eq(history_undo(&history), i != 0 ? 0 : 1);
+  }
+
+  // новая ветка после отмены заменяет устаревшие сохранения
+  for (size_t i = 0; i < HISTORY_SNAPSHOT_INTERVAL + 10; i++) {
+    ck_assert_int_eq(history_redo(&history), 0);
+  }
+  const operation_t scale = {OPERATION_SCALE, 2.0f, 2.0f, 2.0f};
+  ck_assert_int_eq(history_record(&history, &scale, 1, 0), 0);
+  ck_assert_uint_eq(history.count_of_snapshots, 1);
+  transform_t scaled = expected[HISTORY_SNAPSHOT_INTERVAL + 10];
+  transform_compose(&scaled, &scale, 1);
+  history_transform(&history, &base, &transform);
+  check_transform(&transform, &scaled);
+
+  free(expected);
+  history_free(&history);
+}
+
+START_TEST(history_test6) {
+  // повороты X, Y, X не складываются в X и Y
+  operation_t last = {OPERATION_ROTATE, 10.0f, 0.0f, 0.0f};
+  const operation_t turn = {OPERATION_ROTATE, 0.0f, 20.0f, 0.0f};
+  const operation_t tilt = {OPERATION_ROTATE, 5.0f, 0.0f, 0.0f};
+  ck_assert_int_eq(merge_operation(&last, &tilt), 1);
+  ck_assert_float_eq(last.x, 15.0f);
+  ck_assert_int_eq(merge_operation(&last, &turn), 0);
+  ck_assert_float_eq(last.y, 0.0f);
+
+  // сдвиги за пределом ограничиваются по отдельности
+  operation_t move = {OPERATION_MOVE, 60.0f, 0.0f, 0.0f};
+  const operation_t step = {OPERATION_MOVE, 50.0f, 1.0f, 0.0f};
+  ck_assert_int_eq(merge_operation(&move, &step), 0);
+  ck_assert_float_eq(move.x, 60.0f);
+  move.x = 20.0f;
+  ck_assert_int_eq(merge_operation(&move, &step), 1);
+  ck_assert_float_eq(move.x, 70.0f);
+  ck_assert_int_eq(merge_operation(&move, &tilt), 0);
+}
+
+Suite* history_test_suite() {
+  Suite* suite = suite_create("history_test");
+  TCase* tcase = tcase_create("history_test_case");
+
+  tcase_add_test(tcase, history_test1);
+  tcase_add_test(tcase, history_test2);
+  tcase_add_test(tcase, history_test3);
+  tcase_add_test(tcase, history_test4);
+  tcase_add_test(tcase, history_test5);
+  tcase_add_test(tcase, history_test6);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int history_tests() {
+  Suite* suite = history_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -0,0 +1,231 @@
+#include "tests.h"
+
+// количество вершин не кратно ширине ни одного набора инструкций
+#define COUNT 1003
+
+/**
+ * @brief Fill vertices
+ *
+ * Fills vertices with random values, zeros of both signs and infinities.
+ */
+static void fill_vertices(float* vertices) {
+  srand(12);
+  for (size_t i = 0; i < COUNT * 3; i++) {
+    vertices[i] = ((float)rand() / RAND_MAX - 0.5f) * 200.0f;
+  }
+  vertices[1] = -0.0f;
+  vertices[5] = 0.0f;
+  vertices[7] = INFINITY;
+  vertices[COUNT * 3 - 1] = -0.0f;
+}
+
+/**
+ * @brief Reference rotation
+ *
+ * Rotation loops as they were before the vertex kernels, to check that the
+ * kernels give the same bits.
+ */
+static void rotate_reference(float* vertices, int axis, float angle) {
+  angle = deg_to_rad(angle);
+  for (size_t i = 0; i < COUNT; i++) {
+    float* vertex = vertices + i * 3;
+    float temp_x = vertex[0], temp_y = vertex[1], temp_z = vertex[2];
+    if (axis == 0) {
+      vertex[1] = cosf(angle) * temp_y - sinf(angle) * temp_z;
+      vertex[2] = sinf(angle) * temp_y + cosf(angle) * temp_z;
+    } else if (axis == 1) {
+      vertex[0] = cosf(angle) * temp_x + sinf(angle) * temp_z;
+      vertex[2] = -sinf(angle) * temp_x + cosf(angle) * temp_z;
+    } else {
+      vertex[0] = cosf(angle) * temp_x - sinf(angle) * temp_y;
+      vertex[1] = sinf(angle) * temp_x + cosf(angle) * temp_y;
+    }
+  }
+}
+
+START_TEST(kernels_test1) {
+  // самые быстрые ядра всегда есть, скалярные тоже
+  ck_assert_ptr_nonnull(vertex_kernels());
+  ck_assert_ptr_nonnull(vertex_kernels_by_level(KERNELS_SCALAR));
+  ck_assert_ptr_null(vertex_kernels_by_level(KERNELS_COUNT));
+
+  static float expected[COUNT * 3];
+  static float vertices[COUNT * 3];
+  const float offsets[3][3] = {
+      {2.5f, -0.0f, -0.0f}, {-0.0f, -7.0f, -0.0f}, {-0.0f, -0.0f, 0.3f}};
+  const float scales[2][3] = {{1.7f, 1.7f, 1.7f}, {1.0f, 0.3f, 1.0f}};
+
+  for (int level = 0; level < KERNELS_COUNT; level++) {
+    const vertex_kernels_t* kernels = vertex_kernels_by_level(level);
+    if (kernels == NULL) continue;
+
+    for (int axis = 0; axis < 3; axis++) {
+      // перемещение только по одной оси
+      fill_vertices(expected);
+      fill_vertices(vertices);
+      for (size_t i = 0; i < COUNT; i++) {
+        expected[i * 3 + axis] += offsets[axis][axis];
+      }
+      kernels->add(vertices, COUNT, offsets[axis]);
+      ck_assert_mem_eq(vertices, expected, sizeof(vertices));
+
+      // поворот в тех же плоскостях, что и rotate_by_o*
+      const int planes[3][2] = {{1, 2}, {2, 0}, {0, 1}};
+      fill_vertices(expected);
+      fill_vertices(vertices);
+      rotate_reference(expected, axis, 37.0f);
+      float angle = deg_to_rad(37.0f);
+      kernels->rotate(vertices, COUNT, planes[axis][0], planes[axis][1],
+                      cosf(angle), sinf(angle));
+      ck_assert_mem_eq(vertices, expected, sizeof(vertices));
+    }
+
+    for (int k = 0; k < 2; k++) {
+      fill_vertices(expected);
+      fill_vertices(vertices);
+      for (size_t i = 0; i < COUNT * 3; i++) {
+        if (scales[k][i % 3] != 1.0f) expected[i] *= scales[k][i % 3];
+      }
+      kernels->multiply(vertices, COUNT, scales[k]);
+      ck_assert_mem_eq(vertices, expected, sizeof(vertices));
+    }
+  }
+}
+
+START_TEST(kernels_test2) {
+  // все наборы инструкций дают одинаковое преобразование матрицей
+  static float expected[COUNT * 3];
+  static float vertices[COUNT * 3];
+  const float matrix[16] = {0.8f, 0.1f,  -0.3f, 0.0f, -0.2f, 1.1f,
+                            0.4f, 0.0f,  0.5f,  -0.6f, 0.9f, 0.0f,
+                            1.5f, -2.5f, 0.25f, 1.0f};
+
+  fill_vertices(expected);
+  vertex_kernels_by_level(KERNELS_SCALAR)->transform(expected, COUNT, matrix);
+  const float* vertex = expected + 30;
+  float x = vertex[0], y = vertex[1], z = vertex[2];
+  fill_vertices(vertices);
+  vertex = vertices + 30;
+  ck_assert_float_eq_tol(x, 0.8f * vertex[0] - 0.2f * vertex[1] +
+                                0.5f * vertex[2] + 1.5f,
+                         1e-3);
+  ck_assert_float_eq_tol(y, 0.1f * vertex[0] + 1.1f * vertex[1] -
+                                0.6f * vertex[2] - 2.5f,
+                         1e-3);
+  ck_assert_float_eq_tol(z, -0.3f * vertex[0] + 0.4f * vertex[1] +
+                                0.9f * vertex[2] + 0.25f,
+                         1e-3);
+
+  for (int level = 0; level < KERNELS_COUNT; level++) {
+    const vertex_kernels_t* kernels = vertex_kernels_by_level(level);
+    if (kernels != NULL) {
+      fill_vertices(vertices);
+      kernels->transform(vertices, COUNT, matrix);
+      ck_assert_mem_eq(vertices, expected, sizeof(vertices));
+    }
+  }
+}
+
+START_TEST(kernels_test3) {
+  // функции affine.c совпадают с прежними циклами бит в бит
+  data_t data = {.obj_matrix.rows = COUNT, .obj_matrix.cols = 3};
+  ck_assert_int_eq(matrix_mem_alloc(&data), 0);
+  static float expected[COUNT * 3];
+  fill_vertices(expected);
+  fill_vertices(data.obj_matrix.matrix);
+
+  rotate_by_ox(&data.obj_matrix, 15.0f);
+  rotate_reference(expected, 0, 15.0f);
+  rotate_by_oy(&data.obj_matrix, -167.0f);
+  rotate_reference(expected, 1, -167.0f);
+  rotate_by_oz(&data.obj_matrix, 36.0f);
+  rotate_reference(expected, 2, 36.0f);
+  move_by_oy(&data.obj_matrix, 1.25f);
+  scale_by_oz(&data.obj_matrix, 3.0f);
+  scale_even(&data.obj_matrix, 0.7f);
+  for (size_t i = 0; i < COUNT; i++) {
+    expected[i * 3 + 1] += 1.25f;
+    expected[i * 3 + 2] *= 3.0f;
+    expected[i * 3] *= 0.7f;
+    expected[i * 3 + 1] *= 0.7f;
+    expected[i * 3 + 2] *= 0.7f;
+  }
+  ck_assert_mem_eq(data.obj_matrix.matrix, expected, sizeof(expected));
+
+  free_memory(NULL, &data);
+}
+
+START_TEST(kernels_test4) {
+  // границы любого набора инструкций совпадают со скалярными
+  static float vertices[COUNT * 3];
+  fill_vertices(vertices);
+  vertices[10] = NAN;
+  vertices[COUNT * 3 - 2] = -INFINITY;
+
+  float expected_min[3] = {INFINITY, INFINITY, INFINITY};
+  float expected_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  vertex_kernels_by_level(KERNELS_SCALAR)
+      ->bounds(vertices, COUNT, expected_min, expected_max);
+  ck_assert(isinf(expected_min[1]) && expected_min[1] < 0.0f);
+  ck_assert(isinf(expected_max[1]) && expected_max[1] > 0.0f);
+
+  for (int level = 0; level < KERNELS_COUNT; level++) {
+    const vertex_kernels_t* kernels = vertex_kernels_by_level(level);
+    if (kernels == NULL) continue;
+
+    // любые длины, в том числе короче ширины регистра
+    for (size_t count = 0; count <= 40; count++) {
+      float min[3] = {INFINITY, INFINITY, INFINITY};
+      float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+      float scalar_min[3] = {INFINITY, INFINITY, INFINITY};
+      float scalar_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+      kernels->bounds(vertices + 30, count, min, max);
+      vertex_kernels_by_level(KERNELS_SCALAR)
+          ->bounds(vertices + 30, count, scalar_min, scalar_max);
+      for (int k = 0; k < 3; k++) {
+        ck_assert_float_eq(min[k], scalar_min[k]);
+        ck_assert_float_eq(max[k], scalar_max[k]);
+      }
+    }
+
+    // коробка только растёт
+    float min[3] = {-1000.0f, 0.0f, 0.0f};
+    float max[3] = {0.0f, 0.0f, 1000.0f};
+    kernels->bounds(vertices, COUNT, min, max);
+    ck_assert_float_eq(min[0], -1000.0f);
+    ck_assert_float_eq(max[2], 1000.0f);
+    ck_assert_float_eq(min[2], expected_min[2]);
+    for (int k = 0; k < 3; k++) {
+      ck_assert_float_eq(fminf(expected_min[k], k == 0 ? -1000.0f : 0.0f),
+                         min[k]);
+    }
+    ck_assert_float_eq(max[0], expected_max[0]);
+    ck_assert_float_eq(max[1], expected_max[1]);
+  }
+}
+
+Suite* kernels_test_suite() {
+  Suite* suite = suite_create("kernels_test");
+  TCase* tcase = tcase_create("kernels_test_case");
+
+  tcase_add_test(tcase, kernels_test1);
+  tcase_add_test(tcase, kernels_test2);
+  tcase_add_test(tcase, kernels_test3);
+  tcase_add_test(tcase, kernels_test4);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int kernels_tests() {
+  Suite* suite = kernels_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
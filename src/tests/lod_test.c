@@ -0,0 +1,159 @@
+#include "tests.h"
+
+/**
+ * @brief Check levels
+ *
+ * Every level is smaller than the previous one, its error does not
+ * decrease, its edges use its own vertices and its vertices stay near the
+ * box of the object.
+ */
+static void check_levels(const data_t* data) {
+  const lod_chain_t* L = &data->obj_lod;
+  size_t vertices = data->count_of_vertices;
+  float error = 0.0f;
+
+  for (size_t i = 0; i < L->count_of_levels; i++) {
+    const lod_t* level = &L->levels[i];
+    ck_assert_uint_lt(level->vertices.rows, vertices);
+    ck_assert_uint_eq(level->vertices.cols, 3);
+    ck_assert_uint_le(1, level->edges.count_of_edges);
+    ck_assert_float_le(error, level->error);
+    vertices = level->vertices.rows;
+    error = level->error;
+
+    for (size_t e = 0; e < level->edges.count_of_edges * 2; e++) {
+      ck_assert_uint_lt(level->edges.indices[e], level->vertices.rows);
+    }
+    // ошибка уровня - средняя по плоскостям, отдельные вершины дальше
+    float margin = level->error * 2.0f + 1e-3f;
+    for (size_t v = 0; v < level->vertices.rows; v++) {
+      const float* vertex = matrix_vertex(&level->vertices, v);
+      for (int k = 0; k < 3; k++) {
+        ck_assert_float_le(data->bounds.min[k] - margin, vertex[k]);
+        ck_assert_float_le(vertex[k], data->bounds.max[k] + margin);
+      }
+    }
+  }
+}
+
+START_TEST(lod_test1) {
+  // волнистая поверхность упрощается в несколько уровней
+  data_t data;
+  make_grid(&data, 96, 0.1f);
+
+  ck_assert_int_eq(build_lod(&data, NULL), 0);
+  ck_assert_uint_le(2, data.obj_lod.count_of_levels);
+  check_levels(&data);
+  // грубые уровни заметно отходят от поверхности, но не дальше её высоты
+  const lod_chain_t* L = &data.obj_lod;
+  ck_assert_float_lt(0.0f, L->levels[L->count_of_levels - 1].error);
+  ck_assert_float_lt(L->levels[L->count_of_levels - 1].error, 0.2f);
+  // рёбрами уровней остаются только стороны полигонов: без диагоналей
+  // квадратов рёбер меньше, чем в триангуляции
+  const lod_t* first = &L->levels[0];
+  ck_assert_uint_lt(first->edges.count_of_edges,
+                    first->vertices.rows * 3);
+
+  free_memory(NULL, &data);
+  ck_assert_uint_eq(data.obj_lod.count_of_levels, 0);
+}
+
+START_TEST(lod_test2) {
+  // плоскость упрощается почти без ошибки, край не сжимается
+  data_t data;
+  make_grid(&data, 64, 0.0f);
+
+  ck_assert_int_eq(build_lod(&data, NULL), 0);
+  ck_assert_uint_le(1, data.obj_lod.count_of_levels);
+  check_levels(&data);
+  const lod_chain_t* L = &data.obj_lod;
+  for (size_t i = 0; i < L->count_of_levels; i++) {
+    ck_assert_float_lt(L->levels[i].error, 1e-3f);
+    bounds_t box;
+    bounds_reset(&box);
+    bounds_grow(&box, L->levels[i].vertices.matrix,
+                L->levels[i].vertices.rows);
+    for (int k = 0; k < 2; k++) {
+      ck_assert_float_eq_tol(box.min[k], 0.0f, 1e-4f);
+      ck_assert_float_eq_tol(box.max[k], 1.0f, 1e-4f);
+    }
+  }
+
+  // отменённое построение не оставляет уровней
+  progress_t progress = {0};
+  progress_cancel(&progress);
+  ck_assert_int_eq(build_lod(&data, &progress), LOAD_CANCELLED);
+  ck_assert_uint_eq(data.obj_lod.count_of_levels, 0);
+
+  // маленький объект не упрощается
+  free_memory(NULL, &data);
+  make_grid(&data, 8, 0.1f);
+  ck_assert_int_eq(build_lod(&data, NULL), 0);
+  ck_assert_uint_eq(data.obj_lod.count_of_levels, 0);
+  free_memory(NULL, &data);
+}
+
+START_TEST(lod_test3) {
+  // выбирается самый грубый уровень, ошибка которого меньше пикселя
+  lod_chain_t chain = {0};
+  chain.count_of_levels = 3;
+  chain.levels[0].error = 0.0625f;
+  chain.levels[1].error = 0.125f;
+  chain.levels[2].error = 1.0f;
+
+  ck_assert_uint_eq(lod_select(&chain, 1.0, 1.0), 3);
+  ck_assert_uint_eq(lod_select(&chain, 8.0, 1.0), 2);
+  ck_assert_uint_eq(lod_select(&chain, 16.0, 1.0), 1);
+  ck_assert_uint_eq(lod_select(&chain, 1000.0, 1.0), 0);
+  ck_assert_uint_eq(lod_select(&chain, NAN, 1.0), 0);
+
+  lod_chain_t empty = {0};
+  ck_assert_uint_eq(lod_select(&empty, 1.0, 1.0), 0);
+}
+
+START_TEST(lod_test4) {
+  // во время движения берётся самый подробный уровень, влезающий в бюджет
+  lod_chain_t chain = {0};
+  chain.count_of_levels = 3;
+  for (size_t i = 0; i < 3; i++) {
+    chain.levels[i].vertices.rows = 1000 >> (i * 2);
+    chain.levels[i].edges.count_of_edges = 3000 >> (i * 2);
+  }
+
+  ck_assert_uint_eq(lod_fit_budget(&chain, 0, 16000, 20000.0), 0);
+  ck_assert_uint_eq(lod_fit_budget(&chain, 0, 16000, 4000.0), 1);
+  ck_assert_uint_eq(lod_fit_budget(&chain, 0, 16000, 3999.0), 2);
+  ck_assert_uint_eq(lod_fit_budget(&chain, 0, 16000, 10.0), 3);
+  // уровень по ошибке на экране уже грубее бюджета
+  ck_assert_uint_eq(lod_fit_budget(&chain, 2, 16000, 1e9), 2);
+  ck_assert_uint_eq(lod_fit_budget(&chain, 0, 16000, NAN), 3);
+
+  lod_chain_t empty = {0};
+  ck_assert_uint_eq(lod_fit_budget(&empty, 0, 16000, 10.0), 0);
+}
+
+Suite* lod_test_suite() {
+  Suite* suite = suite_create("lod_test");
+  TCase* tcase = tcase_create("lod_test_case");
+
+  tcase_add_test(tcase, lod_test1);
+  tcase_add_test(tcase, lod_test2);
+  tcase_add_test(tcase, lod_test3);
+  tcase_add_test(tcase, lod_test4);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int lod_tests() {
+  Suite* suite = lod_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
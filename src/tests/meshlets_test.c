@@ -0,0 +1,437 @@
+#include "tests.h"
+
+/**
+ * @brief Make sphere
+ *
+ * Builds a closed sphere of radius 0.5 around the origin from rings of quads
+ * and triangles at the poles, wound one way or the other.
+ */
+static void make_sphere(data_t* data, size_t slices, size_t stacks,
+                        int reversed) {
+  size_t rings = stacks - 1;
+  *data = (data_t){0};
+  data->count_of_vertices = rings * slices + 2;
+  data->count_of_facets = stacks * slices;
+  data->obj_matrix.rows = data->count_of_vertices;
+  data->obj_matrix.cols = 3;
+  ck_assert_int_eq(matrix_mem_alloc(data), 0);
+  float* pole = matrix_vertex(&data->obj_matrix, 0);
+  pole[0] = pole[1] = 0.0f;
+  pole[2] = 0.5f;
+  for (size_t t = 0; t < rings; t++) {
+    float theta = 3.14159265f * (float)(t + 1) / (float)stacks;
+    for (size_t s = 0; s < slices; s++) {
+      float phi = 6.2831853f * (float)s / (float)slices;
+      float* vertex = matrix_vertex(&data->obj_matrix, 1 + t * slices + s);
+      vertex[0] = 0.5f * sinf(theta) * cosf(phi);
+      vertex[1] = 0.5f * sinf(theta) * sinf(phi);
+      vertex[2] = 0.5f * cosf(theta);
+    }
+  }
+  pole = matrix_vertex(&data->obj_matrix, data->count_of_vertices - 1);
+  pole[0] = pole[1] = 0.0f;
+  pole[2] = -0.5f;
+
+  size_t count = data->count_of_facets;
+  data->obj_facets.offsets = malloc((count + 1) * sizeof(size_t));
+  data->obj_facets.indices = malloc(count * 4 * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(data->obj_facets.offsets);
+  ck_assert_ptr_nonnull(data->obj_facets.indices);
+  uint32_t* indices = data->obj_facets.indices;
+  size_t facet = 0, offset = 0;
+  uint32_t south = (uint32_t)data->count_of_vertices;
+  for (size_t t = 0; t < stacks; t++) {
+    for (size_t s = 0; s < slices; s++) {
+      // вершины кольца над полосой, у северного полюса это сам полюс
+      uint32_t a = t != 0 ? (uint32_t)(2 + (t - 1) * slices + s) : 1;
+      uint32_t b = t != 0 ? (uint32_t)(2 + (t - 1) * slices + (s + 1) % slices)
+                          : 1;
+      uint32_t corners[4] = {a, (uint32_t)(a + slices),
+                             (uint32_t)(b + slices), b};
+      size_t size = 4;
+      if (t == 0) {
+        corners[1] = (uint32_t)(2 + s);
+        corners[2] = (uint32_t)(2 + (s + 1) % slices);
+        size = 3;
+      } else if (t + 1 == stacks) {
+        corners[0] = b;
+        corners[1] = a;
+        corners[2] = south;
+        size = 3;
+      }
+      data->obj_facets.offsets[facet++] = offset;
+      for (size_t k = 0; k < size; k++) {
+        indices[offset + k] = corners[reversed ? size - 1 - k : k];
+      }
+      offset += size;
+    }
+  }
+  data->obj_facets.offsets[count] = offset;
+  data->obj_facets.count_of_indices = offset;
+
+  ck_assert_int_eq(build_edges(data, 0), 0);
+  ck_assert_int_eq(build_bvh(data, 1), 0);
+  ck_assert_int_eq(build_meshlets(data, 1), 0);
+}
+
+/**
+ * @brief Compare keys
+ *
+ * Orders pairs of an edge key and its index by the key for bsearch.
+ */
+static int compare_keys(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Edge key
+ *
+ * @return Key of an edge by its vertices in any order
+ */
+static uint64_t edge_key(uint32_t from, uint32_t to) {
+  return from < to ? (uint64_t)from << 32 | to : (uint64_t)to << 32 | from;
+}
+
+/**
+ * @brief Sorted keys
+ *
+ * Pairs of keys of edges and their indices, sorted by the keys.
+ *
+ * @return Array of 2 * count_of_edges values, freed by the caller
+ */
+static uint64_t* sorted_keys(const data_t* data) {
+  size_t count = data->obj_edges.count_of_edges;
+  uint64_t* keys = malloc(count * 2 * sizeof(uint64_t));
+  ck_assert_ptr_nonnull(keys);
+  for (size_t e = 0; e < count; e++) {
+    const uint32_t* edge = data->obj_edges.indices + e * 2;
+    keys[e * 2] = edge_key(edge[0], edge[1]);
+    keys[e * 2 + 1] = e;
+  }
+  qsort(keys, count, 2 * sizeof(uint64_t), compare_keys);
+  return keys;
+}
+
+/**
+ * @brief Edge index
+ *
+ * @return Index of the edge between two vertices from 0
+ */
+static size_t edge_index(const data_t* data, const uint64_t* keys,
+                         uint32_t from, uint32_t to) {
+  uint64_t key = edge_key(from, to);
+  const uint64_t* found = bsearch(&key, keys, data->obj_edges.count_of_edges,
+                                  2 * sizeof(uint64_t), compare_keys);
+  ck_assert_ptr_nonnull(found);
+  return found[1];
+}
+
+/**
+ * @brief Drawn edges
+ *
+ * Culls clusters with the matrix and marks edges of the ranges left with 1
+ * and edges drawn only from the ranges of boundary edges with 2.
+ *
+ * @return Number of marked edges
+ */
+static size_t drawn_edges(const data_t* data, const float mvp[16],
+                          char* drawn) {
+  const meshlets_t* M = &data->obj_meshlets;
+  bvh_ranges_t ranges = {0}, boundary = {0};
+  size_t count = 0;
+  ck_assert_int_eq(meshlets_cull(data, mvp, &ranges, &boundary), 0);
+  memset(drawn, 0, data->obj_edges.count_of_edges);
+  for (size_t r = 0; r < ranges.count_of_ranges; r++) {
+    size_t first = ranges.ranges[r * 2], length = ranges.ranges[r * 2 + 1];
+    ck_assert_uint_le(first + length, data->obj_edges.count_of_edges);
+    for (size_t e = first; e < first + length; e++) {
+      if (!drawn[e]) count++;
+      drawn[e] = 1;
+    }
+  }
+  uint64_t* keys = boundary.count_of_ranges != 0 ? sorted_keys(data) : NULL;
+  for (size_t r = 0; r < boundary.count_of_ranges; r++) {
+    size_t first = boundary.ranges[r * 2], length = boundary.ranges[r * 2 + 1];
+    ck_assert_uint_le(first + length, M->count_of_boundary_edges);
+    for (size_t i = first; i < first + length; i++) {
+      const uint32_t* edge = M->boundary_edges + i * 2;
+      size_t e = edge_index(data, keys, edge[0], edge[1]);
+      if (!drawn[e]) {
+        count++;
+        drawn[e] = 2;
+      }
+    }
+  }
+  free(keys);
+  bvh_ranges_free(&ranges);
+  bvh_ranges_free(&boundary);
+  return count;
+}
+
+/**
+ * @brief Check front edges
+ *
+ * Checks that every edge whose vertices are closer to the viewer than the
+ * given depth along z is drawn.
+ */
+static void check_front_edges(const data_t* data, const char* drawn,
+                              float depth) {
+  for (size_t e = 0; e < data->obj_edges.count_of_edges; e++) {
+    const uint32_t* edge = data->obj_edges.indices + e * 2;
+    const float* a = matrix_vertex(&data->obj_matrix, edge[0]);
+    const float* b = matrix_vertex(&data->obj_matrix, edge[1]);
+    if (a[2] < depth && b[2] < depth) ck_assert_int_eq(drawn[e], 1);
+  }
+}
+
+START_TEST(meshlets_test1) {
+  for (int reversed = 0; reversed < 2; reversed++) {
+    data_t data;
+    make_sphere(&data, 64, 32, reversed);
+    const meshlets_t* M = &data.obj_meshlets;
+    ck_assert_int_eq(M->closed, 1);
+    ck_assert_uint_le(2, M->count_of_meshlets);
+
+    size_t facets = 0, edges = 0;
+    for (size_t m = 0; m < M->count_of_meshlets; m++) {
+      const meshlet_t* meshlet = &M->meshlets[m];
+      ck_assert_uint_eq(meshlet->first_facet, facets);
+      ck_assert_uint_eq(meshlet->first_edge, edges);
+      facets += meshlet->count_of_facets;
+      edges += meshlet->count_of_edges;
+      ck_assert_uint_le(meshlet->count_of_vertices, MESHLET_MAX_VERTICES);
+      ck_assert_uint_le(meshlet->count_of_triangles, MESHLET_MAX_TRIANGLES);
+
+      // все вершины кластера внутри его сферы
+      for (uint32_t p = 0; p < meshlet->count_of_facets; p++) {
+        size_t facet = data.obj_bvh.facets[meshlet->first_facet + p];
+        for (size_t k = 0; k < facet_size(&data.obj_facets, facet); k++) {
+          const float* point = matrix_vertex(
+              &data.obj_matrix, facet_vertex(&data.obj_facets, facet, k) - 1);
+          float distance = 0.0f;
+          for (int i = 0; i < 3; i++) {
+            float delta = point[i] - meshlet->center[i];
+            distance += delta * delta;
+          }
+          ck_assert_float_le(sqrtf(distance), meshlet->radius);
+        }
+      }
+
+      // конус смотрит наружу при любом порядке обхода
+      ck_assert_float_le(meshlet->cone_cutoff, 1.0f);
+      float dot = 0.0f, length = 0.0f;
+      for (int i = 0; i < 3; i++) {
+        dot += meshlet->cone_axis[i] * meshlet->center[i];
+        length += meshlet->center[i] * meshlet->center[i];
+      }
+      ck_assert_float_lt(0.5f * sqrtf(length), dot);
+    }
+    ck_assert_uint_eq(facets, data.count_of_facets);
+    ck_assert_uint_eq(edges, data.obj_edges.count_of_edges);
+    free_memory(NULL, &data);
+  }
+}
+
+START_TEST(meshlets_test2) {
+  data_t data;
+  make_sphere(&data, 96, 48, 0);
+  size_t count = data.obj_edges.count_of_edges;
+  char* drawn = malloc(count);
+  ck_assert_ptr_nonnull(drawn);
+
+  // ортографическая проекция, глубина растёт вдоль z
+  float ortho[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  size_t visible = drawn_edges(&data, ortho, drawn);
+  check_front_edges(&data, drawn, -0.1f);
+  ck_assert_uint_le(visible * 4, count * 3);
+  ck_assert_uint_le(count * 3, visible * 10);
+
+  // камера в (0, 0, -3) смотрит вдоль z
+  float n = 0.1f, f = 10.0f, a = (f + n) / (f - n), b = 2 * f * n / (f - n);
+  float perspective[16] = {2, 0, 0, 0, 0, 2, 0, 0, 0, 0, a, 1, 0, 0, 3 * a - b,
+                           3};
+  visible = drawn_edges(&data, perspective, drawn);
+  check_front_edges(&data, drawn, -0.15f);
+  ck_assert_uint_le(visible * 4, count * 3);
+
+  // сфера справа от окна
+  ortho[12] = 5.0f;
+  ck_assert_uint_eq(drawn_edges(&data, ortho, drawn), 0);
+
+  free(drawn);
+  free_memory(NULL, &data);
+}
+
+START_TEST(meshlets_test3) {
+  data_t data;
+  make_sphere(&data, 40, 20, 1);
+  meshlets_t serial = data.obj_meshlets;
+  data.obj_meshlets = (meshlets_t){0};
+  ck_assert_int_eq(build_meshlets(&data, 0), 0);
+  ck_assert_uint_eq(data.obj_meshlets.count_of_meshlets,
+                    serial.count_of_meshlets);
+  ck_assert_int_eq(memcmp(data.obj_meshlets.meshlets, serial.meshlets,
+                          serial.count_of_meshlets * sizeof(meshlet_t)),
+                   0);
+  meshlets_free(&serial);
+
+  // без южной шапки поверхность открыта и видна с обеих сторон
+  data.count_of_facets -= 40;
+  data.obj_facets.count_of_indices =
+      data.obj_facets.offsets[data.count_of_facets];
+  free(data.obj_edges.indices);
+  data.obj_edges.indices = NULL;
+  ck_assert_int_eq(build_edges(&data, 0), 0);
+  ck_assert_int_eq(build_bvh(&data, 1), 0);
+  ck_assert_int_eq(build_meshlets(&data, 1), 0);
+  ck_assert_int_eq(data.obj_meshlets.closed, 0);
+  size_t count = data.obj_edges.count_of_edges;
+  char* drawn = malloc(count);
+  ck_assert_ptr_nonnull(drawn);
+  float ortho[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  ck_assert_uint_eq(drawn_edges(&data, ortho, drawn), count);
+  free(drawn);
+  free_memory(NULL, &data);
+
+  // без упорядоченных рёбер кластеры не строятся
+  data_t empty = {0};
+  ck_assert_int_eq(build_meshlets(&empty, 1), 1);
+  ck_assert_uint_eq(empty.obj_meshlets.count_of_meshlets, 0);
+  free_memory(NULL, &empty);
+}
+
+START_TEST(meshlets_test4) {
+  for (int reversed = 0; reversed < 2; reversed++) {
+    data_t data;
+    make_sphere(&data, 64, 32, reversed);
+    const meshlets_t* M = &data.obj_meshlets;
+    ck_assert_uint_lt(0, M->count_of_boundary_edges);
+    ck_assert_uint_lt(M->count_of_boundary_edges,
+                      data.obj_edges.count_of_edges);
+    uint64_t* keys = sorted_keys(&data);
+    char* drawn = malloc(data.obj_edges.count_of_edges);
+    ck_assert_ptr_nonnull(drawn);
+    size_t rescued = 0;
+
+    // поворот сферы переносит контур через границы кластеров
+    for (int turn = 0; turn < 48; turn++) {
+      float a = 0.29f * (float)turn, b = 0.17f * (float)turn;
+      float ca = cosf(a), sa = sinf(a), cb = cosf(b), sb = sinf(b);
+      // поворот вокруг OX на b после поворота вокруг OY на a, по столбцам
+      float mvp[16] = {ca, sb * sa,  -cb * sa, 0, 0, cb, sb, 0,
+                       sa, -sb * ca, cb * ca,  0, 0, 0,  0,  1};
+      drawn_edges(&data, mvp, drawn);
+
+      // все стороны полигона, обращённого к камере, нарисованы
+      for (size_t f = 0; f < data.count_of_facets; f++) {
+        size_t count = facet_size(&data.obj_facets, f);
+        int front = 0;
+        for (size_t k = 1; k + 1 < count && !front; k++) {
+          const float* c[3];
+          float u[3], w[3], n[3], center[3];
+          for (int i = 0; i < 3; i++) {
+            size_t corner = i == 0 ? 0 : k + (size_t)i - 1;
+            c[i] = matrix_vertex(&data.obj_matrix,
+                                 facet_vertex(&data.obj_facets, f, corner) - 1);
+          }
+          for (int i = 0; i < 3; i++) {
+            u[i] = c[1][i] - c[0][i];
+            w[i] = c[2][i] - c[0][i];
+            center[i] = c[0][i] + c[1][i] + c[2][i];
+          }
+          n[0] = u[1] * w[2] - u[2] * w[1];
+          n[1] = u[2] * w[0] - u[0] * w[2];
+          n[2] = u[0] * w[1] - u[1] * w[0];
+          // нормаль наружу сферы, глубина растёт вдоль z
+          float outward =
+              n[0] * center[0] + n[1] * center[1] + n[2] * center[2];
+          float depth = mvp[2] * n[0] + mvp[6] * n[1] + mvp[10] * n[2];
+          float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+          front = (outward > 0.0f ? depth : -depth) < -1e-3f * length;
+        }
+        for (size_t k = 0; front && k < count; k++) {
+          uint32_t from = facet_vertex(&data.obj_facets, f, k) - 1;
+          uint32_t to = facet_vertex(&data.obj_facets, f, (k + 1) % count) - 1;
+          char mark = drawn[edge_index(&data, keys, from, to)];
+          ck_assert_int_ne(mark, 0);
+          rescued += mark == 2;
+        }
+      }
+    }
+    // контур хотя бы раз проходил по границе пропущенного кластера
+    ck_assert_uint_lt(0, rescued);
+
+    free(drawn);
+    free(keys);
+    free_memory(NULL, &data);
+  }
+}
+
+/**
+ * @brief Perspective matrix
+ *
+ * Camera on OZ at the distance from the origin looking at it, with the near
+ * plane at the given distance from the camera and the far plane at 10.
+ */
+static void perspective(float distance, float near, float mvp[16]) {
+  float a = -(10.0f + near) / (10.0f - near);
+  float b = -2.0f * 10.0f * near / (10.0f - near);
+  float columns[16] = {1, 0, 0, 0, 0, 1, 0, 0,
+                       0, 0, a, -1, 0, 0, b - a * distance, distance};
+  memcpy(mvp, columns, sizeof(columns));
+}
+
+START_TEST(meshlets_test5) {
+  for (int reversed = 0; reversed < 2; reversed++) {
+    data_t data;
+    make_sphere(&data, 64, 32, reversed);
+    char* drawn = malloc(data.obj_edges.count_of_edges);
+    ck_assert_ptr_nonnull(drawn);
+    // камера снаружи, ближняя плоскость перед сферой, невидимое пропускается,
+    // ближняя плоскость режет сферу или камера внутри - видно всё в окне
+    const float cameras[3][2] = {{3.0f, 1.0f}, {0.8f, 0.5f}, {0.0f, 0.1f}};
+    for (int c = 0; c < 3; c++) {
+      float mvp[16];
+      perspective(cameras[c][0], cameras[c][1], mvp);
+      size_t culled = drawn_edges(&data, mvp, drawn);
+      data.obj_meshlets.closed = 0;
+      size_t inside = drawn_edges(&data, mvp, drawn);
+      data.obj_meshlets.closed = 1;
+      if (c == 0) {
+        ck_assert_uint_lt(culled, inside);
+      } else {
+        ck_assert_uint_eq(culled, inside);
+      }
+    }
+    free(drawn);
+    free_memory(NULL, &data);
+  }
+}
+
+Suite* meshlets_test_suite() {
+  Suite* suite = suite_create("meshlets_test");
+  TCase* tcase = tcase_create("meshlets_test_case");
+
+  tcase_add_test(tcase, meshlets_test1);
+  tcase_add_test(tcase, meshlets_test2);
+  tcase_add_test(tcase, meshlets_test3);
+  tcase_add_test(tcase, meshlets_test4);
+  tcase_add_test(tcase, meshlets_test5);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int meshlets_tests() {
+  Suite* suite = meshlets_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
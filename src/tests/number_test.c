@@ -0,0 +1,182 @@
+#include <locale.h>
+
+#include "tests.h"
+
+static const char* number_strings[] = {
+    "0",
+    "-0",
+    "+1",
+    "1.5",
+    ".5",
+    "5.",
+    "-2.6301",
+    "15.6182",
+    "1.000000",
+    "-1.000000",
+    "0.000001",
+    "123.456789",
+    "1e10",
+    "1E-5",
+    "-3.25e+2",
+    "0.1",
+    "0.30000000000000004",
+    "9007199254740993",
+    "123456789012345678901234",
+    "0.000000000000000000000000000001",
+    "3.4028235e38",
+    "3.4028236e38",
+    "1e39",
+    "1e-46",
+    "1.4e-45",
+    "1.17549435e-38",
+    "4.9e-324",
+    "2.2250738585072011e-308",
+    "1.00000005960464477539062",
+    "1.00000017881393432617188",
+    "7.038531e-26",
+    "inf",
+    "-Infinity",
+    "nan",
+    "12abc",
+    "1e",
+    "1e+",
+    "-",
+    ".",
+    "abc",
+    "0x1.8p1",
+    "-0X1P-3",
+    "0x1f",
+    "0x.8",
+    "0x",
+    "0x1p",
+    "0xg",
+    "0x1.fffffep127",
+    "0x1.ffffffp127",
+};
+
+/**
+ * @brief Check one string
+ *
+ * Compares parse_double and parse_float with strtod and strtof bit by bit,
+ * including the number of consumed characters.
+ */
+static void check_number(const char* str) {
+  const char* end = str + strlen(str);
+
+  char* expected_end = NULL;
+  double expected = strtod(str, &expected_end);
+  double value = 0.0;
+  const char* stop = parse_double(str, end, &value);
+  ck_assert_ptr_eq(stop, expected_end);
+  if (stop != str) ck_assert_mem_eq(&value, &expected, sizeof(value));
+
+  float expected_float = strtof(str, &expected_end);
+  float value_float = 0.0f;
+  stop = parse_float(str, end, &value_float);
+  ck_assert_ptr_eq(stop, expected_end);
+  if (stop != str) {
+    ck_assert_mem_eq(&value_float, &expected_float, sizeof(value_float));
+  }
+}
+
+START_TEST(number_test1) {
+  for (size_t i = 0; i < sizeof(number_strings) / sizeof(number_strings[0]);
+       i++) {
+    check_number(number_strings[i]);
+  }
+}
+
+START_TEST(number_test2) {
+  char str[64];
+  srand(21);
+
+  for (int i = 0; i < 200000; i++) {
+    int length = 0;
+    if (rand() % 2) str[length++] = '-';
+    int int_digits = rand() % 12;
+    for (int k = 0; k < int_digits; k++) str[length++] = '0' + rand() % 10;
+    str[length++] = '.';
+    int fraction_digits = rand() % (i % 3 == 0 ? 25 : 9);
+    for (int k = 0; k < fraction_digits; k++) str[length++] = '0' + rand() % 10;
+    if (rand() % 4 == 0) {
+      length += sprintf(str + length, "e%d", rand() % 90 - 45);
+    }
+    str[length] = '\0';
+    check_number(str);
+  }
+}
+
+START_TEST(number_test3) {
+  // строка не обязана завершаться нулём
+  const char* str = "12345.678 9";
+  double value = 0.0;
+  const char* stop = parse_double(str, str + 3, &value);
+  ck_assert_ptr_eq(stop, str + 3);
+  ck_assert_double_eq(value, 123.0);
+
+  stop = parse_double(str, str + 7, &value);
+  ck_assert_ptr_eq(stop, str + 7);
+  ck_assert_double_eq(value, 12345.6);
+
+  size_t index = 0;
+  str = "49712/51224/49701 7";
+  stop = parse_index(str, str + strlen(str), &index);
+  ck_assert_int_eq(index, 49712);
+  ck_assert_int_eq(*stop, '/');
+
+  str = "12345678901234567";
+  stop = parse_index(str, str + strlen(str), &index);
+  ck_assert_ptr_eq(stop, str + strlen(str));
+  ck_assert(index == 12345678901234567ULL);
+
+  index = 5;
+  str = "-1";
+  stop = parse_index(str, str + strlen(str), &index);
+  ck_assert_ptr_eq(stop, str);
+  ck_assert_int_eq(index, 5);
+}
+
+START_TEST(number_test4) {
+  // разбор не зависит от десятичного разделителя локали
+  if (setlocale(LC_NUMERIC, "de_DE.UTF-8") != NULL ||
+      setlocale(LC_NUMERIC, "ru_RU.UTF-8") != NULL) {
+    prepare_number_parser();
+    const char* strings[] = {"1.5", "-2.6301", "123456789012345678901234.5",
+                             "2.2250738585072011e-308"};
+    const double expected[] = {1.5, -2.6301, 123456789012345678901234.5,
+                               2.2250738585072011e-308};
+    for (int i = 0; i < 4; i++) {
+      double value = 0.0;
+      parse_double(strings[i], strings[i] + strlen(strings[i]), &value);
+      ck_assert_double_eq(value, expected[i]);
+    }
+    setlocale(LC_NUMERIC, "C");
+    prepare_number_parser();
+  }
+}
+
+Suite* number_test_suite() {
+  Suite* suite = suite_create("number_test");
+  TCase* tcase = tcase_create("number_test_case");
+
+  tcase_add_test(tcase, number_test1);
+  tcase_add_test(tcase, number_test2);
+  tcase_add_test(tcase, number_test3);
+  tcase_add_test(tcase, number_test4);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int number_tests() {
+  Suite* suite = number_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -37,11 +37,10 @@ START_TEST(obj_test3) {
   ck_assert(test_data.obj_matrix.rows == test_data.count_of_vertices);
   ck_assert(test_data.obj_matrix.cols == 3);
   for (unsigned int i = 0; i < test_data.obj_matrix.rows; i++) {
-    ck_assert(test_data.obj_matrix.matrix[i] != NULL);
-  }
-  for (unsigned int i = 0; i < test_data.obj_matrix.rows; ++i) {
-    free(test_data.obj_matrix.matrix[i]);
+    float* vertex = matrix_vertex(&test_data.obj_matrix, i);
+    ck_assert(vertex[0] == 0 && vertex[1] == 0 && vertex[2] == 0);
   }
+  ck_assert_int_eq((size_t)test_data.obj_matrix.matrix % VERTEX_ALIGNMENT, 0);
   free(test_data.obj_matrix.matrix);
 }
 
@@ -61,16 +60,14 @@ START_TEST(obj_test4) {
   while (fgets(line, sizeof(line), file)) {
     if (line[0] == 'v' && line[1] != 'n' && line[1] != 't') {
       sscanf(line, "%*s %lf %lf %lf\n", &x, &y, &z);
-      ck_assert_float_eq(data.obj_matrix.matrix[v_lines_counter][0], x);
-      ck_assert_float_eq(data.obj_matrix.matrix[v_lines_counter][1], y);
-      ck_assert_float_eq(data.obj_matrix.matrix[v_lines_counter][2], z);
+      float* vertex = matrix_vertex(&data.obj_matrix, v_lines_counter);
+      ck_assert_float_eq(vertex[0], x);
+      ck_assert_float_eq(vertex[1], y);
+      ck_assert_float_eq(vertex[2], z);
       v_lines_counter++;
     }
   }
   fclose(file);
-  for (unsigned int i = 0; i < data.obj_matrix.rows; ++i) {
-    free(data.obj_matrix.matrix[i]);
-  }
   free(data.obj_matrix.matrix);
 }
 
@@ -86,7 +83,7 @@ START_TEST(obj_test5) {
   rewind(file);
   count_vertices_in_facets(file, &data);
   rewind(file);
-  ck_assert(data.obj_polygons != NULL);
+  ck_assert(data.obj_facets.offsets != NULL);
   int f_lines_counter = 0;
   char line[256];
   unsigned int count_of_vertices = 0;
@@ -101,14 +98,13 @@ START_TEST(obj_test5) {
         token = strtok(NULL, " ");
       }
       ck_assert(
-          data.obj_polygons[f_lines_counter].numbers_of_vertices_in_facets ==
-          count_of_vertices);
+          facet_size(&data.obj_facets, f_lines_counter) == count_of_vertices);
       count_of_vertices = 0;
       f_lines_counter++;
     }
   }
   for (unsigned int i = 0; i < data.count_of_facets; i++) {
-    ck_assert(data.obj_polygons[i].vertices != NULL);
+    ck_assert(data.obj_facets.offsets[i] <= data.obj_facets.offsets[i + 1]);
   }
   free_memory(file, &data);
 }
@@ -136,8 +132,10 @@ START_TEST(obj_test6) {
       while (token != NULL) {
         size_t vertex = 0;
         if (sscanf(token, "%zu", &vertex) == 1) {
-          ck_assert(data.obj_polygons[f_lines_counter].vertices[counter] ==
-                    vertex);
+          // номера за последней вершиной хранятся как недопустимые
+          if (vertex > data.count_of_vertices) vertex = 0;
+          ck_assert(facet_vertex(&data.obj_facets, f_lines_counter,
+                                 counter) == vertex);
           counter++;
         }
         token = strtok(NULL, " ");
@@ -163,6 +161,272 @@ START_TEST(obj_test7) {
   ck_assert_ptr_null(data.obj_matrix.matrix);
 }
 
+START_TEST(obj_test8) {
+  data_t expected = {0};
+  FILE* file = fopen("tests/test.obj", "r");
+  count_vertices_and_facets(file, &expected);
+  rewind(file);
+  initialize_obj_matrix(&expected);
+  copy_vertices_from_obj_to_matrix(file, &expected);
+  rewind(file);
+  count_vertices_in_facets(file, &expected);
+  rewind(file);
+  copy_indexes_from_obj_to_struct(file, &expected);
+
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("tests/test.obj", &data), 0);
+  ck_assert_int_eq(data.count_of_vertices, expected.count_of_vertices);
+  ck_assert_int_eq(data.count_of_facets, expected.count_of_facets);
+  for (size_t i = 0; i < data.count_of_vertices; i++) {
+    for (size_t k = 0; k < 3; k++) {
+      ck_assert_float_eq(matrix_vertex(&data.obj_matrix, i)[k],
+                         matrix_vertex(&expected.obj_matrix, i)[k]);
+    }
+  }
+  for (size_t i = 0; i < data.count_of_facets; i++) {
+    size_t count = facet_size(&data.obj_facets, i);
+    ck_assert_int_eq(count, facet_size(&expected.obj_facets, i));
+    for (size_t k = 0; k < count; k++) {
+      ck_assert_int_eq(facet_vertex(&data.obj_facets, i, k),
+                       facet_vertex(&expected.obj_facets, i, k));
+    }
+  }
+  // все три оси, без пропусков у первых вершин
+  ck_assert_float_eq(data.bounds.min[0], -2.8463f);
+  ck_assert_float_eq(data.bounds.max[0], -2.4404f);
+  ck_assert_float_eq(data.bounds.min[1], 6.242f);
+  ck_assert_float_eq(data.bounds.max[1], 7.2213f);
+  ck_assert_float_eq(data.bounds.min[2], 15.4071f);
+  ck_assert_float_eq(data.bounds.max[2], 15.8047f);
+  ck_assert_mem_eq(&data.bounds, &expected.bounds, sizeof(bounds_t));
+
+  free_memory(NULL, &data);
+  free_memory(file, &expected);
+}
+
+START_TEST(obj_test9) {
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("wrong_file.obj", &data), 1);
+  ck_assert_ptr_null(data.obj_matrix.matrix);
+  ck_assert_ptr_null(data.obj_facets.offsets);
+}
+
+START_TEST(obj_test10) {
+  const char* filenames[] = {"tests/test.obj", "frontend/objects/tree.obj"};
+  size_t threads[] = {1, 3, 8, 0};
+
+  for (size_t f = 0; f < 2; f++) {
+    data_t expected = {0};
+    ck_assert_int_eq(parse_obj_file(filenames[f], &expected), 0);
+
+    for (size_t t = 0; t < 4; t++) {
+      data_t data = {0};
+      ck_assert_int_eq(
+          parse_obj_file_parallel(filenames[f], &data, threads[t], NULL), 0);
+      ck_assert_int_eq(data.count_of_vertices, expected.count_of_vertices);
+      ck_assert_int_eq(data.count_of_facets, expected.count_of_facets);
+      for (size_t i = 0; i < data.count_of_vertices; i++) {
+        for (size_t k = 0; k < 3; k++) {
+          ck_assert_float_eq(matrix_vertex(&data.obj_matrix, i)[k],
+                             matrix_vertex(&expected.obj_matrix, i)[k]);
+        }
+      }
+      for (size_t i = 0; i < data.count_of_facets; i++) {
+        size_t count = facet_size(&data.obj_facets, i);
+        ck_assert_int_eq(count, facet_size(&expected.obj_facets, i));
+        for (size_t k = 0; k < count; k++) {
+          ck_assert_int_eq(facet_vertex(&data.obj_facets, i, k),
+                           facet_vertex(&expected.obj_facets, i, k));
+        }
+      }
+      ck_assert_mem_eq(&data.bounds, &expected.bounds, sizeof(bounds_t));
+      free_memory(NULL, &data);
+    }
+
+    free_memory(NULL, &expected);
+  }
+
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file_parallel("wrong_file.obj", &data, 4, NULL),
+                   1);
+}
+
+START_TEST(obj_test11) {
+  progress_t progress = {0};
+  data_t data = {0};
+  ck_assert_int_eq(
+      parse_obj_file_parallel("frontend/objects/tree.obj", &data, 4, &progress),
+      0);
+  ck_assert_double_eq(progress_fraction(&progress), 1.0);
+  free_memory(NULL, &data);
+
+  progress_t cancelled = {0};
+  progress_cancel(&cancelled);
+  ck_assert_int_eq(parse_obj_file_parallel("frontend/objects/tree.obj", &data,
+                                           4, &cancelled),
+                   LOAD_CANCELLED);
+  ck_assert_ptr_null(data.obj_matrix.matrix);
+  ck_assert(progress_fraction(&cancelled) < 1.0);
+
+  // проходы после чтения файла занимают равные доли
+  progress_t stages = {0};
+  progress_set_stages(&stages, 4);
+  ck_assert_int_eq(
+      parse_obj_file_parallel("frontend/objects/tree.obj", &data, 4, &stages),
+      0);
+  ck_assert_double_eq(progress_fraction(&stages), 0.25);
+  ck_assert_int_eq(progress_next_stage(&stages), 0);
+  ck_assert_double_eq(progress_fraction(&stages), 0.25);
+  ck_assert_int_eq(progress_next_stage(&stages), 0);
+  ck_assert_double_eq(progress_fraction(&stages), 0.5);
+  progress_cancel(&stages);
+  ck_assert_int_eq(progress_next_stage(&stages), 1);
+  ck_assert_double_eq(progress_fraction(&stages), 0.75);
+  free_memory(NULL, &data);
+}
+
+START_TEST(obj_test12) {
+  progress_t* progress = calloc(1, sizeof(progress_t));
+  partial_t* partial = calloc(1, sizeof(partial_t));
+  data_t data = {0};
+  ck_assert_int_eq(
+      parse_obj_file_parallel("frontend/objects/tree.obj", &data, 3, progress),
+      0);
+
+  ck_assert_int_eq(progress_acquire_partial(progress, partial), 1);
+  ck_assert_ptr_eq(partial->data->obj_matrix.matrix, data.obj_matrix.matrix);
+  size_t vertices = 0;
+  size_t facets = 0;
+  for (size_t i = 0; i < partial->count_of_parts; i++) {
+    ck_assert_int_eq(partial->parts[i].vertex_base, vertices);
+    vertices += partial->parts[i].parsed_vertices;
+    facets += partial->parts[i].parsed_facets;
+  }
+  ck_assert_int_eq(vertices, data.count_of_vertices);
+  ck_assert_int_eq(facets, data.count_of_facets);
+  ck_assert_int_eq(partial_vertex_parsed(partial, 1), 1);
+  ck_assert_int_eq(partial_vertex_parsed(partial, vertices), 1);
+  ck_assert_int_eq(partial_vertex_parsed(partial, vertices + 1), 0);
+  ck_assert_int_eq(partial_vertex_parsed(partial, 0), 0);
+  progress_release_partial(progress);
+  free_memory(NULL, &data);
+
+  // после отмены частичный объект недоступен
+  memset(progress, 0, sizeof(progress_t));
+  progress_cancel(progress);
+  parse_obj_file_parallel("frontend/objects/tree.obj", &data, 3, progress);
+  ck_assert_int_eq(progress_acquire_partial(progress, partial), 0);
+  ck_assert_int_eq(progress->readers, 0);
+
+  free(progress);
+  free(partial);
+}
+
+START_TEST(obj_test13) {
+  // номера вершин хранятся одним массивом в 32 битах
+  data_t data = {0};
+  data_t parallel = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/tree.obj", &data), 0);
+  ck_assert_int_eq(
+      parse_obj_file_parallel("frontend/objects/tree.obj", &parallel, 4, NULL),
+      0);
+
+  facets_t* facets = &data.obj_facets;
+  ck_assert_int_eq(facets->wide_indices, 0);
+  ck_assert_int_eq(parallel.obj_facets.wide_indices, 0);
+  ck_assert_int_eq(facets->offsets[0], 0);
+  ck_assert_int_eq(facets->offsets[data.count_of_facets],
+                   facets->count_of_indices);
+  ck_assert_int_eq(parallel.obj_facets.count_of_indices,
+                   facets->count_of_indices);
+  ck_assert_mem_eq(parallel.obj_facets.offsets, facets->offsets,
+                   (data.count_of_facets + 1) * sizeof(size_t));
+  ck_assert_mem_eq(parallel.obj_facets.indices, facets->indices,
+                   facets->count_of_indices * sizeof(uint32_t));
+  for (size_t i = 0; i < data.count_of_facets; i++) {
+    ck_assert(facet_size(facets, i) > 0);
+    for (size_t k = 0; k < facet_size(facets, i); k++) {
+      size_t vertex = facet_vertex(facets, i, k);
+      ck_assert(vertex >= 1 && vertex <= data.count_of_vertices);
+    }
+  }
+
+  free_memory(NULL, &data);
+  free_memory(NULL, &parallel);
+  ck_assert_ptr_null(data.obj_facets.indices);
+}
+
+START_TEST(obj_test14) {
+  // сфера с центром в середине коробки касается самой дальней вершины
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/tree.obj", &data), 0);
+  const bounds_t* bounds = &data.bounds;
+  float farthest = 0.0f;
+  for (size_t i = 0; i < data.count_of_vertices; i++) {
+    const float* vertex = matrix_vertex(&data.obj_matrix, i);
+    float squared = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      ck_assert(vertex[k] >= bounds->min[k] && vertex[k] <= bounds->max[k]);
+      float d = vertex[k] - bounds->center[k];
+      squared += d * d;
+    }
+    farthest = fmaxf(farthest, squared);
+  }
+  ck_assert_float_eq_tol(bounds->radius, sqrtf(farthest), 1e-5);
+  for (int k = 0; k < 3; k++) {
+    ck_assert_float_eq_tol(bounds->center[k],
+                           (bounds->min[k] + bounds->max[k]) / 2.0f, 1e-5);
+  }
+
+  // без вершин вычисляется половина диагонали, пустые границы нулевые
+  bounds_t box;
+  bounds_reset(&box);
+  bounds_finish(&box, NULL);
+  ck_assert_float_eq(box.radius, 0.0f);
+  ck_assert_float_eq(box.min[0], 0.0f);
+  bounds_reset(&box);
+  const float corners[2][3] = {{-1.0f, 0.0f, 2.0f}, {1.0f, 2.0f, 4.0f}};
+  bounds_grow(&box, corners[0], 2);
+  bounds_finish(&box, NULL);
+  ck_assert_float_eq_tol(box.radius, sqrtf(3.0f), 1e-6);
+  ck_assert_float_eq(box.center[2], 3.0f);
+
+  free_memory(NULL, &data);
+}
+
+START_TEST(obj_test15) {
+  // отрицательные номера отсчитываются от последней прочитанной вершины
+  const char* filename = "tests/relative.obj";
+  FILE* file = fopen(filename, "w");
+  ck_assert_ptr_nonnull(file);
+  fputs(
+      "v 0x1p-1 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\nv 0 0 1\n"
+      "f 1 -1 -2/1/1\nf -9 1 2\n",
+      file);
+  fclose(file);
+  const size_t expected[3][3] = {{1, 2, 3}, {1, 4, 3}, {0, 1, 2}};
+
+  for (int parallel = 0; parallel < 2; parallel++) {
+    data_t data = {0};
+    int error_code = parallel
+                         ? parse_obj_file_parallel(filename, &data, 1, NULL)
+                         : parse_obj_file(filename, &data);
+    ck_assert_int_eq(error_code, 0);
+    ck_assert_int_eq(data.count_of_vertices, 4);
+    ck_assert_int_eq(data.count_of_facets, 3);
+    ck_assert_float_eq(matrix_vertex(&data.obj_matrix, 0)[0], 0.5f);
+    for (size_t i = 0; i < 3; i++) {
+      ck_assert_int_eq(facet_size(&data.obj_facets, i), 3);
+      for (size_t k = 0; k < 3; k++) {
+        ck_assert_int_eq(facet_vertex(&data.obj_facets, i, k),
+                         expected[i][k]);
+      }
+    }
+    free_memory(NULL, &data);
+  }
+  remove(filename);
+}
+
 Suite* obj_test_suite() {
   Suite* suite = suite_create("obj_test");
   TCase* tcase = tcase_create("obj_tests_case");
@@ -174,6 +438,14 @@ Suite* obj_test_suite() {
   tcase_add_test(tcase, obj_test5);
   tcase_add_test(tcase, obj_test6);
   tcase_add_test(tcase, obj_test7);
+  tcase_add_test(tcase, obj_test8);
+  tcase_add_test(tcase, obj_test9);
+  tcase_add_test(tcase, obj_test10);
+  tcase_add_test(tcase, obj_test11);
+  tcase_add_test(tcase, obj_test12);
+  tcase_add_test(tcase, obj_test13);
+  tcase_add_test(tcase, obj_test14);
+  tcase_add_test(tcase, obj_test15);
 
   suite_add_tcase(suite, tcase);
 
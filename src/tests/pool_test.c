@@ -0,0 +1,124 @@
+#include "tests.h"
+
+// количество вершин больше порога и не кратно размеру порции
+#define COUNT (VERTEX_PARALLEL_MIN * 3 + 5)
+
+/**
+ * @brief Count visits
+ *
+ * Adds one to the counter of every element of the range.
+ */
+static void count_visits(void* arg, size_t begin, size_t end) {
+  unsigned char* visits = arg;
+  for (size_t i = begin; i < end; i++) {
+    __atomic_fetch_add(&visits[i], 1, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * @brief Count calls
+ *
+ * Counts calls of the body and checks that the range is whole.
+ */
+static void count_calls(void* arg, size_t begin, size_t end) {
+  size_t* calls = arg;
+  ck_assert_uint_eq(begin, 0);
+  ck_assert_uint_eq(end, 100);
+  (*calls)++;
+}
+
+/**
+ * @brief Nested loop
+ *
+ * Starts a loop from the body of another one.
+ */
+static void nested_loop(void* arg, size_t begin, size_t end) {
+  unsigned char* visits = arg;
+  for (size_t i = begin; i < end; i++) {
+    pool_parallel_for(16, 2, count_visits, visits + i * 16);
+  }
+}
+
+START_TEST(pool_test1) {
+  // каждый элемент обрабатывается ровно один раз
+  static unsigned char visits[1 << 20];
+  const size_t counts[] = {0, 1, 2, 7, 1000, 1 << 20};
+  ck_assert_uint_le(1, pool_threads());
+
+  for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+    memset(visits, 0, sizeof(visits));
+    pool_parallel_for(counts[k], 2, count_visits, visits);
+    for (size_t i = 0; i < sizeof(visits); i++) {
+      ck_assert_uint_eq(visits[i], i < counts[k] ? 1 : 0);
+    }
+  }
+
+  // короткий цикл выполняется одним вызовом
+  size_t calls = 0;
+  pool_parallel_for(100, 101, count_calls, &calls);
+  ck_assert_uint_eq(calls, 1);
+}
+
+START_TEST(pool_test2) {
+  // вложенный цикл выполняется без потоков и не блокирует пул
+  static unsigned char visits[64 * 16];
+  pool_parallel_for(64, 2, nested_loop, visits);
+  for (size_t i = 0; i < sizeof(visits); i++) {
+    ck_assert_uint_eq(visits[i], 1);
+  }
+}
+
+START_TEST(pool_test3) {
+  // разделение между потоками не меняет результат ни в одном бите
+  const vertex_kernels_t* kernels = vertex_kernels();
+  const float offsets[3] = {1.5f, -0.0f, -3.25f};
+  const float scales[3] = {0.7f, 1.0f, 2.0f};
+  const float matrix[16] = {0.8f, 0.1f,  -0.3f, 0.0f, -0.2f, 1.1f,
+                            0.4f, 0.0f,  0.5f,  -0.6f, 0.9f, 0.0f,
+                            1.5f, -2.5f, 0.25f, 1.0f};
+  float* expected = malloc(COUNT * 3 * sizeof(float));
+  float* vertices = malloc(COUNT * 3 * sizeof(float));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert_ptr_nonnull(vertices);
+  for (size_t i = 0; i < COUNT * 3; i++) {
+    expected[i] = vertices[i] = (float)(i % 1999) * 0.37f - 300.0f;
+  }
+
+  kernels->add(expected, COUNT, offsets);
+  vertices_add(vertices, COUNT, offsets);
+  kernels->multiply(expected, COUNT, scales);
+  vertices_multiply(vertices, COUNT, scales);
+  kernels->rotate(expected, COUNT, 2, 0, 0.6f, 0.8f);
+  vertices_rotate(vertices, COUNT, 2, 0, 0.6f, 0.8f);
+  kernels->transform(expected, COUNT, matrix);
+  vertices_transform(vertices, COUNT, matrix);
+  ck_assert_mem_eq(vertices, expected, COUNT * 3 * sizeof(float));
+
+  free(expected);
+  free(vertices);
+}
+
+Suite* pool_test_suite() {
+  Suite* suite = suite_create("pool_test");
+  TCase* tcase = tcase_create("pool_test_case");
+
+  tcase_add_test(tcase, pool_test1);
+  tcase_add_test(tcase, pool_test2);
+  tcase_add_test(tcase, pool_test3);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int pool_tests() {
+  Suite* suite = pool_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}
@@ -1,5 +1,50 @@
 #include "tests.h"
 
+/**
+ * @brief Make grid
+ *
+ * Builds a square grid of quads with side cells over the unit square,
+ * lifted by a wave of the given height, with bounds as after loading.
+ * Edges are not built.
+ */
+void make_grid(data_t* data, size_t side, float height) {
+  size_t row = side + 1;
+  *data = (data_t){0};
+  data->count_of_vertices = row * row;
+  data->count_of_facets = side * side;
+  data->obj_matrix.rows = row * row;
+  data->obj_matrix.cols = 3;
+  ck_assert_int_eq(matrix_mem_alloc(data), 0);
+  for (size_t y = 0; y < row; y++) {
+    for (size_t x = 0; x < row; x++) {
+      float* vertex = matrix_vertex(&data->obj_matrix, y * row + x);
+      vertex[0] = (float)x / (float)side;
+      vertex[1] = (float)y / (float)side;
+      vertex[2] = height * sinf(vertex[0] * 6.0f) * cosf(vertex[1] * 5.0f);
+    }
+  }
+
+  data->obj_facets.offsets = malloc((side * side + 1) * sizeof(size_t));
+  data->obj_facets.indices = malloc(side * side * 4 * sizeof(uint32_t));
+  ck_assert_ptr_nonnull(data->obj_facets.offsets);
+  ck_assert_ptr_nonnull(data->obj_facets.indices);
+  uint32_t* indices = data->obj_facets.indices;
+  for (size_t i = 0; i < side * side; i++) {
+    size_t corner = i / side * row + i % side + 1;
+    data->obj_facets.offsets[i] = i * 4;
+    indices[i * 4] = (uint32_t)corner;
+    indices[i * 4 + 1] = (uint32_t)(corner + 1);
+    indices[i * 4 + 2] = (uint32_t)(corner + row + 1);
+    indices[i * 4 + 3] = (uint32_t)(corner + row);
+  }
+  data->obj_facets.offsets[side * side] = side * side * 4;
+  data->obj_facets.count_of_indices = side * side * 4;
+
+  bounds_reset(&data->bounds);
+  bounds_compute(&data->bounds, &data->obj_matrix, 0, row * row);
+  bounds_finish(&data->bounds, &data->obj_matrix);
+}
+
 int main() {
   int result = 0;
 
@@ -7,6 +52,30 @@ int main() {
   putchar('\n');
   result += obj_test();
   putchar('\n');
+  result += number_tests();
+  putchar('\n');
+  result += cache_tests();
+  putchar('\n');
+  result += edges_tests();
+  putchar('\n');
+  result += transform_tests();
+  putchar('\n');
+  result += kernels_tests();
+  putchar('\n');
+  result += pool_tests();
+  putchar('\n');
+  result += history_tests();
+  putchar('\n');
+  result += bounds_tests();
+  putchar('\n');
+  result += camera_tests();
+  putchar('\n');
+  result += lod_tests();
+  putchar('\n');
+  result += bvh_tests();
+  putchar('\n');
+  result += meshlets_tests();
+  putchar('\n');
 
   return result == 0 ? 0 : 1;
 }
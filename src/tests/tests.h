@@ -7,5 +7,20 @@
 
 int affine_tests();
 int obj_test();
+int number_tests();
+int cache_tests();
+int edges_tests();
+int transform_tests();
+int kernels_tests();
+int pool_tests();
+int history_tests();
+int bounds_tests();
+int camera_tests();
+int lod_tests();
+int bvh_tests();
+int meshlets_tests();
+
+// сетка из четырёхугольников для тестов иерархии и уровней детализации
+void make_grid(data_t* data, size_t side, float height);
 
 #endif
@@ -0,0 +1,137 @@
+#include "tests.h"
+
+START_TEST(transform_test1) {
+  // новое преобразование тождественное
+  transform_t transform;
+  transform_reset(&transform);
+  float matrix[16];
+  transform_matrix(&transform, matrix);
+  for (int i = 0; i < 16; i++) {
+    ck_assert_float_eq(matrix[i], i % 5 == 0 ? 1.0f : 0.0f);
+  }
+
+  float vertex[3] = {1.5f, -2.0f, 3.0f};
+  float result[3];
+  transform_vertex(&transform, vertex, result);
+  ck_assert_mem_eq(result, vertex, sizeof(vertex));
+
+  // значения ограничиваются так же, как при изменении вершин
+  transform_move(&transform, OFFSET_LIMIT * 3, 0.0f, -OFFSET_LIMIT * 2);
+  transform_scale(&transform, SCALE_LIMIT_MAX * 5, 1.0f, 1.0f);
+  transform_vertex(&transform, vertex, result);
+  ck_assert_float_eq_tol(result[0], (1.5f + OFFSET_LIMIT) * SCALE_LIMIT_MAX,
+                         1e-3);
+  ck_assert_float_eq_tol(result[2], 3.0f - OFFSET_LIMIT, 1e-6);
+
+  transform_reset(&transform);
+  transform_vertex(&transform, vertex, result);
+  ck_assert_mem_eq(result, vertex, sizeof(vertex));
+}
+
+START_TEST(transform_test2) {
+  // последовательность операций совпадает с изменением самих вершин
+  data_t expected = {0};
+  data_t data = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/cube.obj", &expected), 0);
+  ck_assert_int_eq(parse_obj_file("frontend/objects/cube.obj", &data), 0);
+
+  transform_t transform;
+  transform_reset(&transform);
+
+  scale_even(&expected.obj_matrix, 0.5f);
+  transform_scale(&transform, 0.5f, 0.5f, 0.5f);
+  move_by_ox(&expected.obj_matrix, 0.3f);
+  move_by_oy(&expected.obj_matrix, -0.2f);
+  transform_move(&transform, 0.3f, -0.2f, 0.0f);
+  for (int i = 0; i < 30; i++) {
+    rotate_by_ox(&expected.obj_matrix, 7.0f);
+    transform_rotate_by_ox(&transform, 7.0f);
+    rotate_by_oy(&expected.obj_matrix, -11.0f);
+    transform_rotate_by_oy(&transform, -11.0f);
+    rotate_by_oz(&expected.obj_matrix, 13.0f);
+    transform_rotate_by_oz(&transform, 13.0f);
+  }
+  move_by_oz(&expected.obj_matrix, 0.7f);
+  transform_move(&transform, 0.0f, 0.0f, 0.7f);
+  scale_by_ox(&expected.obj_matrix, 2.0f);
+  transform_scale(&transform, 2.0f, 1.0f, 1.0f);
+
+  transform_apply(&transform, &data.obj_matrix);
+  for (size_t i = 0; i < data.count_of_vertices; i++) {
+    const float *vertex = matrix_vertex(&data.obj_matrix, i);
+    const float *expected_vertex = matrix_vertex(&expected.obj_matrix, i);
+    for (int k = 0; k < 3; k++) {
+      ck_assert_float_eq_tol(vertex[k], expected_vertex[k], 1e-4);
+    }
+  }
+
+  free_memory(NULL, &data);
+  free_memory(NULL, &expected);
+}
+
+START_TEST(transform_test3) {
+  // пакет операций равен тем же операциям по одной
+  const operation_t operations[] = {{OPERATION_SCALE, 0.5f, 0.5f, 0.5f},
+                                    {OPERATION_ROTATE, 30.0f, -45.0f, 60.0f},
+                                    {OPERATION_MOVE, 0.1f, 0.0f, -0.4f},
+                                    {OPERATION_ROTATE, 0.0f, 0.0f, 90.0f}};
+  transform_t expected;
+  transform_reset(&expected);
+  transform_scale(&expected, 0.5f, 0.5f, 0.5f);
+  transform_rotate_by_ox(&expected, 30.0f);
+  transform_rotate_by_oy(&expected, -45.0f);
+  transform_rotate_by_oz(&expected, 60.0f);
+  transform_move(&expected, 0.1f, 0.0f, -0.4f);
+  transform_rotate_by_oz(&expected, 90.0f);
+
+  transform_t transform;
+  transform_reset(&transform);
+  transform_compose(&transform, operations, 4);
+  ck_assert_mem_eq(transform.model, expected.model, sizeof(expected.model));
+
+  // один проход по вершинам вместо шести
+  data_t data = {0};
+  data_t passes = {0};
+  ck_assert_int_eq(parse_obj_file("frontend/objects/pyramid.obj", &data), 0);
+  ck_assert_int_eq(parse_obj_file("frontend/objects/pyramid.obj", &passes), 0);
+  apply_operations(&data.obj_matrix, operations, 4);
+  scale_even(&passes.obj_matrix, 0.5f);
+  rotate_by_ox(&passes.obj_matrix, 30.0f);
+  rotate_by_oy(&passes.obj_matrix, -45.0f);
+  rotate_by_oz(&passes.obj_matrix, 60.0f);
+  move_by_ox(&passes.obj_matrix, 0.1f);
+  move_by_oz(&passes.obj_matrix, -0.4f);
+  rotate_by_oz(&passes.obj_matrix, 90.0f);
+  for (size_t i = 0; i < data.count_of_vertices * 3; i++) {
+    ck_assert_float_eq_tol(data.obj_matrix.matrix[i],
+                           passes.obj_matrix.matrix[i], 1e-5);
+  }
+
+  free_memory(NULL, &data);
+  free_memory(NULL, &passes);
+}
+
+Suite* transform_test_suite() {
+  Suite* suite = suite_create("transform_test");
+  TCase* tcase = tcase_create("transform_test_case");
+
+  tcase_add_test(tcase, transform_test1);
+  tcase_add_test(tcase, transform_test2);
+  tcase_add_test(tcase, transform_test3);
+
+  suite_add_tcase(suite, tcase);
+
+  return suite;
+}
+
+int transform_tests() {
+  Suite* suite = transform_test_suite();
+  SRunner* srunner = srunner_create(suite);
+
+  srunner_set_fork_status(srunner, CK_NOFORK);
+  srunner_run_all(srunner, CK_NORMAL);
+  int failed = srunner_ntests_failed(srunner);
+  srunner_free(srunner);
+
+  return failed;
+}